@@ -0,0 +1,1393 @@
+#include "benchmark.h"
+#include "headless_context.h"
+#include "image.h"
+#include "instancing.h"
+#include "light_clusters.h"
+#include "logger.h"
+#include "mesh.h"
+#include "mesh_normals.h"
+#include "mesh_reader.h"
+#include "occlusion_culling.h"
+#include "parallel.h"
+#include "scene_graph.h"
+#include "shader_program.h"
+#include "texture.h"
+#include "texture_cache.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+// Mesh pipeline benchmarks
+// Reading Wavefront OBJ files, building GPU ready vertices from them and
+// compiling shaders are timed on the bundled meshes and on generated meshes
+// of every face form, scene graph updates on orbit scenes, and texture loads
+// with and without their cache on generated images in every texture format,
+// reporting throughput, peak resident set size and heap allocations as JSON
+// to compare across commits.
+
+namespace {
+
+// Heap allocations through operator new since startup
+std::atomic<size_t> ALLOCATIONS(0);
+std::atomic<size_t> ALLOCATED_BYTES(0);
+
+// Bytes of generated files written at once
+const size_t WRITE_BUFFER_BYTES = 1 << 20;
+
+// One node in this many is changed by partial scene graph updates
+const uint32_t PARTIAL_UPDATE_STRIDE = 64;
+
+// Face forms of generated meshes
+enum FaceForm {
+    FACE_FORM_V = 0,
+    FACE_FORM_V_VT = 1,
+    FACE_FORM_V_VN = 2,
+    FACE_FORM_V_VT_VN = 3
+};
+
+const FaceForm FACE_FORMS[] = { FACE_FORM_V, FACE_FORM_V_VT, FACE_FORM_V_VN, FACE_FORM_V_VT_VN };
+
+const char * faceFormName(FaceForm form) {
+    switch (form) {
+    case FACE_FORM_V_VT:
+        return "v/vt";
+    case FACE_FORM_V_VN:
+        return "v//vn";
+    case FACE_FORM_V_VT_VN:
+        return "v/vt/vn";
+    default:
+        return "v";
+    }
+}
+
+// Parse face form name (v, v/vt, v//vn or v/vt/vn)
+bool parseFaceForm(const std::string & name, FaceForm & form) {
+    for (size_t i = 0; i < sizeof(FACE_FORMS) / sizeof(FACE_FORMS[0]); i++) {
+        if (name == faceFormName(FACE_FORMS[i])) {
+            form = FACE_FORMS[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool hasTextureCoordinates(FaceForm form) {
+    return form == FACE_FORM_V_VT || form == FACE_FORM_V_VT_VN;
+}
+
+bool hasNormals(FaceForm form) {
+    return form == FACE_FORM_V_VN || form == FACE_FORM_V_VT_VN;
+}
+
+// Split comma separated list
+std::vector<std::string> splitList(const std::string & list) {
+    std::vector<std::string> items;
+    size_t start = 0;
+
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+
+        if (end == std::string::npos)
+            end = list.size();
+
+        if (end > start)
+            items.push_back(list.substr(start, end - start));
+
+        start = end + 1;
+    }
+
+    return items;
+}
+
+// Parse count with an optional K or M suffix
+bool parseCount(const std::string & text, size_t & count) {
+    char * end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+
+    if (end == text.c_str() || value <= 0.0)
+        return false;
+
+    if (*end == 'K' || *end == 'k') {
+        value *= 1e3;
+        end++;
+    }
+    else if (*end == 'M' || *end == 'm') {
+        value *= 1e6;
+        end++;
+    }
+
+    if (*end != '\0')
+        return false;
+
+    count = (size_t)(value + 0.5);
+
+    return true;
+}
+
+// Buffered file writer of the text of generated meshes
+class TextWriter {
+public:
+    TextWriter() : file(nullptr), used(0), buffer(WRITE_BUFFER_BYTES), failed(false) {
+    }
+
+    ~TextWriter() {
+        close();
+    }
+
+    bool open(const std::string & filename) {
+        close();
+
+        file = std::fopen(filename.c_str(), "wb");
+        failed = false;
+
+        return file != nullptr;
+    }
+
+    // Flush and close, returning false when a write failed
+    bool close() {
+        if (file == nullptr)
+            return true;
+
+        flush();
+
+        bool success = std::fclose(file) == 0 && !failed;
+        file = nullptr;
+
+        return success;
+    }
+
+    void put(char c) {
+        if (used == buffer.size())
+            flush();
+
+        buffer[used++] = c;
+    }
+
+    void put(const char * text, size_t length) {
+        if (used + length > buffer.size())
+            flush();
+
+        std::memcpy(buffer.data() + used, text, length);
+        used += length;
+    }
+
+    void put(uint64_t value) {
+        char digits[20];
+        size_t length = 0;
+
+        do {
+            digits[length++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+
+        while (length > 0)
+            put(digits[--length]);
+    }
+
+    void put(float value) {
+        char text[32];
+        int length = std::snprintf(text, sizeof(text), "%.6g", value);
+
+        put(text, (size_t)length);
+    }
+
+private:
+    TextWriter(const TextWriter &);
+    TextWriter & operator=(const TextWriter &);
+
+    void flush() {
+        failed = failed || std::fwrite(buffer.data(), 1, used, file) != used;
+        used = 0;
+    }
+
+    std::FILE * file;
+    size_t used;
+    std::vector<char> buffer;
+    bool failed;
+};
+
+// Write a wavy height field of the given triangle count in the given face
+// form, a grid of quads split in two triangles with every attribute stored
+// per grid point, returning the number of grid points
+bool writeGeneratedMesh(const std::string & filename, size_t triangles, FaceForm form, size_t & points) {
+    TextWriter writer;
+
+    if (!writer.open(filename))
+        return false;
+
+    size_t quads = (triangles + 1) / 2;
+    size_t columns = std::max<size_t>((size_t)std::sqrt((double)quads), 1);
+    size_t rows = (quads + columns - 1) / columns;
+
+    points = (columns + 1) * (rows + 1);
+
+    writer.put("# Generated mesh\n", 17);
+
+    for (size_t j = 0; j <= rows; j++) {
+        for (size_t i = 0; i <= columns; i++) {
+            float x = (float)i / columns * 2.0f - 1.0f;
+            float z = (float)j / columns * 2.0f - 1.0f;
+            float y = 0.05f * std::sin(7.0f * x) * std::cos(5.0f * z);
+
+            writer.put("v ", 2);
+            writer.put(x);
+            writer.put(' ');
+            writer.put(y);
+            writer.put(' ');
+            writer.put(z);
+            writer.put('\n');
+        }
+    }
+
+    if (hasTextureCoordinates(form)) {
+        for (size_t j = 0; j <= rows; j++) {
+            for (size_t i = 0; i <= columns; i++) {
+                writer.put("vt ", 3);
+                writer.put((float)i / columns);
+                writer.put(' ');
+                writer.put((float)j / rows);
+                writer.put('\n');
+            }
+        }
+    }
+
+    if (hasNormals(form)) {
+        for (size_t j = 0; j <= rows; j++) {
+            for (size_t i = 0; i <= columns; i++) {
+                float x = (float)i / columns * 2.0f - 1.0f;
+                float z = (float)j / columns * 2.0f - 1.0f;
+
+                // Gradient of the height field
+                float dx = 0.35f * std::cos(7.0f * x) * std::cos(5.0f * z);
+                float dz = -0.25f * std::sin(7.0f * x) * std::sin(5.0f * z);
+
+                glm::vec3 normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+
+                writer.put("vn ", 3);
+                writer.put(normal.x);
+                writer.put(' ');
+                writer.put(normal.y);
+                writer.put(' ');
+                writer.put(normal.z);
+                writer.put('\n');
+            }
+        }
+    }
+
+    // Every attribute has the index of the grid point, one based
+    for (size_t t = 0; t < triangles; t++) {
+        size_t quad = t / 2;
+        size_t i = quad % columns;
+        size_t j = quad / columns;
+
+        size_t corner = j * (columns + 1) + i + 1;
+        size_t above = corner + columns + 1;
+
+        size_t corners[3];
+
+        if (t % 2 == 0) {
+            corners[0] = corner;
+            corners[1] = above;
+            corners[2] = corner + 1;
+        }
+        else {
+            corners[0] = corner + 1;
+            corners[1] = above;
+            corners[2] = above + 1;
+        }
+
+        writer.put('f');
+
+        for (int k = 0; k < 3; k++) {
+            writer.put(' ');
+            writer.put((uint64_t)corners[k]);
+
+            if (form == FACE_FORM_V_VT) {
+                writer.put('/');
+                writer.put((uint64_t)corners[k]);
+            }
+            else if (form == FACE_FORM_V_VN) {
+                writer.put("//", 2);
+                writer.put((uint64_t)corners[k]);
+            }
+            else if (form == FACE_FORM_V_VT_VN) {
+                writer.put('/');
+                writer.put((uint64_t)corners[k]);
+                writer.put('/');
+                writer.put((uint64_t)corners[k]);
+            }
+        }
+
+        writer.put('\n');
+    }
+
+    return writer.close();
+}
+
+// Write a square image of smooth color waves over noise and alpha tiles,
+// the content of a typical color texture, to TGA file
+bool writeGeneratedTexture(const std::string & filename, size_t side) {
+    std::vector<uint32_t> pixels(side * side);
+    uint32_t random = 1;
+
+    for (size_t y = 0; y < side; y++) {
+        for (size_t x = 0; x < side; x++) {
+            random = random * 1103515245u + 12345u;
+            float noise = ((random >> 16) & 31) - 16.0f;
+
+            float u = (float)x / side, v = (float)y / side;
+            float r = 128.0f + 100.0f * std::sin(19.0f * u + 3.0f * v) + noise;
+            float g = 128.0f + 90.0f * std::cos(23.0f * v - 5.0f * u) + noise;
+            float b = 128.0f + 110.0f * std::sin(11.0f * (u + v)) * std::cos(7.0f * u) + noise;
+            uint32_t a = ((x * 8 / side) + (y * 8 / side)) % 2 ? 255 : 96;
+
+            pixels[y * side + x] =
+                (uint32_t)std::min(std::max(r, 0.0f), 255.0f) |
+                ((uint32_t)std::min(std::max(g, 0.0f), 255.0f) << 8) |
+                ((uint32_t)std::min(std::max(b, 0.0f), 255.0f) << 16) |
+                (a << 24);
+        }
+    }
+
+    return writeTga(filename, side, side, pixels.data());
+}
+
+// Value in bytes of a kB field of /proc/self/status, 0 when unavailable
+size_t readStatusBytes(const std::string & field) {
+    std::ifstream file("/proc/self/status");
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (line.compare(0, field.size(), field) == 0 && line.size() > field.size() && line[field.size()] == ':')
+            return (size_t)std::strtoull(line.c_str() + field.size() + 1, nullptr, 10) * 1024;
+    }
+
+    return 0;
+}
+
+size_t residentBytes() {
+    return readStatusBytes("VmRSS");
+}
+
+// Largest resident set size since the last reset, or since startup when
+// resets are unsupported
+size_t peakResidentBytes() {
+    size_t bytes = readStatusBytes("VmHWM");
+
+#ifdef __linux__
+    if (bytes == 0) {
+        struct rusage usage;
+
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+            bytes = (size_t)usage.ru_maxrss * 1024;
+    }
+#endif
+
+    return bytes;
+}
+
+// Reset the peak resident set size to the current one, false when unsupported
+bool resetPeakResident() {
+    std::ofstream file("/proc/self/clear_refs");
+    file << "5" << std::endl;
+
+    return file.good();
+}
+
+// Measurements of a stage run repeatedly on the same input
+struct StageResult {
+    std::string stage;
+    std::string input;
+    std::string form;
+
+    size_t triangles;
+    size_t vertices;
+    size_t bytes;
+
+    // Scene graph nodes updated by every run
+    size_t nodes;
+
+    // Lights binned into clusters by every run
+    size_t lights;
+
+    // Instances culled against the occlusion buffer by every run
+    size_t instances;
+
+    // Wall time of every run
+    std::vector<double> seconds;
+
+    // Resident set size before the first run and largest one over the runs,
+    // which includes the input of the stage
+    size_t residentBytes;
+    size_t peakResidentBytes;
+    bool peakReset;
+
+    // Heap allocations through operator new per run, averaged
+    double allocations;
+    double allocatedBytes;
+};
+
+// Run a stage the given number of times, preparing its input before every
+// run outside of the measurements, and stop at the first failed run
+bool measureStage(
+        size_t runs,
+        const std::function<void()> & prepare,
+        const std::function<bool()> & run,
+        StageResult & result) {
+    result.seconds.clear();
+    result.residentBytes = residentBytes();
+    result.peakReset = resetPeakResident();
+
+    size_t allocations = 0;
+    size_t allocatedBytes = 0;
+
+    for (size_t i = 0; i < runs; i++) {
+        prepare();
+
+        size_t allocationsBefore = ALLOCATIONS.load();
+        size_t bytesBefore = ALLOCATED_BYTES.load();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if (!run())
+            return false;
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        allocations += ALLOCATIONS.load() - allocationsBefore;
+        allocatedBytes += ALLOCATED_BYTES.load() - bytesBefore;
+
+        result.seconds.push_back(elapsed.count());
+    }
+
+    result.peakResidentBytes = peakResidentBytes();
+    result.allocations = allocations / (double)std::max<size_t>(runs, 1);
+    result.allocatedBytes = allocatedBytes / (double)std::max<size_t>(runs, 1);
+
+    return true;
+}
+
+// Duration of the median run in seconds
+double medianSeconds(const StageResult & result) {
+    return summarizeFrameTimes(result.seconds).p50 / 1000.0;
+}
+
+void printStageResult(const StageResult & result) {
+    double seconds = std::max(medianSeconds(result), 1e-9);
+
+    LogLine line;
+
+    line << result.stage << " " << result.input << " (" << result.form << "): "
+         << seconds * 1000.0 << " ms median of " << result.seconds.size() << ", ";
+
+    if (result.triangles > 0)
+        line << result.triangles / seconds / 1e6 << " M triangles/s, ";
+
+    if (result.nodes > 0)
+        line << result.nodes / seconds / 1e6 << " M nodes/s, ";
+
+    if (result.lights > 0)
+        line << result.lights / seconds / 1e6 << " M lights/s, ";
+
+    if (result.instances > 0)
+        line << result.instances / seconds / 1e6 << " M instances/s, ";
+
+    line << result.bytes / seconds / (1024.0 * 1024.0) << " MB/s, peak RSS "
+         << result.peakResidentBytes / (1024.0 * 1024.0) << " MB, "
+         << result.allocations << " allocations of "
+         << result.allocatedBytes / (1024.0 * 1024.0) << " MB";
+}
+
+void writeStageJson(std::ostream & stream, const StageResult & result) {
+    double seconds = std::max(medianSeconds(result), 1e-9);
+
+    stream << "    {" << std::endl;
+
+    stream << "      \"stage\": ";
+    writeJsonString(stream, result.stage);
+    stream << "," << std::endl;
+
+    stream << "      \"input\": ";
+    writeJsonString(stream, result.input);
+    stream << "," << std::endl;
+
+    stream << "      \"form\": ";
+    writeJsonString(stream, result.form);
+    stream << "," << std::endl;
+
+    stream << "      \"triangles\": " << result.triangles << "," << std::endl;
+    stream << "      \"vertices\": " << result.vertices << "," << std::endl;
+    stream << "      \"bytes\": " << result.bytes << "," << std::endl;
+    stream << "      \"nodes\": " << result.nodes << "," << std::endl;
+    stream << "      \"lights\": " << result.lights << "," << std::endl;
+    stream << "      \"instances\": " << result.instances << "," << std::endl;
+    stream << "      \"runs\": " << result.seconds.size() << "," << std::endl;
+
+    stream << "      \"ms\": ";
+    writeJsonSummary(stream, result.seconds);
+    stream << "," << std::endl;
+
+    stream << "      \"trianglesPerSecond\": " << result.triangles / seconds << "," << std::endl;
+    stream << "      \"nodesPerSecond\": " << result.nodes / seconds << "," << std::endl;
+    stream << "      \"lightsPerSecond\": " << result.lights / seconds << "," << std::endl;
+    stream << "      \"instancesPerSecond\": " << result.instances / seconds << "," << std::endl;
+    stream << "      \"megabytesPerSecond\": " << result.bytes / seconds / (1024.0 * 1024.0) << "," << std::endl;
+    stream << "      \"residentBytes\": " << result.residentBytes << "," << std::endl;
+    stream << "      \"peakResidentBytes\": " << result.peakResidentBytes << "," << std::endl;
+    stream << "      \"peakReset\": " << (result.peakReset ? "true" : "false") << "," << std::endl;
+    stream << "      \"allocations\": " << result.allocations << "," << std::endl;
+    stream << "      \"allocatedBytes\": " << result.allocatedBytes << std::endl;
+
+    stream << "    }";
+}
+
+// Copy triangle mesh into another one, reusing its arena
+void copyTriangleMesh(const TriangleMesh & source, TriangleMesh & mesh) {
+    const TriangleMeshCounts & counts = source.counts();
+
+    mesh.allocate(counts);
+
+    std::memcpy(mesh.positions(), source.positions(), counts.positions * sizeof(glm::vec3));
+    std::memcpy(mesh.normals(), source.normals(), counts.normals * sizeof(glm::vec3));
+    std::memcpy(mesh.textureCoordinates(), source.textureCoordinates(), counts.textureCoordinates * sizeof(glm::vec2));
+    std::memcpy(mesh.positionIndices(), source.positionIndices(), counts.positionIndices * sizeof(uint32_t));
+    std::memcpy(mesh.normalIndices(), source.normalIndices(), counts.normalIndices * sizeof(uint32_t));
+    std::memcpy(
+        mesh.textureCoordinateIndices(),
+        source.textureCoordinateIndices(),
+        counts.textureCoordinateIndices * sizeof(uint32_t));
+}
+
+// Options of a benchmark run
+struct BenchmarkOptions {
+    bool read;
+    bool build;
+    bool shader;
+    bool scene;
+    bool texture;
+    bool lights;
+    bool occlusion;
+
+    size_t runs;
+    MeshOptions mesh;
+};
+
+// Benchmark reading a mesh file and building its vertices, appending results
+bool benchmarkMesh(
+        const std::string & filename,
+        const std::string & form,
+        const BenchmarkOptions & options,
+        std::vector<StageResult> & results) {
+    TriangleMesh mesh;
+    MeshReadStatistics readStatistics;
+
+    StageResult read;
+    read.stage = "read";
+    read.input = filename;
+    read.form = form;
+
+    // Read once more when only building, the runs being discarded
+    bool success = measureStage(
+        options.read ? options.runs : 1,
+        [&]() {
+            mesh.clear();
+        },
+        [&]() {
+            return readTriangleMesh(filename, mesh, &readStatistics);
+        },
+        read);
+
+    if (!success) {
+        LogLine() << "Cannot read " << filename << ".";
+        return false;
+    }
+
+    read.triangles = mesh.triangleCount();
+    read.nodes = 0;
+    read.lights = 0;
+    read.instances = 0;
+    read.vertices = mesh.counts().positions;
+    read.bytes = readStatistics.bytes;
+
+    if (options.read) {
+        printStageResult(read);
+        results.push_back(read);
+    }
+
+    if (!options.build)
+        return true;
+
+    // Vertex build of loadTriangleMesh: normal generation when missing,
+    // vertex deduplication and packing
+    TriangleMesh triangles;
+    IndexedMesh indexed;
+    PackedMesh packed;
+
+    StageResult build;
+    build.stage = "build";
+    build.input = filename;
+    build.form = form;
+
+    measureStage(
+        options.runs,
+        [&]() {
+            copyTriangleMesh(mesh, triangles);
+
+            indexed = IndexedMesh();
+            packed = PackedMesh();
+        },
+        [&]() {
+            if (triangles.counts().normalIndices != triangles.counts().positionIndices &&
+                    triangles.triangleCount() > 0)
+                generateNormals(triangles, options.mesh.normalWeighting, options.mesh.creaseAngle);
+
+            if (!buildIndexedMesh(triangles, indexed))
+                return false;
+
+            packMesh(indexed, options.mesh.vertexFormat, packed);
+
+            return true;
+        },
+        build);
+
+    build.triangles = mesh.triangleCount();
+    build.nodes = 0;
+    build.lights = 0;
+    build.instances = 0;
+    build.vertices = packed.vertexCount;
+    build.bytes = packed.vertices.size() + packed.indices.size();
+
+    printStageResult(build);
+    results.push_back(build);
+
+    return true;
+}
+
+// Benchmark compiling a shader, appending its result
+bool benchmarkShader(
+        const std::string & filename,
+        GLenum type,
+        const BenchmarkOptions & options,
+        std::vector<StageResult> & results) {
+    std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+
+    StageResult shader;
+    shader.stage = "shader";
+    shader.input = filename;
+    shader.form = type == GL_VERTEX_SHADER ? "vertex" : "fragment";
+    shader.triangles = 0;
+    shader.vertices = 0;
+    shader.nodes = 0;
+    shader.lights = 0;
+    shader.instances = 0;
+    shader.bytes = file.is_open() ? (size_t)file.tellg() : 0;
+
+    GLuint id = 0;
+
+    bool success = measureStage(
+        options.runs,
+        [&]() {
+            if (id != 0)
+                glDeleteShader(id);
+
+            id = 0;
+        },
+        [&]() {
+            return compileShader(filename, type, id);
+        },
+        shader);
+
+    if (id != 0)
+        glDeleteShader(id);
+
+    if (!success) {
+        LogLine() << "Cannot compile " << filename << ".";
+        return false;
+    }
+
+    printStageResult(shader);
+    results.push_back(shader);
+
+    return true;
+}
+
+// Benchmark updating every node of an orbit scene and the dirty subtrees
+// of a fraction of its nodes, appending results
+void benchmarkScene(size_t nodeCount, const BenchmarkOptions & options, std::vector<StageResult> & results) {
+    SceneGraph scene;
+    std::vector<glm::vec4> colors;
+
+    buildOrbitScene(nodeCount, glm::vec3(0.0f), 1.0f, scene, colors);
+    scene.update();
+
+    for (int partial = 0; partial < 2; partial++) {
+        SceneUpdateStatistics statistics = { 0, 0, 0, 0.0 };
+
+        StageResult update;
+        update.stage = "scene";
+        update.input = "orbit scene of " + std::to_string(scene.size()) + " nodes";
+        update.form = partial ? "partial" : "full";
+        update.triangles = 0;
+        update.vertices = 0;
+
+        // Change the roots, or one node in a stride, outside of the runs
+        measureStage(
+            options.runs,
+            [&]() {
+                for (uint32_t i = 0; i < scene.size(); i++)
+                    if (partial ? i % PARTIAL_UPDATE_STRIDE == 0 : scene.parent(i) == NO_PARENT)
+                        scene.setLocal(i, scene.local(i));
+            },
+            [&]() {
+                scene.update(&statistics);
+                return true;
+            },
+            update);
+
+        update.nodes = statistics.updatedNodes;
+        update.lights = 0;
+        update.instances = 0;
+        update.bytes = statistics.updatedNodes * sizeof(glm::mat4);
+
+        printStageResult(update);
+        results.push_back(update);
+    }
+}
+
+// Benchmark binning a light field spread over a square of instances into
+// the clusters of a view looking at it from above one of its sides, the
+// lights moving between runs, appending results
+void benchmarkLights(size_t lightCount, const BenchmarkOptions & options, std::vector<StageResult> & results) {
+    float extent = 60.0f;
+
+    std::vector<Light> field;
+    std::vector<Light> lights;
+    buildLightField(lightCount, glm::vec3(-extent, 1.5f, -extent), glm::vec3(extent, 3.0f, extent), field);
+
+    glm::mat4 view = glm::lookAt(
+        glm::vec3(0.0f, extent * 0.6f, extent * 1.2f),
+        glm::vec3(0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(45.0f, 1024.0f / 768.0f, 0.001f, 1000.0f);
+
+    LightClusters clusters;
+    LightBinningStatistics statistics = { 0, 0, 0, 0, 0, 0, 0.0 };
+    size_t run = 0;
+
+    StageResult binning;
+    binning.stage = "lights";
+    binning.input = "light field of " + std::to_string(field.size()) + " lights";
+    binning.form = "binning";
+    binning.triangles = 0;
+    binning.vertices = 0;
+    binning.nodes = 0;
+    binning.instances = 0;
+
+    measureStage(
+        options.runs,
+        [&]() {
+            animateLightField(field, run++ / 60.0f, lights);
+        },
+        [&]() {
+            clusters.update(lights, view, projection, &statistics);
+            return true;
+        },
+        binning);
+
+    // Throughput in bytes of the uploaded light data and index lists
+    binning.lights = field.size();
+    binning.bytes = (clusters.lightData().size() + clusters.lightIndices().size()) * sizeof(float) +
+        clusters.clusterRanges().size() * sizeof(uint32_t);
+
+    printStageResult(binning);
+    results.push_back(binning);
+
+    LogLine() << "Lights " << field.size() << ": " << statistics.visibleLights << " visible, "
+              << statistics.indices << " light indices in " << statistics.litClusters << " of "
+              << CLUSTER_COUNT << " clusters (at most " << statistics.maximumClusterLights
+              << " lights), " << statistics.tasks << " tasks";
+}
+
+// Benchmark occlusion culling squares of instances of a mesh seen from
+// the height of the instances, the nearest rows hiding the farther ones,
+// appending results
+bool benchmarkOcclusion(
+        const std::string & filename,
+        const std::vector<size_t> & instanceCounts,
+        const BenchmarkOptions & options,
+        std::vector<StageResult> & results) {
+    TriangleMesh mesh;
+
+    if (!readTriangleMesh(filename, mesh)) {
+        LogLine() << "Cannot read " << filename << ".";
+        return false;
+    }
+
+    const TriangleMeshCounts & counts = mesh.counts();
+    std::vector<glm::vec3> positions(mesh.positions(), mesh.positions() + counts.positions);
+    std::vector<uint32_t> indices(mesh.positionIndices(), mesh.positionIndices() + counts.positionIndices);
+
+    OccluderMesh occluder;
+    buildOccluderMesh(positions, indices, OCCLUDER_TRIANGLES, occluder);
+
+    // Bounding sphere around the bounding box, as instances are scaled
+    glm::vec3 center = 0.5f * (occluder.minimum + occluder.maximum);
+    float radius = 0.5f * glm::distance(occluder.minimum, occluder.maximum);
+
+    LogLine() << "Occluder of " << filename << ": " << occluder.indices.size() / 3 << " of "
+              << indices.size() / 3 << " triangles";
+
+    glm::mat4 projection = glm::perspective(45.0f, 1024.0f / 768.0f, 0.001f, 1000.0f);
+
+    for (size_t i = 0; i < instanceCounts.size(); i++) {
+        size_t side = std::max((size_t)std::sqrt((double)instanceCounts[i]), (size_t)1);
+
+        std::vector<InstanceData> grid;
+        std::vector<glm::mat4> models;
+        std::vector<glm::vec4> colors;
+        buildInstanceGrid(side, center, radius, grid);
+
+        // Instances are unit spheres 2.5 units apart
+        float extent = side * 1.25f;
+
+        glm::mat4 view = glm::lookAt(
+            glm::vec3(0.0f, 0.5f, extent + 2.0f),
+            glm::vec3(0.0f, 0.0f, 0.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f));
+
+        OcclusionBuffer buffer;
+        std::vector<unsigned char> occluded;
+        OcclusionStatistics statistics = { 0, 0, 0, 0, 0.0, 0.0 };
+        size_t run = 0;
+
+        StageResult culling;
+        culling.stage = "occlusion";
+        culling.input = "grid of " + std::to_string(grid.size()) + " instances";
+        culling.form = "culling";
+        culling.triangles = 0;
+        culling.vertices = 0;
+        culling.nodes = 0;
+        culling.lights = 0;
+
+        measureStage(
+            options.runs,
+            [&]() {
+                animateInstanceGrid(grid, run++ / 60.0f, models, colors);
+            },
+            [&]() {
+                cullOccludedInstances(
+                    models.data(),
+                    models.size(),
+                    occluder,
+                    center,
+                    radius,
+                    view,
+                    projection,
+                    buffer,
+                    occluded,
+                    &statistics);
+                return true;
+            },
+            culling);
+
+        // Throughput in occluder triangles rasterized and instances tested
+        culling.triangles = statistics.triangles;
+        culling.instances = grid.size();
+        culling.bytes = grid.size() * sizeof(glm::mat4);
+
+        printStageResult(culling);
+        results.push_back(culling);
+
+        LogLine() << "Occlusion " << grid.size() << ": " << statistics.occluded << " occluded and "
+                  << statistics.tested - statistics.occluded << " visible of " << statistics.tested
+                  << " tested behind " << statistics.occluders << " occluders (" << statistics.triangles
+                  << " triangles), rendered in " << statistics.renderSeconds * 1000.0 << " ms, tested in "
+                  << statistics.testSeconds * 1000.0 << " ms";
+    }
+
+    return true;
+}
+
+// Benchmark loading a texture in every format, built from the image with
+// its cache removed and uploaded from the cache, appending results
+bool benchmarkTexture(
+        const std::string & filename,
+        const std::vector<TextureFormat> & formats,
+        const BenchmarkOptions & options,
+        std::vector<StageResult> & results) {
+    std::string cacheFilename = textureCacheFilename(filename);
+    bool success = true;
+
+    for (size_t i = 0; i < formats.size(); i++) {
+        if (!supportsTextureFormat(formats[i])) {
+            LogLine() << "Texture format " << textureFormatName(formats[i]) << " is not supported, skipping.";
+            continue;
+        }
+
+        TextureStatistics statistics;
+        GLuint texture = 0;
+        double medians[2] = { 0.0, 0.0 };
+
+        for (int cached = 0; cached < 2; cached++) {
+            StageResult load;
+            load.stage = "texture";
+            load.input = filename;
+            load.form = std::string(textureFormatName(formats[i])) + (cached ? " cached" : " cold");
+            load.triangles = 0;
+            load.vertices = 0;
+            load.nodes = 0;
+            load.lights = 0;
+            load.instances = 0;
+
+            // Waits for the upload so that it counts in full
+            bool loaded = measureStage(
+                options.runs,
+                [&]() {
+                    glDeleteTextures(1, &texture);
+                    texture = 0;
+
+                    if (!cached)
+                        std::remove(cacheFilename.c_str());
+                },
+                [&]() {
+                    bool success = loadTexture(filename, formats[i], texture, &statistics);
+                    glFinish();
+
+                    return success && statistics.cached == (cached != 0);
+                },
+                load);
+
+            if (!loaded) {
+                LogLine() << "Cannot load " << filename << " in " << load.form << ".";
+                success = false;
+                break;
+            }
+
+            // Throughput in bytes of video memory
+            load.bytes = statistics.bytes;
+            medians[cached] = medianSeconds(load);
+
+            printStageResult(load);
+            results.push_back(load);
+        }
+
+        glDeleteTextures(1, &texture);
+
+        LogLine() << textureFormatName(formats[i]) << " " << filename << ": "
+                  << statistics.bytes / (1024.0 * 1024.0) << " MB of video memory instead of "
+                  << statistics.uncompressedBytes / (1024.0 * 1024.0) << " MB uncompressed ("
+                  << 100.0 - 100.0 * statistics.bytes / std::max<size_t>(statistics.uncompressedBytes, 1)
+                  << "% saved), loaded in " << medians[0] * 1000.0 << " ms cold and "
+                  << medians[1] * 1000.0 << " ms cached";
+    }
+
+    std::remove(cacheFilename.c_str());
+
+    return success;
+}
+
+void writeResultsJson(
+        std::ostream & stream,
+        const std::string & label,
+        const BenchmarkOptions & options,
+        const std::vector<StageResult> & results) {
+    stream << "{" << std::endl;
+
+    stream << "  \"label\": ";
+    writeJsonString(stream, label);
+    stream << "," << std::endl;
+
+    stream << "  \"threads\": " << threadCount() << "," << std::endl;
+    stream << "  \"runs\": " << options.runs << "," << std::endl;
+    stream << "  \"vertexFormat\": \"" << vertexFormatName(options.mesh.vertexFormat) << "\"," << std::endl;
+    stream << "  \"results\": [" << std::endl;
+
+    for (size_t i = 0; i < results.size(); i++) {
+        writeStageJson(stream, results[i]);
+        stream << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+
+    stream << "  ]" << std::endl;
+    stream << "}" << std::endl;
+}
+
+}
+
+// Count every allocation of the benchmark process
+void * operator new(size_t size) {
+    ALLOCATIONS++;
+    ALLOCATED_BYTES += size;
+
+    void * pointer = std::malloc(size > 0 ? size : 1);
+
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+
+    return pointer;
+}
+
+void * operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void * pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void * pointer) noexcept {
+    std::free(pointer);
+}
+
+int main(int argc, char ** argv) {
+    // Parse command line options
+    std::vector<std::string> meshFilenames;
+    std::vector<size_t> sizes;
+    std::vector<size_t> sceneSizes;
+    std::vector<size_t> lightCounts;
+    std::vector<size_t> occlusionCounts;
+    std::vector<FaceForm> forms(FACE_FORMS, FACE_FORMS + sizeof(FACE_FORMS) / sizeof(FACE_FORMS[0]));
+    std::vector<std::string> textureFilenames;
+    std::vector<size_t> textureSizes;
+    std::vector<TextureFormat> textureFormats;
+
+    std::string shaderName = "../res/shaders/triangle";
+    std::string directory = ".";
+    std::string outputFilename = "mesh_benchmark.json";
+    std::string label;
+    bool keep = false;
+
+    BenchmarkOptions options = {
+        true, true, true, true, true, true, true, 3,
+        { VERTEX_FORMAT_FLOAT, false, false, NORMAL_WEIGHTING_ANGLE, 60.0f, false, false, false }
+    };
+
+    // Sizes of generated meshes in triangles and of scenes in nodes
+    std::string sizeList = "10K,100K,1M";
+    std::string sceneSizeList = "10K,100K,1M";
+
+    // Lights of the light fields binned into clusters
+    std::string lightCountList = "1K,4K,16K";
+
+    // Instances of the squares culled against occluders
+    std::string occlusionCountList = "1K,10K,100K";
+
+    // Sides of generated square textures in texels, and formats to load them in
+    std::string textureSizeList = "512,2048";
+    std::string textureFormatList = "rgba8,bc1,bc3,bc7";
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+
+        if (option == "--mesh" && i + 1 < argc)
+            meshFilenames.push_back(argv[++i]);
+        else if (option == "--sizes" && i + 1 < argc)
+            sizeList = argv[++i];
+        else if (option == "--scene-sizes" && i + 1 < argc)
+            sceneSizeList = argv[++i];
+        else if (option == "--light-counts" && i + 1 < argc)
+            lightCountList = argv[++i];
+        else if (option == "--occlusion-counts" && i + 1 < argc)
+            occlusionCountList = argv[++i];
+        else if (option == "--texture" && i + 1 < argc)
+            textureFilenames.push_back(argv[++i]);
+        else if (option == "--texture-sizes" && i + 1 < argc)
+            textureSizeList = argv[++i];
+        else if (option == "--texture-formats" && i + 1 < argc)
+            textureFormatList = argv[++i];
+        else if (option == "--forms" && i + 1 < argc) {
+            std::vector<std::string> names = splitList(argv[++i]);
+            forms.clear();
+
+            for (size_t j = 0; j < names.size(); j++) {
+                FaceForm form;
+
+                if (!parseFaceForm(names[j], form)) {
+                    LogLine() << "Unknown face form " << names[j] << ".";
+                    return -1;
+                }
+
+                forms.push_back(form);
+            }
+        }
+        else if (option == "--stages" && i + 1 < argc) {
+            std::vector<std::string> names = splitList(argv[++i]);
+            options.read = options.build = options.shader = options.scene = options.texture = options.lights =
+                options.occlusion = false;
+
+            for (size_t j = 0; j < names.size(); j++) {
+                if (names[j] == "read")
+                    options.read = true;
+                else if (names[j] == "build")
+                    options.build = true;
+                else if (names[j] == "shader")
+                    options.shader = true;
+                else if (names[j] == "scene")
+                    options.scene = true;
+                else if (names[j] == "texture")
+                    options.texture = true;
+                else if (names[j] == "lights")
+                    options.lights = true;
+                else if (names[j] == "occlusion")
+                    options.occlusion = true;
+                else {
+                    LogLine() << "Unknown stage " << names[j] << ".";
+                    return -1;
+                }
+            }
+        }
+        else if (option == "--runs" && i + 1 < argc)
+            options.runs = std::max(std::atoi(argv[++i]), 1);
+        else if (option == "--vertex-format" && i + 1 < argc) {
+            if (!parseVertexFormat(argv[++i], options.mesh.vertexFormat)) {
+                LogLine() << "Unknown vertex format " << argv[i] << ".";
+                return -1;
+            }
+        }
+        else if (option == "--shader" && i + 1 < argc)
+            shaderName = argv[++i];
+        else if (option == "--directory" && i + 1 < argc)
+            directory = argv[++i];
+        else if (option == "--keep")
+            keep = true;
+        else if (option == "--label" && i + 1 < argc)
+            label = argv[++i];
+        else if (option == "--output" && i + 1 < argc)
+            outputFilename = argv[++i];
+        else {
+            LogLine() << "Unknown option " << option << ".";
+            flushLog();
+
+            std::cerr << "Usage: mesh_benchmark [--mesh file]... [--sizes 10K,100K,1M,10M,50M]"
+                      << " [--forms v,v/vt,v//vn,v/vt/vn] [--scene-sizes 10K,100K,1M] [--light-counts 1K,4K,16K]"
+                      << " [--occlusion-counts 1K,10K,100K]"
+                      << " [--texture file]... [--texture-sizes 512,2048] [--texture-formats rgba8,bc1,bc3,bc7]"
+                      << " [--stages read,build,shader,scene,texture,lights,occlusion]"
+                      << " [--runs n] [--vertex-format format] [--shader name]"
+                      << " [--directory dir] [--keep] [--label text] [--output file]" << std::endl;
+            return -1;
+        }
+    }
+
+    std::vector<std::string> sizeNames = splitList(sizeList);
+
+    for (size_t i = 0; i < sizeNames.size(); i++) {
+        size_t size;
+
+        if (!parseCount(sizeNames[i], size)) {
+            LogLine() << "Invalid mesh size " << sizeNames[i] << ".";
+            return -1;
+        }
+
+        sizes.push_back(size);
+    }
+
+    std::vector<std::string> sceneSizeNames = splitList(sceneSizeList);
+
+    for (size_t i = 0; i < sceneSizeNames.size(); i++) {
+        size_t size;
+
+        if (!parseCount(sceneSizeNames[i], size)) {
+            LogLine() << "Invalid scene size " << sceneSizeNames[i] << ".";
+            return -1;
+        }
+
+        sceneSizes.push_back(size);
+    }
+
+    std::vector<std::string> lightCountNames = splitList(lightCountList);
+
+    for (size_t i = 0; i < lightCountNames.size(); i++) {
+        size_t count;
+
+        if (!parseCount(lightCountNames[i], count)) {
+            LogLine() << "Invalid light count " << lightCountNames[i] << ".";
+            return -1;
+        }
+
+        lightCounts.push_back(count);
+    }
+
+    std::vector<std::string> occlusionCountNames = splitList(occlusionCountList);
+
+    for (size_t i = 0; i < occlusionCountNames.size(); i++) {
+        size_t count;
+
+        if (!parseCount(occlusionCountNames[i], count) || count == 0) {
+            LogLine() << "Invalid occlusion instance count " << occlusionCountNames[i] << ".";
+            return -1;
+        }
+
+        occlusionCounts.push_back(count);
+    }
+
+    std::vector<std::string> textureSizeNames = splitList(textureSizeList);
+
+    for (size_t i = 0; i < textureSizeNames.size(); i++) {
+        size_t size;
+
+        if (!parseCount(textureSizeNames[i], size) || size == 0) {
+            LogLine() << "Invalid texture size " << textureSizeNames[i] << ".";
+            return -1;
+        }
+
+        textureSizes.push_back(size);
+    }
+
+    std::vector<std::string> textureFormatNames = splitList(textureFormatList);
+
+    for (size_t i = 0; i < textureFormatNames.size(); i++) {
+        TextureFormat format;
+
+        if (!parseTextureFormat(textureFormatNames[i], format)) {
+            LogLine() << "Unknown texture format " << textureFormatNames[i] << ".";
+            return -1;
+        }
+
+        textureFormats.push_back(format);
+    }
+
+    if (meshFilenames.empty()) {
+        meshFilenames.push_back("../res/meshes/bunny.obj");
+        meshFilenames.push_back("../res/meshes/object.obj");
+    }
+
+    LogLine() << "Mesh benchmark on " << threadCount() << " threads, "
+              << options.runs << " runs per stage";
+
+    std::vector<StageResult> results;
+    bool success = true;
+
+    // Mesh files
+    if (options.read || options.build) {
+        for (size_t i = 0; i < meshFilenames.size(); i++)
+            success = benchmarkMesh(meshFilenames[i], "file", options, results) && success;
+    }
+
+    // Generated meshes, written to the directory and removed after their
+    // run unless kept, in which case later runs reuse them
+    if (options.read || options.build) {
+        for (size_t i = 0; i < sizes.size(); i++) {
+            for (size_t j = 0; j < forms.size(); j++) {
+                std::string suffix = faceFormName(forms[j]);
+                std::replace(suffix.begin(), suffix.end(), '/', '_');
+
+                std::string filename = directory + "/generated_" + std::to_string(sizes[i]) +
+                    "_" + suffix + ".obj";
+
+                std::ifstream existing(filename.c_str());
+
+                if (!keep || !existing.is_open()) {
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    size_t points = 0;
+
+                    if (!writeGeneratedMesh(filename, sizes[i], forms[j], points)) {
+                        LogLine() << "Cannot write " << filename << ".";
+
+                        std::remove(filename.c_str());
+                        success = false;
+                        continue;
+                    }
+
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+                    LogLine() << "Generated " << filename << ": " << sizes[i] << " triangles, "
+                              << points << " grid points in " << elapsed.count() * 1000.0 << " ms";
+                }
+
+                success = benchmarkMesh(filename, faceFormName(forms[j]), options, results) && success;
+
+                if (!keep)
+                    std::remove(filename.c_str());
+            }
+        }
+    }
+
+    // Scene graph updates
+    if (options.scene) {
+        for (size_t i = 0; i < sceneSizes.size(); i++)
+            benchmarkScene(sceneSizes[i], options, results);
+    }
+
+    // Light binning
+    if (options.lights) {
+        for (size_t i = 0; i < lightCounts.size(); i++)
+            benchmarkLights(lightCounts[i], options, results);
+    }
+
+    // Occlusion culling of instances of the first mesh
+    if (options.occlusion)
+        success = benchmarkOcclusion(meshFilenames[0], occlusionCounts, options, results) && success;
+
+    // Shaders compiled and textures loaded in a headless context
+    if (options.shader || options.texture) {
+        HeadlessContext context;
+
+        if (context.create(1, 1)) {
+            if (options.shader) {
+                success = benchmarkShader(shaderName + ".vert", GL_VERTEX_SHADER, options, results) && success;
+                success = benchmarkShader(shaderName + ".frag", GL_FRAGMENT_SHADER, options, results) && success;
+            }
+
+            if (options.texture) {
+                for (size_t i = 0; i < textureFilenames.size(); i++)
+                    success = benchmarkTexture(textureFilenames[i], textureFormats, options, results) && success;
+
+                // Generated textures, kept like generated meshes
+                for (size_t i = 0; i < textureSizes.size(); i++) {
+                    std::string filename = directory + "/generated_" + std::to_string(textureSizes[i]) + ".tga";
+                    std::ifstream existing(filename.c_str());
+
+                    if ((!keep || !existing.is_open()) && !writeGeneratedTexture(filename, textureSizes[i])) {
+                        LogLine() << "Cannot write " << filename << ".";
+
+                        std::remove(filename.c_str());
+                        success = false;
+                        continue;
+                    }
+
+                    success = benchmarkTexture(filename, textureFormats, options, results) && success;
+
+                    if (!keep)
+                        std::remove(filename.c_str());
+                }
+            }
+        }
+        else {
+            LogLine() << "Cannot create headless OpenGL context, skipping shaders and textures.";
+            success = false;
+        }
+    }
+
+    std::ofstream file(outputFilename.c_str());
+    writeResultsJson(file, label, options, results);
+
+    if (!file.good()) {
+        LogLine() << "Cannot write " << outputFilename << ".";
+        success = false;
+    }
+    else
+        LogLine() << "Wrote " << outputFilename;
+
+    flushLog();
+
+    return success ? 0 : -1;
+}
@@ -1,7 +1,89 @@
 #version 330 core
 
 in vec3 N;
+in vec4 C;
+in vec2 T;
+
+in vec3 viewPosition;
+in vec3 viewNormal;
+
+// Color texture sampled when the mesh has texture coordinates
+uniform sampler2D diffuse;
+uniform bool textured;
+
+// Froxel grid of the light clusters
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 12;
+const int CLUSTER_SLICES = 24;
+
+// Fragments lit by the point and spot lights of their cluster instead of
+// showing the normal
+uniform bool clustered;
+
+// View space lights of 3 texels each, offset and count of the light indices
+// of every cluster, and light indices
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+
+// Tiles per pixel, and slice of a view depth as log(depth) * x + y
+uniform vec2 clusterTileScale;
+uniform vec2 clusterSliceScale;
+
+const vec3 AMBIENT = vec3(0.02f);
+
+// Diffuse lighting of the lights of the cluster of the fragment
+vec3 clusteredLighting(vec3 position, vec3 normal) {
+    int slice = int(floor(log(-position.z) * clusterSliceScale.x + clusterSliceScale.y));
+
+    // Lights reach no farther than the last slice
+    if (slice >= CLUSTER_SLICES)
+        return vec3(0.0f);
+
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterTileScale), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    int cluster = (max(slice, 0) * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+
+    uvec2 range = texelFetch(lightClusters, cluster).xy;
+    vec3 lighting = vec3(0.0f);
+
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).x) * 3;
+
+        vec4 positionRange = texelFetch(lightData, light);
+        vec4 colorInner = texelFetch(lightData, light + 1);
+        vec4 directionOuter = texelFetch(lightData, light + 2);
+
+        vec3 L = positionRange.xyz - position;
+        float d = length(L);
+        L /= max(d, 1e-4f);
+
+        // Inverse square falloff in units of a fifth of the range, windowed
+        // to zero at the range
+        float x = d / positionRange.w;
+        float window = clamp(1.0f - x * x * x * x, 0.0f, 1.0f);
+        float attenuation = window * window / (25.0f * x * x + 1.0f);
+        float spot = smoothstep(directionOuter.w, colorInner.w, dot(-L, directionOuter.xyz));
+
+        lighting += colorInner.rgb * max(dot(normal, L), 0.0f) * attenuation * spot;
+    }
+
+    return lighting;
+}
 
 void main() {
-    gl_FragColor = vec4((N+vec3(1.0f, 1.0f, 1.0f))*0.5, 1.0f);
+    vec4 albedo = textured ? texture(diffuse, T) : vec4(1.0f);
+
+    if (clustered) {
+        vec3 normal = normalize(gl_FrontFacing ? viewNormal : -viewNormal);
+        vec3 color = C.rgb * albedo.rgb * (AMBIENT + clusteredLighting(viewPosition, normal));
+
+        gl_FragColor = vec4(pow(color, vec3(1.0f / 2.2f)), C.a * albedo.a);
+        return;
+    }
+
+    // Texels are filtered in linear space, encode them back like the
+    // display values of the rest of the shading
+    albedo.rgb = pow(albedo.rgb, vec3(1.0f / 2.2f));
+
+    gl_FragColor = vec4((N+vec3(1.0f, 1.0f, 1.0f))*0.5*C.rgb*albedo.rgb, C.a*albedo.a);
 }
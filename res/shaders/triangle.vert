@@ -4,13 +4,54 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texture;
 
+// Per instance model matrix and color, identity and white without instancing
+layout (location = 4) in mat4 instanceModel;
+layout (location = 8) in vec4 instanceColor;
+
+// Per frame camera uniforms shared by every shader program
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 position;
+} camera;
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Position dequantization of compact vertex formats to mesh units
+uniform mat4 dequantization;
+
+// Normal is octahedral encoded in the first two components
+uniform bool octahedralNormal;
 
 out vec3 N;
+out vec4 C;
+out vec2 T;
+
+// View space position and normal of clustered lighting
+out vec3 viewPosition;
+out vec3 viewNormal;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+
+    return normalize(n);
+}
 
 void main() {
-    N = normal;
-    gl_Position = projection * view * model * vec4(position, 1.0f);
+    N = octahedralNormal ? decodeOctahedral(normal.xy) : normal;
+    C = instanceColor;
+    T = texture;
+
+    // Dequantization applies to positions only, and instances scale uniformly
+    mat4 modelView = camera.view * model * instanceModel;
+    vec4 P = modelView * dequantization * vec4(position, 1.0f);
+
+    viewPosition = P.xyz;
+    viewNormal = mat3(modelView) * N;
+    gl_Position = camera.projection * P;
 }
@@ -0,0 +1,282 @@
+#include "benchmark.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// Smallest of the sorted values greater or equal to the given fraction of them
+double percentile(const std::vector<double> & sorted, double fraction) {
+    size_t rank = (size_t)std::ceil(fraction * sorted.size());
+
+    return sorted[std::max(rank, (size_t)1) - 1];
+}
+
+bool compareKeyframes(const CameraKeyframe & a, const CameraKeyframe & b) {
+    return a.time < b.time;
+}
+}
+
+bool readCameraPath(const std::string & filename, std::vector<CameraKeyframe> & keyframes) {
+    std::ifstream file(filename.c_str());
+
+    if (!file.is_open())
+        return false;
+
+    keyframes.clear();
+
+    std::string line;
+
+    while (std::getline(file, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+
+        std::istringstream stream(line);
+        CameraKeyframe keyframe;
+
+        if (!(stream >> keyframe.time
+                >> keyframe.eye.x >> keyframe.eye.y >> keyframe.eye.z
+                >> keyframe.target.x >> keyframe.target.y >> keyframe.target.z
+                >> keyframe.modelAngle))
+            return false;
+
+        keyframes.push_back(keyframe);
+    }
+
+    std::stable_sort(keyframes.begin(), keyframes.end(), compareKeyframes);
+
+    return !keyframes.empty();
+}
+
+void defaultCameraPath(
+        const glm::vec3 & eye,
+        const glm::vec3 & target,
+        std::vector<CameraKeyframe> & keyframes) {
+    keyframes.clear();
+
+    glm::vec3 close = target + (eye - target) * 0.25f;
+
+    CameraKeyframe path[5] = {
+        { 0.0f, eye, target, 0.0f },
+        { 1.0f, glm::mix(eye, close, 0.5f), target, 90.0f },
+        { 2.0f, close, target, 180.0f },
+        { 3.0f, glm::mix(eye, close, 0.5f), target, 270.0f },
+        { 4.0f, eye, target, 360.0f }
+    };
+
+    keyframes.assign(path, path + 5);
+}
+
+void sampleCameraPath(
+        const std::vector<CameraKeyframe> & keyframes,
+        float fraction,
+        glm::mat4 & view,
+        glm::mat4 & model) {
+    if (keyframes.empty())
+        return;
+
+    float time = keyframes.front().time + (keyframes.back().time - keyframes.front().time) * fraction;
+
+    // First keyframe after the time, interpolating from the previous one
+    size_t next = 0;
+
+    while (next < keyframes.size() && keyframes[next].time <= time)
+        next++;
+
+    CameraKeyframe pose;
+
+    if (next == 0)
+        pose = keyframes.front();
+    else if (next == keyframes.size())
+        pose = keyframes.back();
+    else {
+        const CameraKeyframe & a = keyframes[next - 1];
+        const CameraKeyframe & b = keyframes[next];
+
+        float t = (time - a.time) / (b.time - a.time);
+
+        pose.time = time;
+        pose.eye = glm::mix(a.eye, b.eye, t);
+        pose.target = glm::mix(a.target, b.target, t);
+        pose.modelAngle = a.modelAngle + (b.modelAngle - a.modelAngle) * t;
+    }
+
+    view = glm::lookAt(pose.eye, pose.target, glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::rotate(glm::mat4(1.0f), glm::radians(pose.modelAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+GpuFrameTimer::GpuFrameTimer() : begun(0), collected(0) {
+    for (size_t i = 0; i < GPU_TIMER_QUERIES; i++)
+        queries[i] = 0;
+}
+
+GpuFrameTimer::~GpuFrameTimer() {
+    destroy();
+}
+
+void GpuFrameTimer::create() {
+    destroy();
+
+    glGenQueries((GLsizei)GPU_TIMER_QUERIES, queries);
+}
+
+void GpuFrameTimer::destroy() {
+    if (queries[0] != 0)
+        glDeleteQueries((GLsizei)GPU_TIMER_QUERIES, queries);
+
+    for (size_t i = 0; i < GPU_TIMER_QUERIES; i++)
+        queries[i] = 0;
+
+    begun = 0;
+    collected = 0;
+    finished.clear();
+}
+
+void GpuFrameTimer::begin() {
+    // Read back the oldest frame before reusing its query
+    if (begun - collected == GPU_TIMER_QUERIES)
+        readOldest();
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[begun % GPU_TIMER_QUERIES]);
+}
+
+void GpuFrameTimer::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+
+    begun++;
+}
+
+void GpuFrameTimer::collect(std::vector<double> & seconds, bool wait) {
+    while (collected < begun) {
+        GLuint query = queries[collected % GPU_TIMER_QUERIES];
+
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+            if (!available)
+                break;
+        }
+
+        readOldest();
+    }
+
+    seconds.insert(seconds.end(), finished.begin(), finished.end());
+    finished.clear();
+}
+
+void GpuFrameTimer::readOldest() {
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(queries[collected % GPU_TIMER_QUERIES], GL_QUERY_RESULT, &elapsed);
+
+    finished.push_back(elapsed * 1e-9);
+    collected++;
+}
+
+FrameTimeSummary summarizeFrameTimes(const std::vector<double> & seconds) {
+    FrameTimeSummary summary = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+    if (seconds.empty())
+        return summary;
+
+    std::vector<double> sorted(seconds);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+
+    for (size_t i = 0; i < sorted.size(); i++)
+        sum += sorted[i];
+
+    summary.mean = sum / sorted.size() * 1000.0;
+    summary.minimum = sorted.front() * 1000.0;
+    summary.maximum = sorted.back() * 1000.0;
+    summary.p50 = percentile(sorted, 0.50) * 1000.0;
+    summary.p95 = percentile(sorted, 0.95) * 1000.0;
+    summary.p99 = percentile(sorted, 0.99) * 1000.0;
+
+    return summary;
+}
+
+void writeJsonString(std::ostream & stream, const std::string & value) {
+    stream << '"';
+
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char c = (unsigned char)value[i];
+
+        if (c == '"' || c == '\\')
+            stream << '\\' << value[i];
+        else if (c < 0x20)
+            stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c
+                   << std::dec << std::setfill(' ');
+        else
+            stream << value[i];
+    }
+
+    stream << '"';
+}
+
+void writeJsonSummary(std::ostream & stream, const std::vector<double> & seconds) {
+    if (seconds.empty()) {
+        stream << "null";
+        return;
+    }
+
+    FrameTimeSummary summary = summarizeFrameTimes(seconds);
+
+    stream << "{ \"mean\": " << summary.mean
+           << ", \"min\": " << summary.minimum
+           << ", \"max\": " << summary.maximum
+           << ", \"p50\": " << summary.p50
+           << ", \"p95\": " << summary.p95
+           << ", \"p99\": " << summary.p99 << " }";
+}
+
+void writeBenchmarkJson(std::ostream & stream, const BenchmarkResult & result) {
+    double frameSeconds = 0.0;
+
+    for (size_t i = 0; i < result.frameSeconds.size(); i++)
+        frameSeconds += result.frameSeconds[i];
+
+    double trianglesPerSecond = frameSeconds > 0.0 ?
+        result.trianglesPerFrame * result.frameSeconds.size() / frameSeconds : 0.0;
+
+    stream << "{" << std::endl;
+
+    stream << "  \"mesh\": ";
+    writeJsonString(stream, result.mesh);
+    stream << "," << std::endl;
+
+    stream << "  \"renderer\": ";
+    writeJsonString(stream, result.renderer);
+    stream << "," << std::endl;
+
+    stream << "  \"width\": " << result.width << "," << std::endl;
+    stream << "  \"height\": " << result.height << "," << std::endl;
+    stream << "  \"frames\": " << result.frames << "," << std::endl;
+    stream << "  \"warmupFrames\": " << result.warmupFrames << "," << std::endl;
+    stream << "  \"loadMs\": " << result.loadSeconds * 1000.0 << "," << std::endl;
+    stream << "  \"programMs\": " << result.programSeconds * 1000.0 << "," << std::endl;
+    stream << "  \"trianglesPerFrame\": " << result.trianglesPerFrame << "," << std::endl;
+    stream << "  \"trianglesPerSecond\": " << trianglesPerSecond << "," << std::endl;
+
+    stream << "  \"frameMs\": ";
+    writeJsonSummary(stream, result.frameSeconds);
+    stream << "," << std::endl;
+
+    stream << "  \"cpuMs\": ";
+    writeJsonSummary(stream, result.cpuSeconds);
+    stream << "," << std::endl;
+
+    stream << "  \"gpuMs\": ";
+    writeJsonSummary(stream, result.gpuSeconds);
+    stream << std::endl;
+
+    stream << "}" << std::endl;
+}
@@ -0,0 +1,132 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Number of frames in flight of GPU timer queries
+const size_t GPU_TIMER_QUERIES = 4;
+
+// Pose of the camera and the model at a time of a scripted path
+struct CameraKeyframe {
+    float time;
+
+    glm::vec3 eye;
+    glm::vec3 target;
+
+    // Rotation of the model matrix around the vertical axis in degrees
+    float modelAngle;
+};
+
+// Read camera path from text file with one keyframe per line:
+// time eyeX eyeY eyeZ targetX targetY targetZ modelAngle
+// Lines starting with # are comments and keyframes are sorted by time.
+bool readCameraPath(const std::string & filename, std::vector<CameraKeyframe> & keyframes);
+
+// Default camera path from the given eye looking at the target, turning the
+// model once while dollying in to a quarter of the distance and back out
+void defaultCameraPath(
+        const glm::vec3 & eye,
+        const glm::vec3 & target,
+        std::vector<CameraKeyframe> & keyframes);
+
+// Interpolate view and model matrices of a path linearly at the given
+// fraction of its duration
+void sampleCameraPath(
+        const std::vector<CameraKeyframe> & keyframes,
+        float fraction,
+        glm::mat4 & view,
+        glm::mat4 & model);
+
+// Time elapsed on the GPU by the commands of every frame, measured with a
+// ring of GL_TIME_ELAPSED queries read back without stalling
+class GpuFrameTimer {
+public:
+    GpuFrameTimer();
+    ~GpuFrameTimer();
+
+    void create();
+    void destroy();
+
+    void begin();
+    void end();
+
+    // Append seconds of the finished frames in frame order, blocking on
+    // the pending ones when wait is set
+    void collect(std::vector<double> & seconds, bool wait);
+
+private:
+    GpuFrameTimer(const GpuFrameTimer &);
+    GpuFrameTimer & operator=(const GpuFrameTimer &);
+
+    // Read the result of the oldest frame in flight
+    void readOldest();
+
+    GLuint queries[GPU_TIMER_QUERIES];
+
+    // Frames begun and frames read back
+    size_t begun;
+    size_t collected;
+
+    // Results read back but not collected yet
+    std::vector<double> finished;
+};
+
+// Summary of frame durations in milliseconds
+struct FrameTimeSummary {
+    double mean;
+    double minimum;
+    double maximum;
+
+    double p50;
+    double p95;
+    double p99;
+};
+
+// Summarize durations in seconds, nearest rank percentiles
+FrameTimeSummary summarizeFrameTimes(const std::vector<double> & seconds);
+
+// Write string as JSON string literal
+void writeJsonString(std::ostream & stream, const std::string & value);
+
+// Write summary of durations in seconds as JSON object of milliseconds, null
+// when there are none
+void writeJsonSummary(std::ostream & stream, const std::vector<double> & seconds);
+
+// Measurements of a benchmark run
+struct BenchmarkResult {
+    std::string mesh;
+    std::string renderer;
+
+    int width;
+    int height;
+    size_t frames;
+    size_t warmupFrames;
+
+    double loadSeconds;
+    double programSeconds;
+
+    // Triangles submitted by draws, averaged over the measured frames
+    double trianglesPerFrame;
+
+    // Wall time of whole frames, rendering finished
+    std::vector<double> frameSeconds;
+
+    // Time spent by the CPU submitting the commands of every frame
+    std::vector<double> cpuSeconds;
+
+    // Time spent by the GPU executing them, empty when unavailable
+    std::vector<double> gpuSeconds;
+};
+
+// Write benchmark result as JSON
+void writeBenchmarkJson(std::ostream & stream, const BenchmarkResult & result);
+
+#endif
@@ -0,0 +1,801 @@
+#include "bvh.h"
+
+#include "parallel.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vector_relational.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define BVH_SSE2
+#endif
+
+namespace {
+
+const uint32_t INVALID_TRIANGLE = 0xffffffffu;
+
+// Number of centroid bins per axis of the surface area heuristic
+const size_t BIN_COUNT = 16;
+
+// Minimum number of triangles of a subtree built or binned in parallel
+const size_t PARALLEL_SIZE = 65536;
+
+// Depth from which nodes are split at the median, bounding the tree depth
+const size_t MAXIMUM_SAH_DEPTH = 64;
+
+// Size of traversal stacks, above the maximum tree depth
+const size_t STACK_SIZE = 128;
+
+struct Bounds {
+    glm::vec3 minimum;
+    glm::vec3 maximum;
+
+    Bounds() :
+        minimum(std::numeric_limits<float>::max()),
+        maximum(-std::numeric_limits<float>::max()) {
+    }
+
+    void grow(const glm::vec3 & point) {
+        minimum = glm::min(minimum, point);
+        maximum = glm::max(maximum, point);
+    }
+
+    void grow(const Bounds & bounds) {
+        minimum = glm::min(minimum, bounds.minimum);
+        maximum = glm::max(maximum, bounds.maximum);
+    }
+
+    // Half surface area, zero when empty
+    float area() const {
+        glm::vec3 extent = maximum - minimum;
+
+        if (extent.x < 0.0f)
+            return 0.0f;
+
+        return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    }
+};
+
+// Triangle bounds and centroids, and the triangle order being partitioned
+struct BuildContext {
+    std::vector<Bounds> bounds;
+    std::vector<glm::vec3> centroids;
+    std::vector<uint32_t> references;
+};
+
+// Triangle bounds and centroid bounds of a reference range
+struct RangeBounds {
+    Bounds bounds;
+    Bounds centroids;
+};
+
+struct Bin {
+    Bounds bounds;
+    size_t count;
+};
+
+// Centroid bins of the three axes
+struct Bins {
+    Bin bins[3][BIN_COUNT];
+
+    Bins() {
+        for (size_t i = 0; i < 3; i++)
+            for (size_t j = 0; j < BIN_COUNT; j++)
+                bins[i][j].count = 0;
+    }
+
+    void merge(const Bins & other) {
+        for (size_t i = 0; i < 3; i++)
+            for (size_t j = 0; j < BIN_COUNT; j++) {
+                bins[i][j].bounds.grow(other.bins[i][j].bounds);
+                bins[i][j].count += other.bins[i][j].count;
+            }
+    }
+};
+
+inline size_t binIndex(float centroid, float minimum, float scale) {
+    return std::min(BIN_COUNT - 1, (size_t)std::max(0.0f, (centroid - minimum) * scale));
+}
+
+// Apply a function over a reference range, in parallel chunks for large ranges,
+// merging per chunk results of the given type
+template <typename Result, typename Function, typename Merge>
+Result reduceRange(size_t begin, size_t end, Function function, Merge merge) {
+    size_t count = end - begin;
+
+    if (count < PARALLEL_SIZE) {
+        Result result;
+        function(begin, end, result);
+
+        return result;
+    }
+
+    Result result;
+    std::mutex mutex;
+
+    parallelFor(count, PARALLEL_SIZE / 4, [&](size_t first, size_t last) {
+        Result partial;
+        function(begin + first, begin + last, partial);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        merge(result, partial);
+    });
+
+    return result;
+}
+
+void boundRange(const BuildContext & context, size_t begin, size_t end, RangeBounds & result) {
+    for (size_t i = begin; i < end; i++) {
+        uint32_t triangle = context.references[i];
+
+        result.bounds.grow(context.bounds[triangle]);
+        result.centroids.grow(context.centroids[triangle]);
+    }
+}
+
+// Split position of a reference range, the end if no split reduces the cost
+size_t partitionRange(BuildContext & context, size_t begin, size_t end, const Bounds & centroidBounds) {
+    glm::vec3 extent = centroidBounds.maximum - centroidBounds.minimum;
+    glm::vec3 scale;
+
+    for (int i = 0; i < 3; i++)
+        scale[i] = extent[i] > 0.0f ? BIN_COUNT / extent[i] : 0.0f;
+
+    // Bin triangles by centroid on every axis
+    Bins bins = reduceRange<Bins>(
+        begin,
+        end,
+        [&](size_t first, size_t last, Bins & result) {
+            for (size_t i = first; i < last; i++) {
+                uint32_t triangle = context.references[i];
+                const glm::vec3 & centroid = context.centroids[triangle];
+
+                for (int j = 0; j < 3; j++) {
+                    Bin & bin = result.bins[j][binIndex(centroid[j], centroidBounds.minimum[j], scale[j])];
+
+                    bin.bounds.grow(context.bounds[triangle]);
+                    bin.count++;
+                }
+            }
+        },
+        [](Bins & result, const Bins & partial) {
+            result.merge(partial);
+        });
+
+    // Sweep bin boundaries for the lowest surface area heuristic cost
+    int bestAxis = -1;
+    size_t bestSplit = 0;
+    float bestCost = std::numeric_limits<float>::max();
+
+    for (int i = 0; i < 3; i++) {
+        if (extent[i] <= 0.0f)
+            continue;
+
+        float rightCosts[BIN_COUNT];
+        Bounds right;
+        size_t rightCount = 0;
+
+        for (size_t j = BIN_COUNT - 1; j > 0; j--) {
+            right.grow(bins.bins[i][j].bounds);
+            rightCount += bins.bins[i][j].count;
+            rightCosts[j] = right.area() * rightCount;
+        }
+
+        Bounds left;
+        size_t leftCount = 0;
+
+        for (size_t j = 1; j < BIN_COUNT; j++) {
+            left.grow(bins.bins[i][j - 1].bounds);
+            leftCount += bins.bins[i][j - 1].count;
+
+            float cost = left.area() * leftCount + rightCosts[j];
+
+            if (leftCount > 0 && leftCount < end - begin && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = i;
+                bestSplit = j;
+            }
+        }
+    }
+
+    if (bestAxis < 0)
+        return end;
+
+    std::vector<uint32_t>::iterator middle = std::partition(
+        context.references.begin() + begin,
+        context.references.begin() + end,
+        [&](uint32_t triangle) {
+            return binIndex(
+                context.centroids[triangle][bestAxis],
+                centroidBounds.minimum[bestAxis],
+                scale[bestAxis]) < bestSplit;
+        });
+
+    return middle - context.references.begin();
+}
+
+// Build the subtree of a reference range, appending its nodes depth first
+// Leaf offsets are reference offsets until packets are built.
+void buildNode(
+        BuildContext & context,
+        size_t begin,
+        size_t end,
+        size_t depth,
+        std::vector<BvhNode> & nodes) {
+    RangeBounds range = reduceRange<RangeBounds>(
+        begin,
+        end,
+        [&context](size_t first, size_t last, RangeBounds & result) {
+            boundRange(context, first, last, result);
+        },
+        [](RangeBounds & result, const RangeBounds & partial) {
+            result.bounds.grow(partial.bounds);
+            result.centroids.grow(partial.centroids);
+        });
+
+    size_t index = nodes.size();
+
+    BvhNode node;
+
+    for (int i = 0; i < 3; i++) {
+        node.minimum[i] = range.bounds.minimum[i];
+        node.maximum[i] = range.bounds.maximum[i];
+    }
+
+    node.offset = (uint32_t)begin;
+    node.count = (uint32_t)(end - begin);
+
+    nodes.push_back(node);
+
+    if (end - begin <= BVH_PACKET_SIZE)
+        return;
+
+    // Split at the median when all centroids fall in the same bin or the tree is too deep
+    size_t middle = depth < MAXIMUM_SAH_DEPTH ?
+        partitionRange(context, begin, end, range.centroids) : end;
+
+    if (middle == begin || middle == end) {
+        glm::vec3 extent = range.centroids.maximum - range.centroids.minimum;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        middle = begin + (end - begin) / 2;
+
+        std::nth_element(
+            context.references.begin() + begin,
+            context.references.begin() + middle,
+            context.references.begin() + end,
+            [&context, axis](uint32_t a, uint32_t b) {
+                return context.centroids[a][axis] < context.centroids[b][axis];
+            });
+    }
+
+    nodes[index].count = 0;
+
+    if (end - begin < PARALLEL_SIZE) {
+        buildNode(context, begin, middle, depth + 1, nodes);
+        nodes[index].offset = (uint32_t)nodes.size();
+        buildNode(context, middle, end, depth + 1, nodes);
+
+        return;
+    }
+
+    // Build both children in parallel and append them with rebased offsets
+    std::vector<BvhNode> children[2];
+
+    parallelFor(2, 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            buildNode(context, i == 0 ? begin : middle, i == 0 ? middle : end, depth + 1, children[i]);
+    });
+
+    uint32_t base = (uint32_t)nodes.size();
+
+    nodes[index].offset = base + (uint32_t)children[0].size();
+
+    for (size_t i = 0; i < 2; i++) {
+        uint32_t childBase = (uint32_t)nodes.size();
+
+        for (size_t j = 0; j < children[i].size(); j++) {
+            BvhNode child = children[i][j];
+
+            if (child.count == 0)
+                child.offset += childBase;
+
+            nodes.push_back(child);
+        }
+    }
+}
+
+// Closest point of a triangle to a point (Ericson, Real-Time Collision
+// Detection, 5.1.5)
+glm::vec3 closestPointTriangle(const glm::vec3 & p, const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c) {
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return a;
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+
+    if (d3 >= 0.0f && d4 <= d3)
+        return b;
+
+    float vc = d1 * d4 - d3 * d2;
+
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return a + ab * (d1 / (d1 - d3));
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+
+    if (d6 >= 0.0f && d5 <= d6)
+        return c;
+
+    float vb = d5 * d2 - d1 * d6;
+
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denominator = 1.0f / (va + vb + vc);
+
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Squared distance of a point to the box of a node
+inline float boxDistance2(const BvhNode & node, const glm::vec3 & point) {
+    float distance = 0.0f;
+
+    for (int i = 0; i < 3; i++) {
+        float d = std::max(std::max(node.minimum[i] - point[i], point[i] - node.maximum[i]), 0.0f);
+        distance += d * d;
+    }
+
+    return distance;
+}
+
+inline glm::vec3 packetCorner(const BvhPacket & packet, size_t corner, size_t lane) {
+    return glm::vec3(packet.x[corner][lane], packet.y[corner][lane], packet.z[corner][lane]);
+}
+
+#ifdef BVH_SSE2
+
+// Ray with per lane broadcast components for SIMD tests
+struct Ray {
+    __m128 origin;
+    __m128 inverseDirection;
+
+    __m128 originX, originY, originZ;
+    __m128 directionX, directionY, directionZ;
+};
+
+Ray makeRay(const glm::vec3 & origin, const glm::vec3 & direction) {
+    Ray ray;
+    ray.origin = _mm_setr_ps(origin.x, origin.y, origin.z, 0.0f);
+    ray.inverseDirection = _mm_div_ps(
+        _mm_set1_ps(1.0f), _mm_setr_ps(direction.x, direction.y, direction.z, 1.0f));
+
+    ray.originX = _mm_set1_ps(origin.x);
+    ray.originY = _mm_set1_ps(origin.y);
+    ray.originZ = _mm_set1_ps(origin.z);
+    ray.directionX = _mm_set1_ps(direction.x);
+    ray.directionY = _mm_set1_ps(direction.y);
+    ray.directionZ = _mm_set1_ps(direction.z);
+
+    return ray;
+}
+
+// Slab test of the three axes at once, giving the entry distance on a hit
+inline bool intersectBox(const BvhNode & node, const Ray & ray, float farthest, float & entry) {
+    __m128 minimum = _mm_loadu_ps(node.minimum);
+    __m128 maximum = _mm_loadu_ps(node.maximum);
+
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(minimum, ray.origin), ray.inverseDirection);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(maximum, ray.origin), ray.inverseDirection);
+
+    __m128 entries = _mm_min_ps(t0, t1);
+    __m128 exits = _mm_max_ps(t0, t1);
+
+    // Replace the fourth lane, loaded from offset and count, by the first
+    entries = _mm_shuffle_ps(entries, entries, _MM_SHUFFLE(0, 2, 1, 0));
+    exits = _mm_shuffle_ps(exits, exits, _MM_SHUFFLE(0, 2, 1, 0));
+
+    // Latest entry and earliest exit over the axes
+    entries = _mm_max_ps(entries, _mm_shuffle_ps(entries, entries, _MM_SHUFFLE(1, 0, 3, 2)));
+    entries = _mm_max_ps(entries, _mm_shuffle_ps(entries, entries, _MM_SHUFFLE(2, 3, 0, 1)));
+    exits = _mm_min_ps(exits, _mm_shuffle_ps(exits, exits, _MM_SHUFFLE(1, 0, 3, 2)));
+    exits = _mm_min_ps(exits, _mm_shuffle_ps(exits, exits, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    entry = std::max(_mm_cvtss_f32(entries), 0.0f);
+
+    return entry <= std::min(_mm_cvtss_f32(exits), farthest);
+}
+
+// Moller-Trumbore test of the four triangles of a packet, updating the hit
+// with the nearest one closer than the hit distance
+inline void intersectPacket(const BvhPacket & packet, const Ray & ray, RayHit & hit) {
+    __m128 x0 = _mm_loadu_ps(packet.x[0]);
+    __m128 y0 = _mm_loadu_ps(packet.y[0]);
+    __m128 z0 = _mm_loadu_ps(packet.z[0]);
+
+    __m128 e1x = _mm_sub_ps(_mm_loadu_ps(packet.x[1]), x0);
+    __m128 e1y = _mm_sub_ps(_mm_loadu_ps(packet.y[1]), y0);
+    __m128 e1z = _mm_sub_ps(_mm_loadu_ps(packet.z[1]), z0);
+
+    __m128 e2x = _mm_sub_ps(_mm_loadu_ps(packet.x[2]), x0);
+    __m128 e2y = _mm_sub_ps(_mm_loadu_ps(packet.y[2]), y0);
+    __m128 e2z = _mm_sub_ps(_mm_loadu_ps(packet.z[2]), z0);
+
+    // p = direction x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(ray.directionY, e2z), _mm_mul_ps(ray.directionZ, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(ray.directionZ, e2x), _mm_mul_ps(ray.directionX, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(ray.directionX, e2y), _mm_mul_ps(ray.directionY, e2x));
+
+    __m128 determinant = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 valid = _mm_cmpneq_ps(determinant, _mm_setzero_ps());
+    __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+    // s = origin - corner
+    __m128 sx = _mm_sub_ps(ray.originX, x0);
+    __m128 sy = _mm_sub_ps(ray.originY, y0);
+    __m128 sz = _mm_sub_ps(ray.originZ, z0);
+
+    __m128 u = _mm_mul_ps(_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverse);
+
+    // q = s x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(ray.directionX, qx), _mm_mul_ps(ray.directionY, qy)),
+        _mm_mul_ps(ray.directionZ, qz)), inverse);
+
+    __m128 t = _mm_mul_ps(_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse);
+
+    __m128 zero = _mm_setzero_ps();
+
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(t, zero));
+    valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(hit.distance)));
+
+    int mask = _mm_movemask_ps(valid);
+
+    if (mask == 0)
+        return;
+
+    float ts[4], us[4], vs[4];
+    _mm_storeu_ps(ts, t);
+    _mm_storeu_ps(us, u);
+    _mm_storeu_ps(vs, v);
+
+    for (size_t i = 0; i < BVH_PACKET_SIZE; i++)
+        if ((mask & (1 << i)) && ts[i] < hit.distance) {
+            hit.triangle = packet.triangles[i];
+            hit.distance = ts[i];
+            hit.barycentrics = glm::vec2(us[i], vs[i]);
+        }
+}
+
+#else
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverseDirection;
+};
+
+Ray makeRay(const glm::vec3 & origin, const glm::vec3 & direction) {
+    Ray ray;
+    ray.origin = origin;
+    ray.direction = direction;
+    ray.inverseDirection = 1.0f / direction;
+
+    return ray;
+}
+
+inline bool intersectBox(const BvhNode & node, const Ray & ray, float farthest, float & entry) {
+    float latestEntry = 0.0f;
+    float earliestExit = farthest;
+
+    for (int i = 0; i < 3; i++) {
+        float t0 = (node.minimum[i] - ray.origin[i]) * ray.inverseDirection[i];
+        float t1 = (node.maximum[i] - ray.origin[i]) * ray.inverseDirection[i];
+
+        latestEntry = std::max(latestEntry, std::min(t0, t1));
+        earliestExit = std::min(earliestExit, std::max(t0, t1));
+    }
+
+    entry = latestEntry;
+
+    return latestEntry <= earliestExit;
+}
+
+inline void intersectPacket(const BvhPacket & packet, const Ray & ray, RayHit & hit) {
+    for (size_t i = 0; i < BVH_PACKET_SIZE; i++) {
+        glm::vec3 v0 = packetCorner(packet, 0, i);
+        glm::vec3 e1 = packetCorner(packet, 1, i) - v0;
+        glm::vec3 e2 = packetCorner(packet, 2, i) - v0;
+
+        glm::vec3 p = glm::cross(ray.direction, e2);
+        float determinant = glm::dot(e1, p);
+
+        if (determinant == 0.0f)
+            continue;
+
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = ray.origin - v0;
+        float u = glm::dot(s, p) * inverse;
+
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(ray.direction, q) * inverse;
+        float t = glm::dot(e2, q) * inverse;
+
+        if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < hit.distance) {
+            hit.triangle = packet.triangles[i];
+            hit.distance = t;
+            hit.barycentrics = glm::vec2(u, v);
+        }
+    }
+}
+
+#endif
+
+}
+
+void buildBvh(
+        const std::vector<glm::vec3> & positions,
+        const std::vector<uint32_t> & positionIndices,
+        Bvh & bvh) {
+    size_t triangleCount = positionIndices.size() / 3;
+
+    bvh.nodes.clear();
+    bvh.packets.clear();
+
+    if (triangleCount == 0)
+        return;
+
+    // Triangle bounds and centroids
+    BuildContext context;
+    context.bounds.resize(triangleCount);
+    context.centroids.resize(triangleCount);
+    context.references.resize(triangleCount);
+
+    parallelFor(triangleCount, PARALLEL_SIZE / 4, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Bounds bounds;
+
+            for (size_t j = 0; j < 3; j++)
+                bounds.grow(positions[positionIndices[i * 3 + j]]);
+
+            context.bounds[i] = bounds;
+            context.centroids[i] = (bounds.minimum + bounds.maximum) * 0.5f;
+            context.references[i] = (uint32_t)i;
+        }
+    });
+
+    bvh.nodes.reserve(triangleCount / 2 * 2 + 1);
+
+    buildNode(context, 0, triangleCount, 0, bvh.nodes);
+
+    // Pack the triangles of every leaf in depth first order
+    for (size_t i = 0; i < bvh.nodes.size(); i++) {
+        BvhNode & node = bvh.nodes[i];
+
+        if (node.count == 0)
+            continue;
+
+        BvhPacket packet;
+
+        for (size_t j = 0; j < BVH_PACKET_SIZE; j++) {
+            uint32_t triangle = j < node.count ? context.references[node.offset + j] : INVALID_TRIANGLE;
+
+            packet.triangles[j] = triangle;
+
+            for (size_t k = 0; k < 3; k++) {
+                glm::vec3 corner = triangle != INVALID_TRIANGLE ?
+                    positions[positionIndices[triangle * 3 + k]] : glm::vec3(0.0f);
+
+                packet.x[k][j] = corner.x;
+                packet.y[k][j] = corner.y;
+                packet.z[k][j] = corner.z;
+            }
+        }
+
+        node.offset = (uint32_t)bvh.packets.size();
+        bvh.packets.push_back(packet);
+    }
+}
+
+bool intersectRay(
+        const Bvh & bvh,
+        const glm::vec3 & origin,
+        const glm::vec3 & direction,
+        float maximumDistance,
+        RayHit & hit) {
+    if (bvh.nodes.empty())
+        return false;
+
+    Ray ray = makeRay(origin, direction);
+
+    hit.triangle = INVALID_TRIANGLE;
+    hit.distance = maximumDistance;
+
+    uint32_t stack[STACK_SIZE];
+    size_t stackSize = 0;
+    float entry;
+
+    if (!intersectBox(bvh.nodes[0], ray, hit.distance, entry))
+        return false;
+
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const BvhNode & node = bvh.nodes[stack[--stackSize]];
+
+        if (node.count > 0) {
+            intersectPacket(bvh.packets[node.offset], ray, hit);
+            continue;
+        }
+
+        // Visit the nearest child first
+        uint32_t first = (uint32_t)(&node - bvh.nodes.data()) + 1;
+        uint32_t second = node.offset;
+
+        float firstEntry, secondEntry;
+        bool firstHit = intersectBox(bvh.nodes[first], ray, hit.distance, firstEntry);
+        bool secondHit = intersectBox(bvh.nodes[second], ray, hit.distance, secondEntry);
+
+        if (firstHit && secondHit && secondEntry < firstEntry) {
+            std::swap(first, second);
+            std::swap(firstHit, secondHit);
+        }
+
+        if (secondHit && stackSize < STACK_SIZE)
+            stack[stackSize++] = second;
+
+        if (firstHit && stackSize < STACK_SIZE)
+            stack[stackSize++] = first;
+    }
+
+    return hit.triangle != INVALID_TRIANGLE;
+}
+
+bool findClosestPoint(
+        const Bvh & bvh,
+        const glm::vec3 & point,
+        float maximumDistance,
+        ClosestPoint & result) {
+    result.triangle = INVALID_TRIANGLE;
+    result.distance = maximumDistance;
+
+    if (bvh.nodes.empty())
+        return false;
+
+    float bestDistance2 = maximumDistance * maximumDistance;
+
+    uint32_t stack[STACK_SIZE];
+    size_t stackSize = 0;
+
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        uint32_t index = stack[--stackSize];
+        const BvhNode & node = bvh.nodes[index];
+
+        if (boxDistance2(node, point) > bestDistance2)
+            continue;
+
+        if (node.count > 0) {
+            const BvhPacket & packet = bvh.packets[node.offset];
+
+            for (size_t i = 0; i < node.count; i++) {
+                glm::vec3 closest = closestPointTriangle(
+                    point,
+                    packetCorner(packet, 0, i),
+                    packetCorner(packet, 1, i),
+                    packetCorner(packet, 2, i));
+
+                glm::vec3 difference = closest - point;
+                float distance2 = glm::dot(difference, difference);
+
+                if (distance2 <= bestDistance2) {
+                    bestDistance2 = distance2;
+
+                    result.triangle = packet.triangles[i];
+                    result.point = closest;
+                }
+            }
+
+            continue;
+        }
+
+        // Visit the nearest child first
+        uint32_t first = index + 1;
+        uint32_t second = node.offset;
+
+        if (boxDistance2(bvh.nodes[second], point) < boxDistance2(bvh.nodes[first], point))
+            std::swap(first, second);
+
+        if (stackSize + 2 <= STACK_SIZE) {
+            stack[stackSize++] = second;
+            stack[stackSize++] = first;
+        }
+    }
+
+    if (result.triangle == INVALID_TRIANGLE)
+        return false;
+
+    result.distance = std::sqrt(bestDistance2);
+
+    return true;
+}
+
+void findOverlaps(
+        const Bvh & bvh,
+        const glm::vec3 & minimum,
+        const glm::vec3 & maximum,
+        std::vector<uint32_t> & triangles) {
+    triangles.clear();
+
+    if (bvh.nodes.empty())
+        return;
+
+    uint32_t stack[STACK_SIZE];
+    size_t stackSize = 0;
+
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        uint32_t index = stack[--stackSize];
+        const BvhNode & node = bvh.nodes[index];
+
+        if (node.minimum[0] > maximum.x || node.maximum[0] < minimum.x ||
+                node.minimum[1] > maximum.y || node.maximum[1] < minimum.y ||
+                node.minimum[2] > maximum.z || node.maximum[2] < minimum.z)
+            continue;
+
+        if (node.count > 0) {
+            const BvhPacket & packet = bvh.packets[node.offset];
+
+            for (size_t i = 0; i < node.count; i++) {
+                Bounds bounds;
+
+                for (size_t j = 0; j < 3; j++)
+                    bounds.grow(packetCorner(packet, j, i));
+
+                if (glm::all(glm::lessThanEqual(bounds.minimum, maximum)) &&
+                        glm::all(glm::greaterThanEqual(bounds.maximum, minimum)))
+                    triangles.push_back(packet.triangles[i]);
+            }
+
+            continue;
+        }
+
+        if (stackSize + 2 <= STACK_SIZE) {
+            stack[stackSize++] = node.offset;
+            stack[stackSize++] = index + 1;
+        }
+    }
+}
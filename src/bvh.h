@@ -0,0 +1,86 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Maximum number of triangles of a leaf, intersected together with SIMD
+const size_t BVH_PACKET_SIZE = 4;
+
+// Bounding volume hierarchy node of 32 bytes, in depth first order
+// An interior node is followed by its first child and offset is its second
+// child. A leaf has count triangles in the packet at offset.
+struct BvhNode {
+    float minimum[3];
+    uint32_t offset;
+    float maximum[3];
+    uint32_t count;
+};
+
+// Corner positions of the triangles of a leaf as structure of arrays,
+// unused lanes are degenerate with an invalid triangle index
+struct BvhPacket {
+    float x[3][BVH_PACKET_SIZE];
+    float y[3][BVH_PACKET_SIZE];
+    float z[3][BVH_PACKET_SIZE];
+    uint32_t triangles[BVH_PACKET_SIZE];
+};
+
+// Flattened bounding volume hierarchy over the triangles of a mesh
+struct Bvh {
+    std::vector<BvhNode> nodes;
+    std::vector<BvhPacket> packets;
+};
+
+// Nearest intersection of a ray with a triangle
+// Barycentrics are the weights of the second and third corners and the
+// distance is in units of the ray direction length.
+struct RayHit {
+    uint32_t triangle;
+    float distance;
+    glm::vec2 barycentrics;
+};
+
+// Nearest point of a triangle to a query point
+struct ClosestPoint {
+    uint32_t triangle;
+    glm::vec3 point;
+    float distance;
+};
+
+// Build hierarchy of the triangles of a Wavefront OBJ index list with the
+// surface area heuristic evaluated over binned centroids, building large
+// subtrees in parallel
+void buildBvh(
+        const std::vector<glm::vec3> & positions,
+        const std::vector<uint32_t> & positionIndices,
+        Bvh & bvh);
+
+// Find the nearest triangle hit by a ray within the maximum distance,
+// regardless of triangle orientation
+bool intersectRay(
+        const Bvh & bvh,
+        const glm::vec3 & origin,
+        const glm::vec3 & direction,
+        float maximumDistance,
+        RayHit & hit);
+
+// Find the nearest point on the mesh within the maximum distance of a point
+bool findClosestPoint(
+        const Bvh & bvh,
+        const glm::vec3 & point,
+        float maximumDistance,
+        ClosestPoint & result);
+
+// Find the triangles whose bounds overlap an axis aligned box
+void findOverlaps(
+        const Bvh & bvh,
+        const glm::vec3 & minimum,
+        const glm::vec3 & maximum,
+        std::vector<uint32_t> & triangles);
+
+#endif
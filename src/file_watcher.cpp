@@ -0,0 +1,158 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+FileWatcher::FileWatcher() : created(false) {
+#ifdef __linux__
+    descriptor = -1;
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+    destroy();
+}
+
+#ifdef __linux__
+bool FileWatcher::create() {
+    destroy();
+
+    descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    created = descriptor >= 0;
+
+    return created;
+}
+
+void FileWatcher::destroy() {
+    if (descriptor >= 0)
+        close(descriptor);
+
+    descriptor = -1;
+    directories.clear();
+    created = false;
+}
+
+bool FileWatcher::watch(const std::string & directory) {
+    if (!created)
+        return false;
+
+    // Files written in place or replaced by a rename
+    int watch = inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+    if (watch < 0)
+        return false;
+
+    directories[watch] = directory;
+
+    return true;
+}
+
+void FileWatcher::poll(std::vector<std::string> & paths) {
+    if (!created)
+        return;
+
+    size_t first = paths.size();
+
+    alignas(inotify_event) char buffer[4096];
+
+    for (;;) {
+        ssize_t length = read(descriptor, buffer, sizeof(buffer));
+
+        if (length <= 0)
+            break;
+
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event * event = (const inotify_event *)(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            std::map<int, std::string>::const_iterator directory = directories.find(event->wd);
+
+            if (directory == directories.end() || event->len == 0)
+                continue;
+
+            std::string path = directory->second + "/" + event->name;
+
+            if (std::find(paths.begin() + first, paths.end(), path) == paths.end())
+                paths.push_back(path);
+        }
+    }
+}
+#else
+bool FileWatcher::create() {
+    destroy();
+
+    created = true;
+
+    return true;
+}
+
+void FileWatcher::destroy() {
+    directories.clear();
+    times.clear();
+    created = false;
+}
+
+bool FileWatcher::watch(const std::string & directory) {
+    if (!created)
+        return false;
+
+    DIR * entries = opendir(directory.c_str());
+
+    if (entries == nullptr)
+        return false;
+
+    closedir(entries);
+
+    directories.push_back(directory);
+    scan(directory, nullptr);
+
+    return true;
+}
+
+void FileWatcher::poll(std::vector<std::string> & paths) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - lastScan;
+
+    if (elapsed.count() < FILE_WATCHER_SCAN_INTERVAL)
+        return;
+
+    lastScan = now;
+
+    for (size_t i = 0; i < directories.size(); i++)
+        scan(directories[i], &paths);
+}
+
+void FileWatcher::scan(const std::string & directory, std::vector<std::string> * paths) {
+    DIR * entries = opendir(directory.c_str());
+
+    if (entries == nullptr)
+        return;
+
+    for (dirent * entry = readdir(entries); entry != nullptr; entry = readdir(entries)) {
+        std::string path = directory + "/" + entry->d_name;
+        struct stat status;
+
+        if (stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+            continue;
+
+        std::map<std::string, time_t>::iterator time = times.find(path);
+
+        if (time != times.end() && time->second == status.st_mtime)
+            continue;
+
+        times[path] = status.st_mtime;
+
+        if (paths != nullptr)
+            paths->push_back(path);
+    }
+
+    closedir(entries);
+}
+#endif
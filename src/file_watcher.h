@@ -0,0 +1,59 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+// Seconds between scans of the watched directories on platforms without
+// change notification
+const double FILE_WATCHER_SCAN_INTERVAL = 0.25;
+
+// Notification of files written or moved into watched directories
+// Linux is notified through inotify without blocking, other platforms
+// compare modification times of the directory entries on polls at least
+// FILE_WATCHER_SCAN_INTERVAL apart.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    bool create();
+    void destroy();
+
+    // Watch files directly inside a directory, not its subdirectories
+    bool watch(const std::string & directory);
+
+    // Append paths of the files changed since the last poll, directory and
+    // file name joined by a slash, each once
+    void poll(std::vector<std::string> & paths);
+
+private:
+    FileWatcher(const FileWatcher &);
+    FileWatcher & operator=(const FileWatcher &);
+
+    bool created;
+
+#ifdef __linux__
+    int descriptor;
+
+    // Watched directory of every watch descriptor
+    std::map<int, std::string> directories;
+#else
+    std::vector<std::string> directories;
+
+    // Last modification time of every file seen
+    std::map<std::string, time_t> times;
+
+    // Time of the last scan, polls before the interval elapses do nothing
+    std::chrono::steady_clock::time_point lastScan;
+
+    // Record modification times of the files of a directory, appending the
+    // changed ones when requested
+    void scan(const std::string & directory, std::vector<std::string> * paths);
+#endif
+};
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+// Check whether the current context exposes an extension
+bool hasExtension(const char * name);
+
+#endif
@@ -0,0 +1,72 @@
+#include "hash.h"
+
+#include <cstring>
+
+namespace {
+
+const uint64_t PRIME0 = 0x9e3779b185ebca87ull;
+const uint64_t PRIME1 = 0xc2b2ae3d27d4eb4full;
+const uint64_t PRIME2 = 0x165667b19e3779f9ull;
+
+inline uint64_t rotate(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t load(const unsigned char * bytes) {
+    uint64_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+
+    return value;
+}
+
+inline uint64_t mixLane(uint64_t accumulator, uint64_t value) {
+    return rotate(accumulator + value * PRIME1, 31) * PRIME0;
+}
+
+}
+
+uint64_t hashBytes(const void * data, size_t size, uint64_t seed) {
+    const unsigned char * bytes = (const unsigned char *)data;
+    const unsigned char * end = bytes + size;
+
+    uint64_t hash;
+
+    // Four independent lanes keep the multipliers busy on long inputs
+    if (size >= 32) {
+        uint64_t lanes[4] = {
+            seed + PRIME0 + PRIME1,
+            seed + PRIME1,
+            seed,
+            seed - PRIME0
+        };
+
+        for (; bytes + 32 <= end; bytes += 32)
+            for (size_t i = 0; i < 4; i++)
+                lanes[i] = mixLane(lanes[i], load(bytes + i * 8));
+
+        hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) +
+            rotate(lanes[2], 12) + rotate(lanes[3], 18);
+
+        for (size_t i = 0; i < 4; i++)
+            hash = (hash ^ mixLane(0, lanes[i])) * PRIME0 + PRIME2;
+    }
+    else
+        hash = seed + PRIME2;
+
+    hash += size;
+
+    for (; bytes + 8 <= end; bytes += 8)
+        hash = rotate(hash ^ mixLane(0, load(bytes)), 27) * PRIME0 + PRIME2;
+
+    for (; bytes < end; bytes++)
+        hash = rotate(hash ^ (*bytes * PRIME2), 11) * PRIME0;
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME1;
+    hash ^= hash >> 29;
+    hash *= PRIME2;
+    hash ^= hash >> 32;
+
+    return hash;
+}
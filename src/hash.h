@@ -0,0 +1,10 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Non cryptographic 64 bit hash of a byte range
+uint64_t hashBytes(const void * data, size_t size, uint64_t seed = 0);
+
+#endif
@@ -0,0 +1,143 @@
+#include "headless_context.h"
+
+#include "logger.h"
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+HeadlessContext::HeadlessContext() : display(nullptr), context(nullptr), framebuffer(0) {
+    renderbuffers[0] = 0;
+    renderbuffers[1] = 0;
+}
+
+HeadlessContext::~HeadlessContext() {
+    destroy();
+}
+
+#ifdef _WIN32
+bool HeadlessContext::create(int width, int height) {
+    LogLine() << "Headless OpenGL contexts are unavailable on Windows.";
+    return false;
+}
+
+void HeadlessContext::destroy() {
+}
+
+void * headlessProcAddress(const char * name) {
+    return nullptr;
+}
+#else
+bool HeadlessContext::create(int width, int height) {
+    destroy();
+
+    // Surfaceless platform of Mesa, falling back to the default display
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+
+    if (getPlatformDisplay != nullptr)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+
+    if (eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)) {
+        LogLine() << "Cannot initialize EGL display.";
+        return false;
+    }
+
+    display = eglDisplay;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        LogLine() << "Cannot bind OpenGL API to EGL.";
+        destroy();
+        return false;
+    }
+
+    // Context without configuration, rendering only into framebuffer objects
+    const EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    EGLContext eglContext = eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+
+    if (eglContext == EGL_NO_CONTEXT) {
+        LogLine() << "Cannot create EGL context.";
+        destroy();
+        return false;
+    }
+
+    context = eglContext;
+
+    if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+        LogLine() << "Cannot make EGL context current.";
+        destroy();
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)headlessProcAddress)) {
+        LogLine() << "Cannot load OpenGL procedures.";
+        destroy();
+        return false;
+    }
+
+    // Framebuffer object standing in for the default framebuffer of a window
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    glGenRenderbuffers(2, renderbuffers);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LogLine() << "Cannot create framebuffer object.";
+        destroy();
+        return false;
+    }
+
+    glViewport(0, 0, width, height);
+
+    return true;
+}
+
+void HeadlessContext::destroy() {
+    if (context != nullptr) {
+        if (framebuffer != 0) {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteRenderbuffers(2, renderbuffers);
+
+            framebuffer = 0;
+            renderbuffers[0] = 0;
+            renderbuffers[1] = 0;
+        }
+
+        eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+
+        context = nullptr;
+    }
+
+    if (display != nullptr) {
+        eglTerminate((EGLDisplay)display);
+        display = nullptr;
+    }
+}
+
+void * headlessProcAddress(const char * name) {
+    return (void *)eglGetProcAddress(name);
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+
+// OpenGL 3.3 core context without a window, rendering into a framebuffer
+// object with color and depth renderbuffers
+// The context is created on an EGL surfaceless display, so it works without
+// a GPU or a display server through Mesa llvmpipe. Unavailable on Windows.
+class HeadlessContext {
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    // Create context, make it current, load OpenGL procedures and bind a
+    // framebuffer object of the given size
+    bool create(int width, int height);
+
+    void destroy();
+
+private:
+    HeadlessContext(const HeadlessContext &);
+    HeadlessContext & operator=(const HeadlessContext &);
+
+    void * display;
+    void * context;
+
+    GLuint framebuffer;
+    GLuint renderbuffers[2];
+};
+
+// Procedure loader of headless contexts
+void * headlessProcAddress(const char * name);
+
+#endif
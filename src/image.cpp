@@ -0,0 +1,888 @@
+#include "image.h"
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// Largest width or height of decoded images
+const size_t MAX_IMAGE_SIDE = 32768;
+
+const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+// Deflate length and distance codes
+const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+const uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Order of the code length code lengths of dynamic Huffman blocks
+const uint8_t CODE_LENGTH_ORDER[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Bits of the Huffman codes decoded with a single table lookup
+const int FAST_BITS = 9;
+
+inline uint32_t packPixel(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+inline uint32_t readBigEndian32(const unsigned char * data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+// Reverse the lowest bits of a Huffman code, stored from the most
+// significant bit while the stream is read from the least significant one
+inline uint32_t reverseBits(uint32_t code, int bits) {
+    uint32_t reversed = 0;
+
+    for (int i = 0; i < bits; i++, code >>= 1)
+        reversed = (reversed << 1) | (code & 1);
+
+    return reversed;
+}
+
+// Bits of a deflate stream, read from the least significant one of every
+// byte, padded with zeros past the end
+class BitReader {
+public:
+    BitReader(const unsigned char * data, size_t size) :
+        current(data), end(data + size), buffer(0), count(0), padding(0) {
+    }
+
+    // Buffer at least 57 bits
+    void refill() {
+        while (count <= 56) {
+            uint64_t byte = 0;
+
+            if (current < end)
+                byte = *current++;
+            else
+                padding++;
+
+            buffer |= byte << count;
+            count += 8;
+        }
+    }
+
+    // Lowest buffered bits, at most 32 after a refill
+    uint32_t peek(int bits) const {
+        return (uint32_t)(buffer & ((1ull << bits) - 1));
+    }
+
+    void consume(int bits) {
+        buffer >>= bits;
+        count -= bits;
+    }
+
+    uint32_t read(int bits) {
+        if (count < bits)
+            refill();
+
+        uint32_t value = peek(bits);
+        consume(bits);
+
+        return value;
+    }
+
+    // Drop bits up to the next byte boundary
+    void align() {
+        consume(count & 7);
+    }
+
+    // Whether more bits were consumed than the stream has
+    bool overrun() const {
+        return (int)padding * 8 > count;
+    }
+
+private:
+    const unsigned char * current;
+    const unsigned char * end;
+
+    uint64_t buffer;
+    int count;
+    size_t padding;
+};
+
+// Canonical Huffman code of deflate, codes up to FAST_BITS long decoded by
+// a table indexed by the next bits and longer ones by code length
+struct Huffman {
+    // Code length shifted by 9 bits and symbol, 0 for longer codes
+    uint16_t fast[1 << FAST_BITS];
+
+    // First code and its rank in symbols sorted by code, of every length,
+    // and the first code of the next length left aligned to 16 bits
+    uint32_t firstCode[17];
+    uint32_t firstRank[17];
+    uint32_t maxCode[18];
+
+    uint16_t symbols[288];
+
+    bool build(const uint8_t * lengths, size_t count) {
+        uint32_t lengthCounts[17] = {};
+
+        for (size_t i = 0; i < count; i++)
+            lengthCounts[lengths[i]]++;
+
+        lengthCounts[0] = 0;
+        std::memset(fast, 0, sizeof(fast));
+
+        uint32_t nextCode[16];
+        uint32_t code = 0, rank = 0;
+
+        for (int length = 1; length < 16; length++) {
+            nextCode[length] = code;
+            firstCode[length] = code;
+            firstRank[length] = rank;
+
+            code += lengthCounts[length];
+
+            // Oversubscribed code
+            if (lengthCounts[length] > 0 && code - 1 >= (1u << length))
+                return false;
+
+            maxCode[length] = code << (16 - length);
+            code <<= 1;
+            rank += lengthCounts[length];
+        }
+
+        maxCode[16] = 0x10000;
+
+        for (size_t i = 0; i < count; i++) {
+            int length = lengths[i];
+
+            if (length == 0)
+                continue;
+
+            uint32_t index = nextCode[length] - firstCode[length] + firstRank[length];
+            symbols[index] = (uint16_t)i;
+
+            if (length <= FAST_BITS) {
+                uint16_t entry = (uint16_t)((length << 9) | i);
+
+                for (uint32_t j = reverseBits(nextCode[length], length); j < (1u << FAST_BITS); j += 1u << length)
+                    fast[j] = entry;
+            }
+
+            nextCode[length]++;
+        }
+
+        return true;
+    }
+
+    // Next symbol, -1 for an invalid code
+    int decode(BitReader & reader) const {
+        reader.refill();
+
+        uint16_t entry = fast[reader.peek(FAST_BITS)];
+
+        if (entry != 0) {
+            reader.consume(entry >> 9);
+            return entry & 511;
+        }
+
+        uint32_t code = reverseBits(reader.peek(16), 16);
+        int length = FAST_BITS + 1;
+
+        while (length < 16 && code >= maxCode[length])
+            length++;
+
+        if (length >= 16)
+            return -1;
+
+        uint32_t index = (code >> (16 - length)) - firstCode[length] + firstRank[length];
+
+        if (index >= 288)
+            return -1;
+
+        reader.consume(length);
+
+        return symbols[index];
+    }
+};
+
+// Decompress zlib stream into an output of the exact expected size
+bool inflateZlib(const unsigned char * data, size_t size, unsigned char * output, size_t outputSize) {
+    // Deflate method without preset dictionary
+    if (size < 2 || (data[0] & 15) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 32) != 0)
+        return false;
+
+    BitReader reader(data + 2, size - 2);
+    size_t produced = 0;
+
+    Huffman literals, distances;
+    bool final = false;
+
+    while (!final) {
+        final = reader.read(1) != 0;
+        uint32_t type = reader.read(2);
+
+        if (type == 0) {
+            // Stored block
+            reader.align();
+
+            uint32_t length = reader.read(16);
+            uint32_t complement = reader.read(16);
+
+            if ((length ^ 0xffff) != complement || length > outputSize - produced)
+                return false;
+
+            for (uint32_t i = 0; i < length; i++)
+                output[produced++] = (unsigned char)reader.read(8);
+        }
+        else if (type == 1 || type == 2) {
+            uint8_t lengths[288 + 32];
+
+            if (type == 1) {
+                // Fixed codes
+                std::memset(lengths, 8, 144);
+                std::memset(lengths + 144, 9, 112);
+                std::memset(lengths + 256, 7, 24);
+                std::memset(lengths + 280, 8, 8);
+
+                literals.build(lengths, 288);
+
+                std::memset(lengths, 5, 32);
+                distances.build(lengths, 32);
+            }
+            else {
+                // Dynamic codes, their lengths coded by a code length code
+                uint32_t literalCount = reader.read(5) + 257;
+                uint32_t distanceCount = reader.read(5) + 1;
+                uint32_t codeLengthCount = reader.read(4) + 4;
+
+                uint8_t codeLengthLengths[19] = {};
+
+                for (uint32_t i = 0; i < codeLengthCount; i++)
+                    codeLengthLengths[CODE_LENGTH_ORDER[i]] = (uint8_t)reader.read(3);
+
+                Huffman codeLengths;
+
+                if (!codeLengths.build(codeLengthLengths, 19))
+                    return false;
+
+                uint32_t total = literalCount + distanceCount;
+                uint32_t count = 0;
+
+                while (count < total) {
+                    int symbol = codeLengths.decode(reader);
+
+                    if (symbol < 0)
+                        return false;
+
+                    if (symbol < 16) {
+                        lengths[count++] = (uint8_t)symbol;
+                        continue;
+                    }
+
+                    uint8_t value = 0;
+                    uint32_t repeat;
+
+                    if (symbol == 16) {
+                        if (count == 0)
+                            return false;
+
+                        value = lengths[count - 1];
+                        repeat = 3 + reader.read(2);
+                    }
+                    else if (symbol == 17)
+                        repeat = 3 + reader.read(3);
+                    else
+                        repeat = 11 + reader.read(7);
+
+                    if (count + repeat > total)
+                        return false;
+
+                    std::memset(lengths + count, value, repeat);
+                    count += repeat;
+                }
+
+                if (!literals.build(lengths, literalCount) || !distances.build(lengths + literalCount, distanceCount))
+                    return false;
+            }
+
+            // Literals and matches up to the end of block symbol
+            while (true) {
+                int symbol = literals.decode(reader);
+
+                if (symbol < 0)
+                    return false;
+
+                if (symbol < 256) {
+                    if (produced == outputSize)
+                        return false;
+
+                    output[produced++] = (unsigned char)symbol;
+                    continue;
+                }
+
+                if (symbol == 256)
+                    break;
+
+                symbol -= 257;
+
+                if (symbol >= 29)
+                    return false;
+
+                size_t length = LENGTH_BASE[symbol] + reader.read(LENGTH_EXTRA[symbol]);
+
+                int distanceSymbol = distances.decode(reader);
+
+                if (distanceSymbol < 0 || distanceSymbol >= 30)
+                    return false;
+
+                size_t distance = DISTANCE_BASE[distanceSymbol] + reader.read(DISTANCE_EXTRA[distanceSymbol]);
+
+                if (distance > produced || length > outputSize - produced)
+                    return false;
+
+                unsigned char * target = output + produced;
+                const unsigned char * source = target - distance;
+
+                if (distance >= length)
+                    std::memcpy(target, source, length);
+                else {
+                    for (size_t i = 0; i < length; i++)
+                        target[i] = source[i];
+                }
+
+                produced += length;
+            }
+        }
+        else
+            return false;
+
+        if (reader.overrun())
+            return false;
+    }
+
+    return produced == outputSize;
+}
+
+inline unsigned char paethPredictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p;
+    int pb = p > b ? p - b : b - p;
+    int pc = p > c ? p - c : c - p;
+
+    if (pa <= pb && pa <= pc)
+        return (unsigned char)a;
+
+    return (unsigned char)(pb <= pc ? b : c);
+}
+
+bool decodePng(
+        const unsigned char * data,
+        size_t size,
+        size_t & width,
+        size_t & height,
+        std::vector<uint32_t> & pixels) {
+    if (size < sizeof(PNG_SIGNATURE) || std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0)
+        return false;
+
+    uint32_t bitDepth = 0, colorType = 0;
+    bool header = false;
+
+    uint32_t palette[256];
+    size_t paletteSize = 0;
+
+    // Transparent sample values of gray and truecolor images
+    bool hasKey = false;
+    uint32_t key[3] = { 0, 0, 0 };
+
+    std::vector<unsigned char> compressed;
+
+    size_t offset = sizeof(PNG_SIGNATURE);
+
+    while (true) {
+        if (size - offset < 12)
+            return false;
+
+        uint32_t length = readBigEndian32(data + offset);
+        const unsigned char * type = data + offset + 4;
+        const unsigned char * chunk = data + offset + 8;
+
+        if (length > size - offset - 12)
+            return false;
+
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (length != 13)
+                return false;
+
+            width = readBigEndian32(chunk);
+            height = readBigEndian32(chunk + 4);
+            bitDepth = chunk[8];
+            colorType = chunk[9];
+
+            // Deflate compression, adaptive filtering and no interlacing
+            if (chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0)
+                return false;
+
+            header = true;
+        }
+        else if (std::memcmp(type, "PLTE", 4) == 0) {
+            paletteSize = length / 3;
+
+            if (paletteSize > 256)
+                return false;
+
+            for (size_t i = 0; i < paletteSize; i++)
+                palette[i] = packPixel(chunk[i * 3], chunk[i * 3 + 1], chunk[i * 3 + 2], 255);
+        }
+        else if (std::memcmp(type, "tRNS", 4) == 0) {
+            if (colorType == 3) {
+                for (size_t i = 0; i < length && i < paletteSize; i++)
+                    palette[i] = (palette[i] & 0xffffff) | ((uint32_t)chunk[i] << 24);
+            }
+            else if (colorType == 0 && length >= 2) {
+                key[0] = (chunk[0] << 8) | chunk[1];
+                hasKey = true;
+            }
+            else if (colorType == 2 && length >= 6) {
+                for (int i = 0; i < 3; i++)
+                    key[i] = (chunk[i * 2] << 8) | chunk[i * 2 + 1];
+
+                hasKey = true;
+            }
+        }
+        else if (std::memcmp(type, "IDAT", 4) == 0)
+            compressed.insert(compressed.end(), chunk, chunk + length);
+        else if (std::memcmp(type, "IEND", 4) == 0)
+            break;
+        else if ((type[0] & 32) == 0)
+            return false; // Unknown critical chunk
+
+        offset += length + 12;
+    }
+
+    if (!header || width == 0 || height == 0 || width > MAX_IMAGE_SIDE || height > MAX_IMAGE_SIDE)
+        return false;
+
+    // Samples per pixel of every color type, and allowed bit depths
+    size_t channels;
+
+    switch (colorType) {
+    case 0:
+        channels = 1;
+        break;
+    case 2:
+        channels = 3;
+        break;
+    case 3:
+        channels = 1;
+        break;
+    case 4:
+        channels = 2;
+        break;
+    case 6:
+        channels = 4;
+        break;
+    default:
+        return false;
+    }
+
+    bool validDepth = colorType == 3 ? bitDepth <= 8 : (colorType == 0 || bitDepth >= 8);
+
+    if (!validDepth || (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16) ||
+            (colorType == 3 && paletteSize == 0))
+        return false;
+
+    size_t pixelBits = channels * bitDepth;
+    size_t rowBytes = (width * pixelBits + 7) / 8;
+    size_t filterBytes = pixelBits >= 8 ? pixelBits / 8 : 1;
+
+    // Rows of filtered bytes, each after its filter type
+    std::vector<unsigned char> rows(height * (rowBytes + 1));
+
+    if (!inflateZlib(compressed.data(), compressed.size(), rows.data(), rows.size()))
+        return false;
+
+    std::vector<unsigned char>().swap(compressed);
+
+    // Unfilter rows in place from the previous unfiltered one
+    std::vector<unsigned char> zeros(rowBytes, 0);
+
+    for (size_t y = 0; y < height; y++) {
+        unsigned char filter = rows[y * (rowBytes + 1)];
+        unsigned char * row = rows.data() + y * (rowBytes + 1) + 1;
+        const unsigned char * previous = y > 0 ? row - (rowBytes + 1) : zeros.data();
+
+        switch (filter) {
+        case 0:
+            break;
+        case 1:
+            for (size_t i = filterBytes; i < rowBytes; i++)
+                row[i] = (unsigned char)(row[i] + row[i - filterBytes]);
+            break;
+        case 2:
+            for (size_t i = 0; i < rowBytes; i++)
+                row[i] = (unsigned char)(row[i] + previous[i]);
+            break;
+        case 3:
+            for (size_t i = 0; i < rowBytes; i++) {
+                int left = i >= filterBytes ? row[i - filterBytes] : 0;
+                row[i] = (unsigned char)(row[i] + ((left + previous[i]) >> 1));
+            }
+            break;
+        case 4:
+            for (size_t i = 0; i < rowBytes; i++) {
+                int left = i >= filterBytes ? row[i - filterBytes] : 0;
+                int upperLeft = i >= filterBytes ? previous[i - filterBytes] : 0;
+                row[i] = (unsigned char)(row[i] + paethPredictor(left, previous[i], upperLeft));
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+
+    // Expand samples to RGBA, keeping the high byte of 16 bit ones
+    pixels.resize(width * height);
+
+    uint32_t sampleMask = (1u << bitDepth) - 1;
+    uint32_t grayScale = bitDepth < 8 ? 255 / sampleMask : 1;
+
+    for (size_t y = 0; y < height; y++) {
+        const unsigned char * row = rows.data() + y * (rowBytes + 1) + 1;
+        uint32_t * target = pixels.data() + y * width;
+
+        for (size_t x = 0; x < width; x++) {
+            uint32_t samples[4];
+
+            for (size_t c = 0; c < channels; c++) {
+                size_t index = x * channels + c;
+
+                if (bitDepth == 8)
+                    samples[c] = row[index];
+                else if (bitDepth == 16)
+                    samples[c] = (row[index * 2] << 8) | row[index * 2 + 1];
+                else {
+                    size_t bit = index * bitDepth;
+                    samples[c] = (row[bit / 8] >> (8 - bitDepth - bit % 8)) & sampleMask;
+                }
+            }
+
+            // Eight bit value of a sample
+            uint32_t shift = bitDepth == 16 ? 8 : 0;
+
+            switch (colorType) {
+            case 0: {
+                uint32_t gray = bitDepth < 8 ? samples[0] * grayScale : samples[0] >> shift;
+                uint32_t alpha = hasKey && samples[0] == key[0] ? 0 : 255;
+                target[x] = packPixel(gray, gray, gray, alpha);
+                break;
+            }
+            case 2: {
+                bool transparent = hasKey && samples[0] == key[0] && samples[1] == key[1] && samples[2] == key[2];
+                target[x] = packPixel(samples[0] >> shift, samples[1] >> shift, samples[2] >> shift, transparent ? 0 : 255);
+                break;
+            }
+            case 3:
+                target[x] = samples[0] < paletteSize ? palette[samples[0]] : 0;
+                break;
+            case 4: {
+                uint32_t gray = samples[0] >> shift;
+                target[x] = packPixel(gray, gray, gray, samples[1] >> shift);
+                break;
+            }
+            default:
+                target[x] = packPixel(samples[0] >> shift, samples[1] >> shift, samples[2] >> shift, samples[3] >> shift);
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool decodeTga(
+        const unsigned char * data,
+        size_t size,
+        size_t & width,
+        size_t & height,
+        std::vector<uint32_t> & pixels) {
+    if (size < 18)
+        return false;
+
+    size_t idLength = data[0];
+    size_t colorMapType = data[1];
+    size_t imageType = data[2];
+    size_t colorMapLength = data[5] | (data[6] << 8);
+    size_t colorMapDepth = data[7];
+    size_t depth = data[16];
+    size_t descriptor = data[17];
+
+    width = data[12] | (data[13] << 8);
+    height = data[14] | (data[15] << 8);
+
+    // Gray or true color pixels, raw or run length encoded
+    bool gray = imageType == 3 || imageType == 11;
+    bool encoded = imageType == 10 || imageType == 11;
+
+    if (imageType != 2 && imageType != 3 && imageType != 10 && imageType != 11)
+        return false;
+
+    if (gray ? depth != 8 : depth != 24 && depth != 32)
+        return false;
+
+    if (colorMapType > 1 || width == 0 || height == 0)
+        return false;
+
+    // Skip image identifier and the unused color map
+    size_t offset = 18 + idLength + (colorMapType ? colorMapLength * ((colorMapDepth + 7) / 8) : 0);
+    size_t pixelBytes = depth / 8;
+
+    // Alpha is only meaningful with alpha bits in the descriptor
+    bool hasAlpha = depth == 32 && (descriptor & 15) != 0;
+
+    pixels.resize(width * height);
+
+    auto readPixel = [&](const unsigned char * pixel) {
+        if (gray)
+            return packPixel(pixel[0], pixel[0], pixel[0], 255);
+
+        return packPixel(pixel[2], pixel[1], pixel[0], hasAlpha ? pixel[3] : 255);
+    };
+
+    size_t count = width * height;
+
+    if (!encoded) {
+        if (offset > size || count > (size - offset) / pixelBytes)
+            return false;
+
+        for (size_t i = 0; i < count; i++)
+            pixels[i] = readPixel(data + offset + i * pixelBytes);
+    }
+    else {
+        // Packets of repeated or raw pixels, which may cross rows
+        size_t i = 0;
+
+        while (i < count) {
+            if (offset >= size)
+                return false;
+
+            unsigned char packet = data[offset++];
+            size_t length = (packet & 0x7f) + 1;
+
+            if (length > count - i)
+                return false;
+
+            if (packet & 0x80) {
+                if (pixelBytes > size - offset)
+                    return false;
+
+                uint32_t pixel = readPixel(data + offset);
+                offset += pixelBytes;
+
+                for (size_t j = 0; j < length; j++)
+                    pixels[i++] = pixel;
+            }
+            else {
+                if (length > (size - offset) / pixelBytes)
+                    return false;
+
+                for (size_t j = 0; j < length; j++, offset += pixelBytes)
+                    pixels[i++] = readPixel(data + offset);
+            }
+        }
+    }
+
+    // Rows are stored from the bottom unless the top origin bit is set,
+    // and from the left unless the right origin bit is set
+    if ((descriptor & 32) == 0) {
+        for (size_t y = 0; y < height / 2; y++)
+            std::swap_ranges(
+                pixels.begin() + y * width,
+                pixels.begin() + (y + 1) * width,
+                pixels.begin() + (height - 1 - y) * width);
+    }
+
+    if (descriptor & 16) {
+        for (size_t y = 0; y < height; y++)
+            std::reverse(pixels.begin() + y * width, pixels.begin() + (y + 1) * width);
+    }
+
+    return true;
+}
+
+// Next decimal number of a Portable Anymap header, skipping whitespace and
+// comments
+bool readPnmNumber(const unsigned char * data, size_t size, size_t & offset, size_t & value) {
+    while (offset < size) {
+        if (data[offset] == '#') {
+            while (offset < size && data[offset] != '\n')
+                offset++;
+        }
+        else if (data[offset] == ' ' || data[offset] == '\t' || data[offset] == '\r' || data[offset] == '\n')
+            offset++;
+        else
+            break;
+    }
+
+    if (offset >= size || data[offset] < '0' || data[offset] > '9')
+        return false;
+
+    value = 0;
+
+    while (offset < size && data[offset] >= '0' && data[offset] <= '9') {
+        value = value * 10 + (data[offset++] - '0');
+
+        if (value > 0xffffff)
+            return false;
+    }
+
+    return true;
+}
+
+bool decodePnm(
+        const unsigned char * data,
+        size_t size,
+        size_t & width,
+        size_t & height,
+        std::vector<uint32_t> & pixels) {
+    if (size < 3 || data[0] != 'P' || (data[1] != '5' && data[1] != '6'))
+        return false;
+
+    size_t channels = data[1] == '6' ? 3 : 1;
+    size_t offset = 2;
+    size_t maximum;
+
+    if (!readPnmNumber(data, size, offset, width) ||
+            !readPnmNumber(data, size, offset, height) ||
+            !readPnmNumber(data, size, offset, maximum))
+        return false;
+
+    // Single whitespace before the samples
+    offset++;
+
+    if (width == 0 || height == 0 || width > MAX_IMAGE_SIDE || height > MAX_IMAGE_SIDE ||
+            maximum == 0 || maximum > 255 || offset > size ||
+            (size - offset) / channels / width < height)
+        return false;
+
+    pixels.resize(width * height);
+
+    for (size_t i = 0; i < width * height; i++) {
+        const unsigned char * sample = data + offset + i * channels;
+
+        uint32_t r = sample[0] * 255 / maximum;
+        uint32_t g = sample[channels / 3] * 255 / maximum;
+        uint32_t b = sample[channels / 3 * 2] * 255 / maximum;
+
+        pixels[i] = packPixel(r, g, b, 255);
+    }
+
+    return true;
+}
+
+}
+
+bool writePpm(const std::string & filename, size_t width, size_t height, const uint32_t * pixels) {
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    std::vector<unsigned char> row(width * 3);
+
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            uint32_t pixel = pixels[y * width + x];
+
+            row[x * 3] = (unsigned char)(pixel & 0xff);
+            row[x * 3 + 1] = (unsigned char)((pixel >> 8) & 0xff);
+            row[x * 3 + 2] = (unsigned char)((pixel >> 16) & 0xff);
+        }
+
+        file.write((const char *)row.data(), row.size());
+    }
+
+    file.close();
+
+    return !file.fail();
+}
+
+bool writeTga(const std::string & filename, size_t width, size_t height, const uint32_t * pixels) {
+    if (width > 0xffff || height > 0xffff)
+        return false;
+
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    // Raw true color pixels with 8 alpha bits, rows from the top
+    unsigned char header[18] = {};
+    header[2] = 2;
+    header[12] = (unsigned char)(width & 0xff);
+    header[13] = (unsigned char)(width >> 8);
+    header[14] = (unsigned char)(height & 0xff);
+    header[15] = (unsigned char)(height >> 8);
+    header[16] = 32;
+    header[17] = 32 | 8;
+
+    file.write((const char *)header, sizeof(header));
+
+    std::vector<unsigned char> row(width * 4);
+
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            uint32_t pixel = pixels[y * width + x];
+
+            row[x * 4] = (unsigned char)((pixel >> 16) & 0xff);
+            row[x * 4 + 1] = (unsigned char)((pixel >> 8) & 0xff);
+            row[x * 4 + 2] = (unsigned char)(pixel & 0xff);
+            row[x * 4 + 3] = (unsigned char)(pixel >> 24);
+        }
+
+        file.write((const char *)row.data(), row.size());
+    }
+
+    file.close();
+
+    return !file.fail();
+}
+
+bool readImage(
+        const std::string & filename,
+        size_t & width,
+        size_t & height,
+        std::vector<uint32_t> & pixels) {
+    MappedFile file;
+
+    if (!file.open(filename))
+        return false;
+
+    const unsigned char * data = (const unsigned char *)file.data();
+    size_t size = file.size();
+
+    if (size >= sizeof(PNG_SIGNATURE) && std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0)
+        return decodePng(data, size, width, height, pixels);
+
+    if (size >= 2 && data[0] == 'P' && (data[1] == '5' || data[1] == '6'))
+        return decodePnm(data, size, width, height, pixels);
+
+    return decodeTga(data, size, width, height, pixels);
+}
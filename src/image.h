@@ -0,0 +1,28 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Write RGBA pixels, rows from the top, to binary Portable Pixmap file
+// format, dropping alpha
+bool writePpm(const std::string & filename, size_t width, size_t height, const uint32_t * pixels);
+
+// Write RGBA pixels, rows from the top, to uncompressed 32 bit Truevision
+// TGA file format
+bool writeTga(const std::string & filename, size_t width, size_t height, const uint32_t * pixels);
+
+// Decode image file into RGBA pixels, rows from the top, red in the low byte
+// Supported are PNG without interlacing, of 8 or 16 bit samples or palette
+// indices, TGA of 8 bit gray, 24 or 32 bit pixels, raw or run length
+// encoded, and binary Portable Graymap and Pixmap of 8 bit samples. The
+// format is told by the contents, files of no known signature are read as TGA.
+bool readImage(
+        const std::string & filename,
+        size_t & width,
+        size_t & height,
+        std::vector<uint32_t> & pixels);
+
+#endif
@@ -0,0 +1,169 @@
+#include "input.h"
+
+#include <glfw/glfw3.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
+InputQueue::InputQueue() {
+    head.store(0);
+    tail.store(0);
+    droppedEvents.store(0);
+}
+
+bool InputQueue::push(const InputEvent & event) {
+    size_t position = head.load(std::memory_order_relaxed);
+
+    if (position - tail.load(std::memory_order_acquire) == INPUT_QUEUE_CAPACITY) {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    events[position & (INPUT_QUEUE_CAPACITY - 1)] = event;
+    head.store(position + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool InputQueue::pop(InputEvent & event) {
+    size_t position = tail.load(std::memory_order_relaxed);
+
+    if (position == head.load(std::memory_order_acquire))
+        return false;
+
+    event = events[position & (INPUT_QUEUE_CAPACITY - 1)];
+    tail.store(position + 1, std::memory_order_release);
+
+    return true;
+}
+
+size_t InputQueue::dropped() const {
+    return droppedEvents.load(std::memory_order_relaxed);
+}
+
+ModelController::ModelController() :
+        started(false),
+        left(false), right(false), up(false), down(false),
+        translation(0.0f), scale(1.0f), yaw(0.0f), pitch(0.0f),
+        backgroundState(false), consumedEvents(false) {
+}
+
+void ModelController::update(InputQueue & queue, std::chrono::steady_clock::time_point now) {
+    pickPositions.clear();
+    consumedEvents = false;
+
+    InputEvent event;
+
+    while (queue.pop(event))
+        pending.push_back(event);
+
+    if (!started) {
+        time = now;
+        started = true;
+    }
+
+    std::chrono::steady_clock::duration step =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(INPUT_TIMESTEP));
+
+    if (now - time > step * (long)INPUT_MAX_STEPS)
+        time = now - step * (long)INPUT_MAX_STEPS;
+
+    size_t applied = 0;
+
+    for (;;) {
+        // Apply the events of the step in order before integrating it,
+        // including the events of the step in progress
+        std::chrono::steady_clock::time_point end = std::min(time + step, now);
+
+        while (applied < pending.size() && pending[applied].time <= end) {
+            if (!consumedEvents || pending[applied].time < oldestEvent)
+                oldestEvent = pending[applied].time;
+
+            consumedEvents = true;
+
+            apply(pending[applied]);
+            applied++;
+        }
+
+        if (time + step > now)
+            break;
+
+        time += step;
+
+        float angle = INPUT_ROTATION_SPEED * (float)INPUT_TIMESTEP;
+
+        yaw += angle * ((right ? 1.0f : 0.0f) - (left ? 1.0f : 0.0f));
+        pitch += angle * ((up ? 1.0f : 0.0f) - (down ? 1.0f : 0.0f));
+    }
+
+    pending.erase(pending.begin(), pending.begin() + applied);
+}
+
+void ModelController::apply(const InputEvent & event) {
+    bool pressed = event.action == GLFW_PRESS || event.action == GLFW_REPEAT;
+
+    if (event.type == INPUT_EVENT_KEY) {
+        switch (event.code) {
+        case GLFW_KEY_A:
+            if (event.action == GLFW_PRESS)
+                backgroundState = !backgroundState;
+            break;
+        case GLFW_KEY_LEFT:
+            left = pressed;
+            break;
+        case GLFW_KEY_RIGHT:
+            right = pressed;
+            break;
+        case GLFW_KEY_UP:
+            up = pressed;
+            break;
+        case GLFW_KEY_DOWN:
+            down = pressed;
+            break;
+        case GLFW_KEY_S:
+            if (pressed)
+                scale *= glm::vec3(2.0f, 2.0f, 1.0f);
+            break;
+        case GLFW_KEY_N:
+            if (pressed)
+                scale *= glm::vec3(0.5f, 0.5f, 1.0f);
+            break;
+        }
+    }
+    else if (event.type == INPUT_EVENT_CURSOR)
+        translation = glm::vec3((float)(event.x * 0.02), (float)(event.y * 0.02), 0.0f);
+    else if (event.type == INPUT_EVENT_SCROLL) {
+        if (event.y == -1.0)
+            scale *= glm::vec3(2.0f, 2.0f, 1.0f);
+        else
+            scale *= glm::vec3(0.5f, 0.5f, 1.0f);
+    }
+    else if (event.type == INPUT_EVENT_BUTTON) {
+        if (event.code == GLFW_MOUSE_BUTTON_LEFT && event.action == GLFW_PRESS)
+            pickPositions.push_back(glm::dvec2(event.x, event.y));
+    }
+}
+
+glm::mat4 ModelController::model() const {
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), translation);
+    model = glm::rotate(model, pitch, glm::vec3(1.0f, 0.0f, 0.0f));
+    model = glm::rotate(model, yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    return glm::scale(model, scale);
+}
+
+bool ModelController::background() const {
+    return backgroundState;
+}
+
+const std::vector<glm::dvec2> & ModelController::picks() const {
+    return pickPositions;
+}
+
+bool ModelController::consumed(std::chrono::steady_clock::time_point & oldest) const {
+    if (consumedEvents)
+        oldest = oldestEvent;
+
+    return consumedEvents;
+}
@@ -0,0 +1,123 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Events held by an input queue, a power of two
+const size_t INPUT_QUEUE_CAPACITY = 1024;
+
+// Fixed timestep of the model controller in seconds
+const double INPUT_TIMESTEP = 1.0 / 120.0;
+
+// Steps integrated by a single update at most, the remaining time is
+// dropped after a long stall
+const size_t INPUT_MAX_STEPS = 30;
+
+// Rotation of the model while an arrow key is held, in radians per second
+const float INPUT_ROTATION_SPEED = 3.0f;
+
+enum InputEventType {
+    INPUT_EVENT_KEY = 0,
+    INPUT_EVENT_CURSOR = 1,
+    INPUT_EVENT_SCROLL = 2,
+    INPUT_EVENT_BUTTON = 3
+};
+
+// Window event stamped with the time its callback ran
+// Keys and buttons use the GLFW codes, cursor events and button presses
+// carry the cursor position in x and y, scroll events the offsets.
+struct InputEvent {
+    InputEventType type;
+    std::chrono::steady_clock::time_point time;
+
+    int code;
+    int action;
+
+    double x;
+    double y;
+};
+
+// Fixed size queue of events without locks, between a single producer and
+// a single consumer thread
+class InputQueue {
+public:
+    InputQueue();
+
+    // Append event, false when full and the event is dropped
+    bool push(const InputEvent & event);
+
+    // Remove the oldest event, false when empty
+    bool pop(InputEvent & event);
+
+    // Events dropped because the queue was full
+    size_t dropped() const;
+
+private:
+    InputQueue(const InputQueue &);
+    InputQueue & operator=(const InputQueue &);
+
+    InputEvent events[INPUT_QUEUE_CAPACITY];
+
+    // Events pushed and popped, written by the producer and the consumer
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+
+    std::atomic<size_t> droppedEvents;
+};
+
+// Model transform driven by input events and integrated with a fixed
+// timestep, independent from the frame rate
+// Events apply at the start of the step containing them, the step in
+// progress included, so that every update consumes the whole queue.
+// Held arrow keys rotate the model during the steps, the cursor position
+// translates it and the scroll wheel and the S and N keys scale it.
+class ModelController {
+public:
+    ModelController();
+
+    // Drain the queue and integrate the steps elapsed until the given time
+    void update(InputQueue & queue, std::chrono::steady_clock::time_point now);
+
+    glm::mat4 model() const;
+
+    // Background toggled by the A key
+    bool background() const;
+
+    // Cursor positions of the left button presses applied by the last update
+    const std::vector<glm::dvec2> & picks() const;
+
+    // Whether the last update applied events and the time of the oldest
+    bool consumed(std::chrono::steady_clock::time_point & oldest) const;
+
+private:
+    void apply(const InputEvent & event);
+
+    // Events drained from the queue, applied before the update returns
+    std::vector<InputEvent> pending;
+
+    std::chrono::steady_clock::time_point time;
+    bool started;
+
+    // Held arrow keys
+    bool left, right, up, down;
+
+    glm::vec3 translation;
+    glm::vec3 scale;
+    float yaw;
+    float pitch;
+    bool backgroundState;
+
+    std::vector<glm::dvec2> pickPositions;
+
+    bool consumedEvents;
+    std::chrono::steady_clock::time_point oldestEvent;
+};
+
+#endif
@@ -0,0 +1,447 @@
+#include "instancing.h"
+
+#include "meshlet.h"
+#include "parallel.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Distance between neighbor instances of a grid, in bounding sphere radii
+const float GRID_SPACING = 2.5f;
+
+// Fence wait timeout of one attempt in nanoseconds
+const GLuint64 FENCE_TIMEOUT = 1000000;
+
+// Level of detail of culled instances
+const size_t CULLED_LOD = std::numeric_limits<size_t>::max();
+
+// Levels of children below the root of an orbit scene tree and children
+// per node
+const size_t ORBIT_DEPTH = 3;
+const size_t ORBIT_BRANCHING = 4;
+
+// Scale of a child relative to its parent and distance of its orbit in
+// bounding sphere radii of the parent
+const float ORBIT_SCALE = 0.35f;
+const float ORBIT_DISTANCE = 2.0f;
+
+// Distance between neighbor trees of an orbit scene, in root radii
+const float ORBIT_SPACING = 7.0f;
+
+// Colors of orbit scene nodes by depth
+const glm::vec4 ORBIT_COLORS[ORBIT_DEPTH + 1] = {
+    glm::vec4(1.0f, 0.85f, 0.4f, 1.0f),
+    glm::vec4(0.4f, 0.7f, 1.0f, 1.0f),
+    glm::vec4(0.6f, 1.0f, 0.5f, 1.0f),
+    glm::vec4(1.0f, 0.5f, 0.6f, 1.0f)
+};
+
+// Local transformation of a node of an orbit scene placing the mesh center
+// at a position of the parent with the given rotation and scale
+NodeTransform orbitTransform(
+        const glm::vec3 & center,
+        const glm::vec3 & position,
+        const glm::quat & rotation,
+        float scale) {
+    NodeTransform transform;
+    transform.translation = position - rotation * (center * scale);
+    transform.rotation = rotation;
+    transform.scale = glm::vec3(scale);
+
+    return transform;
+}
+
+}
+
+bool parseInstanceUpdate(const std::string & name, InstanceUpdate & update) {
+    if (name == "orphan")
+        update = INSTANCE_UPDATE_ORPHAN;
+    else if (name == "ring")
+        update = INSTANCE_UPDATE_RING;
+    else
+        return false;
+
+    return true;
+}
+
+const char * instanceUpdateName(InstanceUpdate update) {
+    switch (update) {
+    case INSTANCE_UPDATE_ORPHAN:
+        return "orphan";
+    case INSTANCE_UPDATE_RING:
+        return "ring";
+    }
+
+    return "unknown";
+}
+
+InstanceBuffer::InstanceBuffer() :
+        buffer(0), capacity(0), update(INSTANCE_UPDATE_ORPHAN), frame(0), waitTime(0.0) {
+    for (size_t i = 0; i < INSTANCE_RING_FRAMES; i++)
+        fences[i] = 0;
+}
+
+InstanceBuffer::~InstanceBuffer() {
+    destroy();
+}
+
+void InstanceBuffer::create(size_t capacity, InstanceUpdate update) {
+    destroy();
+
+    this->capacity = capacity;
+    this->update = update;
+
+    size_t regions = update == INSTANCE_UPDATE_RING ? INSTANCE_RING_FRAMES : 1;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, regions * capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+}
+
+void InstanceBuffer::destroy() {
+    for (size_t i = 0; i < INSTANCE_RING_FRAMES; i++) {
+        if (fences[i] != 0)
+            glDeleteSync(fences[i]);
+
+        fences[i] = 0;
+    }
+
+    if (buffer != 0)
+        glDeleteBuffers(1, &buffer);
+
+    buffer = 0;
+    capacity = 0;
+    frame = 0;
+}
+
+InstanceData * InstanceBuffer::map(size_t count) {
+    if (count > capacity)
+        return nullptr;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    if (update == INSTANCE_UPDATE_ORPHAN) {
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+
+        return (InstanceData *)glMapBufferRange(
+            GL_ARRAY_BUFFER,
+            0,
+            count * sizeof(InstanceData),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    }
+
+    // Wait until the draws of the frame that last used the region are done
+    GLsync & fence = fences[frame];
+
+    if (fence != 0) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (;;) {
+            GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+
+            if (result != GL_TIMEOUT_EXPIRED)
+                break;
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        waitTime += elapsed.count();
+
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    return (InstanceData *)glMapBufferRange(
+        GL_ARRAY_BUFFER,
+        frame * capacity * sizeof(InstanceData),
+        count * sizeof(InstanceData),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void InstanceBuffer::unmap() {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+void InstanceBuffer::bindAttributes(size_t first) {
+    size_t region = update == INSTANCE_UPDATE_RING ? frame : 0;
+    size_t offset = (region * capacity + first) * sizeof(InstanceData);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    // Model matrix column by column
+    for (GLuint i = 0; i < 4; i++) {
+        glVertexAttribPointer(
+            INSTANCE_MODEL_LOCATION + i,
+            4,
+            GL_FLOAT,
+            false,
+            sizeof(InstanceData),
+            (const GLvoid *)(offset + sizeof(glm::vec4) * i));
+        glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + i, 1);
+        glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + i);
+    }
+
+    glVertexAttribPointer(
+        INSTANCE_COLOR_LOCATION,
+        4,
+        GL_FLOAT,
+        false,
+        sizeof(InstanceData),
+        (const GLvoid *)(offset + sizeof(glm::mat4)));
+    glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+    glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+}
+
+void InstanceBuffer::finishFrame() {
+    if (update != INSTANCE_UPDATE_RING)
+        return;
+
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % INSTANCE_RING_FRAMES;
+}
+
+double InstanceBuffer::takeWaitTime() {
+    double time = waitTime;
+    waitTime = 0.0;
+
+    return time;
+}
+
+void resetInstanceAttributes() {
+    for (GLuint i = 0; i < 4; i++)
+        glVertexAttrib4f(
+            INSTANCE_MODEL_LOCATION + i,
+            i == 0 ? 1.0f : 0.0f,
+            i == 1 ? 1.0f : 0.0f,
+            i == 2 ? 1.0f : 0.0f,
+            i == 3 ? 1.0f : 0.0f);
+
+    glVertexAttrib4f(INSTANCE_COLOR_LOCATION, 1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+void buildInstanceGrid(
+        size_t side,
+        const glm::vec3 & center,
+        float radius,
+        std::vector<InstanceData> & instances) {
+    instances.resize(side * side);
+
+    float scale = radius > 0.0f ? 1.0f / radius : 1.0f;
+    float extent = (side - 1) * GRID_SPACING * 0.5f;
+
+    for (size_t i = 0; i < side; i++)
+        for (size_t j = 0; j < side; j++) {
+            InstanceData & instance = instances[i * side + j];
+
+            glm::vec3 position(j * GRID_SPACING - extent, 0.0f, i * GRID_SPACING - extent);
+
+            instance.model =
+                glm::translate(glm::mat4(1.0f), position) *
+                glm::scale(glm::mat4(1.0f), glm::vec3(scale)) *
+                glm::translate(glm::mat4(1.0f), -center);
+
+            float u = side > 1 ? (float)j / (side - 1) : 0.5f;
+            float v = side > 1 ? (float)i / (side - 1) : 0.5f;
+
+            instance.color = glm::vec4(0.5f + 0.5f * u, 0.5f + 0.5f * v, 1.0f - 0.5f * u * v, 1.0f);
+        }
+}
+
+void animateInstanceGrid(
+        const std::vector<InstanceData> & grid,
+        float time,
+        std::vector<glm::mat4> & models,
+        std::vector<glm::vec4> & colors) {
+    models.resize(grid.size());
+    colors.resize(grid.size());
+
+    parallelFor(grid.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            glm::vec3 position(grid[i].model[3]);
+
+            // Rotate around the vertical axis through the grid cell, with a
+            // phase per instance
+            float angle = time + (float)(i % 97) * 0.1f;
+
+            models[i] =
+                glm::translate(glm::mat4(1.0f), position) *
+                glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f)) *
+                glm::translate(glm::mat4(1.0f), -position) *
+                grid[i].model;
+            colors[i] = grid[i].color;
+        }
+    });
+}
+
+float buildOrbitScene(
+        size_t nodeCount,
+        const glm::vec3 & center,
+        float radius,
+        SceneGraph & scene,
+        std::vector<glm::vec4> & colors) {
+    scene.clear();
+    colors.clear();
+
+    size_t treeNodes = 0;
+
+    for (size_t i = 0, level = 1; i <= ORBIT_DEPTH; i++, level *= ORBIT_BRANCHING)
+        treeNodes += level;
+
+    size_t trees = (nodeCount + treeNodes - 1) / treeNodes;
+    size_t side = std::max<size_t>((size_t)std::ceil(std::sqrt((double)trees)), 1);
+    float extent = (side - 1) * ORBIT_SPACING * 0.5f;
+    float scale = radius > 0.0f ? 1.0f / radius : 1.0f;
+
+    glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+
+    // Nodes to add with their parent, depth and tree or orbit slot, added
+    // depth first so that the scene stays sorted
+    struct OrbitNode {
+        uint32_t parent;
+        size_t depth;
+        size_t slot;
+    };
+
+    std::vector<OrbitNode> stack;
+
+    for (size_t tree = 0; tree < trees; tree++) {
+        OrbitNode root = { NO_PARENT, 0, tree };
+        stack.push_back(root);
+
+        while (!stack.empty() && scene.size() < nodeCount) {
+            OrbitNode entry = stack.back();
+            stack.pop_back();
+
+            NodeTransform local;
+
+            if (entry.parent == NO_PARENT) {
+                glm::vec3 position(
+                    (entry.slot % side) * ORBIT_SPACING - extent,
+                    0.0f,
+                    (entry.slot / side) * ORBIT_SPACING - extent);
+
+                local = orbitTransform(center, position, identity, scale);
+            }
+            else {
+                // Children evenly spaced around the parent, in its mesh units
+                float angle = 6.2831853f * entry.slot / ORBIT_BRANCHING;
+                glm::vec3 offset(std::cos(angle), 0.0f, std::sin(angle));
+
+                local = orbitTransform(center, center + offset * radius * ORBIT_DISTANCE, identity, ORBIT_SCALE);
+            }
+
+            uint32_t node = scene.addNode(entry.parent, local);
+            colors.push_back(ORBIT_COLORS[entry.depth]);
+
+            if (entry.depth == ORBIT_DEPTH)
+                continue;
+
+            for (size_t i = ORBIT_BRANCHING; i > 0; i--) {
+                OrbitNode child = { node, entry.depth + 1, i - 1 };
+                stack.push_back(child);
+            }
+        }
+
+        stack.clear();
+    }
+
+    return extent + ORBIT_SPACING * 0.5f;
+}
+
+void animateOrbitScene(SceneGraph & scene, const glm::vec3 & center, float time) {
+    for (uint32_t i = 0; i < scene.size(); i++) {
+        if (scene.subtreeEnd(i) == i + 1)
+            continue;
+
+        // Position of the mesh center, kept while spinning
+        const NodeTransform & local = scene.local(i);
+        glm::vec3 position = local.translation + local.rotation * (center * local.scale.x);
+
+        float angle = time * (0.5f + (float)(i % 7) * 0.1f);
+        glm::quat rotation = glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        scene.setLocal(i, orbitTransform(center, position, rotation, local.scale.x));
+    }
+}
+
+size_t batchInstances(
+        const glm::mat4 * models,
+        const glm::vec4 * colors,
+        size_t count,
+        const glm::vec3 & center,
+        float radius,
+        const std::vector<MeshLod> & lods,
+        const glm::mat4 & modelView,
+        const glm::mat4 & projection,
+        float viewportHeight,
+        std::vector<size_t> & instanceLods,
+        InstanceData * output,
+        size_t counts[MAX_LOD_COUNT],
+        const unsigned char * occluded) {
+    instanceLods.resize(count, 0);
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(projection * modelView, planes);
+
+    // Cull and select level of detail of every instance
+    parallelFor(count, 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const glm::mat4 & model = models[i];
+
+            glm::vec3 instanceCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+            float scale = std::max(
+                glm::length(glm::vec3(model[0])),
+                std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+            bool outside = false;
+
+            for (int j = 0; j < 6 && !outside; j++)
+                outside = glm::dot(glm::vec3(planes[j]), instanceCenter) + planes[j].w < -radius * scale;
+
+            if (outside || (occluded != nullptr && occluded[i])) {
+                instanceLods[i] = CULLED_LOD;
+                continue;
+            }
+
+            float screenSize = projectedSphereSize(
+                center, radius, modelView * model, projection, viewportHeight);
+            size_t current = instanceLods[i] == CULLED_LOD ? 0 : instanceLods[i];
+
+            instanceLods[i] = selectLod(lods, current, radius, screenSize);
+        }
+    });
+
+    // Counting sort of visible instances by level of detail
+    size_t offsets[MAX_LOD_COUNT];
+
+    for (size_t i = 0; i < MAX_LOD_COUNT; i++)
+        counts[i] = 0;
+
+    for (size_t i = 0; i < count; i++)
+        if (instanceLods[i] != CULLED_LOD)
+            counts[instanceLods[i]]++;
+
+    size_t visible = 0;
+
+    for (size_t i = 0; i < MAX_LOD_COUNT; i++) {
+        offsets[i] = visible;
+        visible += counts[i];
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (instanceLods[i] != CULLED_LOD) {
+            InstanceData & instance = output[offsets[instanceLods[i]]++];
+            instance.model = models[i];
+            instance.color = colors[i];
+        }
+    }
+
+    return visible;
+}
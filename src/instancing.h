@@ -0,0 +1,148 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+
+#include "mesh.h"
+#include "mesh_lod.h"
+#include "scene_graph.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Shader program locations of the instance attributes, the model matrix
+// takes one location per column
+const GLuint INSTANCE_MODEL_LOCATION = 4;
+const GLuint INSTANCE_COLOR_LOCATION = 8;
+
+// Number of frames in flight of a ring instance buffer
+const size_t INSTANCE_RING_FRAMES = 3;
+
+// Per instance vertex attributes
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+// Streaming of instance data written every frame
+enum InstanceUpdate {
+    // Reallocate the buffer storage before every write, the driver keeps
+    // the storage used by pending draws alive
+    INSTANCE_UPDATE_ORPHAN = 0,
+
+    // Write unsynchronized into the next region of a buffer holding several
+    // frames, waiting on the fence of the frame that last used the region
+    INSTANCE_UPDATE_RING = 1
+};
+
+// Parse instance update name (orphan or ring)
+bool parseInstanceUpdate(const std::string & name, InstanceUpdate & update);
+
+// Name of instance update
+const char * instanceUpdateName(InstanceUpdate update);
+
+// Streamed vertex buffer of per instance attributes
+class InstanceBuffer {
+public:
+    InstanceBuffer();
+    ~InstanceBuffer();
+
+    // Create buffer storage for the given number of instances per frame
+    void create(size_t capacity, InstanceUpdate update);
+
+    void destroy();
+
+    // Map storage for the instances of the current frame, nullptr when
+    // exceeding the capacity
+    InstanceData * map(size_t count);
+
+    void unmap();
+
+    // Point the instance attributes of the bound vertex array object at
+    // the given instance of the current frame, advancing once per instance
+    void bindAttributes(size_t first);
+
+    // Fence the draws of the current frame and move to the next region
+    void finishFrame();
+
+    // Seconds spent waiting on fences since the last call
+    double takeWaitTime();
+
+private:
+    InstanceBuffer(const InstanceBuffer &);
+    InstanceBuffer & operator=(const InstanceBuffer &);
+
+    GLuint buffer;
+    size_t capacity;
+    InstanceUpdate update;
+
+    size_t frame;
+    GLsync fences[INSTANCE_RING_FRAMES];
+    double waitTime;
+};
+
+// Set the values of the disabled instance attributes to an identity model
+// matrix and a white color, for drawing without instancing
+void resetInstanceAttributes();
+
+// Stress scene of copies of a mesh laid out on a square grid of the given
+// side, scaled to a unit bounding sphere and colored by grid position
+void buildInstanceGrid(
+        size_t side,
+        const glm::vec3 & center,
+        float radius,
+        std::vector<InstanceData> & instances);
+
+// Spin every instance of a grid around its vertical axis, writing the
+// model matrices and colors of the instances
+void animateInstanceGrid(
+        const std::vector<InstanceData> & grid,
+        float time,
+        std::vector<glm::mat4> & models,
+        std::vector<glm::vec4> & colors);
+
+// Stress scene of nested orbits of copies of a mesh: trees laid out on a
+// square grid, every node orbited by smaller children, up to the given
+// node count
+// Nodes are in mesh units, roots scaled to a unit bounding sphere, so world
+// matrices are instance model matrices. Colors are by depth in node order.
+// Returns half the side of the square covered by the trees.
+float buildOrbitScene(
+        size_t nodeCount,
+        const glm::vec3 & center,
+        float radius,
+        SceneGraph & scene,
+        std::vector<glm::vec4> & colors);
+
+// Spin every node with children around the vertical axis through the mesh
+// center, carrying its children along
+void animateOrbitScene(SceneGraph & scene, const glm::vec3 & center, float time);
+
+// Cull instances against the view frustum and write the visible ones
+// sorted by level of detail, returning their count
+// The view matrix includes the model matrix shared by every instance.
+// Levels are selected per instance from the projected size of its bounding
+// sphere, starting from the level of the previous frame, and the number of
+// instances of every level is written to the counts. Instances flagged as
+// occluded, when given, are culled along those outside of the frustum.
+size_t batchInstances(
+        const glm::mat4 * models,
+        const glm::vec4 * colors,
+        size_t count,
+        const glm::vec3 & center,
+        float radius,
+        const std::vector<MeshLod> & lods,
+        const glm::mat4 & modelView,
+        const glm::mat4 & projection,
+        float viewportHeight,
+        std::vector<size_t> & instanceLods,
+        InstanceData * output,
+        size_t counts[MAX_LOD_COUNT],
+        const unsigned char * occluded = nullptr);
+
+#endif
@@ -0,0 +1,563 @@
+#include "light_clusters.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LIGHT_CLUSTERS_SSE2
+#endif
+
+namespace {
+
+const size_t CLUSTER_TILES = CLUSTER_TILES_X * CLUSTER_TILES_Y;
+
+// Lights transformed to view space by a single task
+const size_t LIGHT_TASK_LIGHTS = 1024;
+
+// Cosine of the half angle above which the bounding sphere of a cone is
+// centered on the cone axis at half the range over the cosine
+const float TIGHT_CONE_COSINE = 0.70710678f;
+
+// Bounding sphere of the cone of a light, or of its range when the cone
+// opens wider than a half space
+glm::vec4 boundingSphere(const glm::vec3 & position, const glm::vec3 & direction, float range, float cosOuter) {
+    if (cosOuter <= 0.0f)
+        return glm::vec4(position, range);
+
+    if (cosOuter <= TIGHT_CONE_COSINE) {
+        float sinOuter = std::sqrt(1.0f - cosOuter * cosOuter);
+
+        return glm::vec4(position + direction * (cosOuter * range), sinOuter * range);
+    }
+
+    float radius = range / (2.0f * cosOuter);
+
+    return glm::vec4(position + direction * radius, radius);
+}
+
+// Squared distances of a coordinate to 4 intervals, written to distances,
+// and bit mask of those within a squared distance
+inline unsigned intervalDistances(
+        const float * minimums,
+        const float * maximums,
+        float coordinate,
+        float limit,
+        float * distances) {
+#ifdef LIGHT_CLUSTERS_SSE2
+    __m128 zero = _mm_setzero_ps();
+    __m128 value = _mm_set1_ps(coordinate);
+
+    __m128 distance = _mm_add_ps(
+        _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minimums), value), zero),
+        _mm_max_ps(_mm_sub_ps(value, _mm_loadu_ps(maximums)), zero));
+    distance = _mm_mul_ps(distance, distance);
+
+    _mm_storeu_ps(distances, distance);
+
+    return (unsigned)_mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(limit)));
+#else
+    unsigned mask = 0;
+
+    for (int i = 0; i < 4; i++) {
+        float distance = std::max(minimums[i] - coordinate, 0.0f) + std::max(coordinate - maximums[i], 0.0f);
+        distances[i] = distance * distance;
+
+        if (distances[i] <= limit)
+            mask |= 1u << i;
+    }
+
+    return mask;
+#endif
+}
+
+// Bit mask of 4 squared distances within a limit
+inline unsigned withinDistance(const float * distances, float limit) {
+#ifdef LIGHT_CLUSTERS_SSE2
+    return (unsigned)_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(distances), _mm_set1_ps(limit)));
+#else
+    unsigned mask = 0;
+
+    for (int i = 0; i < 4; i++)
+        if (distances[i] <= limit)
+            mask |= 1u << i;
+
+    return mask;
+#endif
+}
+
+// Bounds of the tiles along an axis for every slice, from the projection
+// scale and offset of the axis, view coordinates being proportional to
+// depth along the sides of a tile
+void tileBounds(
+        size_t tiles,
+        float scale,
+        float offset,
+        const std::vector<float> & depths,
+        std::vector<float> & minimums,
+        std::vector<float> & maximums) {
+    minimums.resize(CLUSTER_SLICES * tiles);
+    maximums.resize(CLUSTER_SLICES * tiles);
+
+    for (size_t i = 0; i < tiles; i++) {
+        float low = (-1.0f + 2.0f * i / tiles + offset) / scale;
+        float high = (-1.0f + 2.0f * (i + 1) / tiles + offset) / scale;
+
+        for (size_t slice = 0; slice < CLUSTER_SLICES; slice++) {
+            float nearDepth = depths[slice];
+            float farDepth = depths[slice + 1];
+
+            minimums[slice * tiles + i] = std::min(low * nearDepth, low * farDepth);
+            maximums[slice * tiles + i] = std::max(high * nearDepth, high * farDepth);
+        }
+    }
+}
+
+// Color of a hue in [0, 1) at full saturation and value
+glm::vec3 hueColor(float hue) {
+    glm::vec3 color(
+        std::fabs(hue * 6.0f - 3.0f) - 1.0f,
+        2.0f - std::fabs(hue * 6.0f - 2.0f),
+        2.0f - std::fabs(hue * 6.0f - 4.0f));
+
+    return glm::clamp(color, glm::vec3(0.0f), glm::vec3(1.0f));
+}
+
+}
+
+Light pointLight(const glm::vec3 & position, float range, const glm::vec3 & color) {
+    Light light;
+    light.position = position;
+    light.range = range;
+    light.color = color;
+    light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+
+    // Cosines below every direction
+    light.cosInner = -1.0f;
+    light.cosOuter = -2.0f;
+
+    return light;
+}
+
+Light spotLight(
+        const glm::vec3 & position,
+        const glm::vec3 & direction,
+        float range,
+        float innerAngle,
+        float outerAngle,
+        const glm::vec3 & color) {
+    Light light;
+    light.position = position;
+    light.range = range;
+    light.color = color;
+    light.direction = glm::normalize(direction);
+    light.cosInner = std::cos(innerAngle);
+    light.cosOuter = std::cos(outerAngle);
+
+    return light;
+}
+
+LightClusters::LightClusters() :
+        slicePairs(CLUSTER_SLICES),
+        sliceIndices(CLUSTER_SLICES),
+        ranges(CLUSTER_COUNT * 2, 0),
+        nearSlice(0.0f),
+        farSlice(0.0f) {
+}
+
+void LightClusters::update(
+        const std::vector<Light> & lights,
+        const glm::mat4 & view,
+        const glm::mat4 & projection,
+        LightBinningStatistics * statistics) {
+    PROFILE_ZONE("Bin lights");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Transform lights to view space and bound them
+    data.resize(lights.size() * LIGHT_TEXELS);
+    spheres.resize(lights.size());
+
+    // Ranges follow a uniform scale of the view
+    glm::mat3 rotation(view);
+    float scale = glm::length(rotation[0]);
+
+    parallelFor(lights.size(), LIGHT_TASK_LIGHTS, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const Light & light = lights[i];
+
+            glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            glm::vec3 direction = glm::normalize(rotation * light.direction);
+            float range = light.range * scale;
+
+            data[i * LIGHT_TEXELS] = glm::vec4(position, range);
+            data[i * LIGHT_TEXELS + 1] = glm::vec4(light.color, light.cosInner);
+            data[i * LIGHT_TEXELS + 2] = glm::vec4(direction, light.cosOuter);
+
+            glm::vec4 sphere = boundingSphere(position, direction, range, light.cosOuter);
+            spheres[i] = glm::vec4(sphere.x, sphere.y, -sphere.z, sphere.w);
+        }
+    });
+
+    // Span slices over the depths touched by the lights within the clip
+    // planes of a perspective projection
+    float clipNear = projection[3][2] / (projection[2][2] - 1.0f);
+    float clipFar = projection[3][2] / (projection[2][2] + 1.0f);
+
+    float nearest = clipFar;
+    float farthest = clipNear;
+
+    for (size_t i = 0; i < spheres.size(); i++) {
+        const glm::vec4 & sphere = spheres[i];
+
+        if (sphere.z + sphere.w > clipNear && sphere.z - sphere.w < clipFar) {
+            nearest = std::min(nearest, sphere.z - sphere.w);
+            farthest = std::max(farthest, sphere.z + sphere.w);
+        }
+    }
+
+    nearSlice = std::max(nearest, clipNear);
+    farSlice = std::min(farthest, clipFar);
+
+    std::atomic<size_t> tasks(0);
+
+    if (farSlice > nearSlice) {
+        sliceDepths.resize(CLUSTER_SLICES + 1);
+
+        for (size_t i = 0; i <= CLUSTER_SLICES; i++)
+            sliceDepths[i] = nearSlice * std::pow(farSlice / nearSlice, (float)i / CLUSTER_SLICES);
+
+        tileBounds(CLUSTER_TILES_X, projection[0][0], projection[2][0], sliceDepths, columnMinimums, columnMaximums);
+        tileBounds(CLUSTER_TILES_Y, projection[1][1], projection[2][1], sliceDepths, rowMinimums, rowMaximums);
+
+        parallelFor(CLUSTER_SLICES, 1, [&](size_t begin, size_t end) {
+            for (size_t slice = begin; slice < end; slice++)
+                binSlice(slice);
+
+            tasks++;
+        });
+
+        // Compact the lists of every slice in slice order
+        std::vector<size_t> offsets(CLUSTER_SLICES + 1, 0);
+
+        for (size_t slice = 0; slice < CLUSTER_SLICES; slice++)
+            offsets[slice + 1] = offsets[slice] + sliceIndices[slice].size();
+
+        indices.resize(offsets.back());
+
+        parallelFor(CLUSTER_SLICES, 1, [&](size_t begin, size_t end) {
+            for (size_t slice = begin; slice < end; slice++) {
+                std::copy(sliceIndices[slice].begin(), sliceIndices[slice].end(), indices.begin() + offsets[slice]);
+
+                for (size_t tile = 0; tile < CLUSTER_TILES; tile++)
+                    ranges[(slice * CLUSTER_TILES + tile) * 2] += (uint32_t)offsets[slice];
+            }
+        });
+    }
+    else {
+        // Nothing to light
+        farSlice = nearSlice = clipNear;
+
+        std::fill(ranges.begin(), ranges.end(), 0);
+        indices.clear();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (statistics != nullptr) {
+        statistics->lights = lights.size();
+        statistics->litClusters = 0;
+        statistics->maximumClusterLights = 0;
+        statistics->indices = indices.size();
+        statistics->tasks = tasks.load();
+        statistics->seconds = elapsed.count();
+
+        for (size_t i = 0; i < CLUSTER_COUNT; i++) {
+            uint32_t count = ranges[i * 2 + 1];
+
+            if (count > 0)
+                statistics->litClusters++;
+
+            statistics->maximumClusterLights = std::max<size_t>(statistics->maximumClusterLights, count);
+        }
+
+        std::vector<bool> visible(lights.size(), false);
+
+        for (size_t i = 0; i < indices.size(); i++)
+            visible[indices[i]] = true;
+
+        statistics->visibleLights = std::count(visible.begin(), visible.end(), true);
+    }
+}
+
+void LightClusters::binSlice(size_t slice) {
+    std::vector<uint32_t> & pairs = slicePairs[slice];
+    pairs.clear();
+
+    float nearDepth = sliceDepths[slice];
+    float farDepth = sliceDepths[slice + 1];
+
+    const float * columnMinimum = &columnMinimums[slice * CLUSTER_TILES_X];
+    const float * columnMaximum = &columnMaximums[slice * CLUSTER_TILES_X];
+    const float * rowMinimum = &rowMinimums[slice * CLUSTER_TILES_Y];
+    const float * rowMaximum = &rowMaximums[slice * CLUSTER_TILES_Y];
+
+    float columnDistances[CLUSTER_TILES_X];
+    float rowDistances[CLUSTER_TILES_Y];
+
+    // Collect tile and light pairs of the spheres overlapping froxels
+    for (size_t i = 0; i < spheres.size(); i++) {
+        const glm::vec4 & sphere = spheres[i];
+
+        float depthDistance = std::max(nearDepth - sphere.z, 0.0f) + std::max(sphere.z - farDepth, 0.0f);
+        float limit = sphere.w * sphere.w - depthDistance * depthDistance;
+
+        if (limit < 0.0f)
+            continue;
+
+        unsigned columns = 0;
+
+        for (size_t j = 0; j < CLUSTER_TILES_X; j += 4)
+            columns |= intervalDistances(
+                columnMinimum + j, columnMaximum + j, sphere.x, limit, columnDistances + j) << j;
+
+        if (columns == 0)
+            continue;
+
+        unsigned rows = 0;
+
+        for (size_t j = 0; j < CLUSTER_TILES_Y; j += 4)
+            rows |= intervalDistances(rowMinimum + j, rowMaximum + j, sphere.y, limit, rowDistances + j) << j;
+
+        for (size_t row = 0; row < CLUSTER_TILES_Y; row++) {
+            if ((rows & (1u << row)) == 0)
+                continue;
+
+            // Columns within the distance left by the row
+            float rowLimit = limit - rowDistances[row];
+            unsigned overlapped = 0;
+
+            for (size_t j = 0; j < CLUSTER_TILES_X; j += 4)
+                overlapped |= withinDistance(columnDistances + j, rowLimit) << j;
+
+            overlapped &= columns;
+
+            for (size_t column = 0; overlapped != 0; column++, overlapped >>= 1)
+                if (overlapped & 1u) {
+                    pairs.push_back((uint32_t)(row * CLUSTER_TILES_X + column));
+                    pairs.push_back((uint32_t)i);
+                }
+        }
+    }
+
+    // Sort light indices by tile, keeping the light order within tiles
+    uint32_t * sliceRanges = &ranges[slice * CLUSTER_TILES * 2];
+
+    for (size_t tile = 0; tile < CLUSTER_TILES; tile++)
+        sliceRanges[tile * 2 + 1] = 0;
+
+    for (size_t i = 0; i < pairs.size(); i += 2)
+        sliceRanges[pairs[i] * 2 + 1]++;
+
+    uint32_t offset = 0;
+
+    for (size_t tile = 0; tile < CLUSTER_TILES; tile++) {
+        sliceRanges[tile * 2] = offset;
+        offset += sliceRanges[tile * 2 + 1];
+    }
+
+    std::vector<uint32_t> & sorted = sliceIndices[slice];
+    sorted.resize(offset);
+
+    uint32_t next[CLUSTER_TILES];
+
+    for (size_t tile = 0; tile < CLUSTER_TILES; tile++)
+        next[tile] = sliceRanges[tile * 2];
+
+    for (size_t i = 0; i < pairs.size(); i += 2)
+        sorted[next[pairs[i]]++] = pairs[i + 1];
+}
+
+const std::vector<glm::vec4> & LightClusters::lightData() const {
+    return data;
+}
+
+const std::vector<uint32_t> & LightClusters::clusterRanges() const {
+    return ranges;
+}
+
+const std::vector<uint32_t> & LightClusters::lightIndices() const {
+    return indices;
+}
+
+float LightClusters::nearDepth() const {
+    return nearSlice;
+}
+
+float LightClusters::farDepth() const {
+    return farSlice;
+}
+
+glm::vec2 LightClusters::sliceScale() const {
+    if (farSlice <= nearSlice)
+        return glm::vec2(0.0f);
+
+    float scale = CLUSTER_SLICES / std::log(farSlice / nearSlice);
+
+    return glm::vec2(scale, -std::log(nearSlice) * scale);
+}
+
+LightClusterBuffers::LightClusterBuffers() :
+        clusteredUniform(-1),
+        clusterTileScaleUniform(-1),
+        clusterSliceScaleUniform(-1) {
+    for (int i = 0; i < 3; i++) {
+        buffers[i] = 0;
+        textures[i] = 0;
+    }
+}
+
+LightClusterBuffers::~LightClusterBuffers() {
+}
+
+void LightClusterBuffers::create() {
+    destroy();
+
+    static const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+
+    glGenBuffers(3, buffers);
+    glGenTextures(3, textures);
+
+    for (int i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusterBuffers::destroy() {
+    if (textures[0] != 0)
+        glDeleteTextures(3, textures);
+
+    if (buffers[0] != 0)
+        glDeleteBuffers(3, buffers);
+
+    for (int i = 0; i < 3; i++) {
+        buffers[i] = 0;
+        textures[i] = 0;
+    }
+}
+
+void LightClusterBuffers::upload(const LightClusters & clusters) {
+    PROFILE_ZONE("Upload light clusters");
+
+    const void * data[3] = {
+        clusters.lightData().data(),
+        clusters.clusterRanges().data(),
+        clusters.lightIndices().data()
+    };
+
+    size_t sizes[3] = {
+        clusters.lightData().size() * sizeof(glm::vec4),
+        clusters.clusterRanges().size() * sizeof(uint32_t),
+        clusters.lightIndices().size() * sizeof(uint32_t)
+    };
+
+    // Orphan the storage of the previous frame
+    for (int i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(sizes[i], 16), NULL, GL_STREAM_DRAW);
+
+        if (sizes[i] > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusterBuffers::setProgram(ShaderProgram & program) {
+    clusteredUniform = program.uniform("clustered");
+    clusterTileScaleUniform = program.uniform("clusterTileScale");
+    clusterSliceScaleUniform = program.uniform("clusterSliceScale");
+
+    program.set(program.uniform("lightData"), (GLint)LIGHT_DATA_TEXTURE_UNIT);
+    program.set(program.uniform("lightClusters"), (GLint)LIGHT_CLUSTER_TEXTURE_UNIT);
+    program.set(program.uniform("lightIndices"), (GLint)LIGHT_INDEX_TEXTURE_UNIT);
+}
+
+void LightClusterBuffers::bind(ShaderProgram & program, const LightClusters & clusters, int width, int height) {
+    static const GLuint units[3] = { LIGHT_DATA_TEXTURE_UNIT, LIGHT_CLUSTER_TEXTURE_UNIT, LIGHT_INDEX_TEXTURE_UNIT };
+
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+    }
+
+    // Leave the unit of the diffuse texture active for texture loads
+    glActiveTexture(GL_TEXTURE0);
+
+    program.set(clusteredUniform, (GLint)1);
+    program.set(clusterTileScaleUniform, glm::vec2(
+        CLUSTER_TILES_X / (float)std::max(width, 1),
+        CLUSTER_TILES_Y / (float)std::max(height, 1)));
+    program.set(clusterSliceScaleUniform, clusters.sliceScale());
+}
+
+void buildLightField(
+        size_t count,
+        const glm::vec3 & minimum,
+        const glm::vec3 & maximum,
+        std::vector<Light> & lights) {
+    lights.clear();
+    lights.reserve(count);
+
+    // Same field on every run
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    glm::vec3 size = maximum - minimum;
+
+    // Distance between neighbor lights if laid out on a square grid
+    float spacing = std::sqrt(size.x * size.z / std::max<size_t>(count, 1));
+    float range = 2.0f * spacing + size.y;
+
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 position = minimum + size * glm::vec3(unit(random), unit(random), unit(random));
+        glm::vec3 color = hueColor(unit(random)) * (0.5f + unit(random));
+
+        if (i % 4 == 3)
+            lights.push_back(spotLight(
+                position, glm::vec3(0.0f, -1.0f, 0.0f), range * 1.5f, 0.35f, 0.6f, color * 2.0f));
+        else
+            lights.push_back(pointLight(position, range, color));
+    }
+}
+
+void animateLightField(const std::vector<Light> & field, float time, std::vector<Light> & lights) {
+    lights.resize(field.size());
+
+    parallelFor(field.size(), LIGHT_TASK_LIGHTS, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            // Circles of a quarter range at a speed and phase of the light
+            float angle = time * (0.5f + 0.1f * (i % 7)) + i;
+            float radius = field[i].range * 0.25f;
+
+            lights[i] = field[i];
+            lights[i].position += glm::vec3(std::cos(angle) * radius, 0.0f, std::sin(angle) * radius);
+        }
+    });
+}
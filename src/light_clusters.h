@@ -0,0 +1,194 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+
+#include "shader_program.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Froxel grid of clustered shading: tiles across the viewport, times
+// slices exponentially spaced in view depth
+// Tile counts are multiples of 4 so that tiles are tested 4 at a time.
+const size_t CLUSTER_TILES_X = 16;
+const size_t CLUSTER_TILES_Y = 12;
+const size_t CLUSTER_SLICES = 24;
+const size_t CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+// Texture units of the light cluster buffers, after the diffuse texture
+const GLuint LIGHT_DATA_TEXTURE_UNIT = 1;
+const GLuint LIGHT_CLUSTER_TEXTURE_UNIT = 2;
+const GLuint LIGHT_INDEX_TEXTURE_UNIT = 3;
+
+// RGBA32F texels of a light in the light data buffer
+const size_t LIGHT_TEXELS = 3;
+
+// Point or spot light in world space, whose lighting falls off to zero at
+// its range
+// Spot lights fade from the inner to the outer cone around their direction,
+// given as cosines of the half angles. Point lights are spot lights whose
+// cones hold every direction.
+struct Light {
+    glm::vec3 position;
+    float range;
+
+    // Linear color times intensity
+    glm::vec3 color;
+
+    glm::vec3 direction;
+    float cosInner;
+    float cosOuter;
+};
+
+Light pointLight(const glm::vec3 & position, float range, const glm::vec3 & color);
+
+Light spotLight(
+        const glm::vec3 & position,
+        const glm::vec3 & direction,
+        float range,
+        float innerAngle,
+        float outerAngle,
+        const glm::vec3 & color);
+
+// Work done by binning lights into clusters
+struct LightBinningStatistics {
+    size_t lights;
+
+    // Lights overlapping at least one cluster
+    size_t visibleLights;
+
+    // Clusters with at least one light, and the most lights of a cluster
+    size_t litClusters;
+    size_t maximumClusterLights;
+
+    // Entries of the light index lists of every cluster
+    size_t indices;
+
+    // Ranges of slices binned in parallel
+    size_t tasks;
+
+    double seconds;
+};
+
+// Lights of a view binned into the froxels of its projection
+// Lights are transformed to view space and bounded by spheres, tight around
+// the cones of spot lights. Slices span the depth range touched by the
+// spheres, which a fragment outside of receives no light from. The froxel
+// bounds of a slice are separable, so that the squared distance of a
+// sphere to a froxel is the sum of its distances to a column, a row and the
+// slice, and columns and rows are tested 4 at a time. Slices are binned in
+// parallel into lists of light indices per cluster, compacted in cluster
+// order.
+class LightClusters {
+public:
+    LightClusters();
+
+    // Bin lights for a view and a perspective projection
+    void update(
+            const std::vector<Light> & lights,
+            const glm::mat4 & view,
+            const glm::mat4 & projection,
+            LightBinningStatistics * statistics = nullptr);
+
+    // View space lights, LIGHT_TEXELS texels each: position and range,
+    // color and inner cone cosine, direction and outer cone cosine
+    const std::vector<glm::vec4> & lightData() const;
+
+    // Offset and count of the light indices of every cluster, by tile
+    // along x, then along y, then by slice
+    const std::vector<uint32_t> & clusterRanges() const;
+
+    const std::vector<uint32_t> & lightIndices() const;
+
+    // View depths of the near side of the first slice and of the far side
+    // of the last one, equal without lights in front of the camera
+    float nearDepth() const;
+    float farDepth() const;
+
+    // Slice of a view depth as log(depth) * x + y
+    glm::vec2 sliceScale() const;
+
+private:
+    LightClusters(const LightClusters &);
+    LightClusters & operator=(const LightClusters &);
+
+    void binSlice(size_t slice);
+
+    // Bounds in view space of the columns and rows of tiles of every slice,
+    // and depths of the slice sides
+    std::vector<float> columnMinimums;
+    std::vector<float> columnMaximums;
+    std::vector<float> rowMinimums;
+    std::vector<float> rowMaximums;
+    std::vector<float> sliceDepths;
+
+    // Bounding spheres of the lights in view space, with depth positive
+    std::vector<glm::vec4> spheres;
+
+    // Cluster and light pairs of every slice, and light indices of every
+    // slice sorted by cluster
+    std::vector<std::vector<uint32_t> > slicePairs;
+    std::vector<std::vector<uint32_t> > sliceIndices;
+
+    std::vector<glm::vec4> data;
+    std::vector<uint32_t> ranges;
+    std::vector<uint32_t> indices;
+
+    float nearSlice;
+    float farSlice;
+};
+
+// Light clusters uploaded to texture buffers sampled by the clustered
+// forward shading of a shader program
+class LightClusterBuffers {
+public:
+    LightClusterBuffers();
+    ~LightClusterBuffers();
+
+    void create();
+
+    void destroy();
+
+    // Replace buffer contents with the lights binned for the current frame
+    void upload(const LightClusters & clusters);
+
+    // Resolve uniforms of a new shader program and bind its samplers to the
+    // light cluster texture units
+    void setProgram(ShaderProgram & program);
+
+    // Bind buffers to their texture units and enable clustered shading of
+    // a viewport of the given size
+    void bind(ShaderProgram & program, const LightClusters & clusters, int width, int height);
+
+private:
+    LightClusterBuffers(const LightClusterBuffers &);
+    LightClusterBuffers & operator=(const LightClusterBuffers &);
+
+    GLuint buffers[3];
+    GLuint textures[3];
+
+    int clusteredUniform;
+    int clusterTileScaleUniform;
+    int clusterSliceScaleUniform;
+};
+
+// Stress scene of lights over a box, point lights with one spot light
+// pointing down in every 4, of random colors
+// Ranges reach a few neighbor lights.
+void buildLightField(
+        size_t count,
+        const glm::vec3 & minimum,
+        const glm::vec3 & maximum,
+        std::vector<Light> & lights);
+
+// Move every light of a field along a horizontal circle around its place,
+// writing the moved lights
+void animateLightField(const std::vector<Light> & field, float time, std::vector<Light> & lights);
+
+#endif
@@ -0,0 +1,136 @@
+#include "logger.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Lines are appended to a pending buffer, which the writer thread swaps
+// with an empty one before writing it outside of the lock
+class Logger {
+public:
+    Logger() : stop(false), writing(false), dropped(0) {
+    }
+
+    // Write remaining lines on exit
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+
+        available.notify_all();
+
+        if (writer.joinable())
+            writer.join();
+
+        write(pending);
+    }
+
+    void append(const std::string & line) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (pending.size() + line.size() + 1 > LOG_BUFFER_BYTES) {
+                dropped++;
+                return;
+            }
+
+            pending += line;
+            pending += '\n';
+
+            // Start writer thread with the first line
+            if (!writer.joinable() && !stop)
+                writer = std::thread(&Logger::work, this);
+        }
+
+        available.notify_one();
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (!writer.joinable()) {
+            write(pending);
+            pending.clear();
+            return;
+        }
+
+        while (!pending.empty() || writing)
+            written.wait(lock);
+    }
+
+    size_t droppedLines() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dropped;
+    }
+
+private:
+    void work() {
+        std::string buffer;
+
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                writing = false;
+                written.notify_all();
+
+                while (!stop && pending.empty())
+                    available.wait(lock);
+
+                if (pending.empty())
+                    return;
+
+                buffer.swap(pending);
+                writing = true;
+            }
+
+            write(buffer);
+            buffer.clear();
+        }
+    }
+
+    static void write(const std::string & buffer) {
+        if (buffer.empty())
+            return;
+
+        std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+        std::fflush(stdout);
+    }
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable written;
+
+    std::string pending;
+    bool stop;
+    bool writing;
+    size_t dropped;
+};
+
+Logger logger;
+
+}
+
+void logLine(const std::string & line) {
+    logger.append(line);
+}
+
+void flushLog() {
+    logger.flush();
+}
+
+size_t droppedLogLines() {
+    return logger.droppedLines();
+}
+
+LogLine::LogLine() {
+}
+
+LogLine::~LogLine() {
+    logLine(stream.str());
+}
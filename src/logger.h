@@ -0,0 +1,46 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+// Console logging buffered in memory and written to the standard output by
+// a background thread, so that threads logging inside the frame loop never
+// wait on the console
+// Lines keep the order in which they were logged.
+
+// Bytes buffered before further lines are dropped
+const size_t LOG_BUFFER_BYTES = 1 << 20;
+
+// Queue line to be written, a newline is appended
+void logLine(const std::string & line);
+
+// Block until every queued line is written and flushed
+void flushLog();
+
+// Lines dropped because the buffer was full
+size_t droppedLogLines();
+
+// Line formatted with stream operators and queued on destruction
+// Unnamed temporaries queue their line at the end of the statement:
+// LogLine() << "Loaded " << count << " meshes";
+class LogLine {
+public:
+    LogLine();
+    ~LogLine();
+
+    template <typename T>
+    LogLine & operator<<(const T & value) {
+        stream << value;
+        return *this;
+    }
+
+private:
+    LogLine(const LogLine &);
+    LogLine & operator=(const LogLine &);
+
+    std::ostringstream stream;
+};
+
+#endif
@@ -8,454 +8,631 @@
 #include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
 
+#include "benchmark.h"
+#include "bvh.h"
+#include "file_watcher.h"
+#include "headless_context.h"
+#include "image.h"
+#include "input.h"
+#include "instancing.h"
+#include "light_clusters.h"
+#include "logger.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_lod.h"
+#include "mesh_normals.h"
+#include "mesh_optimizer.h"
+#include "mesh_reader.h"
+#include "mesh_streamer.h"
+#include "mesh_pages.h"
+#include "meshlet.h"
+#include "occlusion_culling.h"
+#include "paged_mesh.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "rasterizer.h"
+#include "render_thread.h"
+#include "scene_graph.h"
+#include "shader_program.h"
+#include "texture.h"
+
 #include <string>
 #include <vector>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <future>
+#include <thread>
+#include <utility>
+
+#include <dirent.h>
 
 // Global variables
+// Scene and viewport state is owned by the render thread once started, the
+// main thread passes its changes in frame packets
 bool BACKGROUND_STATE = false;
 
 glm::mat4 PROJECTION(1.0f);
+glm::mat4 VIEW(1.0f);
 glm::mat4 MODEL(1.0f);
 
-// Read triangle mesh from Wavefront OBJ file format
-bool readTriangleMesh(
+int VIEWPORT_WIDTH = 1024;
+int VIEWPORT_HEIGHT = 768;
+
+// Framebuffer size of the window, written by the resize callback on the
+// main thread
+int FRAMEBUFFER_WIDTH = 1024;
+int FRAMEBUFFER_HEIGHT = 768;
+
+// Frames rendered before measuring benchmarks
+const size_t BENCHMARK_WARMUP_FRAMES = 10;
+
+// Picking hierarchy of the loaded mesh, in mesh units
+Bvh PICKING_BVH;
+
+// Build occluders of loaded meshes to cull hidden instances
+bool OCCLUSION_CULLING = false;
+
+// Bounding sphere radius paged meshes are scaled to, about the size of the
+// bundled meshes in the startup view
+const float PAGED_MESH_RADIUS = 5.0f;
+
+// Window events queued by the callbacks until the next frame
+InputQueue INPUT_QUEUE;
+
+MeshOptions MESH_OPTIONS = { VERTEX_FORMAT_FLOAT, false, false, NORMAL_WEIGHTING_ANGLE, 60.0f, false, false, false };
+
+// Print worst case encoding error of a vertex format
+void printVertexError(const VertexLayout & layout, const VertexError & error) {
+    LogLine line;
+
+    line << "Vertex format " << vertexFormatName(layout.format) << " ("
+         << layout.stride << " bytes): position error " << error.position
+         << " (" << error.relativePosition * 100.0 << "% of diagonal), normal error "
+         << error.normalAngle << " degrees, texture coordinate error "
+         << error.textureCoordinate;
+
+    if (layout.hasTangents)
+        line << ", tangent error " << error.tangentAngle << " degrees";
+}
+
+// Read triangle mesh from Wavefront OBJ file format, build its indexed
+// vertices and process them with the mesh options
+bool readIndexedMesh(
         const std::string & filename,
-        std::vector<glm::vec3> & positions,
-        std::vector<glm::vec3> & normals,
-        std::vector<glm::vec2> & textureCoordinates,
-        std::vector<size_t> & positionIndices,
-        std::vector<size_t> & normalIndices,
-        std::vector<size_t> & textureCoordinateIndices) {
-    std::ifstream file(filename, std::ifstream::in);
-
-    if (!file.is_open())
+        const MeshOptions & options,
+        IndexedMesh & mesh) {
+    TriangleMesh triangles;
+    MeshReadStatistics readStatistics;
+
+    if (!readTriangleMesh(filename, triangles, &readStatistics))
         return false;
 
-    std::string line;
+    // Print mesh read throughput
+    LogLine() << "Read " << filename << ": "
+              << readStatistics.bytes / 1024.0 << " KB in "
+              << readStatistics.seconds * 1000.0 << " ms ("
+              << readStatistics.megabytesPerSecond() << " MB/s, "
+              << readStatistics.chunks << " chunks)";
 
-    while (std::getline(file, line)) {
-        std::istringstream attributes(line);
+    // Generate smooth normals when not available on every corner
+    if (triangles.counts().normalIndices != triangles.counts().positionIndices &&
+            triangles.triangleCount() > 0) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-        std::string type;
-        attributes >> type;
+        generateNormals(triangles, options.normalWeighting, options.creaseAngle);
 
-        if (type == "v") {
-            glm::vec3 position;
-            attributes >> position.x >> position.y >> position.z;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-            positions.push_back(position);
-        }
-        else if (type == "vt") {
-            glm::vec2 textureCoordinate;
-            attributes >> textureCoordinate.x >> textureCoordinate.y;
+        LogLine() << "Generated " << triangles.counts().normals << " normals ("
+                  << normalWeightingName(options.normalWeighting) << " weighted, "
+                  << options.creaseAngle << " degree crease angle) in "
+                  << elapsed.count() * 1000.0 << " ms";
+    }
 
-            textureCoordinates.push_back(textureCoordinate);
-        }
-        else if (type == "vn") {
-            glm::vec3 normal;
-            attributes >> normal.x >> normal.y >> normal.z;
+    // Print footprint of the triangle mesh against separate vectors of
+    // size_t indices
+    double millions = std::max<size_t>(triangles.triangleCount(), 1) / 1e6;
+    size_t vectorBytes = vectorMeshBytes(triangles.counts());
+
+    LogLine() << "Triangle mesh: " << triangles.triangleCount() << " triangles in "
+              << triangles.bytes() / (1024.0 * 1024.0) << " MB, "
+              << triangles.bytes() / (1024.0 * 1024.0) / millions << " MB per million triangles ("
+              << vectorBytes / (1024.0 * 1024.0) / millions << " MB with size_t index vectors, "
+              << 100.0 * (1.0 - triangles.bytes() / (double)std::max<size_t>(vectorBytes, 1))
+              << "% less)";
+
+    // Deduplicate vertices
+    if (!buildIndexedMesh(triangles, mesh)) {
+        LogLine() << "Invalid indices in " << filename << ".";
+        return false;
+    }
 
-            normals.push_back(normal);
+    // Print reduction over one vertex per triangle corner
+    size_t expandedBytes = mesh.cornerCount * sizeof(Vertex);
+    size_t indexedBytes = mesh.vertices.size() * sizeof(Vertex) +
+        mesh.indices.size() * indexSize(mesh.vertices.size());
+
+    LogLine() << "Indexed mesh: "
+              << mesh.vertices.size() << " vertices from "
+              << mesh.cornerCount << " corners ("
+              << 100.0 * (1.0 - mesh.vertices.size() / (double)std::max<size_t>(mesh.cornerCount, 1))
+              << "% fewer), "
+              << indexedBytes << " bytes instead of " << expandedBytes << " ("
+              << 100.0 * (1.0 - indexedBytes / (double)std::max<size_t>(expandedBytes, 1))
+              << "% less), " << indexSize(mesh.vertices.size()) * 8 << " bit indices";
+
+    // Generate tangents from texture coordinates
+    if (options.generateTangents) {
+        if (mesh.hasTextureCoordinates) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            size_t vertexCount = mesh.vertices.size();
+
+            generateTangents(mesh);
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            LogLine() << "Generated tangents in " << elapsed.count() * 1000.0 << " ms ("
+                      << mesh.vertices.size() - vertexCount
+                      << " vertices split by mirrored texture mapping)";
         }
-        else if (type == "f") {
-            for (size_t i = 0; i < 3; i++) {
-                std::string tokens;
-                attributes >> tokens;
+        else
+            LogLine() << "Cannot generate tangents without texture coordinates.";
+    }
+
+    // Reorder triangles and vertices for rendering
+    if (options.optimize) {
+        MeshOptimizationStatistics optimizationStatistics;
+        optimizeMesh(mesh, options.optimizeOverdraw, &optimizationStatistics);
+
+        LogLine() << "Optimized mesh: ACMR "
+                  << optimizationStatistics.before.acmr << " -> "
+                  << optimizationStatistics.after.acmr << ", ATVR "
+                  << optimizationStatistics.before.atvr << " -> "
+                  << optimizationStatistics.after.atvr
+                  << " (FIFO cache of " << VERTEX_CACHE_SIZE << " vertices)";
+    }
 
-                std::replace(tokens.begin(), tokens.end(), '/', ' ');
+    // Partition the finest level into meshlets, before the coarser levels
+    // are appended to the index list
+    if (options.generateMeshlets) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-                std::istringstream indices(tokens);
-                size_t index;
+        buildMeshlets(mesh.vertices, mesh.indices, mesh.indices.size(), mesh.meshlets);
 
-                indices >> index;
-                positionIndices.push_back(index - 1);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-                if (indices.peek() == ' ') {
-                    indices.ignore();
+        LogLine() << "Built " << mesh.meshlets.size() << " meshlets in "
+                  << elapsed.count() * 1000.0 << " ms ("
+                  << (double)mesh.indices.size() / 3 / std::max<size_t>(mesh.meshlets.size(), 1)
+                  << " triangles per meshlet)";
+    }
 
-                    if (indices.peek() == ' ') {
-                        indices.ignore();
+    // Simplify levels of detail into the same index list
+    if (options.generateLods) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-                        indices >> index;
-                        normalIndices.push_back(index - 1);
-                    }
-                    else {
-                        indices >> index;
-                        textureCoordinateIndices.push_back(index - 1);
+        generateLods(mesh, options.optimize);
 
-                        if (indices.peek() == ' ') {
-                            indices.ignore();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-                            indices >> index;
-                            normalIndices.push_back(index - 1);
-                        }
-                    }
-                }
-            }
-        }
+        LogLine line;
+
+        line << "Generated " << std::max<size_t>(mesh.lods.size(), 1) - 1
+             << " levels of detail in " << elapsed.count() * 1000.0 << " ms:";
+
+        for (size_t i = 1; i < mesh.lods.size(); i++)
+            line << " " << mesh.lods[i].indexCount / 3 << " triangles (error "
+                 << mesh.lods[i].error << ")";
     }
 
-    file.close();
+    return true;
+}
+
+// Rebuild packed mesh from its Wavefront OBJ file and refresh its binary
+// mesh cache
+bool buildPackedMesh(
+        const std::string & filename,
+        const MeshOptions & options,
+        PackedMesh & packed) {
+    IndexedMesh mesh;
+
+    if (!readIndexedMesh(filename, options, mesh))
+        return false;
+
+    VertexError error;
+
+    packMesh(mesh, options.vertexFormat, packed, &error);
+    printVertexError(packed.layout, error);
+
+    if (!writeMeshCache(filename, options, packed))
+        LogLine() << "Cannot write mesh cache " << meshCacheFilename(filename) << ".";
+
+    return true;
+}
+
+// Copy everything but the vertex and index blobs of a binary mesh cache
+void readCachedMesh(const MeshCache & cache, PackedMesh & packed) {
+    const MeshCacheHeader & header = cache.header();
+
+    packed.layout = cache.layout();
+    packed.vertices.clear();
+    packed.indices.clear();
+    packed.vertexCount = header.vertexCount;
+    packed.indexCount = header.indexCount;
+    packed.indexSize = header.indexSize;
+    packed.lods = cache.lods();
+    packed.meshlets = cache.meshlets();
+    packed.center = glm::vec3(header.center[0], header.center[1], header.center[2]);
+    packed.radius = header.radius;
+}
+
+// Read mesh and build the picking hierarchy of its full level of detail,
+// and its occluder when occlusion culling, called by the mesh streamer on
+// its worker thread
+// Blobs are streamed straight from the memory mapped binary mesh cache when
+// valid, and rebuilt into the packed mesh otherwise.
+bool readStreamedMesh(const std::string & filename, StreamedMesh & mesh) {
+    PackedMesh & packed = mesh.packed;
+
+    mesh.cache = std::make_shared<MeshCache>();
+
+    if (mesh.cache->open(filename, MESH_OPTIONS)) {
+        readCachedMesh(*mesh.cache, packed);
+
+        mesh.vertices = (const unsigned char *)mesh.cache->vertices();
+        mesh.vertexBytes = mesh.cache->header().vertexBytes;
+        mesh.indices = (const unsigned char *)mesh.cache->indices();
+        mesh.indexBytes = mesh.cache->header().indexBytes;
+    }
+    else {
+        mesh.cache.reset();
+
+        if (!buildPackedMesh(filename, MESH_OPTIONS, packed))
+            return false;
+
+        mesh.vertices = packed.vertices.data();
+        mesh.vertexBytes = packed.vertices.size();
+        mesh.indices = packed.indices.data();
+        mesh.indexBytes = packed.indices.size();
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> positionIndices;
+
+    unpackPositions(mesh.vertices, packed.vertexCount, packed.layout, positions);
+    unpackIndices(
+        mesh.indices + packed.lods[0].indexOffset * packed.indexSize,
+        packed.lods[0].indexCount,
+        packed.indexSize,
+        positionIndices);
+
+    buildBvh(positions, positionIndices, mesh.bvh);
+
+    if (OCCLUSION_CULLING)
+        buildOccluderMesh(positions, positionIndices, OCCLUDER_TRIANGLES, mesh.occluder);
 
     return true;
 }
 
-// EXERCÍCIO
-//
-// IMPLEMENTAR A FUNÇÃO ABAIXO VALENDO 10 PONTOS EXTRAS.
-// ATUALMENTE ELA NÃO UTILIZA OS PARÂMETROS DE ENTRADA E
-// CARREGA UM TRIÂNGULO CONSTANTE COM ATRIBUTOS DE POSIÇÃO E COR.
-// O OBJETIVO É MODIFICÁ-LA PARA CARREGAR OS TRIÂNGULOS DESCRITOS
-// PELOS PARÂMETROS, SEGUINDO A SUA DOCUMENTAÇÃO:
-//
 // Load triangle mesh to OpenGL
-// Normal and texture coordinate attributes are calculated by primitive when not available
+// Smooth normals are generated when not available, with the mesh options
+// weighting and crease angle, and tangents when enabled
+// Every unique attribute index triple is uploaded once and referenced by an
+// index buffer of 16 bit indices when the vertex count allows, 32 bit otherwise
+// GPU ready data is cached next to the Wavefront OBJ file and uploaded
+// straight from the memory mapped cache while the source is unchanged
+// Triangles and vertices are reordered for rendering when optimization is enabled
+// The packed mesh returned along the buffers keeps everything but the
+// uploaded vertex and index blobs
+// Compact vertex formats store positions relative to the mesh bounds, the
+// returned layout gives the dequantization to apply before the model matrix
+// Levels of detail are index ranges of the same index buffer, the first one
+// is the full mesh, and the bounding sphere is in mesh units
+// Meshlets, when enabled, are index ranges partitioning the first level
 // Vertex attributes are exported to shader program at locations:
 // 0: position
 // 1: normal
 // 2: texture coordinate
-size_t loadTriangleMesh(
-        const std::vector<glm::vec3> & positions,
-        const std::vector<glm::vec3> & normals,
-        const std::vector<glm::vec2> & textureCoordinates,
-        const std::vector<size_t> & positionIndices,
-        const std::vector<size_t> & normalIndices,
-        const std::vector<size_t> & textureCoordinateIndices,
+// 3: tangent
+bool loadTriangleMesh(
+        const std::string & filename,
+        const MeshOptions & options,
         GLenum usage,
-        GLuint & vao,
-        GLuint & vbo) {
-    // Triangle description
-    /* GLfloat vertices[] = {
-    	// triangle 0
-        0.0f, 0.0f, 0.0f, // First vertex position v0
-        0.0f,  0.0f, 1.0f, // First vertex color vn0
-         
-        1.0f,  0.0f, 0.0f, // Second vertex position v1
-        0.0f,  0.0f, 1.0f, // Second vertex color vn0
-        
-        1.0f,  1.0f, 0.0f, // Third vertex position v2
-        0.0f,  0.0f, 1.0f, // Third vertex color vn0
-        
-        // triangle 1
-        0.0f, 0.0f, 0.0f, // First vertex position v0
-        0.0f,  0.0f, 1.0f, // First vertex color vn0
-         
-        1.0f,  1.0f, 0.0f, // Second vertex position v2
-        0.0f,  0.0f, 1.0f, // Second vertex color vn0
-        
-        0.0f, 1.0f, 0.0f, // Second vertex position v3
-        0.0f,  0.0f, 1.0f, // Second vertex color vn0
-    }; */
-    
-    // LOAD DO CUBO COM TEXTURA E NORMAIS
-    // std::vector<float> data;
-    
-    /* for (size_t i = 0; i < positionIndices.size() / 3; i++) {
-		size_t triangleIndex = i;
- 	   
-	    glm::vec3 p0 = positions[positionIndices[triangleIndex * 3]];
-	    glm::vec3 n0 = normals[normalIndices[triangleIndex * 3]];
-	    glm::vec2 t0 = textureCoordinates[textureCoordinateIndices[triangleIndex * 3]];
-	
-	   data.push_back(p0.x); data.push_back(p0.y); data.push_back(p0.z);
-	   data.push_back(n0.x); data.push_back(n0.y); data.push_back(n0.z);
-	    data.push_back(t0.x); data.push_back(t0.y);
-	
-	    glm::vec3 p1 = positions[positionIndices[triangleIndex * 3 + 1]];
-	    glm::vec3 n1 = normals[normalIndices[triangleIndex * 3 + 1]];
-	    glm::vec2 t1 = textureCoordinates[textureCoordinateIndices[triangleIndex * 3 + 1]];
-	
-	    data.push_back(p1.x); data.push_back(p1.y); data.push_back(p1.z);
-	    data.push_back(n1.x); data.push_back(n1.y); data.push_back(n1.z);
-	    data.push_back(t1.x); data.push_back(t1.y);
-	
-	    glm::vec3 p2 = positions[positionIndices[triangleIndex * 3 + 2]];
-	    glm::vec3 n2 = normals[normalIndices[triangleIndex * 3 + 2]];
-        glm::vec2 t2 = textureCoordinates[textureCoordinateIndices[triangleIndex * 3 + 2]];
-	
-	    data.push_back(p2.x); data.push_back(p2.y); data.push_back(p2.z);
-	    data.push_back(n2.x); data.push_back(n2.y); data.push_back(n2.z);
-	    data.push_back(t2.x); data.push_back(t2.y);
-	} */
-	
-	// LOAD DO OBJ CALCULANDO A FACETA QUANDO NO TIVER TEXTURA OU NORMAL
-	struct Vertex {
-		glm::vec3 position;
-		glm::vec3 normal;
-		glm::vec2 textureCoordinate;
-	};
-	
-	bool hasNormals = normalIndices.size() > 0;
-	bool hasTextureCoordinates = textureCoordinateIndices.size() > 0;
-	
-	std::vector<Vertex> vertices;
-	
-	for (size_t i = 0; i < positionIndices.size() / 3; i++) {
-		Vertex triangleVertices[3];
-		
- 		for(size_t j=0; j < 3; j++) {
- 			Vertex & vertex = triangleVertices[j];
- 			vertex.position = positions[positionIndices[i * 3 + j]];
-		}
-		
-		if(hasNormals){
-			for(size_t j=0; j < 3; j++) {
-	 			Vertex & vertex = triangleVertices[j];
-	 			vertex.normal = normals[normalIndices[i * 3 + j]];
-			}
-		}
-		else {
-			Vertex & vertex0 = triangleVertices[0];
-			Vertex & vertex1 = triangleVertices[1];
-			Vertex & vertex2 = triangleVertices[2];
-			
-			glm::vec3 u = vertex1.position - vertex0.position;
-			glm::vec3 v = vertex2.position - vertex0.position;
-			
-			glm::vec3 n = glm::normalize(glm::cross(u, v));
-			
-			vertex0.normal = n;
-			vertex1.normal = n;
-			vertex2.normal = n;
-		}
-		
-		if(hasTextureCoordinates){
-			for(size_t j=0; j < 3; j++) {
-	 			Vertex & vertex = triangleVertices[j];	
-	 			vertex.textureCoordinate = textureCoordinates[textureCoordinateIndices[i * 3 + j]];
-			}
-		}
-		else {
-			Vertex & vertex0 = triangleVertices[0];
-			Vertex & vertex1 = triangleVertices[1];
-			Vertex & vertex2 = triangleVertices[2];
-			
-			vertex0.textureCoordinate = glm::vec2(0.0f, 0.0f);
-			vertex1.textureCoordinate = glm::vec2(1.0f, 0.0f);
-			vertex2.textureCoordinate = glm::vec2(0.0f, 1.0f);
-		}
-		
-		
-		for(size_t i=0; i < 3; i++)
-			vertices.push_back(triangleVertices[i]);
-	}
-	
-    // Create and bind vertex array object
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    
-    // Create and bind vertex buffer object
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    
-    // Copy vertex attribute data to vertex buffer object
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        // sizeof(vertices),
-        vertices.size() * sizeof(Vertex),
-        // vertices,
-		vertices.data(),
-        usage);
-    
-    // Define position attribute to shader program
-    glVertexAttribPointer(
-        0,
-        3,
-        GL_FLOAT,
-        false,
-        8 * sizeof(GLfloat),
-        (const GLvoid *)nullptr);
-    
-    // Enable position attribute to shader program
-    glEnableVertexAttribArray(0);
-    
-    // Define normal attribute to shader program
-    glVertexAttribPointer(
-        1,
-        3,
-        GL_FLOAT,
-        false,
-        8 * sizeof(GLfloat),
-        (const GLvoid *)(3 * sizeof(GLfloat)));
-    
-    // Enable normal attribute to shader program
-    glEnableVertexAttribArray(1);
-    
-    // Define texture attribute to shader program
-    glVertexAttribPointer(
-        2,
-        2,
-       	GL_FLOAT,
-        false,
-        8 * sizeof(GLfloat),
-        (const GLvoid *)(6 * sizeof(GLfloat)));
-
-    // Enable texture attribute to shader program
-    glEnableVertexAttribArray(2);
-    
-    // Return vertex count or three times the triangle count
-    return positionIndices.size();
-    // return 6;
-}
+        MeshBuffers & buffers,
+        PackedMesh & mesh) {
+    PROFILE_ZONE("loadTriangleMesh");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Upload from binary mesh cache when valid
+    MeshCache cache;
+
+    if (cache.open(filename, options)) {
+        const MeshCacheHeader & header = cache.header();
+
+        readCachedMesh(cache, mesh);
 
-// Compile shader source code from text file format
-bool compileShader(const std::string & filename, GLenum type, GLuint & id) {
-    // Read from text file to string
-    std::ifstream file(filename, std::ifstream::in);
+        uploadTriangleMesh(
+            cache.vertices(),
+            header.vertexBytes,
+            mesh.layout,
+            cache.indices(),
+            header.indexBytes,
+            usage,
+            buffers.vao,
+            buffers.vbo,
+            buffers.ebo);
 
-    if (!file.is_open())
+        buffers.indexType = mesh.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        LogLine() << "Loaded " << meshCacheFilename(filename) << ": "
+                  << header.vertexCount << " vertices, "
+                  << mesh.lods[0].indexCount / 3 << " triangles, "
+                  << mesh.lods.size() << " levels of detail, "
+                  << mesh.meshlets.size() << " meshlets in "
+                  << elapsed.count() * 1000.0 << " ms";
+
+        return true;
+    }
+
+    // Rebuild mesh from source and refresh cache
+    if (!buildPackedMesh(filename, options, mesh))
         return false;
 
-    std::stringstream buffer;
-    std::string source;
+    uploadTriangleMesh(
+        mesh.vertices.data(),
+        mesh.vertices.size(),
+        mesh.layout,
+        mesh.indices.data(),
+        mesh.indices.size(),
+        usage,
+        buffers.vao,
+        buffers.vbo,
+        buffers.ebo);
 
-    buffer << file.rdbuf();
-    source = buffer.str();
+    buffers.indexType = mesh.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-    // Create shader
-    GLuint shaderID = glCreateShader(type);
+    // Blobs are on the GPU now
+    std::vector<unsigned char>().swap(mesh.vertices);
+    std::vector<unsigned char>().swap(mesh.indices);
 
-    // Setup shader source code
-    const GLchar * src = source.data();
-    glShaderSource(shaderID, 1, &src, nullptr);
+    return true;
+}
 
-    // Compile shader
-    glCompileShader(shaderID);
+// Read positions and position indices of the full level of detail of a
+// loaded mesh, from its binary mesh cache when valid, from its Wavefront OBJ
+// file otherwise
+bool readMeshPositions(
+        const std::string & filename,
+        const MeshOptions & options,
+        std::vector<glm::vec3> & positions,
+        std::vector<uint32_t> & positionIndices) {
+    MeshCache cache;
 
-    // Get compilation status
-    GLint status;
-    glGetShaderiv(shaderID, GL_COMPILE_STATUS, &status);
+    if (cache.open(filename, options)) {
+        const MeshCacheHeader & header = cache.header();
 
-    // Check compilation errors
-    if (status != GL_TRUE) {
-        // Get log message size of the compilation process
-        GLint size = 0;
-        glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &size);
+        unpackPositions(cache.vertices(), header.vertexCount, cache.layout(), positions);
+        unpackIndices(cache.indices(), header.lodIndexCounts[0], header.indexSize, positionIndices);
 
-        std::string message;
-        message.resize(size);
+        return true;
+    }
 
-        // Get log message of the compilation process
-        glGetShaderInfoLog(shaderID, size, nullptr, (GLchar *)message.data());
+    TriangleMesh mesh;
 
-        // Print log message
-        std::cout << message << std::endl;
+    if (!readTriangleMesh(filename, mesh))
+        return false;
 
-        // Delete shader
-        glDeleteShader(shaderID);
+    positions.assign(mesh.positions(), mesh.positions() + mesh.counts().positions);
+    positionIndices.assign(mesh.positionIndices(), mesh.positionIndices() + mesh.counts().positionIndices);
 
+    return true;
+}
+
+// Write binary mesh cache of every Wavefront OBJ file in a directory
+// The encoding error of every vertex format is printed to choose a format per asset
+bool bakeTriangleMeshes(const std::string & directory, const MeshOptions & options) {
+    DIR * entries = opendir(directory.c_str());
+
+    if (entries == nullptr) {
+        LogLine() << "Cannot open directory " << directory << ".";
         return false;
     }
 
-    // Return shader id
-    id = shaderID;
+    std::vector<std::string> filenames;
 
-    return true;
+    for (dirent * entry = readdir(entries); entry != nullptr; entry = readdir(entries)) {
+        std::string name = entry->d_name;
+
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".obj") == 0)
+            filenames.push_back(directory + "/" + name);
+    }
+
+    closedir(entries);
+
+    std::sort(filenames.begin(), filenames.end());
+
+    bool success = true;
+
+    for (size_t i = 0; i < filenames.size(); i++) {
+        IndexedMesh mesh;
+
+        if (!readIndexedMesh(filenames[i], options, mesh)) {
+            LogLine() << "Cannot bake " << filenames[i] << ".";
+
+            success = false;
+            continue;
+        }
+
+        // Compare vertex formats
+        PackedMesh packed;
+
+        for (int j = VERTEX_FORMAT_FLOAT; j <= VERTEX_FORMAT_COMPACT_10; j++) {
+            VertexError error;
+
+            packMesh(mesh, (VertexFormat)j, packed, &error);
+            printVertexError(packed.layout, error);
+        }
+
+        packMesh(mesh, options.vertexFormat, packed);
+
+        if (!writeMeshCache(filenames[i], options, packed)) {
+            LogLine() << "Cannot bake " << filenames[i] << ".";
+
+            success = false;
+            continue;
+        }
+
+        LogLine() << "Baked " << meshCacheFilename(filenames[i])
+                  << " (" << vertexFormatName(options.vertexFormat)
+                  << (options.optimize ? ", optimized" : "")
+                  << (options.optimize && options.optimizeOverdraw ? " for overdraw" : "")
+                  << (options.generateTangents ? ", tangents" : "")
+                  << (options.generateLods ? ", levels of detail" : "")
+                  << (options.generateMeshlets ? ", meshlets" : "") << ")";
+    }
+
+    return success;
 }
 
-// Create shader program
-bool createProgram(const std::string & name, GLuint & id) {
-    GLuint vertexShaderID, fragmentShaderID;
+// Convert Wavefront OBJ file into a paged mesh file next to it
+bool buildMeshPages(const std::string & filename, const MeshOptions & options, size_t pageTriangles) {
+    MeshPagingStatistics statistics;
 
-    // Load and compile vertex shader
-    if (!compileShader(name + ".vert", GL_VERTEX_SHADER, vertexShaderID))
+    if (!writeMeshPages(filename, options, pageTriangles, &statistics)) {
+        LogLine() << "Cannot convert " << filename << " to " << meshPagesFilename(filename) << ".";
         return false;
+    }
+
+    LogLine() << "Read " << filename << ": "
+              << statistics.read.bytes / (1024.0 * 1024.0) << " MB in "
+              << statistics.read.seconds * 1000.0 << " ms ("
+              << statistics.read.megabytesPerSecond() << " MB/s)";
+
+    LogLine() << "Paged " << meshPagesFilename(filename) << ": "
+              << statistics.triangles << " triangles in " << statistics.pages << " pages of "
+              << statistics.cells << " grid cells, "
+              << (double)statistics.triangles / std::max<size_t>(statistics.pages, 1)
+              << " triangles per page (" << statistics.largestPage << " largest), "
+              << statistics.temporaryBytes / (1024.0 * 1024.0) << " MB spilled to temporary files, "
+              << statistics.seconds * 1000.0 << " ms (" << vertexFormatName(options.vertexFormat)
+              << (options.optimize ? ", optimized" : "") << ")";
+
+    return true;
+}
 
-    // Load and compile fragment shader
-    if (!compileShader(name + ".frag", GL_FRAGMENT_SHADER, fragmentShaderID))
+// Render mesh with the software rasterizer without opening a window and
+// write the last frame to a Portable Pixmap file
+// Frames use the startup camera of the viewer, so the image is a reference
+// for the OpenGL output.
+bool renderSoftware(
+        const std::string & meshFilename,
+        const MeshOptions & options,
+        const std::string & imageFilename,
+        size_t width,
+        size_t height,
+        size_t frameCount) {
+    IndexedMesh mesh;
+
+    if (!readIndexedMesh(meshFilename, options, mesh))
         return false;
-    
-    // Create shader program
-    GLuint programID = glCreateProgram();
 
-    // Attach compiled shaders to program
-    glAttachShader(programID, vertexShaderID);
-    glAttachShader(programID, fragmentShaderID);
+    size_t indexCount = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
 
-    // Link attached shaders to create an executable
-    glLinkProgram(programID);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(45.0f, width / (float)height, 0.001f, 1000.0f);
 
-    // Delete compiled shaders
-    glDeleteShader(vertexShaderID);
-    glDeleteShader(fragmentShaderID);
-    
-    // Get linkage status
-    GLint status;
-    glGetProgramiv(programID, GL_LINK_STATUS, &status);
+    RasterFramebuffer framebuffer;
+    resizeFramebuffer(framebuffer, width, height);
 
-    // Check linkage errors
-    if (status != GL_TRUE) {
-        // Get log message size of the linkage process
-        GLint size = 0;
-        glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &size);
+    RasterStatistics statistics;
+    double transformSeconds = 0.0, binSeconds = 0.0, rasterSeconds = 0.0;
 
-        std::string message;
-        message.resize(size);
+    for (size_t i = 0; i < frameCount; i++) {
+        rasterizeMesh(
+            mesh.vertices,
+            mesh.indices,
+            indexCount,
+            projection * view * MODEL,
+            glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+            framebuffer,
+            &statistics);
 
-        // Get log message of the linkage process
-        glGetProgramInfoLog(programID, size, nullptr, (GLchar *)message.data());
+        transformSeconds += statistics.transformSeconds;
+        binSeconds += statistics.binSeconds;
+        rasterSeconds += statistics.rasterSeconds;
+    }
 
-        // Print log message
-        std::cout << message << std::endl;
+    // Print average frame time by stage
+    double frameMilliseconds = (transformSeconds + binSeconds + rasterSeconds) * 1000.0 / frameCount;
 
-        // Delete shader program
-        glDeleteProgram(programID);
+    LogLine() << "Software rendered " << statistics.triangles << " triangles ("
+              << statistics.rasterized << " set up, "
+              << statistics.binned << " binned) at " << width << "x" << height
+              << " on " << threadCount() << " threads: "
+              << frameMilliseconds << " ms per frame (transform "
+              << transformSeconds * 1000.0 / frameCount << " ms, bin "
+              << binSeconds * 1000.0 / frameCount << " ms, raster "
+              << rasterSeconds * 1000.0 / frameCount << " ms)";
 
+    if (!writePpm(imageFilename, width, height, framebuffer.color.data())) {
+        LogLine() << "Cannot write " << imageFilename << ".";
         return false;
     }
 
-    // Return shader program id
-    id = programID;
+    LogLine() << "Wrote " << imageFilename;
 
     return true;
 }
 
-// Resize event callback
-void resize(GLFWwindow * window, int width, int height) {
+// Set viewport and projection matrix, on the thread owning the OpenGL context
+void setViewport(int width, int height) {
     glViewport(0, 0, width, height);
     
-    PROJECTION = glm::perspective(45.0f, width / (float)height, 0.001f, 1000.0f);
+    VIEWPORT_WIDTH = width;
+    VIEWPORT_HEIGHT = height;
+    
+    PROJECTION = glm::perspective(45.0f, width / (float)std::max(height, 1), 0.001f, 1000.0f);
+}
+
+// Resize event callback, the size reaches the render thread with the next
+// frame packet
+void resize(GLFWwindow * window, int width, int height) {
+    FRAMEBUFFER_WIDTH = width;
+    FRAMEBUFFER_HEIGHT = height;
+}
+
+// Queue window event stamped with the current time, processed by the
+// model controller at the start of the next frame
+void pushInputEvent(InputEventType type, int code, int action, double x, double y) {
+    InputEvent event;
+    event.type = type;
+    event.time = std::chrono::steady_clock::now();
+    event.code = code;
+    event.action = action;
+    event.x = x;
+    event.y = y;
+    
+    INPUT_QUEUE.push(event);
 }
 
 // Keyboard event callback
 void keyboard(
         GLFWwindow * window,
         int key, int scancode, int action, int modifier) {
-    if (key == GLFW_KEY_A && action == GLFW_PRESS)
-        BACKGROUND_STATE = !BACKGROUND_STATE;
-    
-    if (key == GLFW_KEY_RIGHT && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        MODEL = glm::rotate(MODEL, 0.1f, glm::vec3(0.0f, 1.0f, 0.0f));
-        
-     if (key == GLFW_KEY_RIGHT && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        MODEL = glm::translate(MODEL, glm::vec3(0.0f, 0.2f, 0.0f));
-    
-    if (key == GLFW_KEY_LEFT && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        MODEL = glm::rotate(MODEL, 0.1f, glm::vec3(0.0f, -1.0f, 0.0f));
-    
-    if (key == GLFW_KEY_LEFT && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        MODEL = glm::translate(MODEL, glm::vec3(0.0f, -0.2f, 0.0f));
-    
-    if (key == GLFW_KEY_UP && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        MODEL = glm::rotate(MODEL, 0.1f, glm::vec3(1.0f, 0.0f, 0.0f));
-    
-    if (key == GLFW_KEY_DOWN && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        MODEL = glm::rotate(MODEL, 0.1f, glm::vec3(-1.0f, 0.0f, 0.0f));
-    
-    if (key == GLFW_KEY_S && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        MODEL = glm::scale(MODEL, glm::vec3(2.0f, 2.0f, 1.0f));
-    
-    if (key == GLFW_KEY_N && (action == GLFW_PRESS || action == GLFW_REPEAT))
-        MODEL = glm::scale(MODEL, glm::vec3(0.5f, 0.5f, 1.0f));
+    pushInputEvent(INPUT_EVENT_KEY, key, action, 0.0, 0.0);
 }
 
 static void cursor_position_callback(GLFWwindow* window, double xpos, double ypos){
-	std::cout <<"MOUSE POS: " << xpos << ","<< ypos << std::endl;
-	MODEL = glm::translate(glm::mat4(1.0f), glm::vec3((float)(xpos*0.02),(float)(ypos*0.02),0.0f));
+    pushInputEvent(INPUT_EVENT_CURSOR, 0, 0, xpos, ypos);
 }
 
 void cursor_enter_callback(GLFWwindow* window, int entered)
@@ -476,26 +653,51 @@ void cursor_enter_callback(GLFWwindow* window, int entered)
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-	if(yoffset == -1){
-		
-		MODEL = glm::scale(MODEL, glm::vec3(2.0f, 2.0f, 1.0f));
-	}
-	else {
-		MODEL = glm::scale(MODEL, glm::vec3(0.5f, 0.5f, 1.0f));
-	}
+    pushInputEvent(INPUT_EVENT_SCROLL, 0, 0, xoffset, yoffset);
 }
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE) 
-	{
-     	return;
-  	}
-
-  	double x;
+    double x;
     double y;
     glfwGetCursorPos(window, &x, &y);
-    MODEL = glm::translate(glm::mat4(1.0f), glm::vec3((float)(x*0.02),(float)(y*0.02),0.0f));
+    
+    pushInputEvent(INPUT_EVENT_BUTTON, button, action, x, y);
+}
+
+// Pick the mesh triangle under a cursor position in normalized device
+// coordinates
+void pickTriangle(const glm::vec2 & cursor) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    // Unproject cursor on the near and far planes to mesh units
+    glm::mat4 unprojection = glm::inverse(PROJECTION * VIEW * MODEL);
+    
+    glm::vec4 nearPoint = unprojection * glm::vec4(cursor, -1.0f, 1.0f);
+    glm::vec4 farPoint = unprojection * glm::vec4(cursor, 1.0f, 1.0f);
+    
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+    
+    // Ray distances are fractions of the way from the near to the far plane
+    RayHit hit;
+    
+    if (!intersectRay(PICKING_BVH, origin, direction, 1.0f, hit)) {
+        LogLine() << "Picked nothing";
+        return;
+    }
+    
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    
+    // Distance from the camera in world units
+    glm::vec3 point = glm::vec3(MODEL * glm::vec4(origin + direction * hit.distance, 1.0f));
+    glm::vec3 camera = glm::vec3(glm::inverse(VIEW)[3]);
+    
+    LogLine() << "Picked triangle " << hit.triangle
+              << " at distance " << glm::length(point - camera)
+              << ", barycentrics (" << 1.0f - hit.barycentrics.x - hit.barycentrics.y
+              << ", " << hit.barycentrics.x << ", " << hit.barycentrics.y
+              << ") in " << elapsed.count() * 1000.0 << " ms";
 }
 
 int main(int argc, char ** argv) {
@@ -521,19 +723,14 @@ int main(int argc, char ** argv) {
 
     // Access vertex position attributes of the first triangle
     //
-    // std::vector<glm::vec3> positions;
-    // std::vector<glm::vec3> normals;
-    // std::vector<glm::vec2> textureCoordinates;
-    // std::vector<size_t> positionIndices;
-    // std::vector<size_t> normalIndices;
-    // std::vector<size_t> textureCoordinateIndices;
-
-    // if (loadTriangleMesh(
-    //         "../res/meshes/bunny.obj",
-    //         positions, normals, textureCoordinates,
-    //         positionIndices, normalIndices, textureCoordinateIndices)) {
+    // TriangleMesh mesh;
+
+    // if (readTriangleMesh("../res/meshes/bunny.obj", mesh)) {
     //	   size_t triangleIndex = 0;
     //	   
+    //	   const glm::vec3 * positions = mesh.positions();
+    //	   const uint32_t * positionIndices = mesh.positionIndices();
+    //	   
     //	   glm::vec3 p0 = positions[positionIndices[triangleIndex * 3]];
     //	   glm::vec3 p1 = positions[positionIndices[triangleIndex * 3 + 1]];
     //	   glm::vec3 p2 = positions[positionIndices[triangleIndex * 3 + 2]];
@@ -545,148 +742,1326 @@ int main(int argc, char ** argv) {
     //     std::cout << glm::to_string(p2) << std::endl;
     // }
 
-    // Check GLFW initialization
-    if (!glfwInit()) {
-        std::cout << "Cannot initialize GLFW." << std::endl;
-        return -1;
+    // Parse command line options
+    bool bake = false;
+    std::string bakeDirectory = "../res/meshes";
+    std::string meshFilename = "../res/meshes/triangle.obj";
+    
+    // Side of the instance grid, zero to draw a single copy
+    size_t instanceGridSide = 0;
+    
+    // Nodes of the orbit scene drawn as instances instead, zero for none
+    size_t sceneNodes = 0;
+    InstanceUpdate instanceUpdate = INSTANCE_UPDATE_RING;
+
+    // Image written by the software rasterizer, empty to open a window
+    std::string softwareFilename;
+    
+    // Frames rendered offscreen along a camera path, zero to open a window
+    size_t benchmarkFrames = 0;
+    std::string benchmarkFilename;
+    std::string cameraPathFilename;
+    
+    // Chrome trace written on exit, empty when not profiling
+    std::string traceFilename;
+    
+    // Bytes of streamed meshes uploaded per frame
+    size_t uploadBudget = 1024 * 1024;
+    
+    // Paged mesh converted from the mesh file, or drawn instead of it with
+    // the pages near the camera resident within budgets in bytes
+    bool buildPages = false;
+    size_t pageTriangles = MESH_PAGE_TRIANGLES;
+    std::string pagesFilename;
+    size_t cpuBudget = 256 * 1024 * 1024;
+    size_t gpuBudget = 128 * 1024 * 1024;
+    
+    // Handoff of frames from the main thread to the render thread
+    FramePacing pacing = FRAME_PACING_VSYNC;
+    size_t framePackets = MIN_FRAME_PACKETS;
+    double targetLatency = 0.004;
+    
+    // Image sampled by meshes with texture coordinates, empty for none
+    std::string textureFilename;
+    TextureFormat textureFormat = TEXTURE_FORMAT_RGBA8;
+    
+    // Moving lights of clustered forward shading, zero to show normals
+    size_t lightCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+
+        if (option == "--bake") {
+            bake = true;
+
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                bakeDirectory = argv[++i];
+        }
+        else if (option == "--vertex-format" && i + 1 < argc) {
+            if (!parseVertexFormat(argv[++i], MESH_OPTIONS.vertexFormat)) {
+                LogLine() << "Unknown vertex format " << argv[i] << ".";
+                return -1;
+            }
+        }
+        else if (option == "--optimize") {
+            MESH_OPTIONS.optimize = true;
+
+            if (i + 1 < argc && std::string(argv[i + 1]) == "overdraw") {
+                MESH_OPTIONS.optimizeOverdraw = true;
+                i++;
+            }
+        }
+        else if (option == "--normal-weighting" && i + 1 < argc) {
+            if (!parseNormalWeighting(argv[++i], MESH_OPTIONS.normalWeighting)) {
+                LogLine() << "Unknown normal weighting " << argv[i] << ".";
+                return -1;
+            }
+        }
+        else if (option == "--crease-angle" && i + 1 < argc)
+            MESH_OPTIONS.creaseAngle = (float)std::atof(argv[++i]);
+        else if (option == "--tangents")
+            MESH_OPTIONS.generateTangents = true;
+        else if (option == "--lods")
+            MESH_OPTIONS.generateLods = true;
+        else if (option == "--meshlets")
+            MESH_OPTIONS.generateMeshlets = true;
+        else if (option == "--mesh" && i + 1 < argc)
+            meshFilename = argv[++i];
+        else if (option == "--instances" && i + 1 < argc)
+            instanceGridSide = (size_t)std::atoi(argv[++i]);
+        else if (option == "--scene" && i + 1 < argc)
+            sceneNodes = (size_t)std::atoi(argv[++i]);
+        else if (option == "--instance-update" && i + 1 < argc) {
+            if (!parseInstanceUpdate(argv[++i], instanceUpdate)) {
+                LogLine() << "Unknown instance update " << argv[i] << ".";
+                return -1;
+            }
+        }
+        else if (option == "--software" && i + 1 < argc)
+            softwareFilename = argv[++i];
+        else if (option == "--benchmark" && i + 1 < argc)
+            benchmarkFrames = (size_t)std::atoi(argv[++i]);
+        else if (option == "--benchmark-output" && i + 1 < argc)
+            benchmarkFilename = argv[++i];
+        else if (option == "--camera-path" && i + 1 < argc)
+            cameraPathFilename = argv[++i];
+        else if (option == "--profile" && i + 1 < argc) {
+            traceFilename = argv[++i];
+            
+            if (!profilerEnabled())
+                LogLine() << "Profiler is compiled out, define PROFILER_ENABLED to record zones.";
+        }
+        else if (option == "--upload-budget" && i + 1 < argc)
+            uploadBudget = (size_t)std::atoi(argv[++i]) * 1024;
+        else if (option == "--pacing" && i + 1 < argc) {
+            if (!parseFramePacing(argv[++i], pacing)) {
+                LogLine() << "Unknown frame pacing " << argv[i] << ".";
+                return -1;
+            }
+        }
+        else if (option == "--target-latency" && i + 1 < argc)
+            targetLatency = std::atof(argv[++i]) / 1000.0;
+        else if (option == "--frame-packets" && i + 1 < argc) {
+            framePackets = (size_t)std::atoi(argv[++i]);
+            
+            if (framePackets < MIN_FRAME_PACKETS || framePackets > MAX_FRAME_PACKETS) {
+                LogLine() << "Frame packets must be " << MIN_FRAME_PACKETS << " or " << MAX_FRAME_PACKETS << ".";
+                return -1;
+            }
+        }
+        else if (option == "--build-pages" && i + 1 < argc) {
+            buildPages = true;
+            meshFilename = argv[++i];
+        }
+        else if (option == "--page-triangles" && i + 1 < argc)
+            pageTriangles = (size_t)std::atoi(argv[++i]);
+        else if (option == "--pages" && i + 1 < argc)
+            pagesFilename = argv[++i];
+        else if (option == "--cpu-budget" && i + 1 < argc)
+            cpuBudget = (size_t)std::atoi(argv[++i]) * 1024 * 1024;
+        else if (option == "--gpu-budget" && i + 1 < argc)
+            gpuBudget = (size_t)std::atoi(argv[++i]) * 1024 * 1024;
+        else if (option == "--texture" && i + 1 < argc)
+            textureFilename = argv[++i];
+        else if (option == "--texture-format" && i + 1 < argc) {
+            if (!parseTextureFormat(argv[++i], textureFormat)) {
+                LogLine() << "Unknown texture format " << argv[i] << ".";
+                return -1;
+            }
+        }
+        else if (option == "--lights" && i + 1 < argc)
+            lightCount = (size_t)std::atoi(argv[++i]);
+        else if (option == "--occlusion")
+            OCCLUSION_CULLING = true;
+        else if (option == "--stress") {
+            // Grid of 100 x 100 bunnies
+            meshFilename = "../res/meshes/bunny.obj";
+            instanceGridSide = 100;
+        }
+        else {
+            LogLine() << "Unknown option " << option << ".";
+            return -1;
+        }
     }
 
-    // Setup OpenGL context
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 16);
+    // Precompile binary mesh caches without opening a window
+    if (bake)
+        return bakeTriangleMeshes(bakeDirectory, MESH_OPTIONS) ? 0 : -1;
 
-    // Create window
-    GLFWwindow * window = glfwCreateWindow(1024, 768, "Window", nullptr, nullptr);
+    // Convert mesh into pages without opening a window
+    if (buildPages)
+        return buildMeshPages(meshFilename, MESH_OPTIONS, pageTriangles) ? 0 : -1;
 
-    // Check if cannot create window
-    if (window == nullptr) {
-        glfwTerminate();
+    // Render reference image on the CPU without opening a window
+    if (!softwareFilename.empty())
+        return renderSoftware(meshFilename, MESH_OPTIONS, softwareFilename, 1024, 768, 10) ? 0 : -1;
 
-        std::cout << "Cannot create window." << std::endl;
-        return -1;
+    // Decode the texture and build its cache on a worker thread while the
+    // window opens and shader programs compile, waited for before loading it
+    TextureStatistics bakeStatistics;
+    std::future<bool> textureBake;
+    
+    if (!textureFilename.empty())
+        textureBake = std::async(std::launch::async, [&]() {
+            return bakeTexture(textureFilename, textureFormat, &bakeStatistics);
+        });
+    
+    // Benchmarks render offscreen without opening a window
+    bool benchmark = benchmarkFrames > 0;
+    
+    GLFWwindow * window = nullptr;
+    HeadlessContext headlessContext;
+    GLADloadproc loadProcedure = (GLADloadproc)glfwGetProcAddress;
+    
+    if (benchmark) {
+        if (!headlessContext.create(1024, 768)) {
+            LogLine() << "Cannot create headless OpenGL context.";
+            return -1;
+        }
+        
+        loadProcedure = (GLADloadproc)headlessProcAddress;
     }
+    else {
+        // Check GLFW initialization
+        if (!glfwInit()) {
+            LogLine() << "Cannot initialize GLFW.";
+            return -1;
+        }
 
-    // Register event callbacks
-    glfwSetFramebufferSizeCallback(window, resize);
-    glfwSetKeyCallback(window, keyboard);
-    glfwSetInputMode(window, GLFW_CURSOR,  GLFW_CURSOR_NORMAL);
-	glfwSetCursorPosCallback (window, cursor_position_callback);
-	//glfwSetCursorEnterCallback (window, cursor_enter_callback);
-	glfwSetScrollCallback(window, scroll_callback);
-	glfwSetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS, GLFW_TRUE);
-	glfwSetMouseButtonCallback(window, mouse_button_callback);
-	
-    // Setup window context
-    glfwMakeContextCurrent(window);
-
-    // Check if cannot load OpenGL procedures
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        glfwTerminate();
+        // Setup OpenGL context
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_SAMPLES, 16);
 
-        std::cout << "Cannot load OpenGL procedures." << std::endl;
-        return -1;
+        // Create window
+        window = glfwCreateWindow(1024, 768, "Window", nullptr, nullptr);
+
+        // Check if cannot create window
+        if (window == nullptr) {
+            glfwTerminate();
+
+            LogLine() << "Cannot create window.";
+            return -1;
+        }
+
+        // Register event callbacks
+        glfwSetFramebufferSizeCallback(window, resize);
+        glfwSetKeyCallback(window, keyboard);
+        glfwSetInputMode(window, GLFW_CURSOR,  GLFW_CURSOR_NORMAL);
+        glfwSetCursorPosCallback (window, cursor_position_callback);
+        //glfwSetCursorEnterCallback (window, cursor_enter_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS, GLFW_TRUE);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+
+        // Setup window context
+        glfwMakeContextCurrent(window);
+
+        // Check if cannot load OpenGL procedures
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+            glfwTerminate();
+
+            LogLine() << "Cannot load OpenGL procedures.";
+            return -1;
+        }
     }
     
-    // Shader program ID
-    GLuint programID;
+    // Load program binary and parallel compilation procedures when available
+    const ShaderExtensions & shaderExtensions = loadShaderExtensions(loadProcedure);
+    
+    LogLine() << "Program binaries " << (shaderExtensions.supportsProgramBinary ? "enabled" : "unavailable")
+              << ", parallel shader compilation "
+              << (shaderExtensions.supportsParallelShaderCompile ? "enabled" : "unavailable");
+    
+    // Shader program with reflected uniforms
+    ShaderProgram program;
+    ProgramBuildStatistics programStatistics;
     
     // Check if cannot create shader program
-    if (!createProgram("../res/shaders/triangle", programID)) {
+    if (!createProgram("../res/shaders/triangle", program, &programStatistics)) {
         glfwTerminate();
 
-        std::cout << "Cannot create shader program." << std::endl;
+        LogLine() << "Cannot create shader program.";
         return -1;
     }
     
+    // Warm startup loads every program from the binary cache
+    LogLine() << "Created shader programs in " << programStatistics.seconds * 1000.0 << " ms ("
+              << (programStatistics.compiled == 0 ? "warm" : "cold") << " cache: "
+              << programStatistics.cached << " cached, " << programStatistics.compiled << " compiled"
+              << (programStatistics.parallel ? " in parallel" : "") << ")";
+    
     // Use shader program
-    glUseProgram(programID);
+    program.use();
+    
+    // Resolve uniform handles once instead of every frame
+    int modelUniform = program.uniform("model");
+    int dequantizationUniform = program.uniform("dequantization");
+    int octahedralNormalUniform = program.uniform("octahedralNormal");
+    int texturedUniform = program.uniform("textured");
+    
+    // Share per frame camera uniforms through a uniform buffer
+    UniformBuffer cameraBuffer;
+    cameraBuffer.create(sizeof(CameraBlock), CAMERA_BLOCK_BINDING);
+    
+    if (!program.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING, sizeof(CameraBlock)))
+        LogLine() << "Shader program has no camera uniform block.";
+    
+    // Record GPU zones with timestamp queries
+    if (!traceFilename.empty())
+        profilerCreateGpu();
     
     // Enable depth test
     glEnable(GL_DEPTH_TEST);
     
-    // Read triangle mesh from Wavefront OBJ file format
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> textureCoordinates;
-    std::vector<size_t> positionIndices;
-    std::vector<size_t> normalIndices;
-    std::vector<size_t> textureCoordinateIndices;
-    
-    readTriangleMesh(
-        "../res/meshes/triangle.obj",
-        positions,
-        normals,
-        textureCoordinates,
-        positionIndices,
-        normalIndices,
-        textureCoordinateIndices);
-    
-    // Load triangle mesh to OpenGL
-    GLuint vao, vbo;
-    
-    size_t vertexCount = loadTriangleMesh(
-        positions,
-        normals,
-        textureCoordinates,
-        positionIndices,
-        normalIndices,
-        textureCoordinateIndices,
-        GL_STATIC_DRAW,
-        vao,
-        vbo);
+    // Load triangle mesh to OpenGL, at once when benchmarking, streamed
+    // behind a placeholder otherwise
+    GLuint vao, vbo, ebo;
+    GLenum indexType;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    glm::vec3 center;
+    float radius;
+    VertexLayout layout;
+    
+    MeshStreamer streamer;
+    FileWatcher watcher;
+    
+    std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+    
+    if (benchmark) {
+        MeshBuffers buffers;
+        PackedMesh packed;
+        
+        if (!loadTriangleMesh(meshFilename, MESH_OPTIONS, GL_STATIC_DRAW, buffers, packed)) {
+            glfwTerminate();
+
+            LogLine() << "Cannot load triangle mesh.";
+            return -1;
+        }
+        
+        vao = buffers.vao;
+        vbo = buffers.vbo;
+        ebo = buffers.ebo;
+        indexType = buffers.indexType;
+        lods = packed.lods;
+        meshlets = packed.meshlets;
+        center = packed.center;
+        radius = packed.radius;
+        layout = packed.layout;
+    }
+    else {
+        IndexedMesh placeholder;
+        PackedMesh packed;
+        
+        buildPlaceholderMesh(placeholder);
+        packMesh(placeholder, VERTEX_FORMAT_FLOAT, packed);
+        
+        uploadTriangleMesh(
+            packed.vertices.data(),
+            packed.vertices.size(),
+            packed.layout,
+            packed.indices.data(),
+            packed.indices.size(),
+            GL_STATIC_DRAW,
+            vao,
+            vbo,
+            ebo);
+        
+        indexType = packed.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        lods = packed.lods;
+        center = packed.center;
+        radius = packed.radius;
+        layout = packed.layout;
+        
+        streamer.create(readStreamedMesh, uploadBudget);
+        
+        if (pagesFilename.empty())
+            streamer.request(meshFilename);
+        
+        // Reload meshes and shaders written while running
+        size_t slash = meshFilename.find_last_of('/');
+        std::string meshDirectory = slash != std::string::npos ? meshFilename.substr(0, slash) : ".";
+        
+        if (!watcher.create() || !watcher.watch(meshDirectory) || !watcher.watch("../res/shaders"))
+            LogLine() << "Cannot watch " << meshDirectory << " and ../res/shaders for changes.";
+    }
+    
+    std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+    
+    // Build picking hierarchy of the full level of detail, streamed meshes
+    // bring their own
+    std::vector<glm::vec3> pickingPositions;
+    std::vector<uint32_t> pickingIndices;
+    
+    if (benchmark && readMeshPositions(meshFilename, MESH_OPTIONS, pickingPositions, pickingIndices)) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        
+        buildBvh(pickingPositions, pickingIndices, PICKING_BVH);
+        
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        
+        LogLine() << "Built picking hierarchy: " << PICKING_BVH.nodes.size() << " nodes in "
+                  << elapsed.count() * 1000.0 << " ms";
+    }
+    
+    // Simplify the full level of detail into the occluder of the mesh,
+    // streamed meshes bring their own
+    OccluderMesh occluderMesh;
+    
+    if (OCCLUSION_CULLING && !pickingPositions.empty()) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        
+        buildOccluderMesh(pickingPositions, pickingIndices, OCCLUDER_TRIANGLES, occluderMesh);
+        
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        
+        LogLine() << "Built occluder: " << occluderMesh.indices.size() / 3 << " triangles in "
+                  << elapsed.count() * 1000.0 << " ms";
+    }
+    
+    // Open paged mesh scaled to the startup view, drawn instead of the mesh
+    PagedMesh pagedMesh;
+    glm::mat4 pagesNormalization(1.0f);
+    
+    if (!pagesFilename.empty()) {
+        if (!pagedMesh.create(pagesFilename, cpuBudget, gpuBudget, uploadBudget)) {
+            LogLine() << "Cannot open paged mesh " << pagesFilename << ".";
+            return -1;
+        }
+        
+        const MeshPagesHeader & header = pagedMesh.header();
+        glm::vec3 boundsMin(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+        glm::vec3 boundsMax(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+        float extent = std::max(0.5f * glm::distance(boundsMin, boundsMax), 1e-6f);
+        
+        pagesNormalization = glm::translate(
+            glm::scale(glm::mat4(1.0f), glm::vec3(PAGED_MESH_RADIUS / extent)),
+            -0.5f * (boundsMin + boundsMax));
+        
+        // Normal decoding follows the vertex format of the pages
+        layout = vertexLayout((VertexFormat)header.vertexFormat, false, false);
+        
+        LogLine() << "Paging " << pagesFilename << ": " << header.triangleCount << " triangles in "
+                  << header.pageCount << " pages, " << cpuBudget / (1024 * 1024) << " MB memory and "
+                  << gpuBudget / (1024 * 1024) << " MB GPU budgets";
+    }
+    
+    // Load texture to the first texture unit, bound for the whole run, from
+    // the cache refreshed by the worker thread
+    GLuint texture = 0;
+    
+    if (!textureFilename.empty()) {
+        bool baked = textureBake.get();
+        
+        TextureStatistics textureStatistics;
+        
+        if (loadTexture(textureFilename, textureFormat, texture, &textureStatistics)) {
+            // Loads from a cache the worker thread just built are cold too
+            bool cold = !textureStatistics.cached || (baked && !bakeStatistics.cached);
+            const TextureStatistics & built = textureStatistics.cached ? bakeStatistics : textureStatistics;
+            double seconds = textureStatistics.seconds + (textureStatistics.cached && baked ? bakeStatistics.seconds : 0.0);
+            
+            LogLine line;
+            
+            line << "Loaded texture " << textureFilename << ": " << textureStatistics.width << " x "
+                 << textureStatistics.height << ", " << textureStatistics.levels << " levels, "
+                 << textureFormatName(textureStatistics.format) << ", "
+                 << textureStatistics.bytes / (1024.0 * 1024.0) << " MB of video memory instead of "
+                 << textureStatistics.uncompressedBytes / (1024.0 * 1024.0) << " MB uncompressed ("
+                 << 100.0 - 100.0 * textureStatistics.bytes / std::max<size_t>(textureStatistics.uncompressedBytes, 1)
+                 << "% saved), " << (cold ? "cold" : "cached") << " in " << seconds * 1000.0 << " ms (";
+            
+            if (cold)
+                line << "decoded in " << built.decodeSeconds * 1000.0 << " ms, mipmaps in "
+                     << built.mipmapSeconds * 1000.0 << " ms, encoded in " << built.encodeSeconds * 1000.0 << " ms, ";
+            
+            line << "uploaded in " << textureStatistics.uploadSeconds * 1000.0 << " ms)";
+            
+            if (textureStatistics.format != textureFormat)
+                line << ", " << textureFormatName(textureFormat) << " is not supported";
+        }
+        else
+            LogLine() << "Cannot load texture " << textureFilename << ".";
+    }
+    
+    // Pass vertex layout parameters of the mesh to shader program, again
+    // whenever the mesh or the program is replaced
+    auto setLayoutUniforms = [&]() {
+        // Position dequantization, applied before the instance and model matrices
+        glm::mat4 dequantization = glm::scale(
+            glm::translate(glm::mat4(1.0f), layout.positionOffset),
+            layout.positionScale);
+        
+        program.set(dequantizationUniform, dequantization);
+        
+        // Select normal decoding of the shader program
+        program.set(octahedralNormalUniform, (GLint)(layout.format != VERTEX_FORMAT_FLOAT));
+        
+        // Sample the texture only with texture coordinates to sample it at
+        program.set(texturedUniform, (GLint)(texture != 0 && layout.hasTextureCoordinates));
+    };
+    
+    setLayoutUniforms();
     
     // Setup view matrix
-    glm::mat4 view = glm::lookAt(
+    VIEW = glm::lookAt(
         glm::vec3(0.0f, 0.0f, 20.0f),
         glm::vec3(0.0f),
         glm::vec3(0.0f, 1.0f, 0.0f));
     
+    // Lay out instances of the mesh on a grid of unit spheres, streamed to
+    // an instance buffer every frame
+    std::vector<InstanceData> instanceGrid;
+    std::vector<glm::mat4> instanceModels;
+    std::vector<glm::vec4> instanceColors;
+    std::vector<size_t> instanceLods;
+    InstanceBuffer instanceBuffer;
+    
+    // Or lay out a hierarchy of instances whose world matrices are streamed
+    // to the instance buffer, colored by depth
+    SceneGraph scene;
+    std::vector<glm::vec4> sceneColors;
+    
+    // Box of the light field, around the mesh or above the instances
+    glm::vec3 lightMinimum = center - glm::vec3(radius * 1.5f);
+    glm::vec3 lightMaximum = center + glm::vec3(radius * 1.5f);
+    
+    if (sceneNodes > 0) {
+        float extent = buildOrbitScene(sceneNodes, center, radius, scene, sceneColors);
+        lightMinimum = glm::vec3(-extent, 1.5f, -extent);
+        lightMaximum = glm::vec3(extent, 3.0f, extent);
+        instanceBuffer.create(scene.size(), instanceUpdate);
+        
+        glBindVertexArray(vao);
+        instanceBuffer.bindAttributes(0);
+        
+        VIEW = glm::lookAt(
+            glm::vec3(0.0f, extent * 0.6f, extent * 1.2f),
+            glm::vec3(0.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f));
+        
+        LogLine() << "Scene graph of " << scene.size() << " copies of " << meshFilename
+                  << " (" << instanceUpdateName(instanceUpdate) << " updates)";
+    }
+    else if (instanceGridSide > 0) {
+        buildInstanceGrid(instanceGridSide, center, radius, instanceGrid);
+        instanceBuffer.create(instanceGrid.size(), instanceUpdate);
+        
+        glBindVertexArray(vao);
+        instanceBuffer.bindAttributes(0);
+        
+        // Look at the grid from above one of its sides
+        float extent = instanceGridSide * 1.25f;
+        lightMinimum = glm::vec3(-extent, 1.5f, -extent);
+        lightMaximum = glm::vec3(extent, 3.0f, extent);
+        
+        VIEW = glm::lookAt(
+            glm::vec3(0.0f, extent * 0.6f, extent * 1.2f),
+            glm::vec3(0.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f));
+        
+        LogLine() << "Instancing " << instanceGrid.size() << " copies of " << meshFilename
+                  << " (" << instanceUpdateName(instanceUpdate) << " updates)";
+    }
+    else
+        resetInstanceAttributes();
+    
+    // Bin moving lights into the froxels of the view every frame, sampled
+    // from texture buffers by the fragment shader
+    std::vector<Light> lightField;
+    std::vector<Light> lights;
+    LightClusters lightClusters;
+    LightClusterBuffers lightBuffers;
+    
+    // Light cluster samplers get their own units even without lights, as
+    // samplers of different types cannot share the unit of the diffuse texture
+    lightBuffers.setProgram(program);
+    
+    if (lightCount > 0) {
+        buildLightField(lightCount, lightMinimum, lightMaximum, lightField);
+        
+        lightBuffers.create();
+        
+        LogLine() << "Clustered lighting of " << lightField.size() << " lights ("
+                  << lightField.size() / 4 << " spot lights) in " << CLUSTER_TILES_X << " x "
+                  << CLUSTER_TILES_Y << " x " << CLUSTER_SLICES << " clusters";
+    }
+    
     // Initialize projection matrix and viewport
-    resize(window, 1024, 768);
+    setViewport(1024, 768);
     
-    // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        // Setup color buffer
-        if (BACKGROUND_STATE)
-            glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
-        else
-            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    // Replay camera path from the startup view, timing every frame
+    std::vector<CameraKeyframe> cameraPath;
+    GpuFrameTimer gpuTimer;
+    BenchmarkResult benchmarkResult;
+    size_t benchmarkTriangles = 0;
+    
+    if (benchmark) {
+        if (cameraPathFilename.empty()) {
+            glm::mat4 inverseView = glm::inverse(VIEW);
+            defaultCameraPath(glm::vec3(inverseView[3]), glm::vec3(0.0f), cameraPath);
+        }
+        else if (!readCameraPath(cameraPathFilename, cameraPath)) {
+            LogLine() << "Cannot read camera path " << cameraPathFilename << ".";
+            return -1;
+        }
+        
+        gpuTimer.create();
+        
+        benchmarkResult.mesh = meshFilename;
+        benchmarkResult.renderer = (const char *)glGetString(GL_RENDERER);
+        benchmarkResult.width = 1024;
+        benchmarkResult.height = 768;
+        benchmarkResult.frames = benchmarkFrames;
+        benchmarkResult.warmupFrames = std::min(BENCHMARK_WARMUP_FRAMES, benchmarkFrames / 2);
+        benchmarkResult.loadSeconds = loadTime.count();
+        benchmarkResult.programSeconds = programStatistics.seconds;
+    }
+    
+    // Current level of detail
+    size_t lod = 0;
+    size_t indexBytes = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    
+    // Visible meshlets merged into index ranges of a multi draw
+    std::vector<uint32_t> visibleMeshlets;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const GLvoid *> drawOffsets;
+    
+    // Meshlet culling counters accumulated until printed once per second
+    MeshletCullingStatistics cullingTotals = { 0, 0 };
+    size_t cullingFrames = 0;
+    std::chrono::steady_clock::time_point cullingStart = std::chrono::steady_clock::now();
+    
+    // Paged mesh frames counted until its residency is printed once per second
+    size_t pagedFrames = 0;
+    std::chrono::steady_clock::time_point pagedStart = std::chrono::steady_clock::now();
+    
+    // Instancing counters accumulated until printed once per second
+    size_t instancesDrawn = 0;
+    size_t instanceFrames = 0;
+    SceneUpdateStatistics sceneTotals = { 0, 0, 0, 0.0 };
+    std::chrono::steady_clock::time_point instanceStart = std::chrono::steady_clock::now();
+    
+    // Occlusion buffer of the largest instances, and occlusion culling
+    // counters accumulated with the instancing ones
+    OcclusionBuffer occlusionBuffer;
+    std::vector<unsigned char> occludedInstances;
+    OcclusionStatistics occlusionTotals = { 0, 0, 0, 0, 0.0, 0.0 };
+    double occlusionMaximumSeconds = 0.0;
+    
+    // Light binning counters accumulated until printed once per second
+    LightBinningStatistics lightTotals = { 0, 0, 0, 0, 0, 0, 0.0 };
+    double lightMaximumSeconds = 0.0, lightUploadSeconds = 0.0;
+    size_t lightFrames = 0;
+    std::chrono::steady_clock::time_point lightStart = std::chrono::steady_clock::now();
+    
+    // Input to present latency accumulated until printed once per second
+    double latencyTotal = 0.0, latencyMaximum = 0.0;
+    size_t latencyFrames = 0, latencyFramesTotal = 0;
+    std::chrono::steady_clock::time_point latencyStart = std::chrono::steady_clock::now();
+    
+    // Render loop, over the frames of the camera path when benchmarking and
+    // over the packets built by the main thread otherwise
+    FrameMailbox mailbox;
+    size_t frame = 0;
+    
+    auto renderFrames = [&]() {
+        FramePacket * packet = nullptr;
+        
+        while (benchmark ? frame < benchmarkFrames : (packet = mailbox.consume()) != nullptr) {
+            PROFILE_ZONE("Frame");
+            
+            std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+            
+            if (!benchmark) {
+                // Request meshes and reload shader programs written since the
+                // last frame
+                std::vector<std::string> changed;
+                watcher.poll(changed);
+                
+                bool reloadProgram = false;
+                
+                for (size_t i = 0; i < changed.size(); i++) {
+                    if (changed[i] == meshFilename) {
+                        LogLine() << "Reloading " << meshFilename;
+                        streamer.request(meshFilename);
+                    }
+                    else if (changed[i] == "../res/shaders/triangle.vert" || changed[i] == "../res/shaders/triangle.frag")
+                        reloadProgram = true;
+                }
+                
+                if (reloadProgram) {
+                    PROFILE_ZONE("Reload shader program");
+                    
+                    // Keep the previous program when the new one fails to build
+                    ShaderProgram reloaded;
+                    
+                    if (createProgram("../res/shaders/triangle", reloaded)) {
+                        program.reset(reloaded.release());
+                        program.use();
+                        
+                        modelUniform = program.uniform("model");
+                        dequantizationUniform = program.uniform("dequantization");
+                        octahedralNormalUniform = program.uniform("octahedralNormal");
+                        texturedUniform = program.uniform("textured");
+                        
+                        if (!program.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING, sizeof(CameraBlock)))
+                            LogLine() << "Shader program has no camera uniform block.";
+                        
+                        setLayoutUniforms();
+                        lightBuffers.setProgram(program);
+                        
+                        LogLine() << "Reloaded shader program ../res/shaders/triangle";
+                    }
+                    else
+                        LogLine() << "Cannot reload shader program, keeping the previous one.";
+                }
+                
+                // Upload slices of the streamed mesh and swap it in once complete
+                MeshBuffers streamedBuffers;
+                StreamedMesh streamed;
+                
+                if (streamer.update(streamedBuffers, streamed)) {
+                    MeshBuffers previous = { vao, vbo, ebo, indexType };
+                    destroyMeshBuffers(previous);
+                    
+                    vao = streamedBuffers.vao;
+                    vbo = streamedBuffers.vbo;
+                    ebo = streamedBuffers.ebo;
+                    indexType = streamedBuffers.indexType;
+                    indexBytes = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+                    
+                    lods = streamed.packed.lods;
+                    meshlets = streamed.packed.meshlets;
+                    center = streamed.packed.center;
+                    radius = streamed.packed.radius;
+                    layout = streamed.packed.layout;
+                    lod = 0;
+                    
+                    PICKING_BVH = std::move(streamed.bvh);
+                    occluderMesh = std::move(streamed.occluder);
+                    
+                    setLayoutUniforms();
+                    
+                    if (sceneNodes > 0)
+                        buildOrbitScene(sceneNodes, center, radius, scene, sceneColors);
+                    else if (instanceGridSide > 0)
+                        buildInstanceGrid(instanceGridSide, center, radius, instanceGrid);
+                    
+                    LogLine() << "Streamed " << streamed.filename << ": "
+                              << streamed.packed.vertexCount << " vertices, "
+                              << lods[0].indexCount / 3 << " triangles, read in "
+                              << streamed.readSeconds * 1000.0 << " ms, uploaded over "
+                              << streamed.uploadFrames << " frames ("
+                              << streamed.skippedFrames << " skipped waiting on staging fences)";
+                    
+                    if (!occluderMesh.indices.empty())
+                        LogLine() << "Occluder of " << streamed.filename << ": "
+                                  << occluderMesh.indices.size() / 3 << " triangles";
+                }
+                
+                // Rebind the mesh, the streamer binds the vertex arrays it creates
+                glBindVertexArray(vao);
+                
+                // Take over the scene state of the frame packet
+                MODEL = packet->model;
+                VIEW = packet->view;
+                BACKGROUND_STATE = packet->background;
+                
+                if (packet->width != VIEWPORT_WIDTH || packet->height != VIEWPORT_HEIGHT)
+                    setViewport(packet->width, packet->height);
+                
+                for (size_t i = 0; i < packet->picks.size(); i++)
+                    pickTriangle(packet->picks[i]);
+            }
+            
+            // Triangles submitted by the draws of the frame
+            size_t triangles = 0;
+            
+            if (benchmark) {
+                float fraction = benchmarkFrames > 1 ? frame / (float)(benchmarkFrames - 1) : 0.0f;
+                sampleCameraPath(cameraPath, fraction, VIEW, MODEL);
+                
+                gpuTimer.begin();
+            }
+            
+            {
+                PROFILE_ZONE("Clear");
+                PROFILE_GPU_ZONE("Clear");
+                
+                // Setup color buffer
+                if (BACKGROUND_STATE)
+                    glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+                else
+                    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+                    
+                // Clear color buffer
+                glClear(GL_COLOR_BUFFER_BIT);
+                
+                // Setup depth buffer
+                glClearDepth(1.0f);
+                
+                // Clear depth buffer
+                glClear(GL_DEPTH_BUFFER_BIT);
+            }
+            
+            {
+                PROFILE_ZONE("Uniforms");
+                
+                // Pass model matrix as parameter to shader program, skipped when unchanged
+                program.set(modelUniform, MODEL);
+                
+                // Pass view and projection matrices to every shader program through
+                // the camera uniform buffer, skipped when unchanged
+                CameraBlock camera;
+                camera.view = VIEW;
+                camera.projection = PROJECTION;
+                camera.viewProjection = PROJECTION * VIEW;
+                camera.position = glm::inverse(VIEW)[3];
+                
+                cameraBuffer.update(&camera);
+            }
+            
+            if (lightCount > 0) {
+                PROFILE_ZONE("Lights");
+                
+                // Move lights with the model, at a fixed 60 frames per second
+                // when benchmarking
+                std::chrono::duration<double> time(benchmark ? frame / 60.0 : packet->time);
+                animateLightField(lightField, (float)time.count(), lights);
+                
+                LightBinningStatistics statistics;
+                lightClusters.update(lights, VIEW * MODEL, PROJECTION, &statistics);
+                
+                std::chrono::steady_clock::time_point uploadStart = std::chrono::steady_clock::now();
+                
+                lightBuffers.upload(lightClusters);
+                lightBuffers.bind(program, lightClusters, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+                
+                std::chrono::duration<double> upload = std::chrono::steady_clock::now() - uploadStart;
+                
+                lightTotals.visibleLights += statistics.visibleLights;
+                lightTotals.litClusters += statistics.litClusters;
+                lightTotals.maximumClusterLights = std::max(lightTotals.maximumClusterLights, statistics.maximumClusterLights);
+                lightTotals.indices += statistics.indices;
+                lightTotals.tasks += statistics.tasks;
+                lightTotals.seconds += statistics.seconds;
+                lightMaximumSeconds = std::max(lightMaximumSeconds, statistics.seconds);
+                lightUploadSeconds += upload.count();
+                lightFrames++;
+                
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - lightStart;
+                
+                if (elapsed.count() >= 1.0) {
+                    LogLine() << "Light binning per frame: " << lightTotals.seconds * 1000.0 / lightFrames
+                              << " ms average, " << lightMaximumSeconds * 1000.0 << " ms maximum over "
+                              << lightTotals.tasks / lightFrames << " tasks, "
+                              << lightTotals.visibleLights / lightFrames << " of " << lights.size()
+                              << " lights visible, " << lightTotals.indices / lightFrames << " light indices in "
+                              << lightTotals.litClusters / lightFrames << " of " << CLUSTER_COUNT
+                              << " clusters (at most " << lightTotals.maximumClusterLights << " lights), uploaded in "
+                              << lightUploadSeconds * 1000.0 / lightFrames << " ms";
+                    
+                    lightTotals = LightBinningStatistics();
+                    lightMaximumSeconds = 0.0;
+                    lightUploadSeconds = 0.0;
+                    lightFrames = 0;
+                    lightStart = std::chrono::steady_clock::now();
+                }
+            }
+            
+            // Select level of detail from the projected size of the mesh
+            float screenSize = projectedSphereSize(
+                center, radius, VIEW * MODEL, PROJECTION, (float)VIEWPORT_HEIGHT);
+            lod = selectLod(lods, lod, radius, screenSize);
+            
+            if (pagedMesh.isOpen()) {
+                PROFILE_ZONE("Draw pages");
+                PROFILE_GPU_ZONE("Draw pages");
+                
+                // Rank pages for the camera in mesh units, then draw the
+                // resident visible ones
+                glm::mat4 modelView = VIEW * MODEL * pagesNormalization;
+                glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+                
+                pagedMesh.update(PROJECTION * modelView, cameraPosition);
+                triangles += pagedMesh.draw(program, dequantizationUniform, pagesNormalization);
+                
+                pagedFrames++;
+                
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - pagedStart;
+                
+                if (elapsed.count() >= 1.0) {
+                    PagedMeshStatistics statistics = pagedMesh.takeStatistics();
+                    
+                    LogLine() << "Pages: " << statistics.visiblePages << " of " << statistics.pages
+                              << " visible (" << statistics.missingPages << " not resident), "
+                              << statistics.gpuPages << " on the GPU in "
+                              << statistics.gpuBytes / (1024.0 * 1024.0) << " MB, "
+                              << statistics.cpuPages << " in memory in "
+                              << statistics.cpuBytes / (1024.0 * 1024.0) << " MB, "
+                              << statistics.loads << " loads, " << statistics.uploads << " uploads, "
+                              << statistics.gpuEvictions << " GPU and " << statistics.cpuEvictions
+                              << " memory evictions over " << pagedFrames << " frames";
+                    
+                    pagedFrames = 0;
+                    pagedStart = std::chrono::steady_clock::now();
+                }
+            }
+            else if (!instanceGrid.empty() || scene.size() > 0) {
+                PROFILE_ZONE("Draw instances");
+                PROFILE_GPU_ZONE("Draw instances");
+                
+                // Animate, cull and sort instances by level of detail straight
+                // into the instance buffer
+                // Benchmarks animate at a fixed 60 frames per second
+                std::chrono::duration<double> time(benchmark ? frame / 60.0 : packet->time);
+                
+                const glm::mat4 * models;
+                const glm::vec4 * colors;
+                size_t count;
+                
+                if (scene.size() > 0) {
+                    // World matrices of the dirty subtrees are recomputed in
+                    // place and drawn as they are
+                    SceneUpdateStatistics sceneStatistics;
+                    
+                    animateOrbitScene(scene, center, (float)time.count());
+                    scene.update(&sceneStatistics);
+                    
+                    sceneTotals.dirtySubtrees += sceneStatistics.dirtySubtrees;
+                    sceneTotals.updatedNodes += sceneStatistics.updatedNodes;
+                    sceneTotals.tasks += sceneStatistics.tasks;
+                    sceneTotals.seconds += sceneStatistics.seconds;
+                    
+                    models = scene.worldMatrices().data();
+                    colors = sceneColors.data();
+                    count = scene.size();
+                }
+                else {
+                    animateInstanceGrid(instanceGrid, (float)time.count(), instanceModels, instanceColors);
+                    
+                    models = instanceModels.data();
+                    colors = instanceColors.data();
+                    count = instanceModels.size();
+                }
+                
+                // Cull instances hidden behind the largest ones before
+                // batching, the placeholder has no occluder
+                const unsigned char * occluded = nullptr;
+                
+                if (OCCLUSION_CULLING && !occluderMesh.indices.empty()) {
+                    PROFILE_ZONE("Occlusion culling");
+                    
+                    OcclusionStatistics statistics;
+                    
+                    cullOccludedInstances(
+                        models,
+                        count,
+                        occluderMesh,
+                        center,
+                        radius,
+                        VIEW * MODEL,
+                        PROJECTION,
+                        occlusionBuffer,
+                        occludedInstances,
+                        &statistics);
+                    
+                    occluded = occludedInstances.data();
+                    
+                    double seconds = statistics.renderSeconds + statistics.testSeconds;
+                    
+                    occlusionTotals.occluders += statistics.occluders;
+                    occlusionTotals.triangles += statistics.triangles;
+                    occlusionTotals.tested += statistics.tested;
+                    occlusionTotals.occluded += statistics.occluded;
+                    occlusionTotals.renderSeconds += statistics.renderSeconds;
+                    occlusionTotals.testSeconds += statistics.testSeconds;
+                    occlusionMaximumSeconds = std::max(occlusionMaximumSeconds, seconds);
+                }
+                
+                InstanceData * data = instanceBuffer.map(count);
+                size_t counts[MAX_LOD_COUNT];
+                size_t visible = 0;
+                
+                if (data != nullptr) {
+                    visible = batchInstances(
+                        models,
+                        colors,
+                        count,
+                        center,
+                        radius,
+                        lods,
+                        VIEW * MODEL,
+                        PROJECTION,
+                        (float)VIEWPORT_HEIGHT,
+                        instanceLods,
+                        data,
+                        counts,
+                        occluded);
+                    
+                    instanceBuffer.unmap();
+                }
+                
+                // Draw the instances of every level of detail at once
+                size_t first = 0;
+                
+                for (size_t i = 0; i < lods.size() && visible > 0; i++) {
+                    if (counts[i] == 0)
+                        continue;
+                    
+                    instanceBuffer.bindAttributes(first);
+                    
+                    glDrawElementsInstanced(
+                        GL_TRIANGLES,
+                        lods[i].indexCount,
+                        indexType,
+                        (const GLvoid *)(lods[i].indexOffset * indexBytes),
+                        (GLsizei)counts[i]);
+                    
+                    first += counts[i];
+                    triangles += counts[i] * lods[i].indexCount / 3;
+                }
+                
+                instanceBuffer.finishFrame();
+                
+                instancesDrawn += visible;
+                instanceFrames++;
+                
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - instanceStart;
+                
+                if (elapsed.count() >= 1.0) {
+                    LogLine() << "Instances per frame: " << instancesDrawn / instanceFrames << " of "
+                              << count << " drawn, "
+                              << elapsed.count() * 1000.0 / instanceFrames << " ms per frame, "
+                              << instanceBuffer.takeWaitTime() * 1000.0 / instanceFrames
+                              << " ms waiting on fences";
+                    
+                    if (scene.size() > 0)
+                        LogLine() << "Scene graph per frame: " << sceneTotals.updatedNodes / instanceFrames
+                                  << " nodes of " << sceneTotals.dirtySubtrees / instanceFrames
+                                  << " dirty subtrees updated by " << sceneTotals.tasks / instanceFrames
+                                  << " tasks in " << sceneTotals.seconds * 1000.0 / instanceFrames << " ms";
+                    
+                    // Instances left after frustum culling are tested, those
+                    // not occluded are visible
+                    if (occlusionTotals.tested > 0)
+                        LogLine() << "Occlusion culling per frame: "
+                                  << occlusionTotals.occluded / instanceFrames << " occluded and "
+                                  << (occlusionTotals.tested - occlusionTotals.occluded) / instanceFrames
+                                  << " visible of " << occlusionTotals.tested / instanceFrames << " tested behind "
+                                  << occlusionTotals.occluders / instanceFrames << " occluders ("
+                                  << occlusionTotals.triangles / instanceFrames << " triangles), rendered in "
+                                  << occlusionTotals.renderSeconds * 1000.0 / instanceFrames << " ms, tested in "
+                                  << occlusionTotals.testSeconds * 1000.0 / instanceFrames << " ms, "
+                                  << occlusionMaximumSeconds * 1000.0 << " ms maximum on "
+                                  << threadCount() << " threads";
+                    
+                    instancesDrawn = 0;
+                    instanceFrames = 0;
+                    sceneTotals = SceneUpdateStatistics();
+                    occlusionTotals = OcclusionStatistics();
+                    occlusionMaximumSeconds = 0.0;
+                    instanceStart = std::chrono::steady_clock::now();
+                }
+            }
+            else if (lod == 0 && !meshlets.empty()) {
+                PROFILE_ZONE("Draw meshlets");
+                PROFILE_GPU_ZONE("Draw meshlets");
+                
+                // Cull meshlets in mesh units against the frustum and the camera
+                // position, backfacing meshlets are culled as a whole
+                glm::mat4 modelView = VIEW * MODEL;
+                glm::vec4 planes[6];
+                extractFrustumPlanes(PROJECTION * modelView, planes);
+                
+                glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+                
+                MeshletCullingStatistics statistics;
+                cullMeshlets(meshlets, planes, cameraPosition, visibleMeshlets, &statistics);
+                
+                // Merge meshlets adjacent in the index buffer into one range
+                drawCounts.clear();
+                drawOffsets.clear();
+                
+                for (size_t i = 0; i < visibleMeshlets.size(); i++) {
+                    const Meshlet & meshlet = meshlets[visibleMeshlets[i]];
+                    
+                    if (i > 0 && visibleMeshlets[i] == visibleMeshlets[i - 1] + 1)
+                        drawCounts.back() += meshlet.indexCount;
+                    else {
+                        drawCounts.push_back(meshlet.indexCount);
+                        drawOffsets.push_back((const GLvoid *)(meshlet.indexOffset * indexBytes));
+                    }
+                    
+                    triangles += meshlet.indexCount / 3;
+                }
+                
+                // Draw visible ranges of indexed vertex array as triangles
+                if (!drawCounts.empty())
+                    glMultiDrawElements(
+                        GL_TRIANGLES,
+                        drawCounts.data(),
+                        indexType,
+                        drawOffsets.data(),
+                        (GLsizei)drawCounts.size());
+                
+                cullingTotals.tested += statistics.tested;
+                cullingTotals.drawn += statistics.drawn;
+                cullingFrames++;
+                
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - cullingStart;
+                
+                if (elapsed.count() >= 1.0) {
+                    LogLine() << "Meshlets per frame: " << cullingTotals.tested / cullingFrames
+                              << " tested, " << cullingTotals.drawn / cullingFrames << " drawn in "
+                              << drawCounts.size() << " ranges";
+                    
+                    cullingTotals.tested = 0;
+                    cullingTotals.drawn = 0;
+                    cullingFrames = 0;
+                    cullingStart = std::chrono::steady_clock::now();
+                }
+            }
+            else {
+                PROFILE_ZONE("Draw");
+                PROFILE_GPU_ZONE("Draw");
+                
+                // Draw indexed vertex array as triangles
+                glDrawElements(
+                    GL_TRIANGLES,
+                    lods[lod].indexCount,
+                    indexType,
+                    (const GLvoid *)(lods[lod].indexOffset * indexBytes));
+                
+                triangles += lods[lod].indexCount / 3;
+            }
+            
+            PROFILE_GPU_FRAME();
             
-        // Clear color buffer
-        glClear(GL_COLOR_BUFFER_BIT);
+            if (benchmark) {
+                std::chrono::duration<double> cpuTime = std::chrono::steady_clock::now() - frameStart;
+                
+                gpuTimer.end();
+                
+                // Wait for rendering in place of a buffer swap
+                glFinish();
+                
+                std::chrono::duration<double> frameTime = std::chrono::steady_clock::now() - frameStart;
+                
+                if (frame >= benchmarkResult.warmupFrames) {
+                    benchmarkResult.cpuSeconds.push_back(cpuTime.count());
+                    benchmarkResult.frameSeconds.push_back(frameTime.count());
+                    benchmarkTriangles += triangles;
+                }
+                
+                frame++;
+            }
+            else {
+                PROFILE_ZONE("glfwSwapBuffers");
+                
+                // Swap double buffer
+                glfwSwapBuffers(window);
+                
+                // Time from the oldest event applied by the frame until its
+                // buffer swap
+                std::chrono::steady_clock::time_point presented = std::chrono::steady_clock::now();
+                
+                if (packet->hasInput) {
+                    std::chrono::duration<double> latency = presented - packet->oldestInput;
+                    
+                    latencyTotal += latency.count();
+                    latencyMaximum = std::max(latencyMaximum, latency.count());
+                    latencyFrames++;
+                }
+                
+                latencyFramesTotal++;
+                
+                std::chrono::duration<double> elapsed = presented - latencyStart;
+                
+                if (elapsed.count() >= 1.0) {
+                    double mainWait, renderWait;
+                    mailbox.takeWaitTimes(mainWait, renderWait);
+                    
+                    LogLine line;
+                    
+                    line << "Frame time " << elapsed.count() * 1000.0 / latencyFramesTotal
+                         << " ms, waiting per frame " << mainWait * 1000.0 / latencyFramesTotal
+                         << " ms on the main thread and " << renderWait * 1000.0 / latencyFramesTotal
+                         << " ms on the render thread";
+                    
+                    if (latencyFrames > 0)
+                        line << ", input to present latency " << latencyTotal * 1000.0 / latencyFrames
+                             << " ms mean, " << latencyMaximum * 1000.0 << " ms max over "
+                             << latencyFrames << " frames with input ("
+                             << INPUT_QUEUE.dropped() << " events dropped)";
+                    
+                    latencyTotal = 0.0;
+                    latencyMaximum = 0.0;
+                    latencyFrames = 0;
+                    latencyFramesTotal = 0;
+                    latencyStart = presented;
+                }
+                
+                // Give the packet back to the main thread
+                mailbox.release(packet);
+            }
+        }
+    };
+    
+    if (benchmark)
+        renderFrames();
+    else {
+        mailbox.create(framePackets);
         
-        // Setup depth buffer
-        glClearDepth(1.0f);
+        // Build packets from the startup view, input and animation time
+        ModelController controller;
+        glm::mat4 view = VIEW;
+        std::chrono::steady_clock::time_point animationStart = std::chrono::steady_clock::now();
         
-        // Clear depth buffer
-        glClear(GL_DEPTH_BUFFER_BIT);
+        // Hand the OpenGL context over to the render thread
+        glfwMakeContextCurrent(nullptr);
         
-        // Pass model matrix as parameter to shader program
-        GLint modelLocationID = glGetUniformLocation(programID, "model");
-        glUniformMatrix4fv(modelLocationID, 1, GL_FALSE, glm::value_ptr(MODEL));
+        std::thread renderThread([&]() {
+            glfwMakeContextCurrent(window);
+            glfwSwapInterval(swapInterval(pacing));
+            
+            renderFrames();
+            
+            glfwMakeContextCurrent(nullptr);
+        });
         
-        // Pass view matrix as parameter to shader program
-        GLint viewLocationID = glGetUniformLocation(programID, "view");
-        glUniformMatrix4fv(viewLocationID, 1, GL_FALSE, glm::value_ptr(view));
+        LogLine() << "Rendering on a separate thread with " << framePackets << " frame packets ("
+                  << framePacingName(pacing) << " pacing)";
         
-        // Pass projection matrix as parameter to shader program
-        GLint projectionLocationID = glGetUniformLocation(programID, "projection");
-        glUniformMatrix4fv(projectionLocationID, 1, GL_FALSE, glm::value_ptr(PROJECTION));
+        // Event loop, building a packet whenever the render thread frees one
+        size_t packetFrame = 0;
         
-        // Draw vertex array as triangles
-        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        while (!glfwWindowShouldClose(window)) {
+            FramePacket * packet = mailbox.acquire();
+            
+            if (packet == nullptr)
+                break;
+            
+            // Sample input as late as the target latency allows
+            if (pacing == FRAME_PACING_TARGET_LATENCY)
+                std::this_thread::sleep_until(
+                    mailbox.nextConsume() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(targetLatency)));
+            
+            // Process events and callbacks
+            glfwPollEvents();
+            
+            PROFILE_ZONE("Build frame packet");
+            
+            // Apply the events queued since the last packet at a fixed timestep
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            controller.update(INPUT_QUEUE, now);
+            
+            std::chrono::duration<double> time = now - animationStart;
+            
+            packet->frame = packetFrame++;
+            packet->model = controller.model();
+            packet->view = view;
+            packet->background = controller.background();
+            packet->width = FRAMEBUFFER_WIDTH;
+            packet->height = FRAMEBUFFER_HEIGHT;
+            packet->time = time.count();
+            packet->hasInput = controller.consumed(packet->oldestInput);
+            
+            // Picking positions relative to the window size
+            int width;
+            int height;
+            glfwGetWindowSize(window, &width, &height);
+            
+            packet->picks.clear();
+            
+            for (size_t i = 0; i < controller.picks().size() && width > 0 && height > 0; i++)
+                packet->picks.push_back(glm::vec2(
+                    2.0f * (float)controller.picks()[i].x / width - 1.0f,
+                    1.0f - 2.0f * (float)controller.picks()[i].y / height));
+            
+            mailbox.publish(packet);
+        }
         
-        // Swap double buffer
-        glfwSwapBuffers(window);
-
-        // Process events and callbacks
-        glfwPollEvents();
+        mailbox.close();
+        renderThread.join();
+        
+        // Take the OpenGL context back to delete resources
+        glfwMakeContextCurrent(window);
+    }
+    
+    // Export recorded zones
+    if (!traceFilename.empty() && profilerEnabled()) {
+        if (writeChromeTrace(traceFilename))
+            LogLine() << "Wrote " << traceFilename;
+        else
+            LogLine() << "Cannot write " << traceFilename << ".";
+        
+        profilerDestroyGpu();
+    }
+    
+    // Report frame time statistics of the measured frames
+    if (benchmark) {
+        std::vector<double> gpuSeconds;
+        gpuTimer.collect(gpuSeconds, true);
+        gpuTimer.destroy();
+        
+        if (gpuSeconds.size() == benchmarkFrames)
+            benchmarkResult.gpuSeconds.assign(gpuSeconds.begin() + benchmarkResult.warmupFrames, gpuSeconds.end());
+        
+        size_t measured = benchmarkResult.frameSeconds.size();
+        benchmarkResult.trianglesPerFrame = measured > 0 ? benchmarkTriangles / (double)measured : 0.0;
+        
+        if (benchmarkFilename.empty()) {
+            // Keep the JSON after the logged lines
+            flushLog();
+            writeBenchmarkJson(std::cout, benchmarkResult);
+        }
+        else {
+            std::ofstream file(benchmarkFilename.c_str());
+            writeBenchmarkJson(file, benchmarkResult);
+            
+            if (!file.good())
+                LogLine() << "Cannot write " << benchmarkFilename << ".";
+            else
+                LogLine() << "Wrote " << benchmarkFilename;
+        }
     }
 
     // Delete shader program
-    glDeleteProgram(programID);
+    program.destroy();
+    
+    // Delete camera uniform buffer
+    cameraBuffer.destroy();
+    
+    // Delete light cluster buffers
+    lightBuffers.destroy();
+    
+    // Delete texture
+    glDeleteTextures(1, &texture);
 
     // Delete vertex array object
     glDeleteVertexArrays(1, &vao);
@@ -694,8 +2069,22 @@ int main(int argc, char ** argv) {
     // Delete vertex buffer object
     glDeleteBuffers(1, &vbo);
 
-    // Destroy window
-    glfwDestroyWindow(window);
+    // Delete element buffer object
+    glDeleteBuffers(1, &ebo);
+
+    // Delete instance buffer and its fences
+    instanceBuffer.destroy();
+    
+    // Stop streaming and watching files, and delete resident pages
+    streamer.destroy();
+    pagedMesh.destroy();
+    watcher.destroy();
+
+    // Destroy window or headless context
+    if (window != nullptr)
+        glfwDestroyWindow(window);
+    
+    headlessContext.destroy();
 
     // Deinitialize GLFW
     glfwTerminate();
@@ -0,0 +1,150 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : address(nullptr), length(0), opened(false) {
+#ifdef _WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string & filename) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+        filename.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    length = (size_t)fileSize.QuadPart;
+    opened = true;
+
+    // Empty files cannot be mapped
+    if (length == 0)
+        return true;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+
+    mappingHandle = mapping;
+    address = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (address == nullptr) {
+        close();
+        return false;
+    }
+#else
+    int file = ::open(filename.c_str(), O_RDONLY);
+
+    if (file < 0)
+        return false;
+
+    struct stat status;
+
+    if (fstat(file, &status) != 0) {
+        ::close(file);
+        return false;
+    }
+
+    length = (size_t)status.st_size;
+    opened = true;
+
+    // Empty files cannot be mapped
+    if (length == 0) {
+        ::close(file);
+        return true;
+    }
+
+    void * mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+
+    // The mapping keeps its own reference to the file
+    ::close(file);
+
+    if (mapping == MAP_FAILED) {
+        length = 0;
+        opened = false;
+
+        return false;
+    }
+
+    // Contents are usually consumed once, front to back, by several threads
+    madvise(mapping, length, MADV_WILLNEED);
+
+    address = (const char *)mapping;
+#endif
+
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (address != nullptr)
+        UnmapViewOfFile(address);
+
+    if (mappingHandle != nullptr)
+        CloseHandle((HANDLE)mappingHandle);
+
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle((HANDLE)fileHandle);
+
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#else
+    if (address != nullptr)
+        munmap((void *)address, length);
+#endif
+
+    address = nullptr;
+    length = 0;
+    opened = false;
+}
+
+bool MappedFile::isOpen() const {
+    return opened;
+}
+
+const char * MappedFile::data() const {
+    return address;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Map file contents to memory, replacing the current mapping
+    bool open(const std::string & filename);
+
+    // Unmap file contents
+    void close();
+
+    bool isOpen() const;
+
+    const char * data() const;
+    size_t size() const;
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile & operator=(const MappedFile &);
+
+    const char * address;
+    size_t length;
+    bool opened;
+
+#ifdef _WIN32
+    void * fileHandle;
+    void * mappingHandle;
+#endif
+};
+
+#endif
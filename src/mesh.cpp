@@ -0,0 +1,746 @@
+#include "mesh.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/packing.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// Attribute index triple identifying a vertex
+struct VertexKey {
+    uint32_t position;
+    uint32_t normal;
+    uint32_t textureCoordinate;
+
+    bool operator==(const VertexKey & key) const {
+        return position == key.position &&
+            normal == key.normal &&
+            textureCoordinate == key.textureCoordinate;
+    }
+};
+
+const uint32_t EMPTY_SLOT = 0xffffffffu;
+
+// Alignment in bytes of the arrays inside a triangle mesh arena
+const size_t ARENA_ALIGNMENT = 16;
+
+inline size_t alignArena(size_t bytes) {
+    return (bytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+inline uint64_t hashKey(const VertexKey & key) {
+    uint64_t hash = key.position * 0x9e3779b97f4a7c15ull;
+    hash ^= key.normal * 0xc2b2ae3d27d4eb4full + (hash >> 29);
+    hash ^= key.textureCoordinate * 0x165667b19e3779f9ull + (hash >> 32);
+
+    return hash ^ (hash >> 31);
+}
+
+// Open addressing hash table from vertex key to vertex index
+class VertexTable {
+public:
+    explicit VertexTable(size_t capacity) {
+        size_t size = 16;
+
+        // Keep load factor under one half
+        while (size < capacity * 2)
+            size <<= 1;
+
+        slots.assign(size, EMPTY_SLOT);
+        mask = size - 1;
+
+        keys.reserve(capacity);
+    }
+
+    // Find vertex index of key, inserting it with the next index if absent
+    uint32_t insert(const VertexKey & key, bool & inserted) {
+        size_t slot = hashKey(key) & mask;
+
+        for (;;) {
+            uint32_t index = slots[slot];
+
+            if (index == EMPTY_SLOT) {
+                index = (uint32_t)keys.size();
+
+                slots[slot] = index;
+                keys.push_back(key);
+                inserted = true;
+
+                return index;
+            }
+
+            if (keys[index] == key) {
+                inserted = false;
+                return index;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+    }
+
+private:
+    std::vector<uint32_t> slots;
+    std::vector<VertexKey> keys;
+    size_t mask;
+};
+
+// Maximum magnitude of signed normalized integers with the given bit count
+inline float snormScale(int bits) {
+    return (float)((1 << (bits - 1)) - 1);
+}
+
+// Octahedral projection of a unit vector to [-1, 1]^2
+glm::vec2 encodeOctahedral(const glm::vec3 & normal) {
+    glm::vec3 n = normal / (std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z));
+
+    if (n.z >= 0.0f)
+        return glm::vec2(n.x, n.y);
+
+    return glm::vec2(
+        (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+        (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+// Unit vector of an octahedral projection, as decoded by the vertex shader
+glm::vec3 decodeOctahedral(const glm::vec2 & encoded) {
+    glm::vec3 n(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+    float t = std::max(-n.z, 0.0f);
+
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+
+    return glm::normalize(n);
+}
+
+// Quantize octahedral normal to signed integers, choosing the rounding of
+// each component that minimizes the angular error
+glm::ivec2 quantizeOctahedral(const glm::vec3 & normal, int bits) {
+    float scale = snormScale(bits);
+    glm::vec2 encoded = encodeOctahedral(normal) * scale;
+
+    glm::ivec2 best(0);
+    float bestDot = -2.0f;
+
+    for (int i = 0; i < 4; i++) {
+        glm::ivec2 candidate(
+            (int)((i & 1) ? std::ceil(encoded.x) : std::floor(encoded.x)),
+            (int)((i & 2) ? std::ceil(encoded.y) : std::floor(encoded.y)));
+
+        candidate = glm::clamp(candidate, glm::ivec2(-(int)scale), glm::ivec2((int)scale));
+
+        float d = glm::dot(decodeOctahedral(glm::vec2(candidate) / scale), normal);
+
+        if (d > bestDot) {
+            bestDot = d;
+            best = candidate;
+        }
+    }
+
+    return best;
+}
+
+}
+
+TriangleMesh::TriangleMesh() :
+        arena(nullptr),
+        arenaBytes(0),
+        usedBytes(0) {
+    std::memset(&sizes, 0, sizeof(TriangleMeshCounts));
+    std::memset(offsets, 0, sizeof(offsets));
+}
+
+TriangleMesh::TriangleMesh(TriangleMesh && mesh) :
+        arena(mesh.arena),
+        arenaBytes(mesh.arenaBytes),
+        usedBytes(mesh.usedBytes),
+        sizes(mesh.sizes) {
+    std::memcpy(offsets, mesh.offsets, sizeof(offsets));
+
+    mesh.arena = nullptr;
+    mesh.clear();
+}
+
+TriangleMesh::~TriangleMesh() {
+    clear();
+}
+
+TriangleMesh & TriangleMesh::operator=(TriangleMesh && mesh) {
+    if (this != &mesh) {
+        clear();
+
+        arena = mesh.arena;
+        arenaBytes = mesh.arenaBytes;
+        usedBytes = mesh.usedBytes;
+        sizes = mesh.sizes;
+        std::memcpy(offsets, mesh.offsets, sizeof(offsets));
+
+        mesh.arena = nullptr;
+        mesh.clear();
+    }
+
+    return *this;
+}
+
+void TriangleMesh::allocate(const TriangleMeshCounts & counts) {
+    const size_t lengths[6] = {
+        counts.positions * sizeof(glm::vec3),
+        counts.normals * sizeof(glm::vec3),
+        counts.textureCoordinates * sizeof(glm::vec2),
+        counts.positionIndices * sizeof(uint32_t),
+        counts.normalIndices * sizeof(uint32_t),
+        counts.textureCoordinateIndices * sizeof(uint32_t)
+    };
+
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < 6; i++) {
+        offsets[i] = bytes;
+        bytes += alignArena(lengths[i]);
+    }
+
+    if (bytes > arenaBytes) {
+        delete[] arena;
+
+        arena = new unsigned char[bytes];
+        arenaBytes = bytes;
+    }
+
+    sizes = counts;
+    usedBytes = bytes;
+}
+
+void TriangleMesh::truncate(const TriangleMeshCounts & counts) {
+    sizes.positions = std::min(sizes.positions, counts.positions);
+    sizes.normals = std::min(sizes.normals, counts.normals);
+    sizes.textureCoordinates = std::min(sizes.textureCoordinates, counts.textureCoordinates);
+    sizes.positionIndices = std::min(sizes.positionIndices, counts.positionIndices);
+    sizes.normalIndices = std::min(sizes.normalIndices, counts.normalIndices);
+    sizes.textureCoordinateIndices = std::min(sizes.textureCoordinateIndices, counts.textureCoordinateIndices);
+}
+
+void TriangleMesh::setNormals(
+        const std::vector<glm::vec3> & normals,
+        const std::vector<uint32_t> & normalIndices) {
+    TriangleMeshCounts counts = sizes;
+    counts.normals = normals.size();
+    counts.normalIndices = normalIndices.size();
+
+    TriangleMesh mesh;
+    mesh.allocate(counts);
+
+    std::copy(positions(), positions() + sizes.positions, mesh.positions());
+    std::copy(normals.begin(), normals.end(), mesh.normals());
+    std::copy(textureCoordinates(), textureCoordinates() + sizes.textureCoordinates, mesh.textureCoordinates());
+    std::copy(positionIndices(), positionIndices() + sizes.positionIndices, mesh.positionIndices());
+    std::copy(normalIndices.begin(), normalIndices.end(), mesh.normalIndices());
+    std::copy(
+        textureCoordinateIndices(),
+        textureCoordinateIndices() + sizes.textureCoordinateIndices,
+        mesh.textureCoordinateIndices());
+
+    *this = std::move(mesh);
+}
+
+void TriangleMesh::clear() {
+    delete[] arena;
+
+    arena = nullptr;
+    arenaBytes = 0;
+    usedBytes = 0;
+
+    std::memset(&sizes, 0, sizeof(TriangleMeshCounts));
+    std::memset(offsets, 0, sizeof(offsets));
+}
+
+const TriangleMeshCounts & TriangleMesh::counts() const {
+    return sizes;
+}
+
+size_t TriangleMesh::triangleCount() const {
+    return sizes.positionIndices / 3;
+}
+
+size_t TriangleMesh::bytes() const {
+    return usedBytes;
+}
+
+size_t TriangleMesh::capacity() const {
+    return arenaBytes;
+}
+
+glm::vec3 * TriangleMesh::positions() {
+    return (glm::vec3 *)(arena + offsets[0]);
+}
+
+glm::vec3 * TriangleMesh::normals() {
+    return (glm::vec3 *)(arena + offsets[1]);
+}
+
+glm::vec2 * TriangleMesh::textureCoordinates() {
+    return (glm::vec2 *)(arena + offsets[2]);
+}
+
+uint32_t * TriangleMesh::positionIndices() {
+    return (uint32_t *)(arena + offsets[3]);
+}
+
+uint32_t * TriangleMesh::normalIndices() {
+    return (uint32_t *)(arena + offsets[4]);
+}
+
+uint32_t * TriangleMesh::textureCoordinateIndices() {
+    return (uint32_t *)(arena + offsets[5]);
+}
+
+const glm::vec3 * TriangleMesh::positions() const {
+    return (const glm::vec3 *)(arena + offsets[0]);
+}
+
+const glm::vec3 * TriangleMesh::normals() const {
+    return (const glm::vec3 *)(arena + offsets[1]);
+}
+
+const glm::vec2 * TriangleMesh::textureCoordinates() const {
+    return (const glm::vec2 *)(arena + offsets[2]);
+}
+
+const uint32_t * TriangleMesh::positionIndices() const {
+    return (const uint32_t *)(arena + offsets[3]);
+}
+
+const uint32_t * TriangleMesh::normalIndices() const {
+    return (const uint32_t *)(arena + offsets[4]);
+}
+
+const uint32_t * TriangleMesh::textureCoordinateIndices() const {
+    return (const uint32_t *)(arena + offsets[5]);
+}
+
+size_t vectorMeshBytes(const TriangleMeshCounts & counts) {
+    return counts.positions * sizeof(glm::vec3) +
+        counts.normals * sizeof(glm::vec3) +
+        counts.textureCoordinates * sizeof(glm::vec2) +
+        (counts.positionIndices + counts.normalIndices + counts.textureCoordinateIndices) * sizeof(size_t);
+}
+
+bool buildIndexedMesh(const TriangleMesh & triangles, IndexedMesh & mesh) {
+    const TriangleMeshCounts & counts = triangles.counts();
+
+    const glm::vec3 * positions = triangles.positions();
+    const glm::vec3 * normals = triangles.normals();
+    const glm::vec2 * textureCoordinates = triangles.textureCoordinates();
+    const uint32_t * positionIndices = triangles.positionIndices();
+    const uint32_t * normalIndices = triangles.normalIndices();
+    const uint32_t * textureCoordinateIndices = triangles.textureCoordinateIndices();
+
+    bool hasTextureCoordinates = counts.textureCoordinateIndices > 0;
+
+    size_t triangleCount = triangles.triangleCount();
+
+    mesh.cornerCount = triangleCount * 3;
+    mesh.hasTextureCoordinates = hasTextureCoordinates;
+    mesh.vertices.clear();
+    mesh.tangents.clear();
+    mesh.lods.clear();
+    mesh.meshlets.clear();
+    mesh.indices.clear();
+
+    // Normal indices are required and texture coordinate indices optional,
+    // one per corner either way
+    if (counts.normalIndices != counts.positionIndices ||
+            (hasTextureCoordinates && counts.textureCoordinateIndices != counts.positionIndices))
+        return false;
+
+    mesh.indices.resize(mesh.cornerCount);
+
+    VertexTable table(mesh.cornerCount);
+
+    for (size_t i = 0; i < triangleCount; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            size_t corner = i * 3 + j;
+
+            VertexKey key;
+            key.position = positionIndices[corner];
+            key.normal = normalIndices[corner];
+            key.textureCoordinate = hasTextureCoordinates ?
+                textureCoordinateIndices[corner] : 0;
+
+            if (key.position >= counts.positions || key.normal >= counts.normals ||
+                    (hasTextureCoordinates && key.textureCoordinate >= counts.textureCoordinates)) {
+                mesh.vertices.clear();
+                mesh.indices.clear();
+                return false;
+            }
+
+            bool inserted;
+            uint32_t index = table.insert(key, inserted);
+
+            if (inserted) {
+                Vertex vertex;
+                vertex.position = positions[key.position];
+                vertex.normal = normals[key.normal];
+
+                if (hasTextureCoordinates)
+                    vertex.textureCoordinate = textureCoordinates[key.textureCoordinate];
+                else
+                    vertex.textureCoordinate = glm::vec2(0.0f);
+
+                mesh.vertices.push_back(vertex);
+            }
+
+            mesh.indices[corner] = index;
+        }
+    }
+
+    return true;
+}
+
+size_t indexSize(size_t vertexCount) {
+    return vertexCount <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void packIndices(
+        const std::vector<uint32_t> & indices,
+        size_t size,
+        std::vector<unsigned char> & data) {
+    data.resize(indices.size() * size);
+
+    if (size == sizeof(uint32_t)) {
+        if (!indices.empty())
+            std::memcpy(data.data(), indices.data(), data.size());
+
+        return;
+    }
+
+    uint16_t * packed = (uint16_t *)data.data();
+
+    for (size_t i = 0; i < indices.size(); i++)
+        packed[i] = (uint16_t)indices[i];
+}
+
+bool parseVertexFormat(const std::string & name, VertexFormat & format) {
+    if (name == "float")
+        format = VERTEX_FORMAT_FLOAT;
+    else if (name == "compact")
+        format = VERTEX_FORMAT_COMPACT;
+    else if (name == "compact10")
+        format = VERTEX_FORMAT_COMPACT_10;
+    else
+        return false;
+
+    return true;
+}
+
+const char * vertexFormatName(VertexFormat format) {
+    switch (format) {
+        case VERTEX_FORMAT_COMPACT:
+            return "compact";
+        case VERTEX_FORMAT_COMPACT_10:
+            return "compact10";
+        default:
+            return "float";
+    }
+}
+
+bool parseNormalWeighting(const std::string & name, NormalWeighting & weighting) {
+    if (name == "area")
+        weighting = NORMAL_WEIGHTING_AREA;
+    else if (name == "angle")
+        weighting = NORMAL_WEIGHTING_ANGLE;
+    else
+        return false;
+
+    return true;
+}
+
+const char * normalWeightingName(NormalWeighting weighting) {
+    return weighting == NORMAL_WEIGHTING_AREA ? "area" : "angle";
+}
+
+VertexLayout vertexLayout(VertexFormat format, bool hasTextureCoordinates, bool hasTangents) {
+    VertexLayout layout;
+    layout.format = format;
+    layout.hasTextureCoordinates = format == VERTEX_FORMAT_FLOAT || hasTextureCoordinates;
+    layout.hasTangents = hasTangents;
+    layout.positionOffset = glm::vec3(0.0f);
+    layout.positionScale = glm::vec3(1.0f);
+
+    size_t * offsets = layout.attributeOffsets;
+
+    if (format == VERTEX_FORMAT_FLOAT) {
+        // Vertex structure followed by the tangent
+        offsets[VERTEX_ATTRIBUTE_POSITION] = offsetof(Vertex, position);
+        offsets[VERTEX_ATTRIBUTE_NORMAL] = offsetof(Vertex, normal);
+        offsets[VERTEX_ATTRIBUTE_TEXTURE_COORDINATE] = offsetof(Vertex, textureCoordinate);
+        offsets[VERTEX_ATTRIBUTE_TANGENT] = sizeof(Vertex);
+
+        layout.stride = sizeof(Vertex) + (hasTangents ? sizeof(glm::vec4) : 0);
+
+        return layout;
+    }
+
+    // Padded position, normal, optional tangent and texture coordinate
+    size_t stride = 0;
+
+    offsets[VERTEX_ATTRIBUTE_POSITION] = stride;
+    stride += 4 * sizeof(uint16_t);
+
+    offsets[VERTEX_ATTRIBUTE_NORMAL] = stride;
+    stride += sizeof(uint32_t);
+
+    offsets[VERTEX_ATTRIBUTE_TANGENT] = stride;
+    stride += hasTangents ? sizeof(uint32_t) : 0;
+
+    offsets[VERTEX_ATTRIBUTE_TEXTURE_COORDINATE] = stride;
+    stride += hasTextureCoordinates ? sizeof(uint32_t) : 0;
+
+    layout.stride = stride;
+
+    return layout;
+}
+
+void packVertices(
+        const IndexedMesh & mesh,
+        VertexFormat format,
+        std::vector<unsigned char> & data,
+        VertexLayout & layout,
+        VertexError * error) {
+    const std::vector<Vertex> & vertices = mesh.vertices;
+    const std::vector<glm::vec4> & tangents = mesh.tangents;
+
+    bool hasTangents = !tangents.empty();
+
+    layout = vertexLayout(format, mesh.hasTextureCoordinates, hasTangents);
+
+    const size_t * offsets = layout.attributeOffsets;
+
+    if (error != nullptr)
+        std::memset(error, 0, sizeof(VertexError));
+
+    data.resize(vertices.size() * layout.stride);
+
+    if (format == VERTEX_FORMAT_FLOAT) {
+        if (!hasTangents) {
+            if (!vertices.empty())
+                std::memcpy(data.data(), vertices.data(), data.size());
+
+            return;
+        }
+
+        for (size_t i = 0; i < vertices.size(); i++) {
+            unsigned char * packed = data.data() + i * layout.stride;
+
+            std::memcpy(packed, &vertices[i], sizeof(Vertex));
+            std::memcpy(packed + offsets[VERTEX_ATTRIBUTE_TANGENT], &tangents[i], sizeof(glm::vec4));
+        }
+
+        return;
+    }
+
+    // Quantize positions relative to the bounding box
+    glm::vec3 minimum(0.0f), maximum(0.0f);
+
+    if (!vertices.empty()) {
+        minimum = maximum = vertices[0].position;
+
+        for (size_t i = 1; i < vertices.size(); i++) {
+            minimum = glm::min(minimum, vertices[i].position);
+            maximum = glm::max(maximum, vertices[i].position);
+        }
+    }
+
+    glm::vec3 extent = maximum - minimum;
+
+    layout.positionOffset = minimum;
+    layout.positionScale = extent;
+
+    int normalBits = format == VERTEX_FORMAT_COMPACT ? 16 : 10;
+    float normalScale = snormScale(normalBits);
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex & vertex = vertices[i];
+        unsigned char * packed = data.data() + i * layout.stride;
+
+        // Position as 16 bit unsigned normalized integers
+        uint16_t position[4] = { 0, 0, 0, 0 };
+
+        for (int j = 0; j < 3; j++)
+            if (extent[j] > 0.0f)
+                position[j] = (uint16_t)std::floor(
+                    glm::clamp((vertex.position[j] - minimum[j]) / extent[j], 0.0f, 1.0f) *
+                    65535.0f + 0.5f);
+
+        std::memcpy(packed + offsets[VERTEX_ATTRIBUTE_POSITION], position, sizeof(position));
+
+        // Normal as octahedral signed normalized integers
+        glm::vec3 normal = glm::normalize(vertex.normal);
+        glm::ivec2 octahedral = quantizeOctahedral(normal, normalBits);
+        uint32_t packedNormal;
+
+        if (format == VERTEX_FORMAT_COMPACT)
+            packedNormal = (uint32_t)(uint16_t)octahedral.x |
+                ((uint32_t)(uint16_t)octahedral.y << 16);
+        else
+            packedNormal = ((uint32_t)octahedral.x & 0x3ffu) |
+                (((uint32_t)octahedral.y & 0x3ffu) << 10);
+
+        std::memcpy(packed + offsets[VERTEX_ATTRIBUTE_NORMAL], &packedNormal, sizeof(packedNormal));
+
+        // Tangent as octahedral 10 bit and bitangent sign as 2 bit signed normalized integers
+        glm::vec3 tangent(0.0f, 0.0f, 1.0f);
+        glm::ivec2 octahedralTangent(0);
+
+        if (hasTangents) {
+            tangent = glm::normalize(glm::vec3(tangents[i]));
+            octahedralTangent = quantizeOctahedral(tangent, 10);
+
+            uint32_t packedTangent = ((uint32_t)octahedralTangent.x & 0x3ffu) |
+                (((uint32_t)octahedralTangent.y & 0x3ffu) << 10) |
+                ((tangents[i].w < 0.0f ? 3u : 1u) << 30);
+
+            std::memcpy(packed + offsets[VERTEX_ATTRIBUTE_TANGENT], &packedTangent, sizeof(packedTangent));
+        }
+
+        // Texture coordinate as half floats
+        uint32_t packedTextureCoordinate = glm::packHalf2x16(vertex.textureCoordinate);
+
+        if (layout.hasTextureCoordinates)
+            std::memcpy(
+                packed + offsets[VERTEX_ATTRIBUTE_TEXTURE_COORDINATE],
+                &packedTextureCoordinate,
+                sizeof(packedTextureCoordinate));
+
+        if (error == nullptr)
+            continue;
+
+        // Measure error of the values decoded by the vertex shader
+        glm::vec3 decodedPosition = minimum + glm::vec3(
+            position[0], position[1], position[2]) / 65535.0f * extent;
+
+        error->position = std::max(
+            error->position, glm::length(decodedPosition - vertex.position));
+
+        glm::vec3 decodedNormal = decodeOctahedral(glm::vec2(octahedral) / normalScale);
+        float angle = std::acos(glm::clamp(glm::dot(decodedNormal, normal), -1.0f, 1.0f));
+
+        error->normalAngle = std::max(error->normalAngle, glm::degrees(angle));
+
+        if (hasTangents) {
+            glm::vec3 decodedTangent = decodeOctahedral(glm::vec2(octahedralTangent) / snormScale(10));
+            float tangentAngle = std::acos(glm::clamp(glm::dot(decodedTangent, tangent), -1.0f, 1.0f));
+
+            error->tangentAngle = std::max(error->tangentAngle, glm::degrees(tangentAngle));
+        }
+
+        if (layout.hasTextureCoordinates) {
+            glm::vec2 difference = glm::abs(
+                glm::unpackHalf2x16(packedTextureCoordinate) - vertex.textureCoordinate);
+
+            error->textureCoordinate = std::max(
+                error->textureCoordinate, std::max(difference.x, difference.y));
+        }
+    }
+
+    if (error != nullptr) {
+        float diagonal = glm::length(extent);
+        error->relativePosition = diagonal > 0.0f ? error->position / diagonal : 0.0f;
+    }
+}
+
+void unpackPositions(
+        const void * vertices,
+        size_t vertexCount,
+        const VertexLayout & layout,
+        std::vector<glm::vec3> & positions) {
+    const unsigned char * data = (const unsigned char *)vertices;
+    size_t offset = layout.attributeOffsets[VERTEX_ATTRIBUTE_POSITION];
+
+    positions.resize(vertexCount);
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        const unsigned char * packed = data + i * layout.stride + offset;
+
+        if (layout.format == VERTEX_FORMAT_FLOAT) {
+            std::memcpy(&positions[i], packed, sizeof(glm::vec3));
+            continue;
+        }
+
+        uint16_t position[3];
+        std::memcpy(position, packed, sizeof(position));
+
+        positions[i] = layout.positionOffset + glm::vec3(
+            position[0], position[1], position[2]) / 65535.0f * layout.positionScale;
+    }
+}
+
+void unpackIndices(
+        const void * indices,
+        size_t count,
+        size_t size,
+        std::vector<uint32_t> & result) {
+    result.resize(count);
+
+    for (size_t i = 0; i < count; i++)
+        if (size == sizeof(uint16_t))
+            result[i] = ((const uint16_t *)indices)[i];
+        else
+            result[i] = ((const uint32_t *)indices)[i];
+}
+
+void computeBoundingSphere(const std::vector<Vertex> & vertices, glm::vec3 & center, float & radius) {
+    center = glm::vec3(0.0f);
+    radius = 0.0f;
+
+    if (vertices.empty())
+        return;
+
+    // Center of the bounding box
+    glm::vec3 minimum = vertices[0].position;
+    glm::vec3 maximum = vertices[0].position;
+
+    for (size_t i = 1; i < vertices.size(); i++) {
+        minimum = glm::min(minimum, vertices[i].position);
+        maximum = glm::max(maximum, vertices[i].position);
+    }
+
+    center = (minimum + maximum) * 0.5f;
+
+    for (size_t i = 0; i < vertices.size(); i++)
+        radius = std::max(radius, glm::length(vertices[i].position - center));
+}
+
+void packMesh(
+        const IndexedMesh & mesh,
+        VertexFormat format,
+        PackedMesh & packed,
+        VertexError * error) {
+    packVertices(mesh, format, packed.vertices, packed.layout, error);
+
+    packed.vertexCount = mesh.vertices.size();
+    packed.indexCount = mesh.indices.size();
+    packed.indexSize = indexSize(mesh.vertices.size());
+
+    packIndices(mesh.indices, packed.indexSize, packed.indices);
+
+    packed.lods = mesh.lods;
+
+    if (packed.lods.empty()) {
+        MeshLod lod;
+        lod.indexOffset = 0;
+        lod.indexCount = mesh.indices.size();
+        lod.error = 0.0f;
+
+        packed.lods.push_back(lod);
+    }
+
+    packed.meshlets = mesh.meshlets;
+
+    computeBoundingSphere(mesh.vertices, packed.center, packed.radius);
+}
@@ -0,0 +1,314 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Interleaved vertex attributes
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 textureCoordinate;
+};
+
+// Level of detail as a range of the index list
+// Error is the distance in mesh units between the level and the full mesh.
+struct MeshLod {
+    size_t indexOffset;
+    size_t indexCount;
+    float error;
+};
+
+// Cluster of neighboring triangles drawn as a range of the index list
+// The normal cone is given by its axis and cutoff, the sine of the largest
+// angle between the axis and a triangle normal, 1 when the cone is too wide
+// to ever be backfacing.
+struct Meshlet {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+
+    float center[3];
+    float radius;
+
+    float coneAxis[3];
+    float coneCutoff;
+};
+
+// Triangle mesh with unique vertices referenced by an index list
+struct IndexedMesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    // Tangent with bitangent sign in w of every vertex, empty when not generated
+    std::vector<glm::vec4> tangents;
+
+    // Levels of detail from the finest, stored one after the other in the
+    // index list, empty when the index list is a single level
+    std::vector<MeshLod> lods;
+
+    // Meshlets partitioning the finest level, empty when not generated
+    std::vector<Meshlet> meshlets;
+
+    // Number of face corners before vertex deduplication
+    size_t cornerCount;
+
+    // Texture coordinates were read instead of calculated by primitive
+    bool hasTextureCoordinates;
+};
+
+// Attribute and index counts of a triangle mesh
+struct TriangleMeshCounts {
+    size_t positions;
+    size_t normals;
+    size_t textureCoordinates;
+    size_t positionIndices;
+    size_t normalIndices;
+    size_t textureCoordinateIndices;
+};
+
+// Triangle mesh as read from Wavefront OBJ files: attribute arrays and one
+// 32 bit index array per attribute with an index per face corner
+// Normal and texture coordinate indices are either absent or one per corner.
+// Every array is carved out of a single arena laid out from counts known in
+// advance, so a mesh is allocated once. Meshes are move only, handed from
+// the reader to the processing stages without copies.
+class TriangleMesh {
+public:
+    TriangleMesh();
+    TriangleMesh(TriangleMesh && mesh);
+    ~TriangleMesh();
+
+    TriangleMesh & operator=(TriangleMesh && mesh);
+
+    // Lay out arrays of the given counts with undefined contents, reusing
+    // the arena when large enough
+    void allocate(const TriangleMeshCounts & counts);
+
+    // Reduce counts keeping arrays in place
+    void truncate(const TriangleMeshCounts & counts);
+
+    // Replace normals and normal indices, moving the other arrays to a new arena
+    void setNormals(const std::vector<glm::vec3> & normals, const std::vector<uint32_t> & normalIndices);
+
+    // Release the arena
+    void clear();
+
+    const TriangleMeshCounts & counts() const;
+    size_t triangleCount() const;
+
+    // Bytes of the arrays and of the arena holding them
+    size_t bytes() const;
+    size_t capacity() const;
+
+    glm::vec3 * positions();
+    glm::vec3 * normals();
+    glm::vec2 * textureCoordinates();
+    uint32_t * positionIndices();
+    uint32_t * normalIndices();
+    uint32_t * textureCoordinateIndices();
+
+    const glm::vec3 * positions() const;
+    const glm::vec3 * normals() const;
+    const glm::vec2 * textureCoordinates() const;
+    const uint32_t * positionIndices() const;
+    const uint32_t * normalIndices() const;
+    const uint32_t * textureCoordinateIndices() const;
+
+private:
+    TriangleMesh(const TriangleMesh &);
+    TriangleMesh & operator=(const TriangleMesh &);
+
+    unsigned char * arena;
+    size_t arenaBytes;
+    size_t usedBytes;
+
+    TriangleMeshCounts sizes;
+
+    // Byte offsets of the arrays inside the arena, in member order of the counts
+    size_t offsets[6];
+};
+
+// Bytes of a triangle mesh of the given counts held in separate vectors
+// with size_t indices, for comparison with the arena
+size_t vectorMeshBytes(const TriangleMeshCounts & counts);
+
+// Build indexed mesh from a triangle mesh
+// The triangle mesh must already have normal indices, generated when the
+// file has none. Every unique (position, normal, texture coordinate) index
+// triple becomes one vertex, so corners sharing a normal are deduplicated
+// like any other, while missing texture coordinates are zero and do not
+// prevent sharing. Returns false with an empty mesh when normal indices are
+// missing on some corners or an index addresses no attribute.
+bool buildIndexedMesh(const TriangleMesh & triangles, IndexedMesh & mesh);
+
+// Smallest index size in bytes able to address the vertex count (2 or 4)
+size_t indexSize(size_t vertexCount);
+
+// Pack indices with the given index size in bytes
+void packIndices(
+        const std::vector<uint32_t> & indices,
+        size_t size,
+        std::vector<unsigned char> & data);
+
+// Attribute encodings of GPU vertex buffers
+// VERTEX_FORMAT_FLOAT: 32 bit float position, normal and texture coordinate
+// VERTEX_FORMAT_COMPACT: 16 bit normalized position relative to the mesh
+// bounds, octahedral normal in 2x16 bit snorm, half float texture coordinate
+// VERTEX_FORMAT_COMPACT_10: as compact with the octahedral normal in the
+// two low 10 bit fields of a 2_10_10_10 signed normalized integer
+// Compact formats omit calculated texture coordinates. Tangents are 32 bit
+// floats, or an octahedral direction in the two low 10 bit fields of a
+// 2_10_10_10 signed normalized integer with the bitangent sign in the 2 bit
+// field in compact formats.
+enum VertexFormat {
+    VERTEX_FORMAT_FLOAT = 0,
+    VERTEX_FORMAT_COMPACT = 1,
+    VERTEX_FORMAT_COMPACT_10 = 2
+};
+
+// Vertex attributes by shader program location
+enum VertexAttribute {
+    VERTEX_ATTRIBUTE_POSITION = 0,
+    VERTEX_ATTRIBUTE_NORMAL = 1,
+    VERTEX_ATTRIBUTE_TEXTURE_COORDINATE = 2,
+    VERTEX_ATTRIBUTE_TANGENT = 3,
+    VERTEX_ATTRIBUTE_COUNT = 4
+};
+
+// Layout of a packed vertex buffer
+struct VertexLayout {
+    VertexFormat format;
+    bool hasTextureCoordinates;
+    bool hasTangents;
+    size_t stride;
+
+    // Byte offset of every attribute inside a vertex
+    size_t attributeOffsets[VERTEX_ATTRIBUTE_COUNT];
+
+    // Quantized positions map to positionOffset + position * positionScale
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+};
+
+// Worst case error of a packed vertex buffer against full precision
+struct VertexError {
+    // Distance in object space and relative to the bounding box diagonal
+    float position;
+    float relativePosition;
+
+    // Angle between normals in degrees
+    float normalAngle;
+
+    // Absolute texture coordinate difference
+    float textureCoordinate;
+
+    // Angle between tangents in degrees
+    float tangentAngle;
+};
+
+// GPU ready vertex and index buffers of a mesh
+struct PackedMesh {
+    VertexLayout layout;
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices;
+
+    size_t vertexCount;
+    size_t indexCount;
+
+    // Index size in bytes (2 or 4)
+    size_t indexSize;
+
+    // Levels of detail, at least the full index list
+    std::vector<MeshLod> lods;
+
+    // Meshlets partitioning the finest level, empty when not generated
+    std::vector<Meshlet> meshlets;
+
+    // Bounding sphere in mesh units
+    glm::vec3 center;
+    float radius;
+};
+
+// Weighting of face normals accumulated into smooth vertex normals
+enum NormalWeighting {
+    NORMAL_WEIGHTING_AREA = 0,
+    NORMAL_WEIGHTING_ANGLE = 1
+};
+
+// Processing of a mesh between reading and uploading
+struct MeshOptions {
+    VertexFormat vertexFormat;
+
+    // Reorder triangles and vertices for vertex cache and fetch locality, and
+    // optionally clusters of triangles for less overdraw
+    bool optimize;
+    bool optimizeOverdraw;
+
+    // Smooth normal generation of meshes without normals, faces meeting at
+    // more than the crease angle in degrees keep separate normals
+    NormalWeighting normalWeighting;
+    float creaseAngle;
+
+    // Generate tangents of meshes with texture coordinates
+    bool generateTangents;
+
+    // Generate simplified levels of detail
+    bool generateLods;
+
+    // Partition the finest level into meshlets for culling
+    bool generateMeshlets;
+};
+
+// Parse vertex format name (float, compact or compact10)
+bool parseVertexFormat(const std::string & name, VertexFormat & format);
+
+// Name of vertex format
+const char * vertexFormatName(VertexFormat format);
+
+// Parse normal weighting name (area or angle)
+bool parseNormalWeighting(const std::string & name, NormalWeighting & weighting);
+
+// Name of normal weighting
+const char * normalWeightingName(NormalWeighting weighting);
+
+// Stride and attribute offsets of a format without position dequantization
+VertexLayout vertexLayout(VertexFormat format, bool hasTextureCoordinates, bool hasTangents);
+
+// Pack mesh vertices in the given format, measuring encoding error when requested
+void packVertices(
+        const IndexedMesh & mesh,
+        VertexFormat format,
+        std::vector<unsigned char> & data,
+        VertexLayout & layout,
+        VertexError * error = nullptr);
+
+// Unpack vertex positions of a packed vertex buffer to mesh units
+void unpackPositions(
+        const void * vertices,
+        size_t vertexCount,
+        const VertexLayout & layout,
+        std::vector<glm::vec3> & positions);
+
+// Unpack indices with the given index size in bytes
+void unpackIndices(
+        const void * indices,
+        size_t count,
+        size_t size,
+        std::vector<uint32_t> & result);
+
+// Bounding sphere of mesh vertices
+void computeBoundingSphere(const std::vector<Vertex> & vertices, glm::vec3 & center, float & radius);
+
+// Pack mesh vertices in the given format and indices with the smallest size
+void packMesh(
+        const IndexedMesh & mesh,
+        VertexFormat format,
+        PackedMesh & packed,
+        VertexError * error = nullptr);
+
+#endif
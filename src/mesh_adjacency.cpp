@@ -0,0 +1,86 @@
+#include "mesh_adjacency.h"
+
+#include <cstring>
+
+namespace {
+
+const uint32_t INVALID_INDEX = 0xffffffffu;
+
+// Open addressing hash table from position to the first vertex with it
+class PositionTable {
+public:
+    explicit PositionTable(size_t capacity) {
+        size_t size = 16;
+
+        while (size < capacity * 2)
+            size <<= 1;
+
+        slots.assign(size, INVALID_INDEX);
+        mask = size - 1;
+    }
+
+    uint32_t insert(const std::vector<Vertex> & vertices, uint32_t vertex) {
+        const glm::vec3 & position = vertices[vertex].position;
+        size_t slot = hashPosition(position) & mask;
+
+        for (;;) {
+            uint32_t index = slots[slot];
+
+            if (index == INVALID_INDEX) {
+                slots[slot] = vertex;
+                return vertex;
+            }
+
+            if (vertices[index].position == position)
+                return index;
+
+            slot = (slot + 1) & mask;
+        }
+    }
+
+private:
+    static uint64_t hashPosition(const glm::vec3 & position) {
+        uint32_t bits[3];
+        std::memcpy(bits, &position, sizeof(bits));
+
+        uint64_t hash = bits[0] * 0x9e3779b97f4a7c15ull;
+        hash ^= bits[1] * 0xc2b2ae3d27d4eb4full + (hash >> 29);
+        hash ^= bits[2] * 0x165667b19e3779f9ull + (hash >> 32);
+
+        return hash ^ (hash >> 31);
+    }
+
+    std::vector<uint32_t> slots;
+    size_t mask;
+};
+
+}
+
+void buildTriangleAdjacency(
+        const std::vector<uint32_t> & indices,
+        size_t indexCount,
+        size_t vertexCount,
+        TriangleAdjacency & adjacency) {
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    adjacency.triangles.resize(indexCount);
+
+    for (size_t i = 0; i < indexCount; i++)
+        adjacency.offsets[indices[i] + 1]++;
+
+    for (size_t i = 0; i < vertexCount; i++)
+        adjacency.offsets[i + 1] += adjacency.offsets[i];
+
+    std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+
+    for (size_t i = 0; i < indexCount; i++)
+        adjacency.triangles[cursors[indices[i]]++] = (uint32_t)(i / 3);
+}
+
+void buildPositionRemap(const std::vector<Vertex> & vertices, std::vector<uint32_t> & remap) {
+    PositionTable table(vertices.size());
+
+    remap.resize(vertices.size());
+
+    for (uint32_t i = 0; i < vertices.size(); i++)
+        remap[i] = table.insert(vertices, i);
+}
@@ -0,0 +1,26 @@
+#ifndef MESH_ADJACENCY_H
+#define MESH_ADJACENCY_H
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Triangles adjacent to every vertex in compressed row format
+struct TriangleAdjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+// Build adjacency of the first index count indices of an index list
+void buildTriangleAdjacency(
+        const std::vector<uint32_t> & indices,
+        size_t indexCount,
+        size_t vertexCount,
+        TriangleAdjacency & adjacency);
+
+// Map every vertex to the first vertex with the same position
+void buildPositionRemap(const std::vector<Vertex> & vertices, std::vector<uint32_t> & remap);
+
+#endif
@@ -0,0 +1,313 @@
+#include "mesh_cache.h"
+
+#include "hash.h"
+
+#include <sys/stat.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const char MAGIC[8] = { 'C', 'G', 'M', 'E', 'S', 'H', '\0', '\0' };
+
+// Size and modification time of a file
+bool fileStatus(const std::string & filename, uint64_t & size, int64_t & time) {
+    struct stat status;
+
+    if (stat(filename.c_str(), &status) != 0)
+        return false;
+
+    size = (uint64_t)status.st_size;
+    time = (int64_t)status.st_mtime;
+
+    return true;
+}
+
+// Content hash of a file
+bool fileHash(const std::string & filename, uint64_t & hash) {
+    MappedFile file;
+
+    if (!file.open(filename))
+        return false;
+
+    hash = hashBytes(file.data(), file.size());
+
+    return true;
+}
+
+inline uint64_t alignOffset(uint64_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+// Write zero padding up to the given offset
+void writePadding(std::ofstream & file, uint64_t offset) {
+    static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+
+    uint64_t position = (uint64_t)file.tellp();
+
+    if (offset > position)
+        file.write(zeros, offset - position);
+}
+
+}
+
+MeshCache::MeshCache() {
+}
+
+bool MeshCache::open(const std::string & sourceFilename, const MeshOptions & options) {
+    close();
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+
+    if (!fileStatus(sourceFilename, sourceSize, sourceTime))
+        return false;
+
+    std::string filename = meshCacheFilename(sourceFilename);
+
+    if (!file.open(filename))
+        return false;
+
+    // Check format
+    const MeshCacheHeader * header = (const MeshCacheHeader *)file.data();
+
+    if (file.size() < sizeof(MeshCacheHeader) ||
+            std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header->version != MESH_CACHE_VERSION ||
+            header->alignment != MESH_CACHE_ALIGNMENT ||
+            header->vertexFormat != (uint32_t)options.vertexFormat ||
+            header->optimized != (uint32_t)options.optimize ||
+            header->optimizedOverdraw != (uint32_t)options.optimizeOverdraw ||
+            header->normalWeighting != (uint32_t)options.normalWeighting ||
+            header->creaseAngle != options.creaseAngle ||
+            header->generateTangents != (uint32_t)options.generateTangents ||
+            header->generateLods != (uint32_t)options.generateLods ||
+            header->generateMeshlets != (uint32_t)options.generateMeshlets ||
+            header->lodCount == 0 ||
+            header->lodCount > MAX_LOD_COUNT ||
+            header->vertexStride != vertexLayout(
+                options.vertexFormat,
+                header->hasTextureCoordinates != 0,
+                header->hasTangents != 0).stride ||
+            header->vertexBytes != (uint64_t)header->vertexCount * header->vertexStride ||
+            header->vertexOffset + header->vertexBytes > file.size() ||
+            (header->indexSize != sizeof(uint16_t) && header->indexSize != sizeof(uint32_t)) ||
+            header->indexBytes != (uint64_t)header->indexCount * header->indexSize ||
+            header->indexOffset + header->indexBytes > file.size() ||
+            header->meshletBytes != header->meshletCount * sizeof(Meshlet) ||
+            header->meshletOffset + header->meshletBytes > file.size()) {
+        close();
+        return false;
+    }
+
+    // Levels of detail must lie within the index blob drawn from
+    for (uint32_t i = 0; i < header->lodCount; i++) {
+        if ((uint64_t)header->lodIndexOffsets[i] + header->lodIndexCounts[i] > header->indexCount) {
+            close();
+            return false;
+        }
+    }
+
+    // Meshlets must lie within the full level of detail they partition
+    const Meshlet * meshlets = (const Meshlet *)(file.data() + header->meshletOffset);
+    uint64_t lodBegin = header->lodIndexOffsets[0];
+    uint64_t lodEnd = lodBegin + header->lodIndexCounts[0];
+
+    for (uint32_t i = 0; i < header->meshletCount; i++) {
+        if (meshlets[i].indexOffset < lodBegin ||
+                (uint64_t)meshlets[i].indexOffset + meshlets[i].indexCount > lodEnd) {
+            close();
+            return false;
+        }
+    }
+
+    // Check source identity, a size change always invalidates the cache
+    if (header->sourceSize != sourceSize) {
+        close();
+        return false;
+    }
+
+    if (header->sourceTime == sourceTime)
+        return true;
+
+    // Touched but possibly unchanged source, compare contents
+    uint64_t sourceHash;
+
+    if (!fileHash(sourceFilename, sourceHash) || sourceHash != header->sourceHash) {
+        close();
+        return false;
+    }
+
+    // Record the new modification time to skip hashing next time
+    std::fstream update(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+
+    if (update.is_open()) {
+        update.seekp(offsetof(MeshCacheHeader, sourceTime));
+        update.write((const char *)&sourceTime, sizeof(sourceTime));
+    }
+
+    return true;
+}
+
+void MeshCache::close() {
+    file.close();
+}
+
+const MeshCacheHeader & MeshCache::header() const {
+    return *(const MeshCacheHeader *)file.data();
+}
+
+VertexLayout MeshCache::layout() const {
+    const MeshCacheHeader & cached = header();
+
+    VertexLayout layout = vertexLayout(
+        (VertexFormat)cached.vertexFormat,
+        cached.hasTextureCoordinates != 0,
+        cached.hasTangents != 0);
+
+    layout.positionOffset = glm::vec3(
+        cached.positionOffset[0], cached.positionOffset[1], cached.positionOffset[2]);
+    layout.positionScale = glm::vec3(
+        cached.positionScale[0], cached.positionScale[1], cached.positionScale[2]);
+
+    return layout;
+}
+
+std::vector<MeshLod> MeshCache::lods() const {
+    const MeshCacheHeader & cached = header();
+
+    std::vector<MeshLod> lods(cached.lodCount);
+
+    for (size_t i = 0; i < lods.size(); i++) {
+        lods[i].indexOffset = cached.lodIndexOffsets[i];
+        lods[i].indexCount = cached.lodIndexCounts[i];
+        lods[i].error = cached.lodErrors[i];
+    }
+
+    return lods;
+}
+
+std::vector<Meshlet> MeshCache::meshlets() const {
+    const MeshCacheHeader & cached = header();
+    const Meshlet * meshlets = (const Meshlet *)(file.data() + cached.meshletOffset);
+
+    return std::vector<Meshlet>(meshlets, meshlets + cached.meshletCount);
+}
+
+const void * MeshCache::vertices() const {
+    return file.data() + header().vertexOffset;
+}
+
+const void * MeshCache::indices() const {
+    return file.data() + header().indexOffset;
+}
+
+std::string meshCacheFilename(const std::string & sourceFilename) {
+    size_t separator = sourceFilename.find_last_of("/\\");
+    size_t extension = sourceFilename.rfind('.');
+
+    if (extension == std::string::npos ||
+            (separator != std::string::npos && extension < separator))
+        return sourceFilename + ".mesh";
+
+    return sourceFilename.substr(0, extension) + ".mesh";
+}
+
+bool writeMeshCache(
+        const std::string & sourceFilename,
+        const MeshOptions & options,
+        const PackedMesh & mesh) {
+    MeshCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.alignment = MESH_CACHE_ALIGNMENT;
+
+    if (!fileStatus(sourceFilename, header.sourceSize, header.sourceTime) ||
+            !fileHash(sourceFilename, header.sourceHash))
+        return false;
+
+    const VertexLayout & layout = mesh.layout;
+
+    header.vertexFormat = (uint32_t)layout.format;
+    header.optimized = (uint32_t)options.optimize;
+    header.optimizedOverdraw = (uint32_t)options.optimizeOverdraw;
+    header.normalWeighting = (uint32_t)options.normalWeighting;
+    header.creaseAngle = options.creaseAngle;
+    header.generateTangents = (uint32_t)options.generateTangents;
+    header.generateLods = (uint32_t)options.generateLods;
+    header.generateMeshlets = (uint32_t)options.generateMeshlets;
+
+    header.vertexStride = (uint32_t)layout.stride;
+    header.hasTextureCoordinates = layout.hasTextureCoordinates;
+    header.hasTangents = layout.hasTangents;
+
+    for (int i = 0; i < 3; i++) {
+        header.positionOffset[i] = layout.positionOffset[i];
+        header.positionScale[i] = layout.positionScale[i];
+    }
+
+    header.vertexCount = (uint32_t)mesh.vertexCount;
+    header.indexSize = (uint32_t)mesh.indexSize;
+    header.indexCount = (uint32_t)mesh.indexCount;
+
+    if (mesh.lods.empty() || mesh.lods.size() > MAX_LOD_COUNT)
+        return false;
+
+    header.lodCount = (uint32_t)mesh.lods.size();
+
+    for (size_t i = 0; i < mesh.lods.size(); i++) {
+        header.lodIndexOffsets[i] = (uint32_t)mesh.lods[i].indexOffset;
+        header.lodIndexCounts[i] = (uint32_t)mesh.lods[i].indexCount;
+        header.lodErrors[i] = mesh.lods[i].error;
+    }
+
+    for (int i = 0; i < 3; i++)
+        header.center[i] = mesh.center[i];
+
+    header.radius = mesh.radius;
+    header.meshletCount = (uint32_t)mesh.meshlets.size();
+
+    header.vertexOffset = alignOffset(sizeof(MeshCacheHeader));
+    header.vertexBytes = mesh.vertices.size();
+    header.indexOffset = alignOffset(header.vertexOffset + header.vertexBytes);
+    header.indexBytes = mesh.indices.size();
+    header.meshletOffset = alignOffset(header.indexOffset + header.indexBytes);
+    header.meshletBytes = mesh.meshlets.size() * sizeof(Meshlet);
+
+    // Write to a temporary file replacing the cache only when complete
+    std::string filename = meshCacheFilename(sourceFilename);
+    std::string temporaryFilename = filename + ".tmp";
+
+    std::ofstream file(temporaryFilename.c_str(), std::ios::out | std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    file.write((const char *)&header, sizeof(header));
+
+    writePadding(file, header.vertexOffset);
+    file.write((const char *)mesh.vertices.data(), header.vertexBytes);
+
+    writePadding(file, header.indexOffset);
+    file.write((const char *)mesh.indices.data(), header.indexBytes);
+
+    writePadding(file, header.meshletOffset);
+    file.write((const char *)mesh.meshlets.data(), header.meshletBytes);
+
+    file.close();
+
+    if (!file) {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    std::remove(filename.c_str());
+
+    return std::rename(temporaryFilename.c_str(), filename.c_str()) == 0;
+}
@@ -0,0 +1,108 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mapped_file.h"
+#include "mesh.h"
+#include "mesh_lod.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary mesh cache file format version, incremented on every layout change
+const uint32_t MESH_CACHE_VERSION = 7;
+
+// Alignment in bytes of the data blobs inside a mesh cache file
+const uint32_t MESH_CACHE_ALIGNMENT = 64;
+
+// Header at the beginning of a binary mesh cache file
+// The source file is identified by size, modification time and content
+// hash. Vertex and index blobs are GPU ready, processed with the recorded
+// mesh options, and stored with the meshlet table at offsets aligned to MESH_CACHE_ALIGNMENT.
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t alignment;
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+
+    uint32_t vertexFormat;
+    uint32_t optimized;
+    uint32_t optimizedOverdraw;
+    uint32_t normalWeighting;
+    float creaseAngle;
+    uint32_t generateTangents;
+    uint32_t generateLods;
+    uint32_t generateMeshlets;
+
+    uint32_t vertexStride;
+    uint32_t hasTextureCoordinates;
+    uint32_t hasTangents;
+    float positionOffset[3];
+    float positionScale[3];
+
+    uint32_t vertexCount;
+    uint32_t indexSize;
+    uint32_t indexCount;
+
+    // Levels of detail as index ranges of the index blob
+    uint32_t lodCount;
+    uint32_t lodIndexOffsets[MAX_LOD_COUNT];
+    uint32_t lodIndexCounts[MAX_LOD_COUNT];
+    float lodErrors[MAX_LOD_COUNT];
+
+    float center[3];
+    float radius;
+
+    // Meshlets of the finest level of detail
+    uint32_t meshletCount;
+
+    uint64_t vertexOffset;
+    uint64_t vertexBytes;
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+    uint64_t meshletOffset;
+    uint64_t meshletBytes;
+};
+
+// Memory mapped binary mesh cache
+class MeshCache {
+public:
+    MeshCache();
+
+    // Map cache file of a source mesh file, failing if missing, stale or
+    // written with other mesh options
+    bool open(const std::string & sourceFilename, const MeshOptions & options);
+
+    void close();
+
+    const MeshCacheHeader & header() const;
+
+    // Layout of the cached vertex blob
+    VertexLayout layout() const;
+
+    // Levels of detail of the cached index blob
+    std::vector<MeshLod> lods() const;
+
+    // Meshlets of the cached index blob, empty when not generated
+    std::vector<Meshlet> meshlets() const;
+
+    const void * vertices() const;
+    const void * indices() const;
+
+private:
+    MappedFile file;
+};
+
+// Cache file name of a source mesh file, next to it
+std::string meshCacheFilename(const std::string & sourceFilename);
+
+// Write packed mesh to the cache file of its source mesh file
+bool writeMeshCache(
+        const std::string & sourceFilename,
+        const MeshOptions & options,
+        const PackedMesh & mesh);
+
+#endif
@@ -0,0 +1,117 @@
+#include "mesh_lod.h"
+
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Triangle fraction of every simplified level of detail
+const float LOD_RATIOS[MAX_LOD_COUNT - 1] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+
+// Minimum reduction over the previous level to keep a level
+const float MINIMUM_REDUCTION = 0.1f;
+
+}
+
+void generateLods(IndexedMesh & mesh, bool optimize) {
+    size_t fullIndexCount = mesh.indices.size();
+
+    mesh.lods.clear();
+
+    MeshLod full;
+    full.indexOffset = 0;
+    full.indexCount = fullIndexCount;
+    full.error = 0.0f;
+
+    mesh.lods.push_back(full);
+
+    std::vector<uint32_t> previous(mesh.indices);
+    std::vector<uint32_t> simplified;
+
+    for (size_t i = 0; i < MAX_LOD_COUNT - 1; i++) {
+        size_t target = (size_t)(fullIndexCount / 3 * LOD_RATIOS[i]) * 3;
+
+        float error = simplifyMesh(
+            mesh.vertices,
+            previous,
+            target,
+            std::numeric_limits<float>::max(),
+            simplified);
+
+        if (simplified.empty() ||
+                simplified.size() > previous.size() * (1.0f - MINIMUM_REDUCTION))
+            break;
+
+        if (optimize)
+            optimizeVertexCache(simplified, mesh.vertices.size());
+
+        // Errors of successive simplifications add up against the full mesh
+        MeshLod lod;
+        lod.indexOffset = mesh.indices.size();
+        lod.indexCount = simplified.size();
+        lod.error = mesh.lods.back().error + error;
+
+        mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+        mesh.lods.push_back(lod);
+
+        previous.swap(simplified);
+    }
+
+    // A single level needs no table
+    if (mesh.lods.size() == 1)
+        mesh.lods.clear();
+}
+
+float projectedSphereSize(
+        const glm::vec3 & center,
+        float radius,
+        const glm::mat4 & modelView,
+        const glm::mat4 & projection,
+        float viewportHeight) {
+    glm::vec3 viewCenter = glm::vec3(modelView * glm::vec4(center, 1.0f));
+
+    // Largest scale of the transformation
+    float scale = std::max(
+        glm::length(glm::vec3(modelView[0])),
+        std::max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+
+    float viewRadius = radius * scale;
+    float distance = glm::length(viewCenter);
+
+    // The camera is inside the sphere
+    if (distance <= viewRadius)
+        return std::numeric_limits<float>::max();
+
+    return viewRadius / distance * projection[1][1] * viewportHeight;
+}
+
+size_t selectLod(
+        const std::vector<MeshLod> & lods,
+        size_t current,
+        float radius,
+        float screenSize,
+        float pixelError,
+        float hysteresis) {
+    if (lods.size() <= 1)
+        return 0;
+
+    // Pixels per mesh unit
+    float pixels = radius > 0.0f ? screenSize / (2.0f * radius) : 0.0f;
+    size_t lod = std::min(current, lods.size() - 1);
+
+    // Refine while the error of the level is visible
+    while (lod > 0 && lods[lod].error * pixels > pixelError * (1.0f + hysteresis))
+        lod--;
+
+    // Coarsen while the error of the next level stays invisible
+    while (lod + 1 < lods.size() && lods[lod + 1].error * pixels <= pixelError * (1.0f - hysteresis))
+        lod++;
+
+    return lod;
+}
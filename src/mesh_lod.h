@@ -0,0 +1,43 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include "mesh.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <vector>
+
+// Maximum number of levels of detail of a mesh, the full mesh included
+const size_t MAX_LOD_COUNT = 5;
+
+// Generate a chain of simplified levels of detail with 50, 25, 12.5 and
+// 6.25% of the triangles of the full mesh, each one simplified from the
+// previous one. Levels are appended to the index list after the full mesh
+// and reordered for the vertex cache when optimizing. The chain stops early
+// when the simplifier cannot remove enough triangles.
+void generateLods(IndexedMesh & mesh, bool optimize);
+
+// Height in pixels of a bounding sphere projected to the viewport
+float projectedSphereSize(
+        const glm::vec3 & center,
+        float radius,
+        const glm::mat4 & modelView,
+        const glm::mat4 & projection,
+        float viewportHeight);
+
+// Select the coarsest level of detail whose error projects under the pixel
+// error, given the projected size of the bounding sphere of the mesh
+// Starting from the current level, a level is only refined when its error
+// exceeds the pixel error by the hysteresis fraction and only coarsened when
+// the next error is under it by the same fraction, so that levels do not
+// alternate every frame around a threshold.
+size_t selectLod(
+        const std::vector<MeshLod> & lods,
+        size_t current,
+        float radius,
+        float screenSize,
+        float pixelError = 1.0f,
+        float hysteresis = 0.25f);
+
+#endif
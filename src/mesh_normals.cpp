@@ -0,0 +1,523 @@
+#include "mesh_normals.h"
+
+#include "parallel.h"
+
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define MESH_NORMALS_SSE2
+#endif
+
+namespace {
+
+// Minimum number of triangles or vertices of a parallel range
+const size_t GRAIN = 16384;
+
+// Positions as structure of arrays for SIMD loads
+struct PositionArrays {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+};
+
+// Unit normal of every face and accumulation weight of its three corners,
+// zero for degenerate faces
+struct FaceArrays {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> weights[3];
+};
+
+// Corners of every vertex in compressed row format
+struct CornerAdjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> corners;
+};
+
+template <typename Index>
+void buildCornerAdjacency(
+        const Index * indices,
+        size_t cornerCount,
+        size_t vertexCount,
+        CornerAdjacency & adjacency) {
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    adjacency.corners.resize(cornerCount);
+
+    for (size_t i = 0; i < cornerCount; i++)
+        adjacency.offsets[indices[i] + 1]++;
+
+    for (size_t i = 0; i < vertexCount; i++)
+        adjacency.offsets[i + 1] += adjacency.offsets[i];
+
+    std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+
+    for (size_t i = 0; i < cornerCount; i++)
+        adjacency.corners[cursors[indices[i]]++] = (uint32_t)i;
+}
+
+// Angle between two vectors, zero if either is degenerate
+inline float vectorAngle(const glm::vec3 & a, const glm::vec3 & b) {
+    float lengths = std::sqrt(glm::dot(a, a) * glm::dot(b, b));
+
+    if (!(lengths > 0.0f))
+        return 0.0f;
+
+    return std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.0f, 1.0f));
+}
+
+// Unit vector perpendicular to a unit vector
+glm::vec3 perpendicular(const glm::vec3 & n) {
+    glm::vec3 axis = std::fabs(n.x) < std::fabs(n.y) ?
+        (std::fabs(n.x) < std::fabs(n.z) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f)) :
+        (std::fabs(n.y) < std::fabs(n.z) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f));
+
+    return glm::normalize(glm::cross(n, axis));
+}
+
+void computeFaceScalar(
+        const PositionArrays & positions,
+        const uint32_t * indices,
+        NormalWeighting weighting,
+        size_t face,
+        FaceArrays & faces) {
+    glm::vec3 p[3];
+
+    for (size_t j = 0; j < 3; j++) {
+        size_t index = indices[face * 3 + j];
+        p[j] = glm::vec3(positions.x[index], positions.y[index], positions.z[index]);
+    }
+
+    glm::vec3 e1 = p[1] - p[0];
+    glm::vec3 e2 = p[2] - p[0];
+    glm::vec3 normal = glm::cross(e1, e2);
+    float length = glm::length(normal);
+
+    if (!(length > 0.0f)) {
+        faces.x[face] = faces.y[face] = faces.z[face] = 0.0f;
+
+        for (size_t j = 0; j < 3; j++)
+            faces.weights[j][face] = 0.0f;
+
+        return;
+    }
+
+    normal /= length;
+
+    faces.x[face] = normal.x;
+    faces.y[face] = normal.y;
+    faces.z[face] = normal.z;
+
+    if (weighting == NORMAL_WEIGHTING_AREA) {
+        for (size_t j = 0; j < 3; j++)
+            faces.weights[j][face] = 0.5f * length;
+
+        return;
+    }
+
+    glm::vec3 e12 = p[2] - p[1];
+
+    faces.weights[0][face] = vectorAngle(e1, e2);
+    faces.weights[1][face] = vectorAngle(-e1, e12);
+    faces.weights[2][face] = vectorAngle(e2, e12);
+}
+
+#ifdef MESH_NORMALS_SSE2
+
+// Load one coordinate of a corner of four consecutive faces
+inline __m128 gatherCorner(
+        const std::vector<float> & coordinates,
+        const uint32_t * indices,
+        size_t face,
+        size_t corner) {
+    const uint32_t * index = indices + face * 3 + corner;
+
+    return _mm_setr_ps(
+        coordinates[index[0]],
+        coordinates[index[3]],
+        coordinates[index[6]],
+        coordinates[index[9]]);
+}
+
+inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Arc cosine with absolute error under 7e-5 radians (Abramowitz and Stegun 4.4.45)
+inline __m128 acosApproximation(__m128 c) {
+    __m128 x = _mm_andnot_ps(_mm_set1_ps(-0.0f), c);
+
+    __m128 polynomial = _mm_set1_ps(-0.0187293f);
+    polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(0.0742610f));
+    polynomial = _mm_sub_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(0.2121144f));
+    polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(1.5707288f));
+
+    __m128 angle = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), x)), polynomial);
+    __m128 negative = _mm_cmplt_ps(c, _mm_setzero_ps());
+
+    return select(negative, _mm_sub_ps(_mm_set1_ps(3.14159265f), angle), angle);
+}
+
+// Angle between vectors given their dot product and squared lengths
+inline __m128 vectorAngle4(__m128 dot, __m128 lengthA, __m128 lengthB) {
+    __m128 lengths = _mm_sqrt_ps(_mm_mul_ps(lengthA, lengthB));
+    __m128 valid = _mm_cmpgt_ps(lengths, _mm_setzero_ps());
+    __m128 cosine = _mm_div_ps(dot, select(valid, lengths, _mm_set1_ps(1.0f)));
+
+    cosine = _mm_min_ps(_mm_max_ps(cosine, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+
+    return _mm_and_ps(valid, acosApproximation(cosine));
+}
+
+inline __m128 dot4(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+// Normals and corner weights of four consecutive faces
+void computeFaces4(
+        const PositionArrays & positions,
+        const uint32_t * indices,
+        NormalWeighting weighting,
+        size_t face,
+        FaceArrays & faces) {
+    __m128 x0 = gatherCorner(positions.x, indices, face, 0);
+    __m128 y0 = gatherCorner(positions.y, indices, face, 0);
+    __m128 z0 = gatherCorner(positions.z, indices, face, 0);
+
+    __m128 x1 = _mm_sub_ps(gatherCorner(positions.x, indices, face, 1), x0);
+    __m128 y1 = _mm_sub_ps(gatherCorner(positions.y, indices, face, 1), y0);
+    __m128 z1 = _mm_sub_ps(gatherCorner(positions.z, indices, face, 1), z0);
+
+    __m128 x2 = _mm_sub_ps(gatherCorner(positions.x, indices, face, 2), x0);
+    __m128 y2 = _mm_sub_ps(gatherCorner(positions.y, indices, face, 2), y0);
+    __m128 z2 = _mm_sub_ps(gatherCorner(positions.z, indices, face, 2), z0);
+
+    // Cross product of the edges from the first corner
+    __m128 nx = _mm_sub_ps(_mm_mul_ps(y1, z2), _mm_mul_ps(z1, y2));
+    __m128 ny = _mm_sub_ps(_mm_mul_ps(z1, x2), _mm_mul_ps(x1, z2));
+    __m128 nz = _mm_sub_ps(_mm_mul_ps(x1, y2), _mm_mul_ps(y1, x2));
+
+    __m128 length = _mm_sqrt_ps(dot4(nx, ny, nz, nx, ny, nz));
+    __m128 valid = _mm_cmpgt_ps(length, _mm_setzero_ps());
+    __m128 inverse = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), length));
+
+    _mm_storeu_ps(faces.x.data() + face, _mm_mul_ps(nx, inverse));
+    _mm_storeu_ps(faces.y.data() + face, _mm_mul_ps(ny, inverse));
+    _mm_storeu_ps(faces.z.data() + face, _mm_mul_ps(nz, inverse));
+
+    if (weighting == NORMAL_WEIGHTING_AREA) {
+        __m128 area = _mm_and_ps(valid, _mm_mul_ps(length, _mm_set1_ps(0.5f)));
+
+        for (size_t j = 0; j < 3; j++)
+            _mm_storeu_ps(faces.weights[j].data() + face, area);
+
+        return;
+    }
+
+    // Edge from the second to the third corner
+    __m128 x12 = _mm_sub_ps(x2, x1);
+    __m128 y12 = _mm_sub_ps(y2, y1);
+    __m128 z12 = _mm_sub_ps(z2, z1);
+
+    __m128 length1 = dot4(x1, y1, z1, x1, y1, z1);
+    __m128 length2 = dot4(x2, y2, z2, x2, y2, z2);
+    __m128 length12 = dot4(x12, y12, z12, x12, y12, z12);
+
+    __m128 dot12 = dot4(x1, y1, z1, x2, y2, z2);
+    __m128 dot1 = dot4(x1, y1, z1, x12, y12, z12);
+    __m128 dot2 = dot4(x2, y2, z2, x12, y12, z12);
+
+    __m128 angle0 = vectorAngle4(dot12, length1, length2);
+    __m128 angle1 = vectorAngle4(_mm_sub_ps(_mm_setzero_ps(), dot1), length1, length12);
+    __m128 angle2 = vectorAngle4(dot2, length2, length12);
+
+    _mm_storeu_ps(faces.weights[0].data() + face, _mm_and_ps(valid, angle0));
+    _mm_storeu_ps(faces.weights[1].data() + face, _mm_and_ps(valid, angle1));
+    _mm_storeu_ps(faces.weights[2].data() + face, _mm_and_ps(valid, angle2));
+}
+
+#endif
+
+// Normals and corner weights of a range of faces
+void computeFaces(
+        const PositionArrays & positions,
+        const uint32_t * indices,
+        NormalWeighting weighting,
+        size_t begin,
+        size_t end,
+        FaceArrays & faces) {
+    size_t face = begin;
+
+#ifdef MESH_NORMALS_SSE2
+    for (; face + 4 <= end; face += 4)
+        computeFaces4(positions, indices, weighting, face, faces);
+#endif
+
+    for (; face < end; face++)
+        computeFaceScalar(positions, indices, weighting, face, faces);
+}
+
+}
+
+void generateNormals(TriangleMesh & mesh, NormalWeighting weighting, float creaseAngle) {
+    const glm::vec3 * positions = mesh.positions();
+    const uint32_t * positionIndices = mesh.positionIndices();
+
+    size_t positionCount = mesh.counts().positions;
+    size_t faceCount = mesh.triangleCount();
+
+    std::vector<glm::vec3> normals;
+    std::vector<uint32_t> normalIndices(faceCount * 3, 0);
+
+    // Copy positions to structure of arrays
+    PositionArrays arrays;
+    arrays.x.resize(positionCount);
+    arrays.y.resize(positionCount);
+    arrays.z.resize(positionCount);
+
+    parallelFor(positionCount, GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            arrays.x[i] = positions[i].x;
+            arrays.y[i] = positions[i].y;
+            arrays.z[i] = positions[i].z;
+        }
+    });
+
+    // Face normals and corner weights
+    FaceArrays faces;
+    faces.x.resize(faceCount);
+    faces.y.resize(faceCount);
+    faces.z.resize(faceCount);
+
+    for (size_t j = 0; j < 3; j++)
+        faces.weights[j].resize(faceCount);
+
+    parallelFor(faceCount, GRAIN, [&](size_t begin, size_t end) {
+        computeFaces(arrays, positionIndices, weighting, begin, end, faces);
+    });
+
+    CornerAdjacency adjacency;
+    buildCornerAdjacency(positionIndices, faceCount * 3, positionCount, adjacency);
+
+    const std::vector<uint32_t> & offsets = adjacency.offsets;
+    const std::vector<uint32_t> & corners = adjacency.corners;
+
+    float creaseCosine = std::cos(glm::radians(glm::clamp(creaseAngle, 0.0f, 180.0f)));
+
+    // Smooth normal of every corner, in adjacency order, and its smoothing
+    // group among the corners of its position
+    std::vector<glm::vec3> cornerNormals(corners.size());
+    std::vector<uint32_t> cornerGroups(corners.size());
+    std::vector<size_t> groupOffsets(positionCount + 1, 0);
+
+    parallelFor(positionCount, GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t first = offsets[i];
+            uint32_t last = offsets[i + 1];
+            uint32_t groupCount = 0;
+
+            for (uint32_t j = first; j < last; j++) {
+                uint32_t face = corners[j] / 3;
+                glm::vec3 faceNormal(faces.x[face], faces.y[face], faces.z[face]);
+
+                // Accumulate faces within the crease angle, the corner face included
+                glm::vec3 normal(0.0f);
+                glm::vec3 allNormal(0.0f);
+
+                for (uint32_t k = first; k < last; k++) {
+                    uint32_t other = corners[k] / 3;
+                    glm::vec3 otherNormal(faces.x[other], faces.y[other], faces.z[other]);
+                    glm::vec3 weighted = otherNormal * faces.weights[corners[k] % 3][other];
+
+                    if (glm::dot(faceNormal, otherNormal) >= creaseCosine)
+                        normal += weighted;
+
+                    allNormal += weighted;
+                }
+
+                // Degenerate faces take the normal of the whole position
+                float length = glm::length(normal);
+
+                if (!(length > 0.0f)) {
+                    normal = allNormal;
+                    length = glm::length(normal);
+                }
+
+                cornerNormals[j] = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+
+                // Corners with equal neighborhoods share a normal
+                cornerGroups[j] = groupCount;
+
+                for (uint32_t k = first; k < j; k++)
+                    if (cornerNormals[k] == cornerNormals[j]) {
+                        cornerGroups[j] = cornerGroups[k];
+                        break;
+                    }
+
+                if (cornerGroups[j] == groupCount)
+                    groupCount++;
+            }
+
+            groupOffsets[i + 1] = groupCount;
+        }
+    });
+
+    for (size_t i = 0; i < positionCount; i++)
+        groupOffsets[i + 1] += groupOffsets[i];
+
+    // Write one normal per smoothing group
+    normals.resize(groupOffsets[positionCount]);
+
+    parallelFor(positionCount, GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            for (uint32_t j = offsets[i]; j < offsets[i + 1]; j++) {
+                size_t normal = groupOffsets[i] + cornerGroups[j];
+
+                normals[normal] = cornerNormals[j];
+                normalIndices[corners[j]] = (uint32_t)normal;
+            }
+    });
+
+    mesh.setNormals(normals, normalIndices);
+}
+
+void generateTangents(IndexedMesh & mesh) {
+    mesh.tangents.clear();
+
+    if (!mesh.hasTextureCoordinates)
+        return;
+
+    std::vector<Vertex> & vertices = mesh.vertices;
+    std::vector<uint32_t> & indices = mesh.indices;
+
+    size_t faceCount = indices.size() / 3;
+
+    // Tangent of every corner projected on the vertex normal and weighted by
+    // corner angle, with the orientation of the texture mapping of its face
+    std::vector<glm::vec3> cornerTangents(faceCount * 3);
+    std::vector<signed char> cornerSigns(faceCount * 3);
+
+    parallelFor(faceCount, GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const Vertex * corner[3] = {
+                &vertices[indices[i * 3]],
+                &vertices[indices[i * 3 + 1]],
+                &vertices[indices[i * 3 + 2]]
+            };
+
+            glm::vec3 e1 = corner[1]->position - corner[0]->position;
+            glm::vec3 e2 = corner[2]->position - corner[0]->position;
+            glm::vec2 d1 = corner[1]->textureCoordinate - corner[0]->textureCoordinate;
+            glm::vec2 d2 = corner[2]->textureCoordinate - corner[0]->textureCoordinate;
+
+            // Signed texture area gives the orientation, faces without
+            // texture area contribute nothing
+            float area = d1.x * d2.y - d2.x * d1.y;
+            float sign = area > 0.0f ? 1.0f : -1.0f;
+            glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) * sign;
+
+            for (size_t j = 0; j < 3; j++) {
+                size_t index = i * 3 + j;
+
+                cornerTangents[index] = glm::vec3(0.0f);
+                cornerSigns[index] = 0;
+
+                if (area == 0.0f)
+                    continue;
+
+                glm::vec3 normal = glm::normalize(corner[j]->normal);
+                glm::vec3 projected = tangent - normal * glm::dot(normal, tangent);
+                float length = glm::length(projected);
+
+                if (!(length > 0.0f))
+                    continue;
+
+                // Angle between the edges projected on the tangent plane
+                glm::vec3 a = corner[(j + 1) % 3]->position - corner[j]->position;
+                glm::vec3 b = corner[(j + 2) % 3]->position - corner[j]->position;
+
+                a -= normal * glm::dot(normal, a);
+                b -= normal * glm::dot(normal, b);
+
+                cornerTangents[index] = projected / length * vectorAngle(a, b);
+                cornerSigns[index] = (signed char)sign;
+            }
+        }
+    });
+
+    CornerAdjacency adjacency;
+    buildCornerAdjacency(indices.data(), faceCount * 3, vertices.size(), adjacency);
+
+    const std::vector<uint32_t> & offsets = adjacency.offsets;
+    const std::vector<uint32_t> & corners = adjacency.corners;
+
+    // Accumulate the corners of every vertex by sign, the most frequent sign
+    // keeps the vertex and the other one gets a split vertex
+    std::vector<glm::vec4> & tangents = mesh.tangents;
+    std::vector<glm::vec4> splitTangents(vertices.size());
+    std::vector<signed char> splitSigns(vertices.size());
+
+    tangents.resize(vertices.size());
+
+    parallelFor(vertices.size(), GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            glm::vec3 sums[2] = { glm::vec3(0.0f), glm::vec3(0.0f) };
+            size_t counts[2] = { 0, 0 };
+
+            for (uint32_t j = offsets[i]; j < offsets[i + 1]; j++) {
+                signed char sign = cornerSigns[corners[j]];
+
+                if (sign == 0)
+                    continue;
+
+                size_t side = sign > 0 ? 0 : 1;
+
+                sums[side] += cornerTangents[corners[j]];
+                counts[side]++;
+            }
+
+            size_t primary = counts[1] > counts[0] ? 1 : 0;
+            glm::vec3 normal = glm::normalize(vertices[i].normal);
+
+            for (size_t side = 0; side < 2; side++) {
+                // Orthogonalize against the normal, any tangent is valid without texture area
+                glm::vec3 tangent = sums[side] - normal * glm::dot(normal, sums[side]);
+                float length = glm::length(tangent);
+
+                tangent = length > 0.0f ? tangent / length : perpendicular(normal);
+
+                glm::vec4 result(tangent, side == 0 ? 1.0f : -1.0f);
+
+                if (side == primary)
+                    tangents[i] = result;
+                else
+                    splitTangents[i] = result;
+            }
+
+            splitSigns[i] = counts[0] > 0 && counts[1] > 0 ? (primary == 0 ? -1 : 1) : 0;
+        }
+    });
+
+    // Split vertices with mirrored texture mapping
+    size_t vertexCount = vertices.size();
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        if (splitSigns[i] == 0)
+            continue;
+
+        uint32_t split = (uint32_t)vertices.size();
+
+        vertices.push_back(vertices[i]);
+        tangents.push_back(splitTangents[i]);
+
+        for (uint32_t j = offsets[i]; j < offsets[i + 1]; j++)
+            if (cornerSigns[corners[j]] == splitSigns[i])
+                indices[corners[j]] = split;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef MESH_NORMALS_H
+#define MESH_NORMALS_H
+
+#include "mesh.h"
+
+#include <glm/vec3.hpp>
+
+#include <vector>
+
+// Generate smooth normals of a triangle list without normals
+// Face normals are accumulated at every position weighted by triangle area
+// or by the angle of the corner. Faces meeting at more than the crease angle
+// in degrees do not smooth each other, so 0 gives flat shading and 180
+// smooths every position. One normal is written per distinct smoothing group
+// of a position and referenced by corner, like Wavefront OBJ normal indices,
+// replacing the normals of the mesh.
+void generateNormals(TriangleMesh & mesh, NormalWeighting weighting, float creaseAngle);
+
+// Generate tangents of an indexed mesh from its texture coordinates
+// Follows the MikkTSpace conventions: per corner tangents are projected on
+// the vertex normal and accumulated weighted by corner angle, w holds the
+// bitangent sign so that bitangent = w * cross(normal, tangent), and vertices
+// shared by corners of opposite sign (mirrored texture mapping) are split.
+// Does nothing on meshes without texture coordinates.
+void generateTangents(IndexedMesh & mesh);
+
+#endif
@@ -0,0 +1,361 @@
+#include "mesh_optimizer.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+
+namespace {
+
+const uint32_t INVALID_INDEX = 0xffffffffu;
+
+// Triangles adjacent to every vertex in compressed row format
+struct VertexAdjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> counts;
+};
+
+void buildAdjacency(
+        const std::vector<uint32_t> & indices,
+        size_t vertexCount,
+        VertexAdjacency & adjacency) {
+    adjacency.counts.assign(vertexCount, 0);
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    adjacency.triangles.resize(indices.size());
+
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency.counts[indices[i]]++;
+
+    for (size_t i = 0; i < vertexCount; i++)
+        adjacency.offsets[i + 1] = adjacency.offsets[i] + adjacency.counts[i];
+
+    std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency.triangles[cursors[indices[i]]++] = (uint32_t)(i / 3);
+}
+
+// FIFO cache simulation with time stamps
+class VertexCache {
+public:
+    VertexCache(size_t vertexCount, size_t size) :
+        timestamps(vertexCount, 0), time((uint32_t)size + 1), size((uint32_t)size) {
+    }
+
+    // Access vertex, returning true on a cache miss
+    bool access(uint32_t vertex) {
+        if (time - timestamps[vertex] <= size)
+            return false;
+
+        timestamps[vertex] = time++;
+
+        return true;
+    }
+
+    // Evict all vertices
+    void flush() {
+        time += size + 1;
+    }
+
+private:
+    std::vector<uint32_t> timestamps;
+    uint32_t time;
+    uint32_t size;
+};
+
+}
+
+VertexCacheStatistics analyzeVertexCache(
+        const std::vector<uint32_t> & indices,
+        size_t vertexCount,
+        size_t cacheSize) {
+    VertexCache cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+
+    size_t misses = 0;
+    size_t usedCount = 0;
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        misses += cache.access(indices[i]);
+
+        if (!used[indices[i]]) {
+            used[indices[i]] = true;
+            usedCount++;
+        }
+    }
+
+    VertexCacheStatistics statistics;
+    statistics.acmr = indices.empty() ? 0.0f : misses / (indices.size() / 3.0f);
+    statistics.atvr = usedCount == 0 ? 0.0f : misses / (float)usedCount;
+
+    return statistics;
+}
+
+void optimizeVertexCache(
+        std::vector<uint32_t> & indices,
+        size_t vertexCount,
+        size_t cacheSize) {
+    if (indices.empty())
+        return;
+
+    VertexAdjacency adjacency;
+    buildAdjacency(indices, vertexCount, adjacency);
+
+    // Live triangle count of every vertex
+    std::vector<uint32_t> & live = adjacency.counts;
+
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<bool> emitted(indices.size() / 3, false);
+
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+
+    deadEnd.reserve(indices.size());
+    output.reserve(indices.size());
+
+    uint32_t time = (uint32_t)cacheSize + 1;
+    size_t cursor = 0;
+    uint32_t fanning = indices[0];
+
+    while (fanning != INVALID_INDEX) {
+        candidates.clear();
+
+        // Emit all live triangles around the fanning vertex
+        for (uint32_t i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; i++) {
+            uint32_t triangle = adjacency.triangles[i];
+
+            if (emitted[triangle])
+                continue;
+
+            for (size_t j = 0; j < 3; j++) {
+                uint32_t vertex = indices[triangle * 3 + j];
+
+                output.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+
+                live[vertex]--;
+
+                if (time - timestamps[vertex] > cacheSize)
+                    timestamps[vertex] = time++;
+            }
+
+            emitted[triangle] = true;
+        }
+
+        // Choose the candidate that stays longest in cache after its fan
+        fanning = INVALID_INDEX;
+        int bestPriority = -1;
+
+        for (size_t i = 0; i < candidates.size(); i++) {
+            uint32_t vertex = candidates[i];
+
+            if (live[vertex] == 0)
+                continue;
+
+            int priority = 0;
+
+            if (time - timestamps[vertex] + 2 * live[vertex] <= cacheSize)
+                priority = (int)(time - timestamps[vertex]);
+
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanning = vertex;
+            }
+        }
+
+        if (fanning != INVALID_INDEX)
+            continue;
+
+        // Dead end, fall back to recently used vertices, then to input order
+        while (!deadEnd.empty() && fanning == INVALID_INDEX) {
+            uint32_t vertex = deadEnd.back();
+            deadEnd.pop_back();
+
+            if (live[vertex] > 0)
+                fanning = vertex;
+        }
+
+        while (cursor < vertexCount && fanning == INVALID_INDEX) {
+            if (live[cursor] > 0)
+                fanning = (uint32_t)cursor;
+
+            cursor++;
+        }
+    }
+
+    indices.swap(output);
+}
+
+void optimizeOverdraw(
+        std::vector<uint32_t> & indices,
+        const std::vector<Vertex> & vertices,
+        float threshold,
+        size_t cacheSize) {
+    size_t triangleCount = indices.size() / 3;
+
+    if (triangleCount == 0)
+        return;
+
+    // Hard boundaries where a triangle misses the cache on all vertices
+    std::vector<uint32_t> clusters;
+    std::vector<uint32_t> misses(triangleCount);
+
+    {
+        VertexCache cache(vertices.size(), cacheSize);
+
+        for (size_t i = 0; i < triangleCount; i++) {
+            misses[i] = cache.access(indices[i * 3]) +
+                cache.access(indices[i * 3 + 1]) +
+                cache.access(indices[i * 3 + 2]);
+
+            if (i == 0 || misses[i] == 3)
+                clusters.push_back((uint32_t)i);
+        }
+    }
+
+    // Soft boundaries where a cluster, simulated from an empty cache, gets
+    // under threshold times the ACMR of its hard cluster
+    std::vector<uint32_t> softClusters;
+    VertexCache cache(vertices.size(), cacheSize);
+
+    for (size_t i = 0; i < clusters.size(); i++) {
+        uint32_t begin = clusters[i];
+        uint32_t end = i + 1 < clusters.size() ? clusters[i + 1] : (uint32_t)triangleCount;
+
+        uint32_t hardMisses = 0;
+
+        for (uint32_t j = begin; j < end; j++)
+            hardMisses += misses[j];
+
+        float target = threshold * hardMisses / (end - begin);
+
+        softClusters.push_back(begin);
+        cache.flush();
+
+        uint32_t clusterMisses = 0;
+
+        for (uint32_t j = begin; j < end; j++) {
+            clusterMisses += cache.access(indices[j * 3]) +
+                cache.access(indices[j * 3 + 1]) +
+                cache.access(indices[j * 3 + 2]);
+
+            // Avoid splitting off a single triangle at the end of the cluster
+            if (j + 2 < end && clusterMisses <= target * (j + 1 - begin)) {
+                softClusters.push_back(j + 1);
+
+                begin = j + 1;
+                clusterMisses = 0;
+                cache.flush();
+            }
+        }
+    }
+
+    clusters.swap(softClusters);
+
+    // Area weighted centroid and normal of the mesh and every cluster
+    std::vector<glm::vec3> clusterCentroids(clusters.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormals(clusters.size(), glm::vec3(0.0f));
+    std::vector<float> clusterAreas(clusters.size(), 0.0f);
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for (size_t i = 0; i < clusters.size(); i++) {
+        uint32_t end = i + 1 < clusters.size() ? clusters[i + 1] : (uint32_t)triangleCount;
+
+        for (uint32_t j = clusters[i]; j < end; j++) {
+            const glm::vec3 & p0 = vertices[indices[j * 3]].position;
+            const glm::vec3 & p1 = vertices[indices[j * 3 + 1]].position;
+            const glm::vec3 & p2 = vertices[indices[j * 3 + 2]].position;
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+
+            clusterCentroids[i] += (p0 + p1 + p2) * (area / 3.0f);
+            clusterNormals[i] += normal;
+            clusterAreas[i] += area;
+        }
+
+        meshCentroid += clusterCentroids[i];
+        meshArea += clusterAreas[i];
+    }
+
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Sort clusters from the most outward facing
+    std::vector<float> keys(clusters.size());
+    std::vector<uint32_t> order(clusters.size());
+
+    for (size_t i = 0; i < clusters.size(); i++) {
+        glm::vec3 centroid = clusterAreas[i] > 0.0f ?
+            clusterCentroids[i] / clusterAreas[i] : meshCentroid;
+        float length = glm::length(clusterNormals[i]);
+
+        keys[i] = length > 0.0f ?
+            glm::dot(centroid - meshCentroid, clusterNormals[i] / length) : 0.0f;
+        order[i] = (uint32_t)i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) {
+        return keys[a] > keys[b];
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        uint32_t cluster = order[i];
+        uint32_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : (uint32_t)triangleCount;
+
+        output.insert(output.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + end * 3);
+    }
+
+    indices.swap(output);
+}
+
+void optimizeVertexFetch(IndexedMesh & mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), INVALID_INDEX);
+    std::vector<Vertex> vertices;
+    std::vector<glm::vec4> tangents;
+
+    bool hasTangents = !mesh.tangents.empty();
+
+    vertices.reserve(mesh.vertices.size());
+    tangents.reserve(mesh.tangents.size());
+
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        uint32_t & index = mesh.indices[i];
+
+        if (remap[index] == INVALID_INDEX) {
+            remap[index] = (uint32_t)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+
+            if (hasTangents)
+                tangents.push_back(mesh.tangents[index]);
+        }
+
+        index = remap[index];
+    }
+
+    // Unreferenced vertices are dropped
+    mesh.vertices.swap(vertices);
+    mesh.tangents.swap(tangents);
+}
+
+void optimizeMesh(IndexedMesh & mesh, bool overdraw, MeshOptimizationStatistics * statistics) {
+    if (statistics != nullptr)
+        statistics->before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+
+    if (overdraw)
+        optimizeOverdraw(mesh.indices, mesh.vertices);
+
+    optimizeVertexFetch(mesh);
+
+    if (statistics != nullptr)
+        statistics->after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+}
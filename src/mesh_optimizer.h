@@ -0,0 +1,57 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+// Post-transform vertex cache size assumed by the optimizer and statistics
+const size_t VERTEX_CACHE_SIZE = 16;
+
+// Vertex cache efficiency of an index list on a FIFO cache
+// ACMR: average cache misses per triangle, between 0.5 and 3
+// ATVR: average transforms per vertex, 1 is optimal
+struct VertexCacheStatistics {
+    float acmr;
+    float atvr;
+};
+
+// Efficiency of a mesh before and after optimization
+struct MeshOptimizationStatistics {
+    VertexCacheStatistics before;
+    VertexCacheStatistics after;
+};
+
+// Simulate a FIFO post-transform vertex cache over an index list
+VertexCacheStatistics analyzeVertexCache(
+        const std::vector<uint32_t> & indices,
+        size_t vertexCount,
+        size_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorder triangles for vertex cache locality with the Tipsify algorithm
+// (Sander, Nehab and Barczak, Fast Triangle Reordering for Vertex Locality
+// and Reduced Overdraw, 2007)
+void optimizeVertexCache(
+        std::vector<uint32_t> & indices,
+        size_t vertexCount,
+        size_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorder clusters of cache optimized triangles so that outward facing
+// clusters are drawn first, reducing overdraw independently of the view
+// Clusters are split where their ACMR falls under threshold times the mesh
+// ACMR, so larger thresholds trade cache efficiency for less overdraw.
+void optimizeOverdraw(
+        std::vector<uint32_t> & indices,
+        const std::vector<Vertex> & vertices,
+        float threshold = 1.05f,
+        size_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorder vertices by first use in the index list for vertex fetch locality
+void optimizeVertexFetch(IndexedMesh & mesh);
+
+// Optimize triangle and vertex order of a mesh for rendering, with overdraw
+// clustering when requested
+void optimizeMesh(IndexedMesh & mesh, bool overdraw, MeshOptimizationStatistics * statistics = nullptr);
+
+#endif
@@ -0,0 +1,765 @@
+#include "mesh_pages.h"
+
+#include "mapped_file.h"
+#include "mesh_normals.h"
+#include "mesh_optimizer.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+const char MAGIC[8] = { 'C', 'G', 'P', 'A', 'G', 'E', 'S', '\0' };
+
+// Missing attribute index of a triangle record
+const uint32_t NO_INDEX = 0xffffffff;
+
+// Bytes of the source file parsed at a time
+const size_t READ_BLOCK_SIZE = 16 << 20;
+
+// Grid cells per page, cells much smaller than a page let pages follow the
+// surface instead of the mostly empty volume around it
+const size_t CELLS_PER_PAGE = 64;
+const size_t MAX_CELLS = 1 << 24;
+
+// Triangles of the temporary files read at a time
+const size_t TRIANGLE_BATCH = 1 << 16;
+
+// Memory of the triangles binned per page before spilling them to disk
+const size_t BIN_BYTES = 64 << 20;
+
+// Attribute indices of a triangle, zero based over the whole source file
+struct TriangleRecord {
+    uint32_t positions[3];
+    uint32_t normals[3];
+    uint32_t textureCoordinates[3];
+};
+
+// Triangles of one page spilled together to the bin file
+struct TriangleRun {
+    uint32_t page;
+    uint32_t count;
+    uint64_t offset;
+};
+
+// Temporary files removed when going out of scope
+class TemporaryFiles {
+public:
+    ~TemporaryFiles() {
+        for (size_t i = 0; i < filenames.size(); i++)
+            std::remove(filenames[i].c_str());
+    }
+
+    std::string add(const std::string & filename) {
+        filenames.push_back(filename);
+        return filename;
+    }
+
+private:
+    std::vector<std::string> filenames;
+};
+
+// Uniform grid of cells over the mesh bounds
+struct Grid {
+    glm::vec3 origin;
+    float inverseCellSize;
+    uint32_t sides[3];
+
+    size_t count() const {
+        return (size_t)sides[0] * sides[1] * sides[2];
+    }
+
+    size_t cell(const glm::vec3 & point) const {
+        uint32_t coordinates[3];
+
+        for (int i = 0; i < 3; i++) {
+            float c = std::floor((point[i] - origin[i]) * inverseCellSize);
+            coordinates[i] = (uint32_t)glm::clamp(c, 0.0f, (float)(sides[i] - 1));
+        }
+
+        return ((size_t)coordinates[2] * sides[1] + coordinates[1]) * sides[0] + coordinates[0];
+    }
+};
+
+// Cells along every side of a grid of cubic cells of the given size
+size_t cellCount(const glm::vec3 & extent, float size, uint32_t sides[3]) {
+    size_t count = 1;
+
+    for (int i = 0; i < 3; i++) {
+        double side = std::ceil(extent[i] / size);
+        sides[i] = (uint32_t)std::max(1.0, std::min(side, (double)MAX_CELLS));
+        count = std::min(count * sides[i], MAX_CELLS + 1);
+    }
+
+    return count;
+}
+
+// Grid of cubic cells over the bounds with at most the given cell count,
+// found by bisecting the cell size
+Grid buildGrid(const glm::vec3 & min, const glm::vec3 & max, size_t cells) {
+    glm::vec3 extent = max - min;
+    float largest = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-20f));
+
+    float lower = largest / cells;
+    float upper = largest;
+
+    for (int i = 0; i < 64; i++) {
+        float middle = 0.5f * (lower + upper);
+        uint32_t sides[3];
+
+        if (cellCount(extent, middle, sides) <= cells)
+            upper = middle;
+        else
+            lower = middle;
+    }
+
+    Grid grid;
+    grid.origin = min;
+    grid.inverseCellSize = 1.0f / upper;
+    cellCount(extent, upper, grid.sides);
+
+    return grid;
+}
+
+// Spread the low 21 bits of a value to every third bit
+inline uint64_t spreadBits(uint64_t value) {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffULL;
+    value = (value | value << 16) & 0x1f0000ff0000ffULL;
+    value = (value | value << 8) & 0x100f00f00f00f00fULL;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+    value = (value | value << 2) & 0x1249249249249249ULL;
+
+    return value;
+}
+
+// Morton order of a grid cell
+uint64_t mortonCode(const Grid & grid, size_t cell) {
+    uint64_t x = cell % grid.sides[0];
+    uint64_t y = cell / grid.sides[0] % grid.sides[1];
+    uint64_t z = cell / grid.sides[0] / grid.sides[1];
+
+    return spreadBits(x) | spreadBits(y) << 1 | spreadBits(z) << 2;
+}
+
+inline uint64_t alignOffset(uint64_t offset) {
+    return (offset + MESH_PAGES_ALIGNMENT - 1) / MESH_PAGES_ALIGNMENT * MESH_PAGES_ALIGNMENT;
+}
+
+// Write zero padding up to the given offset
+void writePadding(std::ofstream & file, uint64_t offset) {
+    static const char zeros[MESH_PAGES_ALIGNMENT] = {};
+
+    uint64_t position = (uint64_t)file.tellp();
+
+    if (offset > position)
+        file.write(zeros, offset - position);
+}
+
+// Read every triangle of a triangle file in batches
+template <typename Function>
+bool forEachTriangle(const std::string & filename, Function function) {
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    std::vector<TriangleRecord> batch(TRIANGLE_BATCH);
+
+    while (file) {
+        file.read((char *)batch.data(), batch.size() * sizeof(TriangleRecord));
+
+        size_t count = (size_t)file.gcount() / sizeof(TriangleRecord);
+
+        for (size_t i = 0; i < count; i++)
+            function(batch[i]);
+    }
+
+    return file.eof();
+}
+
+// Attributes of the source file spilled to temporary files
+struct SourceAttributes {
+    const glm::vec3 * positions;
+    const glm::vec3 * normals;
+    const glm::vec2 * textureCoordinates;
+    size_t positionCount;
+    size_t normalCount;
+    size_t textureCoordinateCount;
+};
+
+inline bool isValid(const TriangleRecord & triangle, const SourceAttributes & source) {
+    return triangle.positions[0] < source.positionCount &&
+        triangle.positions[1] < source.positionCount &&
+        triangle.positions[2] < source.positionCount;
+}
+
+inline glm::vec3 centroid(const TriangleRecord & triangle, const SourceAttributes & source) {
+    return (source.positions[triangle.positions[0]] +
+        source.positions[triangle.positions[1]] +
+        source.positions[triangle.positions[2]]) / 3.0f;
+}
+
+// Local copy of the attributes referenced by the triangles of a page
+// Normals and texture coordinates are used only when every corner has one.
+// The arena is allocated for one attribute per corner and truncated to the
+// attributes referenced.
+void gatherPage(
+        const std::vector<TriangleRecord> & triangles,
+        const SourceAttributes & source,
+        TriangleMesh & mesh) {
+    bool hasNormals = true;
+    bool hasTextureCoordinates = true;
+
+    for (size_t i = 0; i < triangles.size(); i++)
+        for (int j = 0; j < 3; j++) {
+            hasNormals = hasNormals && triangles[i].normals[j] < source.normalCount;
+            hasTextureCoordinates = hasTextureCoordinates &&
+                triangles[i].textureCoordinates[j] < source.textureCoordinateCount;
+        }
+
+    size_t corners = triangles.size() * 3;
+
+    TriangleMeshCounts counts = {
+        corners,
+        hasNormals ? corners : 0,
+        hasTextureCoordinates ? corners : 0,
+        corners,
+        hasNormals ? corners : 0,
+        hasTextureCoordinates ? corners : 0
+    };
+
+    mesh.allocate(counts);
+
+    std::unordered_map<uint32_t, uint32_t> positionMap;
+    std::unordered_map<uint32_t, uint32_t> normalMap;
+    std::unordered_map<uint32_t, uint32_t> textureCoordinateMap;
+
+    typedef std::unordered_map<uint32_t, uint32_t>::iterator Iterator;
+
+    for (size_t i = 0; i < triangles.size(); i++)
+        for (int j = 0; j < 3; j++) {
+            size_t corner = i * 3 + j;
+
+            uint32_t index = triangles[i].positions[j];
+            std::pair<Iterator, bool> inserted =
+                positionMap.insert(std::make_pair(index, (uint32_t)positionMap.size()));
+
+            if (inserted.second)
+                mesh.positions()[inserted.first->second] = source.positions[index];
+
+            mesh.positionIndices()[corner] = inserted.first->second;
+
+            if (hasNormals) {
+                index = triangles[i].normals[j];
+                inserted = normalMap.insert(std::make_pair(index, (uint32_t)normalMap.size()));
+
+                if (inserted.second)
+                    mesh.normals()[inserted.first->second] = source.normals[index];
+
+                mesh.normalIndices()[corner] = inserted.first->second;
+            }
+
+            if (hasTextureCoordinates) {
+                index = triangles[i].textureCoordinates[j];
+                inserted = textureCoordinateMap.insert(
+                    std::make_pair(index, (uint32_t)textureCoordinateMap.size()));
+
+                if (inserted.second)
+                    mesh.textureCoordinates()[inserted.first->second] = source.textureCoordinates[index];
+
+                mesh.textureCoordinateIndices()[corner] = inserted.first->second;
+            }
+        }
+
+    counts.positions = positionMap.size();
+    counts.normals = normalMap.size();
+    counts.textureCoordinates = textureCoordinateMap.size();
+
+    mesh.truncate(counts);
+}
+
+// Process the triangles of a page into GPU ready blobs
+bool buildPage(
+        const std::vector<TriangleRecord> & triangles,
+        const SourceAttributes & source,
+        const MeshOptions & options,
+        PackedMesh & packed,
+        MeshPage & page) {
+    TriangleMesh triangleMesh;
+    gatherPage(triangles, source, triangleMesh);
+
+    if (triangleMesh.counts().normalIndices != triangleMesh.counts().positionIndices)
+        generateNormals(triangleMesh, options.normalWeighting, options.creaseAngle);
+
+    IndexedMesh mesh;
+
+    if (!buildIndexedMesh(triangleMesh, mesh))
+        return false;
+
+    if (options.optimize)
+        optimizeMesh(mesh, options.optimizeOverdraw);
+
+    packMesh(mesh, options.vertexFormat, packed);
+
+    const glm::vec3 * positions = triangleMesh.positions();
+
+    glm::vec3 min = positions[0];
+    glm::vec3 max = positions[0];
+
+    for (size_t i = 1; i < triangleMesh.counts().positions; i++) {
+        min = glm::min(min, positions[i]);
+        max = glm::max(max, positions[i]);
+    }
+
+    std::memset(&page, 0, sizeof(MeshPage));
+
+    for (int i = 0; i < 3; i++) {
+        page.boundsMin[i] = min[i];
+        page.boundsMax[i] = max[i];
+        page.center[i] = packed.center[i];
+        page.positionOffset[i] = packed.layout.positionOffset[i];
+        page.positionScale[i] = packed.layout.positionScale[i];
+    }
+
+    page.radius = packed.radius;
+    page.vertexStride = (uint32_t)packed.layout.stride;
+    page.hasTextureCoordinates = packed.layout.hasTextureCoordinates;
+    page.vertexCount = (uint32_t)packed.vertexCount;
+    page.indexSize = (uint32_t)packed.indexSize;
+    page.indexCount = (uint32_t)packed.indexCount;
+    page.vertexBytes = packed.vertices.size();
+    page.indexBytes = packed.indices.size();
+
+    return true;
+}
+
+}
+
+std::string meshPagesFilename(const std::string & sourceFilename) {
+    size_t separator = sourceFilename.find_last_of("/\\");
+    size_t extension = sourceFilename.rfind('.');
+
+    if (extension == std::string::npos ||
+            (separator != std::string::npos && extension < separator))
+        return sourceFilename + ".pages";
+
+    return sourceFilename.substr(0, extension) + ".pages";
+}
+
+bool writeMeshPages(
+        const std::string & sourceFilename,
+        const MeshOptions & options,
+        size_t pageTriangles,
+        MeshPagingStatistics * statistics) {
+    PROFILE_ZONE("writeMeshPages");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::string filename = meshPagesFilename(sourceFilename);
+    pageTriangles = std::max<size_t>(pageTriangles, 1);
+
+    TemporaryFiles temporary;
+    std::string positionFilename = temporary.add(filename + ".positions.tmp");
+    std::string normalFilename = temporary.add(filename + ".normals.tmp");
+    std::string textureCoordinateFilename = temporary.add(filename + ".uvs.tmp");
+    std::string triangleFilename = temporary.add(filename + ".triangles.tmp");
+    std::string binFilename = temporary.add(filename + ".bins.tmp");
+    std::string temporaryFilename = temporary.add(filename + ".tmp");
+
+    // Spill attributes and triangles of the streamed source, only one block
+    // of the source is in memory at a time
+    std::ofstream positionFile(positionFilename.c_str(), std::ios::out | std::ios::binary);
+    std::ofstream normalFile(normalFilename.c_str(), std::ios::out | std::ios::binary);
+    std::ofstream textureCoordinateFile(textureCoordinateFilename.c_str(), std::ios::out | std::ios::binary);
+    std::ofstream triangleFile(triangleFilename.c_str(), std::ios::out | std::ios::binary);
+
+    if (!positionFile.is_open() || !normalFile.is_open() ||
+            !textureCoordinateFile.is_open() || !triangleFile.is_open())
+        return false;
+
+    SourceAttributes source;
+    std::memset(&source, 0, sizeof(SourceAttributes));
+
+    glm::vec3 min(HUGE_VALF);
+    glm::vec3 max(-HUGE_VALF);
+    size_t triangleCount = 0;
+    std::vector<TriangleRecord> records;
+
+    MeshReadStatistics readStatistics;
+
+    bool read = streamTriangleMesh(sourceFilename, READ_BLOCK_SIZE, [&](const TriangleMesh & block) {
+        const TriangleMeshCounts & counts = block.counts();
+
+        for (size_t i = 0; i < counts.positions; i++) {
+            min = glm::min(min, block.positions()[i]);
+            max = glm::max(max, block.positions()[i]);
+        }
+
+        positionFile.write((const char *)block.positions(), counts.positions * sizeof(glm::vec3));
+        normalFile.write((const char *)block.normals(), counts.normals * sizeof(glm::vec3));
+        textureCoordinateFile.write(
+            (const char *)block.textureCoordinates(),
+            counts.textureCoordinates * sizeof(glm::vec2));
+
+        source.positionCount += counts.positions;
+        source.normalCount += counts.normals;
+        source.textureCoordinateCount += counts.textureCoordinates;
+
+        // Indices must fit in 32 bits with one value left for missing ones
+        if (source.positionCount >= NO_INDEX || source.normalCount >= NO_INDEX ||
+                source.textureCoordinateCount >= NO_INDEX)
+            return false;
+
+        // Corner attributes are kept only when read for every corner of the block
+        size_t corners = block.triangleCount() * 3;
+        bool hasNormals = counts.normalIndices == counts.positionIndices;
+        bool hasTextureCoordinates = counts.textureCoordinateIndices == counts.positionIndices;
+
+        records.resize(corners / 3);
+
+        for (size_t i = 0; i < corners; i++) {
+            TriangleRecord & record = records[i / 3];
+
+            record.positions[i % 3] = block.positionIndices()[i];
+            record.normals[i % 3] = hasNormals ? block.normalIndices()[i] : NO_INDEX;
+            record.textureCoordinates[i % 3] = hasTextureCoordinates ?
+                block.textureCoordinateIndices()[i] : NO_INDEX;
+        }
+
+        triangleFile.write((const char *)records.data(), records.size() * sizeof(TriangleRecord));
+        triangleCount += records.size();
+
+        return true;
+    }, &readStatistics);
+
+    positionFile.close();
+    normalFile.close();
+    textureCoordinateFile.close();
+    triangleFile.close();
+
+    if (!read || !positionFile || !normalFile || !textureCoordinateFile || !triangleFile ||
+            source.positionCount == 0)
+        return false;
+
+    records.clear();
+    records.shrink_to_fit();
+
+    // Map spilled attributes, paged in by the operating system on access
+    MappedFile positionMap;
+    MappedFile normalMap;
+    MappedFile textureCoordinateMap;
+
+    if (!positionMap.open(positionFilename))
+        return false;
+
+    source.positions = (const glm::vec3 *)positionMap.data();
+
+    if (source.normalCount > 0 && normalMap.open(normalFilename))
+        source.normals = (const glm::vec3 *)normalMap.data();
+    else
+        source.normalCount = 0;
+
+    if (source.textureCoordinateCount > 0 && textureCoordinateMap.open(textureCoordinateFilename))
+        source.textureCoordinates = (const glm::vec2 *)textureCoordinateMap.data();
+    else
+        source.textureCoordinateCount = 0;
+
+    // Count triangles per grid cell by centroid
+    size_t pageEstimate = (triangleCount + pageTriangles - 1) / pageTriangles;
+    Grid grid = buildGrid(min, max, std::max<size_t>(std::min(pageEstimate * CELLS_PER_PAGE, MAX_CELLS), 1));
+
+    std::vector<uint32_t> cells(grid.count(), 0);
+
+    if (!forEachTriangle(triangleFilename, [&](const TriangleRecord & triangle) {
+            if (isValid(triangle, source))
+                cells[grid.cell(centroid(triangle, source))]++;
+        }))
+        return false;
+
+    // Group occupied cells in Morton order into pages of at most the page
+    // triangle count, cells larger than a page are a page of their own
+    std::vector<std::pair<uint64_t, uint32_t> > occupied;
+
+    for (size_t i = 0; i < cells.size(); i++)
+        if (cells[i] > 0)
+            occupied.push_back(std::make_pair(mortonCode(grid, i), (uint32_t)i));
+
+    std::sort(occupied.begin(), occupied.end());
+
+    std::vector<size_t> pageSizes;
+
+    for (size_t i = 0; i < occupied.size(); i++) {
+        uint32_t & cell = cells[occupied[i].second];
+
+        if (pageSizes.empty() || pageSizes.back() + cell > pageTriangles)
+            pageSizes.push_back(0);
+
+        pageSizes.back() += cell;
+
+        // Cells now hold their page
+        cell = (uint32_t)(pageSizes.size() - 1);
+    }
+
+    size_t pageCount = pageSizes.size();
+
+    // Bin triangles by page, spilling runs of every page to the bin file
+    size_t binCapacity = glm::clamp<size_t>(
+        BIN_BYTES / sizeof(TriangleRecord) / std::max<size_t>(pageCount, 1), 64, pageTriangles);
+
+    std::vector<std::vector<TriangleRecord> > bins(pageCount);
+    std::vector<TriangleRun> runs;
+
+    std::ofstream binFile(binFilename.c_str(), std::ios::out | std::ios::binary);
+
+    if (!binFile.is_open())
+        return false;
+
+    uint64_t binOffset = 0;
+
+    auto spill = [&](uint32_t page) {
+        std::vector<TriangleRecord> & bin = bins[page];
+
+        TriangleRun run = { page, (uint32_t)bin.size(), binOffset };
+        runs.push_back(run);
+
+        binFile.write((const char *)bin.data(), bin.size() * sizeof(TriangleRecord));
+        binOffset += bin.size() * sizeof(TriangleRecord);
+
+        bin.clear();
+    };
+
+    if (!forEachTriangle(triangleFilename, [&](const TriangleRecord & triangle) {
+            if (!isValid(triangle, source))
+                return;
+
+            uint32_t page = cells[grid.cell(centroid(triangle, source))];
+            std::vector<TriangleRecord> & bin = bins[page];
+
+            if (bin.capacity() == 0)
+                bin.reserve(binCapacity);
+
+            bin.push_back(triangle);
+
+            if (bin.size() == binCapacity)
+                spill(page);
+        }))
+        return false;
+
+    for (size_t i = 0; i < pageCount; i++)
+        if (!bins[i].empty())
+            spill((uint32_t)i);
+
+    binFile.close();
+
+    if (!binFile)
+        return false;
+
+    std::vector<std::vector<TriangleRecord> >().swap(bins);
+    std::vector<uint32_t>().swap(cells);
+
+    // Runs of a page in file order
+    std::stable_sort(runs.begin(), runs.end(), [](const TriangleRun & a, const TriangleRun & b) {
+        return a.page < b.page;
+    });
+
+    // Build pages in parallel batches, written in page order
+    std::ifstream binInput(binFilename.c_str(), std::ios::in | std::ios::binary);
+    std::ofstream file(temporaryFilename.c_str(), std::ios::out | std::ios::binary);
+
+    if (!binInput.is_open() || !file.is_open())
+        return false;
+
+    MeshPagesHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+
+    header.version = MESH_PAGES_VERSION;
+    header.alignment = MESH_PAGES_ALIGNMENT;
+    header.vertexFormat = (uint32_t)options.vertexFormat;
+    header.pageCount = (uint32_t)pageCount;
+
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = min[i];
+        header.boundsMax[i] = max[i];
+    }
+
+    file.write((const char *)&header, sizeof(header));
+
+    std::vector<MeshPage> table(pageCount);
+    size_t batchSize = threadCount();
+    size_t run = 0;
+    size_t largestPage = 0;
+
+    for (size_t first = 0; first < pageCount; first += batchSize) {
+        size_t count = std::min(batchSize, pageCount - first);
+
+        std::vector<std::vector<TriangleRecord> > triangles(count);
+        std::vector<PackedMesh> packed(count);
+
+        for (size_t i = 0; i < count; i++) {
+            triangles[i].resize(pageSizes[first + i]);
+
+            size_t offset = 0;
+
+            for (; run < runs.size() && runs[run].page == first + i; run++) {
+                binInput.seekg((std::streamoff)runs[run].offset);
+                binInput.read((char *)(triangles[i].data() + offset), runs[run].count * sizeof(TriangleRecord));
+                offset += runs[run].count;
+            }
+
+            largestPage = std::max(largestPage, offset);
+        }
+
+        if (!binInput)
+            return false;
+
+        std::vector<unsigned char> built(count);
+
+        parallelFor(count, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                built[i] = buildPage(triangles[i], source, options, packed[i], table[first + i]);
+        });
+
+        if (std::find(built.begin(), built.end(), 0) != built.end())
+            return false;
+
+        for (size_t i = 0; i < count; i++) {
+            MeshPage & page = table[first + i];
+
+            page.vertexOffset = alignOffset((uint64_t)file.tellp());
+            writePadding(file, page.vertexOffset);
+            file.write((const char *)packed[i].vertices.data(), page.vertexBytes);
+
+            page.indexOffset = alignOffset((uint64_t)file.tellp());
+            writePadding(file, page.indexOffset);
+            file.write((const char *)packed[i].indices.data(), page.indexBytes);
+
+            header.triangleCount += page.indexCount / 3;
+            header.vertexCount += page.vertexCount;
+        }
+    }
+
+    header.tableOffset = alignOffset((uint64_t)file.tellp());
+
+    writePadding(file, header.tableOffset);
+    file.write((const char *)table.data(), table.size() * sizeof(MeshPage));
+
+    file.seekp(0);
+    file.write((const char *)&header, sizeof(header));
+    file.close();
+
+    if (!file)
+        return false;
+
+    if (statistics != nullptr) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        statistics->read = readStatistics;
+        statistics->triangles = (size_t)header.triangleCount;
+        statistics->pages = pageCount;
+        statistics->cells = occupied.size();
+        statistics->largestPage = largestPage;
+        statistics->temporaryBytes = positionMap.size() + normalMap.size() +
+            textureCoordinateMap.size() + triangleCount * sizeof(TriangleRecord) + binOffset;
+        statistics->seconds = elapsed.count();
+    }
+
+    std::remove(filename.c_str());
+
+    return std::rename(temporaryFilename.c_str(), filename.c_str()) == 0;
+}
+
+MeshPagesFile::MeshPagesFile() {
+    std::memset(&fileHeader, 0, sizeof(MeshPagesHeader));
+}
+
+bool MeshPagesFile::open(const std::string & filename) {
+    close();
+
+    file.open(filename.c_str(), std::ios::in | std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    file.read((char *)&fileHeader, sizeof(MeshPagesHeader));
+
+    if (!file || std::memcmp(fileHeader.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            fileHeader.version != MESH_PAGES_VERSION) {
+        close();
+        return false;
+    }
+
+    table.resize(fileHeader.pageCount);
+
+    file.seekg((std::streamoff)fileHeader.tableOffset);
+    file.read((char *)table.data(), table.size() * sizeof(MeshPage));
+
+    if (!file) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MeshPagesFile::close() {
+    if (file.is_open())
+        file.close();
+
+    file.clear();
+    table.clear();
+    std::memset(&fileHeader, 0, sizeof(MeshPagesHeader));
+}
+
+bool MeshPagesFile::isOpen() const {
+    return file.is_open();
+}
+
+const MeshPagesHeader & MeshPagesFile::header() const {
+    return fileHeader;
+}
+
+const std::vector<MeshPage> & MeshPagesFile::pages() const {
+    return table;
+}
+
+VertexLayout MeshPagesFile::layout(size_t page) const {
+    const MeshPage & entry = table[page];
+
+    VertexLayout layout = vertexLayout(
+        (VertexFormat)fileHeader.vertexFormat, entry.hasTextureCoordinates != 0, false);
+
+    for (int i = 0; i < 3; i++) {
+        layout.positionOffset[i] = entry.positionOffset[i];
+        layout.positionScale[i] = entry.positionScale[i];
+    }
+
+    return layout;
+}
+
+bool MeshPagesFile::read(
+        size_t page,
+        std::vector<unsigned char> & vertices,
+        std::vector<unsigned char> & indices) {
+    const MeshPage & entry = table[page];
+
+    vertices.resize(entry.vertexBytes);
+    indices.resize(entry.indexBytes);
+
+    file.clear();
+    file.seekg((std::streamoff)entry.vertexOffset);
+    file.read((char *)vertices.data(), entry.vertexBytes);
+    file.seekg((std::streamoff)entry.indexOffset);
+    file.read((char *)indices.data(), entry.indexBytes);
+
+    return !file.fail();
+}
@@ -0,0 +1,138 @@
+#ifndef MESH_PAGES_H
+#define MESH_PAGES_H
+
+#include "mesh.h"
+#include "mesh_reader.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Paged mesh file format version, incremented on every layout change
+const uint32_t MESH_PAGES_VERSION = 1;
+
+// Alignment in bytes of the page blobs inside a paged mesh file
+const uint32_t MESH_PAGES_ALIGNMENT = 64;
+
+// Default triangles per page of a paged mesh
+const size_t MESH_PAGE_TRIANGLES = 65536;
+
+// Header at the beginning of a paged mesh file
+// Pages are GPU ready vertex and index blobs at offsets aligned to
+// MESH_PAGES_ALIGNMENT, described by the page table at the end of the file.
+struct MeshPagesHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t alignment;
+
+    uint32_t vertexFormat;
+    uint32_t pageCount;
+
+    uint64_t triangleCount;
+    uint64_t vertexCount;
+
+    // Bounds of the whole mesh in mesh units
+    float boundsMin[3];
+    float boundsMax[3];
+
+    uint64_t tableOffset;
+};
+
+// Spatially coherent group of triangles of a paged mesh, uploaded and
+// drawn as a mesh of its own
+struct MeshPage {
+    // Bounds and bounding sphere in mesh units
+    float boundsMin[3];
+    float boundsMax[3];
+    float center[3];
+    float radius;
+
+    // Compact formats omit texture coordinates of pages without them
+    uint32_t vertexStride;
+    uint32_t hasTextureCoordinates;
+    float positionOffset[3];
+    float positionScale[3];
+
+    uint32_t vertexCount;
+    uint32_t indexSize;
+    uint32_t indexCount;
+
+    uint64_t vertexOffset;
+    uint64_t vertexBytes;
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+};
+
+// Timing and sizes of a paged mesh conversion
+struct MeshPagingStatistics {
+    MeshReadStatistics read;
+
+    size_t triangles;
+    size_t pages;
+
+    // Occupied cells of the grid grouped into pages
+    size_t cells;
+
+    // Triangles of the largest page
+    size_t largestPage;
+
+    // Bytes of the temporary files spilled to disk
+    size_t temporaryBytes;
+
+    double seconds;
+};
+
+// Paged mesh file name of a source mesh file, next to it
+std::string meshPagesFilename(const std::string & sourceFilename);
+
+// Convert Wavefront OBJ file into a paged mesh file of pages of about the
+// given triangle count, processed with the mesh options
+// The source is streamed and its attributes and triangles are spilled to
+// temporary files next to the output, so meshes larger than memory can be
+// converted. Triangles are binned by centroid into a grid of cells much
+// smaller than a page, and occupied cells are grouped in Morton order into
+// pages. Normals are generated per page when missing, so they may differ
+// across page borders. Levels of detail, meshlets and tangents are not
+// generated.
+bool writeMeshPages(
+        const std::string & sourceFilename,
+        const MeshOptions & options,
+        size_t pageTriangles,
+        MeshPagingStatistics * statistics = nullptr);
+
+// Paged mesh file with its page table in memory
+// Page blobs are read on demand, by a single thread at a time.
+class MeshPagesFile {
+public:
+    MeshPagesFile();
+
+    // Read header and page table, failing if missing or of another version
+    bool open(const std::string & filename);
+
+    void close();
+
+    bool isOpen() const;
+
+    const MeshPagesHeader & header() const;
+    const std::vector<MeshPage> & pages() const;
+
+    // Layout of the vertex blob of a page
+    VertexLayout layout(size_t page) const;
+
+    // Read vertex and index blobs of a page
+    bool read(
+            size_t page,
+            std::vector<unsigned char> & vertices,
+            std::vector<unsigned char> & indices);
+
+private:
+    MeshPagesFile(const MeshPagesFile &);
+    MeshPagesFile & operator=(const MeshPagesFile &);
+
+    std::ifstream file;
+    MeshPagesHeader fileHeader;
+    std::vector<MeshPage> table;
+};
+
+#endif
@@ -0,0 +1,578 @@
+#include "mesh_reader.h"
+
+#include "mapped_file.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+// Attribute and index counts of a chunk
+struct ChunkCounts {
+    size_t positions;
+    size_t normals;
+    size_t textureCoordinates;
+    size_t positionIndices;
+    size_t normalIndices;
+    size_t textureCoordinateIndices;
+};
+
+// Destination of the attributes and indices of a chunk
+struct ChunkOutput {
+    glm::vec3 * positions;
+    glm::vec3 * normals;
+    glm::vec2 * textureCoordinates;
+    uint32_t * positionIndices;
+    uint32_t * normalIndices;
+    uint32_t * textureCoordinateIndices;
+
+    // Attribute counts read before the chunk, used by relative indices
+    ChunkCounts base;
+};
+
+// Powers of ten exactly representable in single precision
+const float POWERS_OF_TEN[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+// Chunks smaller than this are not worth a separate task
+const size_t MINIMUM_CHUNK_SIZE = 1 << 20;
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline const char * skipBlanks(const char * c, const char * end) {
+    while (c < end && isBlank(*c))
+        c++;
+
+    return c;
+}
+
+inline const char * nextLine(const char * c, const char * end) {
+    const char * newline = (const char *)std::memchr(c, '\n', end - c);
+    return newline != nullptr ? newline + 1 : end;
+}
+
+// Parse decimal floating point number without allocations
+// Numbers with at most 7 significant digits and small exponents are converted
+// with a single correctly rounded operation, others are delegated to strtof,
+// so results are identical to stream extraction in both cases.
+bool parseFloat(const char *& cursor, const char * end, float & value) {
+    const char * start = skipBlanks(cursor, end);
+    const char * c = start;
+
+    bool negative = false;
+
+    if (c < end && (*c == '-' || *c == '+')) {
+        negative = *c == '-';
+        c++;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int significantDigits = 0;
+    bool hasDigits = false;
+
+    // Integer part
+    for (; c < end && isDigit(*c); c++) {
+        hasDigits = true;
+
+        if (significantDigits < 19) {
+            mantissa = mantissa * 10 + (*c - '0');
+            significantDigits += mantissa != 0;
+        }
+        else
+            exponent++;
+    }
+
+    // Fractional part
+    if (c < end && *c == '.') {
+        c++;
+
+        for (; c < end && isDigit(*c); c++) {
+            hasDigits = true;
+
+            if (significantDigits < 19) {
+                mantissa = mantissa * 10 + (*c - '0');
+                significantDigits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+
+    if (!hasDigits) {
+        value = 0.0f;
+        return false;
+    }
+
+    // Exponent part, only when followed by digits
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        const char * e = c + 1;
+        bool negativeExponent = false;
+
+        if (e < end && (*e == '-' || *e == '+')) {
+            negativeExponent = *e == '-';
+            e++;
+        }
+
+        if (e < end && isDigit(*e)) {
+            int explicitExponent = 0;
+
+            for (; e < end && isDigit(*e); e++)
+                if (explicitExponent < 100000)
+                    explicitExponent = explicitExponent * 10 + (*e - '0');
+
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            c = e;
+        }
+    }
+
+    cursor = c;
+
+    if (mantissa == 0) {
+        value = negative ? -0.0f : 0.0f;
+        return true;
+    }
+
+    while (mantissa % 10 == 0) {
+        mantissa /= 10;
+        exponent++;
+    }
+
+    // Exact operands give a correctly rounded result
+    if (significantDigits < 19 && mantissa <= (1 << 24) &&
+            exponent >= -10 && exponent <= 10) {
+        double m = (double)mantissa;
+
+        if (exponent < 0)
+            value = (float)(m / POWERS_OF_TEN[-exponent]);
+        else
+            value = (float)(m * POWERS_OF_TEN[exponent]);
+
+        if (negative)
+            value = -value;
+
+        return true;
+    }
+
+    // Slow path over a null terminated copy of the token
+    char buffer[128];
+    size_t length = c - start;
+
+    if (length < sizeof(buffer)) {
+        std::memcpy(buffer, start, length);
+        buffer[length] = '\0';
+
+        value = std::strtof(buffer, nullptr);
+    }
+    else
+        value = std::strtof(std::string(start, length).c_str(), nullptr);
+
+    return true;
+}
+
+// Parse signed decimal integer without allocations
+bool parseInteger(const char *& cursor, const char * end, int64_t & value) {
+    const char * c = cursor;
+    bool negative = false;
+
+    if (c < end && (*c == '-' || *c == '+')) {
+        negative = *c == '-';
+        c++;
+    }
+
+    if (c == end || !isDigit(*c))
+        return false;
+
+    uint64_t magnitude = 0;
+
+    for (; c < end && isDigit(*c); c++)
+        magnitude = magnitude * 10 + (*c - '0');
+
+    value = negative ? -(int64_t)magnitude : (int64_t)magnitude;
+    cursor = c;
+
+    return true;
+}
+
+// Convert one based or negative relative index to zero based
+inline uint32_t resolveIndex(int64_t index, size_t count) {
+    return (uint32_t)(index < 0 ? count + (size_t)index : (size_t)index - 1);
+}
+
+// Whether every index addresses one of the given number of attributes
+bool indicesInRange(const uint32_t * indices, size_t indexCount, size_t count) {
+    for (size_t i = 0; i < indexCount; i++) {
+        if (indices[i] >= count)
+            return false;
+    }
+
+    return true;
+}
+
+// Compare line type token
+inline bool isType(const char * token, size_t length, const char * type) {
+    return length == std::strlen(type) && std::memcmp(token, type, length) == 0;
+}
+
+// Scan the lines of a chunk, counting or storing attributes and indices
+template <bool Store>
+void scanChunk(
+        const char * c,
+        const char * end,
+        ChunkCounts & counts,
+        const ChunkOutput * output) {
+    while (c < end) {
+        const char * lineEnd = (const char *)std::memchr(c, '\n', end - c);
+
+        if (lineEnd == nullptr)
+            lineEnd = end;
+
+        c = skipBlanks(c, lineEnd);
+
+        const char * token = c;
+
+        while (c < lineEnd && !isBlank(*c))
+            c++;
+
+        size_t length = c - token;
+
+        if (isType(token, length, "v")) {
+            if (Store) {
+                glm::vec3 & position = output->positions[counts.positions];
+
+                parseFloat(c, lineEnd, position.x) &&
+                    parseFloat(c, lineEnd, position.y) &&
+                    parseFloat(c, lineEnd, position.z);
+            }
+
+            counts.positions++;
+        }
+        else if (isType(token, length, "vt")) {
+            if (Store) {
+                glm::vec2 & textureCoordinate =
+                    output->textureCoordinates[counts.textureCoordinates];
+
+                parseFloat(c, lineEnd, textureCoordinate.x) &&
+                    parseFloat(c, lineEnd, textureCoordinate.y);
+            }
+
+            counts.textureCoordinates++;
+        }
+        else if (isType(token, length, "vn")) {
+            if (Store) {
+                glm::vec3 & normal = output->normals[counts.normals];
+
+                parseFloat(c, lineEnd, normal.x) &&
+                    parseFloat(c, lineEnd, normal.y) &&
+                    parseFloat(c, lineEnd, normal.z);
+            }
+
+            counts.normals++;
+        }
+        else if (isType(token, length, "f")) {
+            for (size_t i = 0; i < 3; i++) {
+                c = skipBlanks(c, lineEnd);
+
+                int64_t index;
+
+                if (!parseInteger(c, lineEnd, index))
+                    break;
+
+                if (Store)
+                    output->positionIndices[counts.positionIndices] = resolveIndex(
+                        index, output->base.positions + counts.positions);
+
+                counts.positionIndices++;
+
+                if (c == lineEnd || *c != '/')
+                    continue;
+
+                c++;
+
+                // Texture coordinate index is absent in the v//vn form
+                if (c < lineEnd && *c != '/') {
+                    if (!parseInteger(c, lineEnd, index))
+                        continue;
+
+                    if (Store)
+                        output->textureCoordinateIndices[counts.textureCoordinateIndices] =
+                            resolveIndex(index,
+                                output->base.textureCoordinates + counts.textureCoordinates);
+
+                    counts.textureCoordinateIndices++;
+                }
+
+                if (c == lineEnd || *c != '/')
+                    continue;
+
+                c++;
+
+                if (!parseInteger(c, lineEnd, index))
+                    continue;
+
+                if (Store)
+                    output->normalIndices[counts.normalIndices] = resolveIndex(
+                        index, output->base.normals + counts.normals);
+
+                counts.normalIndices++;
+            }
+        }
+
+        c = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+// Parse line aligned buffer in parallel chunks into a triangle mesh
+// Chunks are counted first, so the mesh arena is allocated once at its
+// final size. Relative indices are resolved against the attribute counts
+// read before the buffer. Normal or texture coordinate indices missing on
+// some corners are dropped altogether. Returns the number of chunks, zero
+// when an index addresses no attribute read so far.
+size_t parseBuffer(
+        const char * data,
+        size_t size,
+        const ChunkCounts & previous,
+        TriangleMesh & mesh) {
+    // Split buffer in line aligned chunks
+    size_t chunkCount = std::max<size_t>(
+        1, std::min(threadCount() * 4, size / MINIMUM_CHUNK_SIZE));
+
+    std::vector<size_t> boundaries(chunkCount + 1, size);
+    boundaries[0] = 0;
+
+    for (size_t i = 1; i < chunkCount; i++) {
+        size_t offset = std::max(boundaries[i - 1], size / chunkCount * i);
+
+        if (offset < size && offset > 0 && data[offset - 1] != '\n')
+            offset = nextLine(data + offset, data + size) - data;
+
+        boundaries[i] = offset;
+    }
+
+    // Count attributes and indices of every chunk
+    std::vector<ChunkCounts> counts(chunkCount);
+
+    parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            std::memset(&counts[i], 0, sizeof(ChunkCounts));
+
+            scanChunk<false>(
+                data + boundaries[i], data + boundaries[i + 1], counts[i], nullptr);
+        }
+    });
+
+    // Compute chunk offsets in the mesh arrays
+    std::vector<ChunkOutput> outputs(chunkCount);
+    ChunkCounts total;
+    std::memset(&total, 0, sizeof(ChunkCounts));
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        outputs[i].base = total;
+
+        total.positions += counts[i].positions;
+        total.normals += counts[i].normals;
+        total.textureCoordinates += counts[i].textureCoordinates;
+        total.positionIndices += counts[i].positionIndices;
+        total.normalIndices += counts[i].normalIndices;
+        total.textureCoordinateIndices += counts[i].textureCoordinateIndices;
+    }
+
+    TriangleMeshCounts meshCounts = {
+        total.positions,
+        total.normals,
+        total.textureCoordinates,
+        total.positionIndices,
+        total.normalIndices,
+        total.textureCoordinateIndices
+    };
+
+    mesh.allocate(meshCounts);
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        ChunkOutput & output = outputs[i];
+
+        output.positions = mesh.positions() + output.base.positions;
+        output.normals = mesh.normals() + output.base.normals;
+        output.textureCoordinates = mesh.textureCoordinates() + output.base.textureCoordinates;
+        output.positionIndices = mesh.positionIndices() + output.base.positionIndices;
+        output.normalIndices = mesh.normalIndices() + output.base.normalIndices;
+        output.textureCoordinateIndices =
+            mesh.textureCoordinateIndices() + output.base.textureCoordinateIndices;
+
+        // Relative indices count the attributes of previous buffers too
+        output.base.positions += previous.positions;
+        output.base.normals += previous.normals;
+        output.base.textureCoordinates += previous.textureCoordinates;
+    }
+
+    // Parse chunks directly into their output ranges, then check their
+    // indices against the attributes read up to the end of the buffer
+    size_t positionCount = previous.positions + total.positions;
+    size_t normalCount = previous.normals + total.normals;
+    size_t textureCoordinateCount = previous.textureCoordinates + total.textureCoordinates;
+
+    std::vector<unsigned char> valid(chunkCount);
+
+    parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            ChunkCounts cursor;
+            std::memset(&cursor, 0, sizeof(ChunkCounts));
+
+            scanChunk<true>(
+                data + boundaries[i], data + boundaries[i + 1], cursor, &outputs[i]);
+
+            const ChunkOutput & output = outputs[i];
+
+            valid[i] =
+                indicesInRange(output.positionIndices, cursor.positionIndices, positionCount) &&
+                indicesInRange(output.normalIndices, cursor.normalIndices, normalCount) &&
+                indicesInRange(
+                    output.textureCoordinateIndices,
+                    cursor.textureCoordinateIndices,
+                    textureCoordinateCount);
+        }
+    });
+
+    if (std::find(valid.begin(), valid.end(), 0) != valid.end())
+        return 0;
+
+    // Corner attributes are kept only when read for every corner, as
+    // otherwise they cannot be matched to their corners
+    if (total.normalIndices != total.positionIndices)
+        meshCounts.normalIndices = 0;
+
+    if (total.textureCoordinateIndices != total.positionIndices)
+        meshCounts.textureCoordinateIndices = 0;
+
+    mesh.truncate(meshCounts);
+
+    return chunkCount;
+}
+
+}
+
+double MeshReadStatistics::megabytesPerSecond() const {
+    return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+bool readTriangleMesh(
+        const std::string & filename,
+        TriangleMesh & mesh,
+        MeshReadStatistics * statistics) {
+    PROFILE_ZONE("readTriangleMesh");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    MappedFile file;
+
+    if (!file.open(filename))
+        return false;
+
+    ChunkCounts previous;
+    std::memset(&previous, 0, sizeof(ChunkCounts));
+
+    size_t chunkCount = parseBuffer(file.data(), file.size(), previous, mesh);
+
+    if (chunkCount == 0)
+        return false;
+
+    if (statistics != nullptr) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        statistics->bytes = file.size();
+        statistics->chunks = chunkCount;
+        statistics->seconds = elapsed.count();
+    }
+
+    return true;
+}
+
+bool streamTriangleMesh(
+        const std::string & filename,
+        size_t blockSize,
+        const TriangleMeshBlockFunction & function,
+        MeshReadStatistics * statistics) {
+    PROFILE_ZONE("streamTriangleMesh");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    std::vector<char> buffer(std::max<size_t>(blockSize, 1));
+    size_t carried = 0;
+    size_t bytes = 0;
+    size_t chunks = 0;
+
+    ChunkCounts previous;
+    std::memset(&previous, 0, sizeof(ChunkCounts));
+
+    TriangleMesh block;
+    bool end = false;
+
+    while (!end) {
+        // Fill the buffer after the partial line carried from the last block
+        file.read(buffer.data() + carried, buffer.size() - carried);
+
+        size_t size = carried + (size_t)file.gcount();
+        end = !file;
+        bytes += size - carried;
+
+        // Parse complete lines only, unless the file ended
+        size_t parsed = size;
+
+        if (!end) {
+            while (parsed > 0 && buffer[parsed - 1] != '\n')
+                parsed--;
+
+            // Grow the buffer of a line longer than the block
+            if (parsed == 0) {
+                carried = size;
+                buffer.resize(buffer.size() * 2);
+                continue;
+            }
+        }
+
+        // Blocks reuse the arena of the previous one when large enough
+        size_t blockChunks = parseBuffer(buffer.data(), parsed, previous, block);
+
+        if (blockChunks == 0)
+            return false;
+
+        chunks += blockChunks;
+
+        previous.positions += block.counts().positions;
+        previous.normals += block.counts().normals;
+        previous.textureCoordinates += block.counts().textureCoordinates;
+
+        if (!function(block))
+            return false;
+
+        carried = size - parsed;
+        std::memmove(buffer.data(), buffer.data() + parsed, carried);
+    }
+
+    if (statistics != nullptr) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        statistics->bytes = bytes;
+        statistics->chunks = chunks;
+        statistics->seconds = elapsed.count();
+    }
+
+    return true;
+}
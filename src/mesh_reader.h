@@ -0,0 +1,45 @@
+#ifndef MESH_READER_H
+#define MESH_READER_H
+
+#include "mesh.h"
+
+#include <functional>
+#include <string>
+
+// Timing of a mesh file read
+struct MeshReadStatistics {
+    size_t bytes;
+    size_t chunks;
+    double seconds;
+
+    // Throughput in megabytes per second
+    double megabytesPerSecond() const;
+};
+
+// Read triangle mesh from Wavefront OBJ file format
+// The file is memory mapped and split in line aligned chunks parsed in
+// parallel, after a counting pass sizing the mesh arena. Faces are read as
+// triangles in the v, v/vt, v//vn and v/vt/vn forms, negative indices are
+// resolved relative to the attributes read so far. Normal and texture
+// coordinate indices are dropped unless read for every corner, and the read
+// fails on indices past the attributes of the file.
+bool readTriangleMesh(
+        const std::string & filename,
+        TriangleMesh & mesh,
+        MeshReadStatistics * statistics = nullptr);
+
+// Consume a block of a streamed mesh file, whose indices are zero based over
+// the attributes of the whole file, returning false to stop reading
+typedef std::function<bool(const TriangleMesh & block)> TriangleMeshBlockFunction;
+
+// Read triangle mesh from Wavefront OBJ file format one block at a time
+// Only one line aligned block of about the given size in bytes is held in
+// memory, parsed in parallel chunks as by readTriangleMesh, so files larger
+// than memory can be processed.
+bool streamTriangleMesh(
+        const std::string & filename,
+        size_t blockSize,
+        const TriangleMeshBlockFunction & function,
+        MeshReadStatistics * statistics = nullptr);
+
+#endif
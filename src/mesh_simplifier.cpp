@@ -0,0 +1,348 @@
+#include "mesh_simplifier.h"
+
+#include "mesh_adjacency.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const uint32_t INVALID_INDEX = 0xffffffffu;
+const uint64_t EMPTY_EDGE = ~0ull;
+
+// Symmetric 4x4 quadric of plane distances, weighted by triangle area
+struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+Quadric planeQuadric(const glm::vec3 & normal, float distance, float weight) {
+    double x = normal.x, y = normal.y, z = normal.z, d = distance;
+
+    Quadric q;
+    q.a00 = weight * x * x;
+    q.a01 = weight * x * y;
+    q.a02 = weight * x * z;
+    q.a11 = weight * y * y;
+    q.a12 = weight * y * z;
+    q.a22 = weight * z * z;
+    q.b0 = weight * x * d;
+    q.b1 = weight * y * d;
+    q.b2 = weight * z * d;
+    q.c = weight * d * d;
+    q.weight = weight;
+
+    return q;
+}
+
+void addQuadric(Quadric & q, const Quadric & r) {
+    q.a00 += r.a00;
+    q.a01 += r.a01;
+    q.a02 += r.a02;
+    q.a11 += r.a11;
+    q.a12 += r.a12;
+    q.a22 += r.a22;
+    q.b0 += r.b0;
+    q.b1 += r.b1;
+    q.b2 += r.b2;
+    q.c += r.c;
+    q.weight += r.weight;
+}
+
+// Mean squared distance of a point to the planes of a quadric
+double quadricError(const Quadric & q, const glm::vec3 & p) {
+    double x = p.x, y = p.y, z = p.z;
+
+    double error =
+        q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+        2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+        2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) +
+        q.c;
+
+    return q.weight > 0.0 ? std::max(error, 0.0) / q.weight : 0.0;
+}
+
+// Edge collapse of a vertex onto a neighbor vertex
+struct Collapse {
+    uint32_t vertex;
+    uint32_t target;
+    float error;
+};
+
+// Open addressing set of directed edges between positions
+class EdgeSet {
+public:
+    explicit EdgeSet(size_t capacity) {
+        size_t size = 16;
+
+        while (size < capacity * 2)
+            size <<= 1;
+
+        slots.assign(size, EMPTY_EDGE);
+        mask = size - 1;
+    }
+
+    void insert(uint32_t a, uint32_t b) {
+        uint64_t key = ((uint64_t)a << 32) | b;
+        size_t slot = hashEdge(key) & mask;
+
+        while (slots[slot] != EMPTY_EDGE && slots[slot] != key)
+            slot = (slot + 1) & mask;
+
+        slots[slot] = key;
+    }
+
+    bool contains(uint32_t a, uint32_t b) const {
+        uint64_t key = ((uint64_t)a << 32) | b;
+        size_t slot = hashEdge(key) & mask;
+
+        while (slots[slot] != EMPTY_EDGE) {
+            if (slots[slot] == key)
+                return true;
+
+            slot = (slot + 1) & mask;
+        }
+
+        return false;
+    }
+
+private:
+    static uint64_t hashEdge(uint64_t key) {
+        key *= 0x9e3779b97f4a7c15ull;
+        return key ^ (key >> 32);
+    }
+
+    std::vector<uint64_t> slots;
+    size_t mask;
+};
+
+// Check that moving a vertex onto a target keeps the orientation of every
+// triangle around it that is not removed by the collapse
+bool flipsTriangles(
+        const std::vector<Vertex> & vertices,
+        const std::vector<uint32_t> & indices,
+        const TriangleAdjacency & adjacency,
+        uint32_t vertex,
+        uint32_t target) {
+    const glm::vec3 & position = vertices[target].position;
+
+    for (uint32_t i = adjacency.offsets[vertex]; i < adjacency.offsets[vertex + 1]; i++) {
+        const uint32_t * triangle = &indices[adjacency.triangles[i] * 3];
+
+        if (triangle[0] == target || triangle[1] == target || triangle[2] == target)
+            continue;
+
+        glm::vec3 p[3];
+
+        for (size_t j = 0; j < 3; j++)
+            p[j] = vertices[triangle[j]].position;
+
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+        for (size_t j = 0; j < 3; j++)
+            if (triangle[j] == vertex)
+                p[j] = position;
+
+        glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+        if (glm::dot(before, after) <= 0.0f)
+            return true;
+    }
+
+    return false;
+}
+
+}
+
+float simplifyMesh(
+        const std::vector<Vertex> & vertices,
+        const std::vector<uint32_t> & indices,
+        size_t targetIndexCount,
+        float maximumError,
+        std::vector<uint32_t> & result) {
+    size_t vertexCount = vertices.size();
+
+    result = indices;
+
+    if (result.size() <= targetIndexCount)
+        return 0.0f;
+
+    // Vertices sharing a position with other vertices are attribute seams
+    std::vector<uint32_t> positionVertices;
+    std::vector<uint32_t> positionCounts(vertexCount, 0);
+
+    buildPositionRemap(vertices, positionVertices);
+
+    for (size_t i = 0; i < vertexCount; i++)
+        positionCounts[positionVertices[i]]++;
+
+    std::vector<bool> locked(vertexCount, false);
+
+    for (size_t i = 0; i < vertexCount; i++)
+        locked[i] = positionCounts[positionVertices[i]] > 1;
+
+    // Vertices of edges without an opposite edge between the same positions are borders
+    {
+        EdgeSet edges(result.size());
+
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (size_t j = 0; j < 3; j++)
+                edges.insert(
+                    positionVertices[result[i + j]],
+                    positionVertices[result[i + (j + 1) % 3]]);
+
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (size_t j = 0; j < 3; j++) {
+                uint32_t a = result[i + j];
+                uint32_t b = result[i + (j + 1) % 3];
+
+                if (!edges.contains(positionVertices[b], positionVertices[a]))
+                    locked[a] = locked[b] = true;
+            }
+    }
+
+    // Sum of the plane quadrics of the triangles around every vertex
+    std::vector<Quadric> quadrics(vertexCount);
+    std::memset(quadrics.data(), 0, vertexCount * sizeof(Quadric));
+
+    for (size_t i = 0; i < result.size(); i += 3) {
+        const glm::vec3 & p0 = vertices[result[i]].position;
+        const glm::vec3 & p1 = vertices[result[i + 1]].position;
+        const glm::vec3 & p2 = vertices[result[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+
+        if (!(area > 0.0f))
+            continue;
+
+        normal /= area;
+
+        Quadric quadric = planeQuadric(normal, -glm::dot(normal, p0), 0.5f * area);
+
+        for (size_t j = 0; j < 3; j++)
+            addQuadric(quadrics[result[i + j]], quadric);
+    }
+
+    double errorLimit = (double)maximumError * maximumError;
+    double resultError = 0.0;
+
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    TriangleAdjacency adjacency;
+
+    // Collapse the cheapest independent edges in passes until the target is reached
+    while (result.size() > targetIndexCount) {
+        buildTriangleAdjacency(result, result.size(), vertexCount, adjacency);
+
+        // Cheapest direction of every edge with a removable vertex
+        collapses.clear();
+
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (size_t j = 0; j < 3; j++) {
+                uint32_t a = result[i + j];
+                uint32_t b = result[i + (j + 1) % 3];
+
+                // Every interior edge is seen twice, keep the first
+                if (!locked[a] && !locked[b] && a > b)
+                    continue;
+
+                Collapse collapse;
+                collapse.error = -1.0f;
+
+                if (!locked[a]) {
+                    collapse.vertex = a;
+                    collapse.target = b;
+                    collapse.error = (float)quadricError(quadrics[a], vertices[b].position);
+                }
+
+                if (!locked[b]) {
+                    float error = (float)quadricError(quadrics[b], vertices[a].position);
+
+                    if (collapse.error < 0.0f || error < collapse.error) {
+                        collapse.vertex = b;
+                        collapse.target = a;
+                        collapse.error = error;
+                    }
+                }
+
+                if (collapse.error >= 0.0f && collapse.error <= errorLimit)
+                    collapses.push_back(collapse);
+            }
+
+        if (collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse & a, const Collapse & b) {
+            return a.error < b.error;
+        });
+
+        // Every collapse of a manifold edge removes two triangles
+        size_t triangleGoal = (result.size() - targetIndexCount) / 3;
+        size_t removedTriangles = 0;
+        size_t collapseCount = 0;
+
+        for (uint32_t i = 0; i < vertexCount; i++)
+            remap[i] = i;
+
+        std::fill(touched.begin(), touched.end(), false);
+
+        for (size_t i = 0; i < collapses.size() && removedTriangles < triangleGoal; i++) {
+            const Collapse & collapse = collapses[i];
+            uint32_t vertex = collapse.vertex;
+            uint32_t target = collapse.target;
+
+            // Triangles around a collapse are fixed until the next pass
+            if (touched[vertex] || touched[target])
+                continue;
+
+            if (flipsTriangles(vertices, result, adjacency, vertex, target))
+                continue;
+
+            for (uint32_t j = adjacency.offsets[vertex]; j < adjacency.offsets[vertex + 1]; j++) {
+                const uint32_t * triangle = &result[adjacency.triangles[j] * 3];
+
+                if (triangle[0] == target || triangle[1] == target || triangle[2] == target)
+                    removedTriangles++;
+
+                for (size_t k = 0; k < 3; k++)
+                    touched[triangle[k]] = true;
+            }
+
+            remap[vertex] = target;
+            addQuadric(quadrics[target], quadrics[vertex]);
+
+            resultError = std::max(resultError, (double)collapse.error);
+            collapseCount++;
+        }
+
+        if (collapseCount == 0)
+            break;
+
+        // Apply collapses and remove degenerate triangles
+        size_t write = 0;
+
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t a = remap[result[i]];
+            uint32_t b = remap[result[i + 1]];
+            uint32_t c = remap[result[i + 2]];
+
+            if (a == b || b == c || c == a)
+                continue;
+
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+
+        result.resize(write);
+    }
+
+    return (float)std::sqrt(resultError);
+}
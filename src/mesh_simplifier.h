@@ -0,0 +1,24 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+// Simplify a triangle list by collapsing edges onto existing vertices, in
+// order of quadric error (Garland and Heckbert, Surface Simplification Using
+// Quadric Error Metrics, 1997), until the index count reaches the target or
+// every remaining collapse exceeds the maximum error. The result references
+// the same vertices, so every simplified level shares one vertex buffer.
+// Vertices on open borders and attribute seams, where several vertices share
+// a position, are never removed. Collapses that flip a triangle are rejected.
+// Returns the error of the result as a distance in mesh units.
+float simplifyMesh(
+        const std::vector<Vertex> & vertices,
+        const std::vector<uint32_t> & indices,
+        size_t targetIndexCount,
+        float maximumError,
+        std::vector<uint32_t> & result);
+
+#endif
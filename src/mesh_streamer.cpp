@@ -0,0 +1,521 @@
+#include "mesh_streamer.h"
+
+#include "profiler.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// Insert vertex at the middle of an edge of the unit sphere, once per edge
+uint32_t midpoint(
+        std::vector<Vertex> & vertices,
+        std::vector<std::pair<uint64_t, uint32_t> > & midpoints,
+        uint32_t a,
+        uint32_t b) {
+    uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+
+    for (size_t i = 0; i < midpoints.size(); i++)
+        if (midpoints[i].first == key)
+            return midpoints[i].second;
+
+    Vertex vertex;
+    vertex.position = glm::normalize(vertices[a].position + vertices[b].position);
+    vertex.normal = vertex.position;
+    vertex.textureCoordinate = glm::vec2(0.0f);
+
+    vertices.push_back(vertex);
+    midpoints.push_back(std::make_pair(key, (uint32_t)(vertices.size() - 1)));
+
+    return (uint32_t)(vertices.size() - 1);
+}
+
+}
+
+void defineVertexAttributes(const VertexLayout & layout) {
+    GLsizei stride = (GLsizei)layout.stride;
+    const size_t * offsets = layout.attributeOffsets;
+    
+    if (layout.format == VERTEX_FORMAT_FLOAT) {
+        // Define position attribute to shader program
+        glVertexAttribPointer(
+            0,
+            3,
+            GL_FLOAT,
+            false,
+            stride,
+            (const GLvoid *)offsets[VERTEX_ATTRIBUTE_POSITION]);
+        
+        // Define normal attribute to shader program
+        glVertexAttribPointer(
+            1,
+            3,
+            GL_FLOAT,
+            false,
+            stride,
+            (const GLvoid *)offsets[VERTEX_ATTRIBUTE_NORMAL]);
+        
+        // Define texture attribute to shader program
+        glVertexAttribPointer(
+            2,
+            2,
+            GL_FLOAT,
+            false,
+            stride,
+            (const GLvoid *)offsets[VERTEX_ATTRIBUTE_TEXTURE_COORDINATE]);
+        
+        // Define tangent attribute to shader program
+        glVertexAttribPointer(
+            3,
+            4,
+            GL_FLOAT,
+            false,
+            stride,
+            (const GLvoid *)offsets[VERTEX_ATTRIBUTE_TANGENT]);
+    }
+    else {
+        // Define quantized position attribute to shader program
+        glVertexAttribPointer(
+            0,
+            3,
+            GL_UNSIGNED_SHORT,
+            true,
+            stride,
+            (const GLvoid *)offsets[VERTEX_ATTRIBUTE_POSITION]);
+        
+        // Define octahedral normal attribute to shader program
+        if (layout.format == VERTEX_FORMAT_COMPACT)
+            glVertexAttribPointer(
+                1,
+                2,
+                GL_SHORT,
+                true,
+                stride,
+                (const GLvoid *)offsets[VERTEX_ATTRIBUTE_NORMAL]);
+        else
+            glVertexAttribPointer(
+                1,
+                4,
+                GL_INT_2_10_10_10_REV,
+                true,
+                stride,
+                (const GLvoid *)offsets[VERTEX_ATTRIBUTE_NORMAL]);
+        
+        // Define half float texture attribute to shader program
+        glVertexAttribPointer(
+            2,
+            2,
+            GL_HALF_FLOAT,
+            false,
+            stride,
+            (const GLvoid *)offsets[VERTEX_ATTRIBUTE_TEXTURE_COORDINATE]);
+        
+        // Define octahedral tangent attribute to shader program
+        glVertexAttribPointer(
+            3,
+            4,
+            GL_INT_2_10_10_10_REV,
+            true,
+            stride,
+            (const GLvoid *)offsets[VERTEX_ATTRIBUTE_TANGENT]);
+    }
+    
+    // Enable position attribute to shader program
+    glEnableVertexAttribArray(0);
+    
+    // Enable normal attribute to shader program
+    glEnableVertexAttribArray(1);
+    
+    // Enable texture attribute to shader program
+    if (layout.hasTextureCoordinates)
+        glEnableVertexAttribArray(2);
+    else
+        glDisableVertexAttribArray(2);
+    
+    // Enable tangent attribute to shader program
+    if (layout.hasTangents)
+        glEnableVertexAttribArray(3);
+    else
+        glDisableVertexAttribArray(3);
+}
+
+void uploadTriangleMesh(
+        const void * vertices,
+        size_t vertexBytes,
+        const VertexLayout & layout,
+        const void * indices,
+        size_t indexBytes,
+        GLenum usage,
+        GLuint & vao,
+        GLuint & vbo,
+        GLuint & ebo) {
+    PROFILE_ZONE("uploadTriangleMesh");
+
+    // Create and bind vertex array object
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    
+    // Create and bind vertex buffer object
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    
+    // Copy vertex attribute data to vertex buffer object
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, usage);
+    
+    // Create and bind element buffer object, recorded by the vertex array object
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    
+    // Copy index data to element buffer object
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, usage);
+    
+    defineVertexAttributes(layout);
+}
+
+void buildPlaceholderMesh(IndexedMesh & mesh) {
+    mesh = IndexedMesh();
+
+    // Icosahedron subdivided once
+    const float t = 1.618034f;
+
+    const float corners[12][3] = {
+        { -1.0f, t, 0.0f }, { 1.0f, t, 0.0f }, { -1.0f, -t, 0.0f }, { 1.0f, -t, 0.0f },
+        { 0.0f, -1.0f, t }, { 0.0f, 1.0f, t }, { 0.0f, -1.0f, -t }, { 0.0f, 1.0f, -t },
+        { t, 0.0f, -1.0f }, { t, 0.0f, 1.0f }, { -t, 0.0f, -1.0f }, { -t, 0.0f, 1.0f }
+    };
+
+    const uint32_t faces[20][3] = {
+        { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+        { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+        { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+        { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+    };
+
+    for (size_t i = 0; i < 12; i++) {
+        Vertex vertex;
+        vertex.position = glm::normalize(glm::vec3(corners[i][0], corners[i][1], corners[i][2]));
+        vertex.normal = vertex.position;
+        vertex.textureCoordinate = glm::vec2(0.0f);
+
+        mesh.vertices.push_back(vertex);
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t> > midpoints;
+
+    for (size_t i = 0; i < 20; i++) {
+        uint32_t a = faces[i][0], b = faces[i][1], c = faces[i][2];
+
+        uint32_t ab = midpoint(mesh.vertices, midpoints, a, b);
+        uint32_t bc = midpoint(mesh.vertices, midpoints, b, c);
+        uint32_t ca = midpoint(mesh.vertices, midpoints, c, a);
+
+        const uint32_t triangles[12] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+        mesh.indices.insert(mesh.indices.end(), triangles, triangles + 12);
+    }
+
+    mesh.cornerCount = mesh.indices.size();
+    mesh.hasTextureCoordinates = false;
+}
+
+void destroyMeshBuffers(MeshBuffers & buffers) {
+    if (buffers.vao != 0)
+        glDeleteVertexArrays(1, &buffers.vao);
+
+    if (buffers.vbo != 0)
+        glDeleteBuffers(1, &buffers.vbo);
+
+    if (buffers.ebo != 0)
+        glDeleteBuffers(1, &buffers.ebo);
+
+    buffers.vao = 0;
+    buffers.vbo = 0;
+    buffers.ebo = 0;
+}
+
+MeshStreamer::MeshStreamer() :
+        uploadBudget(0), stop(false), uploading(nullptr), uploadedBytes(0), staging(0), frame(0) {
+    uploadBuffers.vao = 0;
+    uploadBuffers.vbo = 0;
+    uploadBuffers.ebo = 0;
+    uploadBuffers.indexType = GL_UNSIGNED_INT;
+
+    for (size_t i = 0; i < STAGING_RING_FRAMES; i++)
+        fences[i] = 0;
+}
+
+MeshStreamer::~MeshStreamer() {
+    destroy();
+}
+
+void MeshStreamer::create(const MeshReadFunction & read, size_t uploadBudget) {
+    destroy();
+
+    this->read = read;
+    this->uploadBudget = std::max(uploadBudget, (size_t)4096);
+
+    glGenBuffers(1, &staging);
+    glBindBuffer(GL_COPY_READ_BUFFER, staging);
+    glBufferData(GL_COPY_READ_BUFFER, STAGING_RING_FRAMES * this->uploadBudget, NULL, GL_STREAM_COPY);
+
+    stop = false;
+    worker = std::thread(&MeshStreamer::work, this);
+}
+
+void MeshStreamer::destroy() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+
+        available.notify_all();
+        worker.join();
+    }
+
+    requests.clear();
+
+    for (size_t i = 0; i < finished.size(); i++)
+        delete finished[i];
+
+    finished.clear();
+
+    if (uploading != nullptr) {
+        destroyMeshBuffers(uploadBuffers);
+
+        delete uploading;
+        uploading = nullptr;
+    }
+
+    for (size_t i = 0; i < STAGING_RING_FRAMES; i++) {
+        if (fences[i] != 0)
+            glDeleteSync(fences[i]);
+
+        fences[i] = 0;
+    }
+
+    if (staging != 0)
+        glDeleteBuffers(1, &staging);
+
+    staging = 0;
+    frame = 0;
+}
+
+void MeshStreamer::request(const std::string & filename) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (std::find(requests.begin(), requests.end(), filename) != requests.end())
+            return;
+
+        requests.push_back(filename);
+    }
+
+    available.notify_one();
+}
+
+bool MeshStreamer::busy() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return !requests.empty() || !reading.empty() || !finished.empty() || uploading != nullptr;
+}
+
+void MeshStreamer::work() {
+    for (;;) {
+        std::string filename;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (!stop && requests.empty())
+                available.wait(lock);
+
+            if (stop)
+                return;
+
+            filename = requests.front();
+            requests.pop_front();
+            reading = filename;
+        }
+
+        PROFILE_ZONE("Stream mesh");
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        StreamedMesh * mesh = new StreamedMesh();
+        mesh->filename = filename;
+        mesh->vertices = nullptr;
+        mesh->vertexBytes = 0;
+        mesh->indices = nullptr;
+        mesh->indexBytes = 0;
+        mesh->uploadFrames = 0;
+        mesh->skippedFrames = 0;
+
+        bool success = read(filename, *mesh);
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        mesh->readSeconds = elapsed.count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        reading.clear();
+
+        if (success)
+            finished.push_back(mesh);
+        else
+            delete mesh;
+    }
+}
+
+void MeshStreamer::beginUpload() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (finished.empty())
+            return;
+
+        uploading = finished.front();
+        finished.pop_front();
+    }
+
+    const PackedMesh & packed = uploading->packed;
+
+    // Allocate storage, filled by copies from the staging buffer
+    glGenVertexArrays(1, &uploadBuffers.vao);
+    glBindVertexArray(uploadBuffers.vao);
+
+    glGenBuffers(1, &uploadBuffers.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, uploadBuffers.vbo);
+    glBufferData(GL_ARRAY_BUFFER, uploading->vertexBytes, NULL, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &uploadBuffers.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, uploadBuffers.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, uploading->indexBytes, NULL, GL_STATIC_DRAW);
+
+    defineVertexAttributes(packed.layout);
+
+    glBindVertexArray(0);
+
+    uploadBuffers.indexType = packed.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    uploadedBytes = 0;
+}
+
+bool MeshStreamer::update(MeshBuffers & buffers, StreamedMesh & mesh) {
+    if (staging == 0)
+        return false;
+
+    if (uploading == nullptr)
+        beginUpload();
+
+    if (uploading == nullptr)
+        return false;
+
+    const unsigned char * vertices = uploading->vertices;
+    const unsigned char * indices = uploading->indices;
+    size_t totalVertexBytes = uploading->vertexBytes;
+    size_t totalBytes = totalVertexBytes + uploading->indexBytes;
+
+    // Nothing to copy from an empty mesh, and no staging region to map
+    if (totalBytes == 0) {
+        finishUpload(buffers, mesh);
+        return true;
+    }
+
+    PROFILE_ZONE("Upload mesh slices");
+
+    // Skip the frame while the GPU still copies from the region
+    GLsync & fence = fences[frame];
+
+    if (fence != 0) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            uploading->skippedFrames++;
+            return false;
+        }
+
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    size_t regionOffset = frame * uploadBudget;
+    size_t sliceBytes = std::min(uploadBudget, totalBytes - uploadedBytes);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, staging);
+
+    unsigned char * region = (unsigned char *)glMapBufferRange(
+        GL_COPY_READ_BUFFER,
+        regionOffset,
+        sliceBytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+    if (region == nullptr)
+        return false;
+
+    // Slices of the vertex blob then of the index blob
+    size_t vertexBytes = 0, indexBytes = 0;
+
+    if (uploadedBytes < totalVertexBytes) {
+        vertexBytes = std::min(sliceBytes, totalVertexBytes - uploadedBytes);
+        std::memcpy(region, vertices + uploadedBytes, vertexBytes);
+    }
+
+    size_t indexOffset = uploadedBytes + vertexBytes - totalVertexBytes;
+    indexBytes = sliceBytes - vertexBytes;
+
+    if (indexBytes > 0)
+        std::memcpy(region + vertexBytes, indices + indexOffset, indexBytes);
+
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    if (vertexBytes > 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, uploadBuffers.vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, regionOffset, uploadedBytes, vertexBytes);
+    }
+
+    if (indexBytes > 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, uploadBuffers.ebo);
+        glCopyBufferSubData(
+            GL_COPY_READ_BUFFER,
+            GL_COPY_WRITE_BUFFER,
+            regionOffset + vertexBytes,
+            indexOffset,
+            indexBytes);
+    }
+
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % STAGING_RING_FRAMES;
+
+    uploadedBytes += sliceBytes;
+    uploading->uploadFrames++;
+
+    if (uploadedBytes < totalBytes)
+        return false;
+
+    finishUpload(buffers, mesh);
+
+    return true;
+}
+
+void MeshStreamer::finishUpload(MeshBuffers & buffers, StreamedMesh & mesh) {
+    buffers = uploadBuffers;
+
+    mesh = std::move(*uploading);
+    mesh.packed.vertices.clear();
+    mesh.packed.vertices.shrink_to_fit();
+    mesh.packed.indices.clear();
+    mesh.packed.indices.shrink_to_fit();
+    mesh.cache.reset();
+    mesh.vertices = nullptr;
+    mesh.vertexBytes = 0;
+    mesh.indices = nullptr;
+    mesh.indexBytes = 0;
+
+    delete uploading;
+    uploading = nullptr;
+
+    uploadBuffers.vao = 0;
+    uploadBuffers.vbo = 0;
+    uploadBuffers.ebo = 0;
+}
@@ -0,0 +1,147 @@
+#ifndef MESH_STREAMER_H
+#define MESH_STREAMER_H
+
+#include <glad/glad.h>
+
+#include "bvh.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "occlusion_culling.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Frames of staging buffer regions in flight, each holding one frame of uploads
+const size_t STAGING_RING_FRAMES = 3;
+
+// Define vertex attributes of a layout from the bound vertex buffer object
+// to shader program at locations:
+// 0: position, normalized to the mesh bounds in compact formats
+// 1: normal, octahedral encoded in compact formats
+// 2: texture coordinate, absent in compact formats without them
+// 3: tangent with bitangent sign in w, when generated
+void defineVertexAttributes(const VertexLayout & layout);
+
+// Upload indexed triangle mesh to OpenGL at once
+void uploadTriangleMesh(
+        const void * vertices,
+        size_t vertexBytes,
+        const VertexLayout & layout,
+        const void * indices,
+        size_t indexBytes,
+        GLenum usage,
+        GLuint & vao,
+        GLuint & vbo,
+        GLuint & ebo);
+
+// Low polygon unit sphere drawn while a mesh is streamed
+void buildPlaceholderMesh(IndexedMesh & mesh);
+
+// Mesh read from file on the worker thread, with the picking hierarchy of
+// its full level of detail and its occluder when occlusion culling
+struct StreamedMesh {
+    std::string filename;
+
+    // Vertex and index blobs uploaded, read into the packed mesh or mapped
+    // from the mesh cache kept open meanwhile, and released once uploaded
+    PackedMesh packed;
+    std::shared_ptr<MeshCache> cache;
+    const unsigned char * vertices;
+    size_t vertexBytes;
+    const unsigned char * indices;
+    size_t indexBytes;
+
+    Bvh bvh;
+    OccluderMesh occluder;
+
+    double readSeconds;
+
+    // Frames spent uploading and frames skipped because every staging
+    // region was still in use
+    size_t uploadFrames;
+    size_t skippedFrames;
+};
+
+// Read mesh file into a streamed mesh, called on the worker thread
+typedef std::function<bool(const std::string & filename, StreamedMesh & mesh)> MeshReadFunction;
+
+// Vertex array object of an uploaded mesh and its buffers
+struct MeshBuffers {
+    GLuint vao;
+    GLuint vbo;
+    GLuint ebo;
+    GLenum indexType;
+};
+
+// Delete buffers of a mesh
+void destroyMeshBuffers(MeshBuffers & buffers);
+
+// Streaming of meshes read on a worker thread and uploaded over several
+// frames through a ring of staging buffer regions
+// Every frame copies at most the upload budget into the next region of the
+// staging buffer and from there into the mesh buffers. Regions still read
+// by the GPU, as told by their fences, skip the frame instead of stalling.
+class MeshStreamer {
+public:
+    MeshStreamer();
+    ~MeshStreamer();
+
+    // Start worker thread and create staging buffer of the budget in bytes
+    // per frame
+    void create(const MeshReadFunction & read, size_t uploadBudget);
+
+    // Stop worker thread and delete staging buffer and partial uploads
+    void destroy();
+
+    // Queue mesh file to be read, ignored when already queued
+    void request(const std::string & filename);
+
+    // Upload the next slices within the budget, returning true with the
+    // buffers and data of a mesh whose upload finished in this frame
+    bool update(MeshBuffers & buffers, StreamedMesh & mesh);
+
+    // Whether meshes are queued, being read or uploaded
+    bool busy();
+
+private:
+    MeshStreamer(const MeshStreamer &);
+    MeshStreamer & operator=(const MeshStreamer &);
+
+    void work();
+
+    // Create buffers of the next read mesh and define its vertex attributes
+    void beginUpload();
+
+    // Hand over the buffers and data of the uploaded mesh, releasing its blobs
+    void finishUpload(MeshBuffers & buffers, StreamedMesh & mesh);
+
+    MeshReadFunction read;
+    size_t uploadBudget;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stop;
+
+    // Files queued, file being read, and meshes read but not uploaded
+    std::deque<std::string> requests;
+    std::string reading;
+    std::deque<StreamedMesh *> finished;
+
+    // Mesh being uploaded and bytes of its vertex and index blobs uploaded
+    StreamedMesh * uploading;
+    MeshBuffers uploadBuffers;
+    size_t uploadedBytes;
+
+    GLuint staging;
+    size_t frame;
+    GLsync fences[STAGING_RING_FRAMES];
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include "meshlet.h"
+
+#include "mesh_adjacency.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const uint32_t INVALID_INDEX = 0xffffffffu;
+
+// Cones with a smaller minimum dot product between the axis and a normal
+// are too wide to be culled often enough
+const float MINIMUM_CONE_DOT = 0.1f;
+
+// Bounding sphere and normal cone of the triangles of a meshlet
+void computeMeshletBounds(
+        const std::vector<Vertex> & vertices,
+        const uint32_t * indices,
+        Meshlet & meshlet) {
+    glm::vec3 minimum(0.0f), maximum(0.0f);
+
+    if (meshlet.indexCount > 0)
+        minimum = maximum = vertices[indices[0]].position;
+
+    for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+        minimum = glm::min(minimum, vertices[indices[i]].position);
+        maximum = glm::max(maximum, vertices[indices[i]].position);
+    }
+
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    float radius = 0.0f;
+
+    for (uint32_t i = 0; i < meshlet.indexCount; i++)
+        radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+
+    // Cone around the mean triangle normal
+    std::vector<glm::vec3> normals;
+    glm::vec3 axis(0.0f);
+
+    for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+        const glm::vec3 & p0 = vertices[indices[i]].position;
+        const glm::vec3 & p1 = vertices[indices[i + 1]].position;
+        const glm::vec3 & p2 = vertices[indices[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+
+        if (!(length > 0.0f))
+            continue;
+
+        normals.push_back(normal / length);
+        axis += normal / length;
+    }
+
+    float axisLength = glm::length(axis);
+    float minimumDot = -1.0f;
+
+    if (axisLength > 0.0f) {
+        axis /= axisLength;
+        minimumDot = 1.0f;
+
+        for (size_t i = 0; i < normals.size(); i++)
+            minimumDot = std::min(minimumDot, glm::dot(normals[i], axis));
+    }
+
+    for (int i = 0; i < 3; i++) {
+        meshlet.center[i] = center[i];
+        meshlet.coneAxis[i] = axis[i];
+    }
+
+    meshlet.radius = radius;
+    meshlet.coneCutoff = minimumDot < MINIMUM_CONE_DOT ?
+        1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+}
+
+}
+
+void buildMeshlets(
+        const std::vector<Vertex> & vertices,
+        std::vector<uint32_t> & indices,
+        size_t indexCount,
+        std::vector<Meshlet> & meshlets) {
+    size_t triangleCount = indexCount / 3;
+
+    meshlets.clear();
+
+    // Triangles are neighbors through shared positions, so that meshlets
+    // also grow across normal and texture coordinate seams
+    std::vector<uint32_t> positionVertices;
+    buildPositionRemap(vertices, positionVertices);
+
+    std::vector<uint32_t> positionIndices(triangleCount * 3);
+
+    for (size_t i = 0; i < positionIndices.size(); i++)
+        positionIndices[i] = positionVertices[indices[i]];
+
+    TriangleAdjacency adjacency;
+    buildTriangleAdjacency(positionIndices, positionIndices.size(), vertices.size(), adjacency);
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> vertexMeshlets(vertices.size(), INVALID_INDEX);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+
+    output.reserve(triangleCount * 3);
+
+    size_t seed = 0;
+
+    while (output.size() < triangleCount * 3) {
+        // Seed a new meshlet with the first triangle left
+        while (emitted[seed])
+            seed++;
+
+        uint32_t id = (uint32_t)meshlets.size();
+        uint32_t triangle = (uint32_t)seed;
+        size_t vertexCount = 0;
+        size_t meshletTriangles = 0;
+
+        Meshlet meshlet;
+        meshlet.indexOffset = (uint32_t)output.size();
+
+        candidates.clear();
+
+        while (triangle != INVALID_INDEX) {
+            // Add triangle and the neighbors of its new vertices as candidates
+            for (size_t i = 0; i < 3; i++) {
+                uint32_t vertex = indices[triangle * 3 + i];
+
+                output.push_back(vertex);
+
+                if (vertexMeshlets[vertex] == id)
+                    continue;
+
+                vertexMeshlets[vertex] = id;
+                vertexCount++;
+
+                uint32_t position = positionVertices[vertex];
+
+                for (uint32_t j = adjacency.offsets[position]; j < adjacency.offsets[position + 1]; j++)
+                    if (!emitted[adjacency.triangles[j]])
+                        candidates.push_back(adjacency.triangles[j]);
+            }
+
+            emitted[triangle] = true;
+            meshletTriangles++;
+
+            if (meshletTriangles == MESHLET_MAX_TRIANGLES)
+                break;
+
+            // Choose the candidate adding the fewest vertices, dropping emitted ones
+            triangle = INVALID_INDEX;
+            size_t bestNewVertices = 4;
+            size_t write = 0;
+
+            for (size_t i = 0; i < candidates.size(); i++) {
+                uint32_t candidate = candidates[i];
+
+                if (emitted[candidate])
+                    continue;
+
+                candidates[write++] = candidate;
+
+                size_t newVertices =
+                    (vertexMeshlets[indices[candidate * 3]] != id) +
+                    (vertexMeshlets[indices[candidate * 3 + 1]] != id) +
+                    (vertexMeshlets[indices[candidate * 3 + 2]] != id);
+
+                if (newVertices < bestNewVertices && vertexCount + newVertices <= MESHLET_MAX_VERTICES) {
+                    bestNewVertices = newVertices;
+                    triangle = candidate;
+                }
+            }
+
+            candidates.resize(write);
+        }
+
+        meshlet.indexCount = (uint32_t)(output.size() - meshlet.indexOffset);
+        computeMeshletBounds(vertices, output.data() + meshlet.indexOffset, meshlet);
+
+        meshlets.push_back(meshlet);
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void extractFrustumPlanes(const glm::mat4 & modelViewProjection, glm::vec4 planes[6]) {
+    const glm::mat4 & m = modelViewProjection;
+
+    // Rows of the matrix combined as in Gribb and Hartmann
+    glm::vec4 rows[4];
+
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    for (int i = 0; i < 3; i++) {
+        planes[i * 2] = rows[3] + rows[i];
+        planes[i * 2 + 1] = rows[3] - rows[i];
+    }
+
+    for (int i = 0; i < 6; i++) {
+        float length = glm::length(glm::vec3(planes[i]));
+
+        if (length > 0.0f)
+            planes[i] /= length;
+    }
+}
+
+void cullMeshlets(
+        const std::vector<Meshlet> & meshlets,
+        const glm::vec4 planes[6],
+        const glm::vec3 & cameraPosition,
+        std::vector<uint32_t> & visible,
+        MeshletCullingStatistics * statistics) {
+    visible.clear();
+
+    for (size_t i = 0; i < meshlets.size(); i++) {
+        const Meshlet & meshlet = meshlets[i];
+        glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+
+        // Sphere entirely outside of a plane
+        bool outside = false;
+
+        for (int j = 0; j < 6 && !outside; j++)
+            outside = glm::dot(glm::vec3(planes[j]), center) + planes[j].w < -meshlet.radius;
+
+        if (outside)
+            continue;
+
+        // Every triangle faces away from every camera direction into the sphere
+        glm::vec3 axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+        glm::vec3 direction = center - cameraPosition;
+
+        if (glm::dot(direction, axis) >= meshlet.coneCutoff * glm::length(direction) + meshlet.radius)
+            continue;
+
+        visible.push_back((uint32_t)i);
+    }
+
+    if (statistics != nullptr) {
+        statistics->tested = meshlets.size();
+        statistics->drawn = visible.size();
+    }
+}
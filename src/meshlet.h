@@ -0,0 +1,46 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include "mesh.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Maximum number of unique vertices and triangles of a meshlet
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+// Counters of a culling pass
+struct MeshletCullingStatistics {
+    size_t tested;
+    size_t drawn;
+};
+
+// Partition the first index count indices of a mesh into meshlets, growing
+// every meshlet from a seed triangle over the neighbor triangles adding the
+// fewest vertices. Indices are reordered so that every meshlet is a
+// contiguous range.
+void buildMeshlets(
+        const std::vector<Vertex> & vertices,
+        std::vector<uint32_t> & indices,
+        size_t indexCount,
+        std::vector<Meshlet> & meshlets);
+
+// Normalized planes of the view frustum of a model view projection matrix,
+// in model space with normals pointing inside
+void extractFrustumPlanes(const glm::mat4 & modelViewProjection, glm::vec4 planes[6]);
+
+// Collect the meshlets intersecting the frustum whose normal cone is not
+// entirely backfacing from the camera position, both in model space
+void cullMeshlets(
+        const std::vector<Meshlet> & meshlets,
+        const glm::vec4 planes[6],
+        const glm::vec3 & cameraPosition,
+        std::vector<uint32_t> & visible,
+        MeshletCullingStatistics * statistics = nullptr);
+
+#endif
@@ -0,0 +1,725 @@
+#include "occlusion_culling.h"
+
+#include "mesh.h"
+#include "mesh_adjacency.h"
+#include "mesh_lod.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+#include "parallel.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define OCCLUSION_CULLING_SSE2
+#endif
+
+namespace {
+
+const size_t TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+const size_t TILES_Y = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+const size_t SUBTILES = TILES_X * TILES_Y * 4;
+
+// Rows of tiles rasterized by a task, and boxes tested by a task
+const size_t BAND_TILE_ROWS = 4;
+const size_t TEST_TASK_BOXES = 256;
+
+// Coverage mask of a subtile whose every pixel is covered
+const uint32_t FULL_MASK = 0xffffffffu;
+
+// Snap a projected vertex to screen space with depth in [0, 1]
+inline glm::vec3 toScreen(const glm::vec4 & position) {
+    float inverseW = 1.0f / position.w;
+
+    return glm::vec3(
+        (position.x * inverseW * 0.5f + 0.5f) * OCCLUSION_WIDTH,
+        (0.5f - position.y * inverseW * 0.5f) * OCCLUSION_HEIGHT,
+        position.z * inverseW * 0.5f + 0.5f);
+}
+
+inline float inverseSlope(const glm::vec3 & from, const glm::vec3 & to) {
+    float height = to.y - from.y;
+
+    return height > 0.0f ? (to.x - from.x) / height : 0.0f;
+}
+
+// Set up a triangle of screen space vertices and append it when front
+// facing and over pixel centers
+void setupTriangle(
+        const glm::vec3 & s0,
+        const glm::vec3 & s1,
+        const glm::vec3 & s2,
+        std::vector<OcclusionTriangle> & triangles) {
+    glm::vec3 v[3] = { s0, s1, s2 };
+
+    // Counterclockwise front faces turn clockwise with y pointing down
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+
+    if (!(area < 0.0f) || !std::isfinite(area))
+        return;
+
+    if (v[1].y < v[0].y)
+        std::swap(v[0], v[1]);
+    if (v[2].y < v[1].y)
+        std::swap(v[1], v[2]);
+    if (v[1].y < v[0].y)
+        std::swap(v[0], v[1]);
+
+    float minimumX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+    float maximumX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+
+    if (maximumX < 0.0f || minimumX > (float)OCCLUSION_WIDTH)
+        return;
+
+    OcclusionTriangle triangle;
+    triangle.rowBegin = (int)std::max(0.0f, std::ceil(v[0].y - 0.5f));
+    triangle.rowEnd = (int)std::min((float)OCCLUSION_HEIGHT, std::floor(v[2].y - 0.5f) + 1.0f);
+
+    if (triangle.rowBegin >= triangle.rowEnd)
+        return;
+
+    triangle.x0 = v[0].x;
+    triangle.y0 = v[0].y;
+    triangle.x1 = v[1].x;
+    triangle.y1 = v[1].y;
+    triangle.y2 = v[2].y;
+    triangle.slope02 = inverseSlope(v[0], v[2]);
+    triangle.slope01 = inverseSlope(v[0], v[1]);
+    triangle.slope12 = inverseSlope(v[1], v[2]);
+
+    // Sorting may have flipped the winding, which the plane ignores
+    float x1 = v[1].x - v[0].x, y1 = v[1].y - v[0].y, z1 = v[1].z - v[0].z;
+    float x2 = v[2].x - v[0].x, y2 = v[2].y - v[0].y, z2 = v[2].z - v[0].z;
+    float determinant = x1 * y2 - x2 * y1;
+
+    triangle.a = (z1 * y2 - z2 * y1) / determinant;
+    triangle.b = (z2 * x1 - z1 * x2) / determinant;
+    triangle.c = v[0].z - triangle.a * v[0].x - triangle.b * v[0].y;
+    triangle.maximumZ = std::max(v[0].z, std::max(v[1].z, v[2].z));
+
+    triangles.push_back(triangle);
+}
+
+// Clip a triangle crossing the near plane z = -w and set up the result
+void clipTriangle(
+        const glm::vec4 & p0,
+        const glm::vec4 & p1,
+        const glm::vec4 & p2,
+        std::vector<OcclusionTriangle> & triangles) {
+    const glm::vec4 * input[3] = { &p0, &p1, &p2 };
+    float distances[3];
+    int inside = 0;
+
+    for (int i = 0; i < 3; i++) {
+        distances[i] = input[i]->z + input[i]->w;
+        inside += distances[i] >= 0.0f;
+    }
+
+    if (inside == 0)
+        return;
+
+    // Sutherland-Hodgman against a single plane gives at most 4 vertices
+    glm::vec4 output[4];
+    int count = 0;
+
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+
+        if (distances[i] >= 0.0f)
+            output[count++] = *input[i];
+
+        if ((distances[i] >= 0.0f) != (distances[j] >= 0.0f)) {
+            float t = distances[i] / (distances[i] - distances[j]);
+
+            output[count++] = *input[i] + (*input[j] - *input[i]) * t;
+        }
+    }
+
+    glm::vec3 screen[4];
+
+    for (int i = 0; i < count; i++)
+        screen[i] = toScreen(output[i]);
+
+    for (int i = 2; i < count; i++)
+        setupTriangle(screen[0], screen[i - 1], screen[i], triangles);
+}
+
+#ifdef OCCLUSION_CULLING_SSE2
+// 2 to the power of 4 integral floats in [0, 8], through their exponents
+inline __m128 power2(__m128 exponents) {
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(exponents), _mm_set1_epi32(127)), 23));
+}
+
+// Bits of the pixels of a subtile row from a column span, for the 4
+// subtiles of a tile starting at the given columns
+inline __m128i spanBits(__m128 columns, float begin, float end) {
+    __m128 zero = _mm_setzero_ps();
+    __m128 width = _mm_set1_ps((float)OCCLUSION_SUBTILE_WIDTH);
+
+    __m128 first = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(begin), columns), zero), width);
+    __m128 last = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(end), columns), zero), width);
+    last = _mm_max_ps(last, first);
+
+    return _mm_cvttps_epi32(_mm_sub_ps(power2(last), power2(first)));
+}
+#else
+inline uint32_t spanBits(float column, float begin, float end) {
+    float width = (float)OCCLUSION_SUBTILE_WIDTH;
+    int first = (int)std::min(std::max(begin - column, 0.0f), width);
+    int last = std::max((int)std::min(std::max(end - column, 0.0f), width), first);
+
+    return (1u << last) - (1u << first);
+}
+#endif
+
+// Column spans of the pixel centers of 4 rows of a tile row inside a
+// triangle, clamped to the buffer, empty as begin >= end
+void triangleSpans(const OcclusionTriangle & triangle, int tileRow, float begins[4], float ends[4]) {
+    for (int r = 0; r < 4; r++) {
+        int row = tileRow * (int)OCCLUSION_TILE_HEIGHT + r;
+
+        if (row < triangle.rowBegin || row >= triangle.rowEnd) {
+            begins[r] = 0.0f;
+            ends[r] = 0.0f;
+            continue;
+        }
+
+        float y = (float)row + 0.5f;
+        float longX = triangle.x0 + (y - triangle.y0) * triangle.slope02;
+        float shortX = y < triangle.y1 ?
+            triangle.x0 + (y - triangle.y0) * triangle.slope01 :
+            triangle.x1 + (y - triangle.y1) * triangle.slope12;
+
+        float left = std::min(longX, shortX), right = std::max(longX, shortX);
+
+        begins[r] = std::min(std::max(std::ceil(left - 0.5f), 0.0f), (float)OCCLUSION_WIDTH);
+        ends[r] = std::min(std::max(std::floor(right - 0.5f) + 1.0f, 0.0f), (float)OCCLUSION_WIDTH);
+    }
+}
+
+// Merge the coverage of a triangle into the 4 subtiles of a tile, given the
+// farthest depth of the triangle over every subtile
+// Coverage behind the farthest depth of a subtile is dropped. A triangle
+// nearer than the working layer by more than the layer is nearer than the
+// subtile starts a new layer, so that near occluders are not held back by
+// far ones. A full layer becomes the farthest depth of the subtile.
+void updateTile(uint32_t * masks, float * farDepths, float * maskDepths, const uint32_t coverage[4], const float depths[4]) {
+#ifdef OCCLUSION_CULLING_SSE2
+    __m128 depth = _mm_loadu_ps(depths);
+    __m128 farDepth = _mm_loadu_ps(farDepths);
+    __m128 maskDepth = _mm_loadu_ps(maskDepths);
+    __m128i mask = _mm_loadu_si128((const __m128i *)masks);
+
+    __m128i covered = _mm_and_si128(
+        _mm_loadu_si128((const __m128i *)coverage),
+        _mm_castps_si128(_mm_cmplt_ps(depth, farDepth)));
+    __m128 active = _mm_castsi128_ps(_mm_xor_si128(
+        _mm_cmpeq_epi32(covered, _mm_setzero_si128()), _mm_set1_epi32(-1)));
+
+    if (_mm_movemask_ps(active) == 0)
+        return;
+
+    __m128 discard = _mm_and_ps(active, _mm_cmpgt_ps(
+        _mm_sub_ps(maskDepth, depth), _mm_sub_ps(farDepth, maskDepth)));
+    mask = _mm_andnot_si128(_mm_castps_si128(discard), mask);
+    maskDepth = _mm_andnot_ps(discard, maskDepth);
+
+    maskDepth = _mm_or_ps(_mm_and_ps(active, _mm_max_ps(maskDepth, depth)), _mm_andnot_ps(active, maskDepth));
+    mask = _mm_or_si128(mask, covered);
+
+    __m128i full = _mm_cmpeq_epi32(mask, _mm_set1_epi32(-1));
+    __m128 fullDepth = _mm_castsi128_ps(full);
+    farDepth = _mm_or_ps(_mm_and_ps(fullDepth, maskDepth), _mm_andnot_ps(fullDepth, farDepth));
+    maskDepth = _mm_andnot_ps(fullDepth, maskDepth);
+    mask = _mm_andnot_si128(full, mask);
+
+    _mm_storeu_ps(farDepths, farDepth);
+    _mm_storeu_ps(maskDepths, maskDepth);
+    _mm_storeu_si128((__m128i *)masks, mask);
+#else
+    for (int i = 0; i < 4; i++) {
+        if (coverage[i] == 0 || !(depths[i] < farDepths[i]))
+            continue;
+
+        if (maskDepths[i] - depths[i] > farDepths[i] - maskDepths[i]) {
+            masks[i] = 0;
+            maskDepths[i] = 0.0f;
+        }
+
+        maskDepths[i] = std::max(maskDepths[i], depths[i]);
+        masks[i] |= coverage[i];
+
+        if (masks[i] == FULL_MASK) {
+            farDepths[i] = maskDepths[i];
+            maskDepths[i] = 0.0f;
+            masks[i] = 0;
+        }
+    }
+#endif
+}
+
+// Rasterize the rows of a triangle within a range of tile rows
+void rasterizeTriangle(
+        const OcclusionTriangle & triangle,
+        int firstTileRow,
+        int lastTileRow,
+        uint32_t * masks,
+        float * farDepths,
+        float * maskDepths) {
+    int begin = std::max(firstTileRow, triangle.rowBegin / (int)OCCLUSION_TILE_HEIGHT);
+    int end = std::min(lastTileRow, (triangle.rowEnd - 1) / (int)OCCLUSION_TILE_HEIGHT + 1);
+
+    // Corners of a subtile where its plane depth is farthest
+    float cornerX = triangle.a > 0.0f ? (float)OCCLUSION_SUBTILE_WIDTH : 0.0f;
+    float cornerY = triangle.b > 0.0f ? (float)OCCLUSION_TILE_HEIGHT : 0.0f;
+
+    for (int tileRow = begin; tileRow < end; tileRow++) {
+        float begins[4], ends[4];
+        triangleSpans(triangle, tileRow, begins, ends);
+
+        float spanBegin = (float)OCCLUSION_WIDTH, spanEnd = 0.0f;
+
+        for (int r = 0; r < 4; r++) {
+            if (begins[r] < ends[r]) {
+                spanBegin = std::min(spanBegin, begins[r]);
+                spanEnd = std::max(spanEnd, ends[r]);
+            }
+        }
+
+        if (!(spanBegin < spanEnd))
+            continue;
+
+        int firstTile = (int)spanBegin / (int)OCCLUSION_TILE_WIDTH;
+        int lastTile = ((int)spanEnd - 1) / (int)OCCLUSION_TILE_WIDTH;
+
+        float rowDepth = triangle.c + triangle.b * ((float)(tileRow * (int)OCCLUSION_TILE_HEIGHT) + cornerY);
+
+        for (int tile = firstTile; tile <= lastTile; tile++) {
+            float column = (float)(tile * (int)OCCLUSION_TILE_WIDTH);
+
+            uint32_t coverage[4];
+            float depths[4];
+
+#ifdef OCCLUSION_CULLING_SSE2
+            __m128 columns = _mm_add_ps(_mm_set1_ps(column), _mm_setr_ps(0.0f, 8.0f, 16.0f, 24.0f));
+            __m128i bits = _mm_setzero_si128();
+
+            for (int r = 0; r < 4; r++)
+                bits = _mm_or_si128(bits, _mm_sll_epi32(spanBits(columns, begins[r], ends[r]), _mm_cvtsi32_si128(8 * r)));
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(bits, _mm_setzero_si128())) == 0xffff)
+                continue;
+
+            __m128 depth = _mm_add_ps(
+                _mm_set1_ps(rowDepth),
+                _mm_mul_ps(_mm_set1_ps(triangle.a), _mm_add_ps(columns, _mm_set1_ps(cornerX))));
+
+            _mm_storeu_si128((__m128i *)coverage, bits);
+            _mm_storeu_ps(depths, _mm_min_ps(depth, _mm_set1_ps(triangle.maximumZ)));
+#else
+            uint32_t any = 0;
+
+            for (int i = 0; i < 4; i++) {
+                float subtileColumn = column + (float)(i * (int)OCCLUSION_SUBTILE_WIDTH);
+
+                coverage[i] = 0;
+
+                for (int r = 0; r < 4; r++)
+                    coverage[i] |= spanBits(subtileColumn, begins[r], ends[r]) << (8 * r);
+
+                depths[i] = std::min(rowDepth + triangle.a * (subtileColumn + cornerX), triangle.maximumZ);
+                any |= coverage[i];
+            }
+
+            if (any == 0)
+                continue;
+#endif
+
+            size_t offset = ((size_t)tileRow * TILES_X + (size_t)tile) * 4;
+            updateTile(masks + offset, farDepths + offset, maskDepths + offset, coverage, depths);
+        }
+    }
+}
+
+}
+
+void buildOccluderMesh(
+        const std::vector<glm::vec3> & positions,
+        const std::vector<uint32_t> & indices,
+        size_t triangleCount,
+        OccluderMesh & occluder) {
+    occluder.positions.clear();
+    occluder.indices.clear();
+    occluder.minimum = glm::vec3(0.0f);
+    occluder.maximum = glm::vec3(0.0f);
+
+    if (positions.empty() || indices.size() < 3)
+        return;
+
+    occluder.minimum = positions[0];
+    occluder.maximum = positions[0];
+
+    for (size_t i = 1; i < positions.size(); i++) {
+        occluder.minimum = glm::min(occluder.minimum, positions[i]);
+        occluder.maximum = glm::max(occluder.maximum, positions[i]);
+    }
+
+    // Positions repeated in the file would stop the simplifier as seams
+    std::vector<Vertex> vertices(positions.size());
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        vertices[i].position = positions[i];
+        vertices[i].normal = glm::vec3(0.0f);
+        vertices[i].textureCoordinate = glm::vec2(0.0f);
+    }
+
+    std::vector<uint32_t> remap;
+    buildPositionRemap(vertices, remap);
+
+    std::vector<uint32_t> welded;
+    welded.reserve(indices.size());
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+
+        if (a != b && b != c && c != a) {
+            welded.push_back(a);
+            welded.push_back(b);
+            welded.push_back(c);
+        }
+    }
+
+    std::vector<uint32_t> simplified;
+
+    if (welded.size() > triangleCount * 3)
+        simplifyMesh(vertices, welded, triangleCount * 3, std::numeric_limits<float>::max(), simplified);
+
+    if (simplified.empty())
+        simplified.swap(welded);
+
+    // Keep the vertices left, in order of first use
+    std::vector<uint32_t> compact(vertices.size(), UINT32_MAX);
+
+    occluder.indices.resize(simplified.size());
+
+    for (size_t i = 0; i < simplified.size(); i++) {
+        uint32_t & index = compact[simplified[i]];
+
+        if (index == UINT32_MAX) {
+            index = (uint32_t)occluder.positions.size();
+            occluder.positions.push_back(vertices[simplified[i]].position);
+        }
+
+        occluder.indices[i] = index;
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer() :
+        masks(SUBTILES, 0),
+        farDepths(SUBTILES, 1.0f),
+        maskDepths(SUBTILES, 0.0f) {
+}
+
+void OcclusionBuffer::clear() {
+    std::fill(masks.begin(), masks.end(), 0u);
+    std::fill(farDepths.begin(), farDepths.end(), 1.0f);
+    std::fill(maskDepths.begin(), maskDepths.end(), 0.0f);
+}
+
+void OcclusionBuffer::render(const std::vector<Occluder> & occluders, OcclusionStatistics * statistics) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (setups.size() < occluders.size())
+        setups.resize(occluders.size());
+
+    // Transform and project the vertices of every occluder once, then set
+    // up its triangles, clipping those crossing the near plane
+    parallelFor(occluders.size(), 1, [&](size_t begin, size_t end) {
+        std::vector<glm::vec4> clipPositions;
+        std::vector<glm::vec3> screenPositions;
+        std::vector<unsigned char> inside;
+
+        for (size_t i = begin; i < end; i++) {
+            const OccluderMesh & mesh = *occluders[i].mesh;
+            std::vector<OcclusionTriangle> & triangles = setups[i];
+
+            triangles.clear();
+            clipPositions.resize(mesh.positions.size());
+            screenPositions.resize(mesh.positions.size());
+            inside.resize(mesh.positions.size());
+
+            for (size_t j = 0; j < mesh.positions.size(); j++) {
+                glm::vec4 position = occluders[i].modelViewProjection * glm::vec4(mesh.positions[j], 1.0f);
+
+                clipPositions[j] = position;
+                inside[j] = position.z + position.w >= 0.0f;
+
+                if (inside[j])
+                    screenPositions[j] = toScreen(position);
+            }
+
+            for (size_t j = 0; j + 2 < mesh.indices.size(); j += 3) {
+                uint32_t a = mesh.indices[j], b = mesh.indices[j + 1], c = mesh.indices[j + 2];
+
+                if (inside[a] && inside[b] && inside[c])
+                    setupTriangle(screenPositions[a], screenPositions[b], screenPositions[c], triangles);
+                else
+                    clipTriangle(clipPositions[a], clipPositions[b], clipPositions[c], triangles);
+            }
+        }
+    });
+
+    // Bands of tile rows are rasterized in parallel, triangles in order
+    parallelFor(TILES_Y, BAND_TILE_ROWS, [&](size_t begin, size_t end) {
+        for (size_t i = 0; i < occluders.size(); i++) {
+            const std::vector<OcclusionTriangle> & triangles = setups[i];
+
+            for (size_t j = 0; j < triangles.size(); j++)
+                rasterizeTriangle(triangles[j], (int)begin, (int)end, &masks[0], &farDepths[0], &maskDepths[0]);
+        }
+    });
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (statistics) {
+        size_t triangles = 0;
+
+        for (size_t i = 0; i < occluders.size(); i++)
+            triangles += setups[i].size();
+
+        statistics->occluders = occluders.size();
+        statistics->triangles = triangles;
+        statistics->renderSeconds = elapsed.count();
+    }
+}
+
+OcclusionResult OcclusionBuffer::testBox(
+        const glm::vec3 & minimum,
+        const glm::vec3 & maximum,
+        const glm::mat4 & modelViewProjection) const {
+    float minimumX = std::numeric_limits<float>::max(), maximumX = -minimumX;
+    float minimumY = minimumX, maximumY = maximumX;
+    float nearestZ = minimumX;
+
+    // Corners from the minimum one along the box edges in clip space
+    glm::vec4 origin = modelViewProjection * glm::vec4(minimum, 1.0f);
+    glm::vec4 edgeX = modelViewProjection[0] * (maximum.x - minimum.x);
+    glm::vec4 edgeY = modelViewProjection[1] * (maximum.y - minimum.y);
+    glm::vec4 edgeZ = modelViewProjection[2] * (maximum.z - minimum.z);
+
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 position = origin;
+
+        if (i & 1)
+            position += edgeX;
+        if (i & 2)
+            position += edgeY;
+        if (i & 4)
+            position += edgeZ;
+
+        if (position.z < -position.w || position.w <= 0.0f)
+            return OCCLUSION_VISIBLE;
+
+        glm::vec3 screen = toScreen(position);
+
+        minimumX = std::min(minimumX, screen.x);
+        maximumX = std::max(maximumX, screen.x);
+        minimumY = std::min(minimumY, screen.y);
+        maximumY = std::max(maximumY, screen.y);
+        nearestZ = std::min(nearestZ, screen.z);
+    }
+
+    // Pixels touched by the screen bounds, end excluded
+    int beginX = (int)std::max(0.0f, std::floor(minimumX));
+    int beginY = (int)std::max(0.0f, std::floor(minimumY));
+    int endX = (int)std::min((float)OCCLUSION_WIDTH, std::ceil(maximumX));
+    int endY = (int)std::min((float)OCCLUSION_HEIGHT, std::ceil(maximumY));
+
+    if (beginX >= endX || beginY >= endY)
+        return OCCLUSION_OFFSCREEN;
+
+    int firstTile = beginX / (int)OCCLUSION_TILE_WIDTH;
+    int lastTile = (endX - 1) / (int)OCCLUSION_TILE_WIDTH;
+
+    // A subtile hides the box when its farthest depth is nearer, or when
+    // the working layer covers every pixel of the box with a nearer depth
+    for (int tileRow = beginY / (int)OCCLUSION_TILE_HEIGHT; tileRow <= (endY - 1) / (int)OCCLUSION_TILE_HEIGHT; tileRow++) {
+        int firstRow = std::max(beginY - tileRow * (int)OCCLUSION_TILE_HEIGHT, 0);
+        int lastRow = std::min(endY - tileRow * (int)OCCLUSION_TILE_HEIGHT, (int)OCCLUSION_TILE_HEIGHT);
+
+        for (int tile = firstTile; tile <= lastTile; tile++) {
+            size_t offset = ((size_t)tileRow * TILES_X + (size_t)tile) * 4;
+            float column = (float)(tile * (int)OCCLUSION_TILE_WIDTH);
+
+#ifdef OCCLUSION_CULLING_SSE2
+            __m128 columns = _mm_add_ps(_mm_set1_ps(column), _mm_setr_ps(0.0f, 8.0f, 16.0f, 24.0f));
+            __m128i columnBits = spanBits(columns, (float)beginX, (float)endX);
+            __m128i bits = _mm_setzero_si128();
+
+            for (int r = firstRow; r < lastRow; r++)
+                bits = _mm_or_si128(bits, _mm_sll_epi32(columnBits, _mm_cvtsi32_si128(8 * r)));
+
+            __m128 z = _mm_set1_ps(nearestZ);
+            __m128i zero = _mm_setzero_si128();
+
+            __m128 touched = _mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(bits, zero), _mm_set1_epi32(-1)));
+            __m128 uncovered = _mm_castsi128_ps(_mm_xor_si128(
+                _mm_cmpeq_epi32(_mm_andnot_si128(_mm_loadu_si128((const __m128i *)&masks[offset]), bits), zero),
+                _mm_set1_epi32(-1)));
+
+            __m128 visible = _mm_and_ps(touched, _mm_and_ps(
+                _mm_cmple_ps(z, _mm_loadu_ps(&farDepths[offset])),
+                _mm_or_ps(uncovered, _mm_cmple_ps(z, _mm_loadu_ps(&maskDepths[offset])))));
+
+            if (_mm_movemask_ps(visible) != 0)
+                return OCCLUSION_VISIBLE;
+#else
+            for (int i = 0; i < 4; i++) {
+                uint32_t columnBits = spanBits(column + (float)(i * (int)OCCLUSION_SUBTILE_WIDTH), (float)beginX, (float)endX);
+                uint32_t bits = 0;
+
+                for (int r = firstRow; r < lastRow; r++)
+                    bits |= columnBits << (8 * r);
+
+                if (bits == 0 || nearestZ > farDepths[offset + i])
+                    continue;
+
+                if ((bits & ~masks[offset + i]) != 0 || nearestZ <= maskDepths[offset + i])
+                    return OCCLUSION_VISIBLE;
+            }
+#endif
+        }
+    }
+
+    return OCCLUSION_OCCLUDED;
+}
+
+size_t cullOccludedInstances(
+        const glm::mat4 * models,
+        size_t count,
+        const OccluderMesh & mesh,
+        const glm::vec3 & center,
+        float radius,
+        const glm::mat4 & modelView,
+        const glm::mat4 & projection,
+        OcclusionBuffer & buffer,
+        std::vector<unsigned char> & occluded,
+        OcclusionStatistics * statistics) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    occluded.assign(count, 0);
+
+    if (statistics) {
+        statistics->occluders = 0;
+        statistics->triangles = 0;
+        statistics->tested = 0;
+        statistics->occluded = 0;
+        statistics->renderSeconds = 0.0;
+        statistics->testSeconds = 0.0;
+    }
+
+    size_t meshTriangles = mesh.indices.size() / 3;
+
+    if (count == 0 || meshTriangles == 0)
+        return 0;
+
+    glm::mat4 modelViewProjection = projection * modelView;
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(modelViewProjection, planes);
+
+    // Projected size of every instance inside the frustum, 0 outside
+    std::vector<float> sizes(count);
+
+    parallelFor(count, 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const glm::mat4 & model = models[i];
+
+            glm::vec3 instanceCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+            float scale = std::max(
+                glm::length(glm::vec3(model[0])),
+                std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+            bool outside = false;
+
+            for (int j = 0; j < 6 && !outside; j++)
+                outside = glm::dot(glm::vec3(planes[j]), instanceCenter) + planes[j].w < -radius * scale;
+
+            sizes[i] = outside ? 0.0f : projectedSphereSize(center, radius, modelView * model, projection, (float)OCCLUSION_HEIGHT);
+        }
+    });
+
+    // Largest instances on screen, nearest first as far as size tells
+    std::vector<uint32_t> order;
+    order.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        if (sizes[i] > 0.0f)
+            order.push_back((uint32_t)i);
+    }
+
+    size_t occluderCount = std::min(order.size(), std::max(OCCLUSION_TRIANGLE_BUDGET / meshTriangles, (size_t)1));
+
+    auto larger = [&sizes](uint32_t a, uint32_t b) {
+        return sizes[a] > sizes[b];
+    };
+
+    if (occluderCount < order.size())
+        std::nth_element(order.begin(), order.begin() + occluderCount, order.end(), larger);
+
+    std::sort(order.begin(), order.begin() + occluderCount, larger);
+
+    std::vector<Occluder> occluders(occluderCount);
+
+    for (size_t i = 0; i < occluderCount; i++) {
+        occluders[i].mesh = &mesh;
+        occluders[i].modelViewProjection = modelViewProjection * models[order[i]];
+    }
+
+    buffer.clear();
+    buffer.render(occluders, statistics);
+
+    std::chrono::steady_clock::time_point rendered = std::chrono::steady_clock::now();
+
+    // Test the bounding box of every instance inside the frustum
+    std::atomic<size_t> tested(0), hidden(0);
+
+    parallelFor(count, TEST_TASK_BOXES, [&](size_t begin, size_t end) {
+        size_t taskTested = 0, taskHidden = 0;
+
+        for (size_t i = begin; i < end; i++) {
+            if (sizes[i] <= 0.0f)
+                continue;
+
+            OcclusionResult result = buffer.testBox(mesh.minimum, mesh.maximum, modelViewProjection * models[i]);
+
+            taskTested += result != OCCLUSION_OFFSCREEN;
+
+            if (result == OCCLUSION_OCCLUDED) {
+                occluded[i] = 1;
+                taskHidden++;
+            }
+        }
+
+        tested += taskTested;
+        hidden += taskHidden;
+    });
+
+    std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+
+    if (statistics) {
+        statistics->tested = tested;
+        statistics->occluded = hidden;
+        statistics->renderSeconds = std::chrono::duration<double>(rendered - start).count();
+        statistics->testSeconds = std::chrono::duration<double>(finished - rendered).count();
+    }
+
+    return hidden;
+}
@@ -0,0 +1,153 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Size in pixels of the occlusion buffer, whole tiles of 32 x 4 pixels made
+// of 4 subtiles of 8 x 4 pixels
+const size_t OCCLUSION_WIDTH = 256;
+const size_t OCCLUSION_HEIGHT = 192;
+const size_t OCCLUSION_TILE_WIDTH = 32;
+const size_t OCCLUSION_TILE_HEIGHT = 4;
+const size_t OCCLUSION_SUBTILE_WIDTH = 8;
+
+// Triangles of simplified occluder meshes, and occluder triangles drawn per
+// frame to keep culling within about a millisecond
+const size_t OCCLUDER_TRIANGLES = 256;
+const size_t OCCLUSION_TRIANGLE_BUDGET = 8192;
+
+// Simplified mesh drawn into the occlusion buffer in place of an object,
+// with the bounding box of the full object in the same units
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+
+    glm::vec3 minimum;
+    glm::vec3 maximum;
+};
+
+// Weld the positions of a triangle list and simplify it down to the given
+// number of triangles
+// Simplified surfaces stray from the full one by the simplification error,
+// so that objects barely hidden behind silhouettes may be culled.
+void buildOccluderMesh(
+        const std::vector<glm::vec3> & positions,
+        const std::vector<uint32_t> & indices,
+        size_t triangleCount,
+        OccluderMesh & occluder);
+
+// Occluder mesh drawn with a model view projection matrix
+struct Occluder {
+    const OccluderMesh * mesh;
+    glm::mat4 modelViewProjection;
+};
+
+// Occluder triangle in screen space with vertices sorted from the top,
+// inverse slopes of its edges and its depth plane z = a * x + b * y + c
+struct OcclusionTriangle {
+    float x0, y0;
+    float x1, y1;
+    float y2;
+
+    float slope02;
+    float slope01;
+    float slope12;
+
+    float a, b, c;
+    float maximumZ;
+
+    // Rows of the pixel centers covered, end excluded
+    int rowBegin;
+    int rowEnd;
+};
+
+// Outcome of testing a bounding box against the occlusion buffer
+enum OcclusionResult {
+    OCCLUSION_VISIBLE,
+    OCCLUSION_OCCLUDED,
+
+    // Entirely outside of the buffer, left to frustum culling
+    OCCLUSION_OFFSCREEN
+};
+
+// Counters and durations of occlusion culling a frame
+struct OcclusionStatistics {
+    size_t occluders;
+
+    // Front facing occluder triangles left after near plane clipping
+    size_t triangles;
+
+    // Boxes tested on screen, and the hidden ones
+    size_t tested;
+    size_t occluded;
+
+    double renderSeconds;
+    double testSeconds;
+};
+
+// Low resolution depth buffer of occluders for conservative visibility
+// tests of bounding boxes, after Hasselgren, Andersson and Akenine-Moller,
+// Masked Software Occlusion Culling, 2016
+// Every subtile keeps a coverage mask of its pixels and two depths: the
+// farthest depth of the whole subtile and the farthest depth of the
+// triangles covering the pixels of the mask. Triangles nearer than the
+// subtile add their coverage to the mask, and a full mask replaces the
+// farthest depth of the subtile. Coverage masks are built from the spans
+// of 4 pixel rows and subtiles are updated 4 at a time. Occluders are set
+// up in parallel and rasterized in parallel bands of tile rows, and boxes
+// are tested against the farthest depths of the subtiles under their
+// screen bounds.
+class OcclusionBuffer {
+public:
+    OcclusionBuffer();
+
+    // Reset every subtile to the far plane
+    void clear();
+
+    // Rasterize the front faces of occluders, in order
+    void render(const std::vector<Occluder> & occluders, OcclusionStatistics * statistics = nullptr);
+
+    // Test a box given in the units of a model view projection matrix,
+    // visible when crossing the near plane
+    OcclusionResult testBox(
+            const glm::vec3 & minimum,
+            const glm::vec3 & maximum,
+            const glm::mat4 & modelViewProjection) const;
+
+private:
+    OcclusionBuffer(const OcclusionBuffer &);
+    OcclusionBuffer & operator=(const OcclusionBuffer &);
+
+    // Coverage masks and depths of the 4 subtiles of every tile, a pixel
+    // row of a subtile in every byte of its mask
+    std::vector<uint32_t> masks;
+    std::vector<float> farDepths;
+    std::vector<float> maskDepths;
+
+    // Triangles of every occluder set up for rasterization
+    std::vector<std::vector<OcclusionTriangle> > setups;
+};
+
+// Cull instances of an object hidden behind the largest ones on screen
+// The instances of largest projected bounding sphere are drawn as
+// occluders within OCCLUSION_TRIANGLE_BUDGET, then the bounding box of
+// every instance is tested in parallel. Flags of hidden instances are set,
+// and the number of them is returned.
+size_t cullOccludedInstances(
+        const glm::mat4 * models,
+        size_t count,
+        const OccluderMesh & mesh,
+        const glm::vec3 & center,
+        float radius,
+        const glm::mat4 & modelView,
+        const glm::mat4 & projection,
+        OcclusionBuffer & buffer,
+        std::vector<unsigned char> & occluded,
+        OcclusionStatistics * statistics = nullptr);
+
+#endif
@@ -0,0 +1,402 @@
+#include "paged_mesh.h"
+
+#include "meshlet.h"
+#include "profiler.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const size_t NO_PAGE = (size_t)-1;
+
+}
+
+PagedMesh::PagedMesh() :
+        cpuBudget(0),
+        gpuBudget(0),
+        uploadBudget(0),
+        frame(0),
+        stop(false),
+        reading(NO_PAGE) {
+    std::memset(&counters, 0, sizeof(PagedMeshStatistics));
+}
+
+PagedMesh::~PagedMesh() {
+    destroy();
+}
+
+bool PagedMesh::create(
+        const std::string & filename,
+        size_t cpuBudget,
+        size_t gpuBudget,
+        size_t uploadBudget) {
+    destroy();
+
+    if (!file.open(filename))
+        return false;
+
+    this->cpuBudget = cpuBudget;
+    this->gpuBudget = gpuBudget;
+    this->uploadBudget = uploadBudget;
+
+    PageState state;
+    std::memset(&state, 0, sizeof(PageState));
+
+    states.assign(file.pages().size(), state);
+    ranking.resize(states.size());
+
+    for (size_t i = 0; i < ranking.size(); i++)
+        ranking[i] = i;
+
+    stop = false;
+    worker = std::thread(&PagedMesh::work, this);
+
+    return true;
+}
+
+void PagedMesh::destroy() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+
+        available.notify_all();
+        worker.join();
+    }
+
+    requests.clear();
+    reading = NO_PAGE;
+
+    for (size_t i = 0; i < finished.size(); i++)
+        delete finished[i];
+
+    finished.clear();
+
+    for (size_t i = 0; i < states.size(); i++) {
+        destroyMeshBuffers(states[i].buffers);
+        delete states[i].data;
+    }
+
+    states.clear();
+    ranking.clear();
+    frame = 0;
+
+    std::memset(&counters, 0, sizeof(PagedMeshStatistics));
+
+    file.close();
+}
+
+bool PagedMesh::isOpen() const {
+    return file.isOpen();
+}
+
+const MeshPagesHeader & PagedMesh::header() const {
+    return file.header();
+}
+
+size_t PagedMesh::pageBytes(size_t page) const {
+    const MeshPage & entry = file.pages()[page];
+    return (size_t)(entry.vertexBytes + entry.indexBytes);
+}
+
+void PagedMesh::evictFromGpu(size_t page) {
+    PageState & state = states[page];
+
+    destroyMeshBuffers(state.buffers);
+    state.uploaded = false;
+
+    counters.gpuPages--;
+    counters.gpuBytes -= pageBytes(page);
+    counters.gpuEvictions++;
+}
+
+void PagedMesh::evictFromMemory(size_t page) {
+    PageState & state = states[page];
+
+    delete state.data;
+    state.data = nullptr;
+
+    counters.cpuPages--;
+    counters.cpuBytes -= pageBytes(page);
+    counters.cpuEvictions++;
+}
+
+void PagedMesh::update(const glm::mat4 & modelViewProjection, const glm::vec3 & cameraPosition) {
+    PROFILE_ZONE("Update pages");
+
+    frame++;
+
+    const std::vector<MeshPage> & pages = file.pages();
+
+    // Collect pages read by the worker thread
+    std::vector<PageData *> collected;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        collected.swap(finished);
+    }
+
+    for (size_t i = 0; i < collected.size(); i++) {
+        PageState & state = states[collected[i]->page];
+
+        // Pages queued again while being collected are read twice
+        if (state.data != nullptr) {
+            delete collected[i];
+            continue;
+        }
+
+        state.data = collected[i];
+        state.lastUsed = frame;
+
+        counters.cpuPages++;
+        counters.cpuBytes += pageBytes(collected[i]->page);
+        counters.loads++;
+    }
+
+    // Rank pages, visible ones first, then by distance from the camera
+    glm::vec4 planes[6];
+    extractFrustumPlanes(modelViewProjection, planes);
+
+    counters.visiblePages = 0;
+
+    for (size_t i = 0; i < states.size(); i++) {
+        const MeshPage & page = pages[i];
+        glm::vec3 center(page.center[0], page.center[1], page.center[2]);
+
+        bool outside = false;
+
+        for (int j = 0; j < 6 && !outside; j++)
+            outside = glm::dot(glm::vec3(planes[j]), center) + planes[j].w < -page.radius;
+
+        states[i].visible = !outside;
+        states[i].distance = std::max(0.0f, glm::distance(center, cameraPosition) - page.radius);
+
+        counters.visiblePages += states[i].visible;
+    }
+
+    std::sort(ranking.begin(), ranking.end(), [this](size_t a, size_t b) {
+        if (states[a].visible != states[b].visible)
+            return states[a].visible;
+
+        return states[a].distance < states[b].distance;
+    });
+
+    // Keep the highest ranked pages fitting every budget
+    size_t gpuUsed = 0;
+    size_t cpuUsed = 0;
+    bool gpuFull = false;
+    bool cpuFull = false;
+
+    for (size_t i = 0; i < ranking.size(); i++) {
+        PageState & state = states[ranking[i]];
+        size_t bytes = pageBytes(ranking[i]);
+
+        gpuFull = gpuFull || gpuUsed + bytes > gpuBudget;
+        cpuFull = cpuFull || cpuUsed + bytes > cpuBudget;
+
+        state.wantedOnGpu = !gpuFull;
+        state.wantedInMemory = !cpuFull;
+
+        gpuUsed += state.wantedOnGpu ? bytes : 0;
+        cpuUsed += state.wantedInMemory ? bytes : 0;
+    }
+
+    // Pages on the GPU that may be evicted, least recently used first
+    std::vector<std::pair<uint64_t, size_t> > evictable;
+
+    for (size_t i = 0; i < states.size(); i++)
+        if (states[i].uploaded && !states[i].wantedOnGpu)
+            evictable.push_back(std::make_pair(states[i].lastUsed, i));
+
+    std::sort(evictable.begin(), evictable.end());
+
+    // Upload pages in ranking order within the upload budget, making room by
+    // evicting pages no longer wanted
+    size_t uploaded = 0;
+    size_t evicted = 0;
+
+    for (size_t i = 0; i < ranking.size(); i++) {
+        size_t page = ranking[i];
+        PageState & state = states[page];
+
+        if (!state.wantedOnGpu)
+            break;
+
+        if (state.uploaded || state.data == nullptr)
+            continue;
+
+        size_t bytes = pageBytes(page);
+
+        if (uploaded > 0 && uploaded + bytes > uploadBudget)
+            break;
+
+        while (counters.gpuBytes + bytes > gpuBudget && evicted < evictable.size())
+            evictFromGpu(evictable[evicted++].second);
+
+        if (counters.gpuBytes + bytes > gpuBudget)
+            break;
+
+        PROFILE_ZONE("Upload page");
+
+        uploadTriangleMesh(
+            state.data->vertices.data(),
+            state.data->vertices.size(),
+            file.layout(page),
+            state.data->indices.data(),
+            state.data->indices.size(),
+            GL_STATIC_DRAW,
+            state.buffers.vao,
+            state.buffers.vbo,
+            state.buffers.ebo);
+
+        state.buffers.indexType = pages[page].indexSize == sizeof(GLushort) ?
+            GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        state.uploaded = true;
+        state.lastUsed = frame;
+
+        uploaded += bytes;
+
+        counters.gpuPages++;
+        counters.gpuBytes += bytes;
+        counters.uploads++;
+    }
+
+    // Evict pages from memory over the budget, least recently used first,
+    // keeping pages waiting for their upload
+    if (counters.cpuBytes > cpuBudget) {
+        evictable.clear();
+
+        for (size_t i = 0; i < states.size(); i++)
+            if (states[i].data != nullptr && !states[i].wantedInMemory &&
+                    (states[i].uploaded || !states[i].wantedOnGpu))
+                evictable.push_back(std::make_pair(states[i].lastUsed, i));
+
+        std::sort(evictable.begin(), evictable.end());
+
+        for (size_t i = 0; i < evictable.size() && counters.cpuBytes > cpuBudget; i++)
+            evictFromMemory(evictable[i].second);
+    }
+
+    // Queue reads of wanted pages in ranking order, replacing the previous queue
+    std::vector<size_t> queue;
+
+    for (size_t i = 0; i < ranking.size(); i++) {
+        const PageState & state = states[ranking[i]];
+
+        if (state.data == nullptr &&
+                ((state.wantedOnGpu && !state.uploaded) || state.wantedInMemory))
+            queue.push_back(ranking[i]);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        requests.clear();
+
+        for (size_t i = 0; i < queue.size(); i++) {
+            bool pending = queue[i] == reading;
+
+            for (size_t j = 0; j < finished.size() && !pending; j++)
+                pending = finished[j]->page == queue[i];
+
+            if (!pending)
+                requests.push_back(queue[i]);
+        }
+    }
+
+    available.notify_one();
+
+    counters.missingPages = 0;
+
+    for (size_t i = 0; i < states.size(); i++)
+        counters.missingPages += states[i].visible && !states[i].uploaded;
+}
+
+size_t PagedMesh::draw(ShaderProgram & program, int dequantizationUniform, const glm::mat4 & transformation) {
+    const std::vector<MeshPage> & pages = file.pages();
+    size_t triangles = 0;
+
+    for (size_t i = 0; i < ranking.size(); i++) {
+        size_t page = ranking[i];
+        PageState & state = states[page];
+
+        // Ranking puts every visible page first
+        if (!state.visible)
+            break;
+
+        if (!state.uploaded)
+            continue;
+
+        const MeshPage & entry = pages[page];
+
+        // Position dequantization of the page, applied before the model matrix
+        glm::mat4 dequantization = glm::scale(
+            glm::translate(
+                transformation,
+                glm::vec3(entry.positionOffset[0], entry.positionOffset[1], entry.positionOffset[2])),
+            glm::vec3(entry.positionScale[0], entry.positionScale[1], entry.positionScale[2]));
+
+        program.set(dequantizationUniform, dequantization);
+
+        glBindVertexArray(state.buffers.vao);
+        glDrawElements(GL_TRIANGLES, entry.indexCount, state.buffers.indexType, (const GLvoid *)0);
+
+        state.lastUsed = frame;
+        triangles += entry.indexCount / 3;
+    }
+
+    return triangles;
+}
+
+PagedMeshStatistics PagedMesh::takeStatistics() {
+    PagedMeshStatistics statistics = counters;
+    statistics.pages = states.size();
+
+    counters.loads = 0;
+    counters.uploads = 0;
+    counters.gpuEvictions = 0;
+    counters.cpuEvictions = 0;
+
+    return statistics;
+}
+
+void PagedMesh::work() {
+    for (;;) {
+        size_t page;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (!stop && requests.empty())
+                available.wait(lock);
+
+            if (stop)
+                return;
+
+            page = requests.front();
+            requests.pop_front();
+            reading = page;
+        }
+
+        PROFILE_ZONE("Read page");
+
+        PageData * data = new PageData();
+        data->page = page;
+
+        bool success = file.read(page, data->vertices, data->indices);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        reading = NO_PAGE;
+
+        if (success)
+            finished.push_back(data);
+        else
+            delete data;
+    }
+}
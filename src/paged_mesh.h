@@ -0,0 +1,136 @@
+#ifndef PAGED_MESH_H
+#define PAGED_MESH_H
+
+#include <glad/glad.h>
+
+#include "mesh_pages.h"
+#include "mesh_streamer.h"
+#include "shader_program.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Residency of a paged mesh and the work done since the last report
+struct PagedMeshStatistics {
+    size_t pages;
+    size_t visiblePages;
+
+    // Pages resident on the GPU and in memory, and their bytes
+    size_t gpuPages;
+    size_t gpuBytes;
+    size_t cpuPages;
+    size_t cpuBytes;
+
+    // Visible pages not yet on the GPU
+    size_t missingPages;
+
+    size_t loads;
+    size_t uploads;
+    size_t gpuEvictions;
+    size_t cpuEvictions;
+};
+
+// Paged mesh drawn with only the pages near the camera resident
+// Every frame pages are ranked, visible ones first, then by distance from
+// the camera. Walking the ranking, the pages fitting the GPU budget are kept
+// uploaded and the pages fitting the CPU budget are kept in memory, read by
+// a worker thread in ranking order. Pages falling out of a budget are
+// evicted least recently drawn first, and uploads per frame are limited to
+// the upload budget, at least one page.
+class PagedMesh {
+public:
+    PagedMesh();
+    ~PagedMesh();
+
+    // Open paged mesh file and start worker thread, with budgets in bytes
+    bool create(
+            const std::string & filename,
+            size_t cpuBudget,
+            size_t gpuBudget,
+            size_t uploadBudget);
+
+    // Stop worker thread and delete resident pages
+    void destroy();
+
+    bool isOpen() const;
+
+    const MeshPagesHeader & header() const;
+
+    // Rank pages for a camera in mesh units, collect pages read by the worker
+    // thread, evict and upload pages and queue reads
+    void update(const glm::mat4 & modelViewProjection, const glm::vec3 & cameraPosition);
+
+    // Draw visible pages resident on the GPU, setting the dequantization of
+    // every page applied after the given transformation, returning triangles
+    size_t draw(ShaderProgram & program, int dequantizationUniform, const glm::mat4 & transformation);
+
+    // Residency and counters since the last call
+    PagedMeshStatistics takeStatistics();
+
+private:
+    PagedMesh(const PagedMesh &);
+    PagedMesh & operator=(const PagedMesh &);
+
+    // Page blobs read from file
+    struct PageData {
+        size_t page;
+        std::vector<unsigned char> vertices;
+        std::vector<unsigned char> indices;
+    };
+
+    struct PageState {
+        bool visible;
+        float distance;
+
+        // Kept on the GPU or in memory by the last ranking
+        bool wantedOnGpu;
+        bool wantedInMemory;
+
+        PageData * data;
+        MeshBuffers buffers;
+        bool uploaded;
+
+        // Frame last drawn or uploaded
+        uint64_t lastUsed;
+    };
+
+    void work();
+
+    // Bytes of a page in memory and on the GPU
+    size_t pageBytes(size_t page) const;
+
+    void evictFromGpu(size_t page);
+    void evictFromMemory(size_t page);
+
+    MeshPagesFile file;
+    size_t cpuBudget;
+    size_t gpuBudget;
+    size_t uploadBudget;
+
+    std::vector<PageState> states;
+    std::vector<size_t> ranking;
+    uint64_t frame;
+
+    PagedMeshStatistics counters;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stop;
+
+    // Pages queued in ranking order, page being read, and pages read but
+    // not collected
+    std::deque<size_t> requests;
+    size_t reading;
+    std::vector<PageData *> finished;
+};
+
+#endif
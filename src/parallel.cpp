@@ -0,0 +1,188 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Range partition of a single parallelFor call
+struct Job {
+    const std::function<void(size_t, size_t)> * task;
+    size_t count;
+    size_t rangeSize;
+    size_t rangeCount;
+
+    std::atomic<size_t> nextRange;
+    std::atomic<size_t> finishedRanges;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+// Execute ranges of a job until none is left to claim
+void executeRanges(Job & job) {
+    size_t executed = 0;
+
+    for (;;) {
+        size_t range = job.nextRange.fetch_add(1);
+
+        if (range >= job.rangeCount)
+            break;
+
+        size_t begin = range * job.rangeSize;
+        size_t end = std::min(job.count, begin + job.rangeSize);
+
+        (*job.task)(begin, end);
+        executed++;
+    }
+
+    if (executed == 0)
+        return;
+
+    // Wake up the calling thread when the last range is finished
+    if (job.finishedRanges.fetch_add(executed) + executed == job.rangeCount) {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.finished.notify_all();
+    }
+}
+
+class ThreadPool {
+public:
+    ThreadPool() : stop(false) {
+        size_t count = std::max(1u, std::thread::hardware_concurrency());
+
+        // The calling thread of parallelFor is also a worker
+        for (size_t i = 1; i < count; i++)
+            workers.emplace_back(&ThreadPool::work, this);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+
+        available.notify_all();
+
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    size_t size() const {
+        return workers.size() + 1;
+    }
+
+    void submit(const std::shared_ptr<Job> & job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+
+        available.notify_all();
+    }
+
+    void remove(const std::shared_ptr<Job> & job) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::deque<std::shared_ptr<Job> >::iterator it =
+            std::find(jobs.begin(), jobs.end(), job);
+
+        if (it != jobs.end())
+            jobs.erase(it);
+    }
+
+private:
+    void work() {
+        for (;;) {
+            std::shared_ptr<Job> job;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this] { return stop || !jobs.empty(); });
+
+                if (stop)
+                    return;
+
+                job = jobs.front();
+
+                // Retire jobs whose ranges were all claimed
+                if (job->nextRange.load() >= job->rangeCount) {
+                    jobs.pop_front();
+                    continue;
+                }
+            }
+
+            executeRanges(*job);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::shared_ptr<Job> > jobs;
+
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stop;
+};
+
+ThreadPool & threadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+}
+
+size_t threadCount() {
+    return threadPool().size();
+}
+
+void parallelFor(
+        size_t count,
+        size_t grain,
+        const std::function<void(size_t begin, size_t end)> & task) {
+    if (count == 0)
+        return;
+
+    ThreadPool & pool = threadPool();
+
+    // Split in a few ranges per thread to balance uneven workloads
+    size_t targetRanges = pool.size() * 4;
+    size_t rangeSize = std::max(
+        std::max<size_t>(grain, 1),
+        (count + targetRanges - 1) / targetRanges);
+
+    size_t rangeCount = (count + rangeSize - 1) / rangeSize;
+
+    // Execute serially when there is nothing to distribute
+    if (rangeCount == 1 || pool.size() == 1) {
+        task(0, count);
+        return;
+    }
+
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->task = &task;
+    job->count = count;
+    job->rangeSize = rangeSize;
+    job->rangeCount = rangeCount;
+    job->nextRange = 0;
+    job->finishedRanges = 0;
+
+    pool.submit(job);
+
+    executeRanges(*job);
+
+    // Wait for ranges claimed by worker threads
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&job] {
+            return job->finishedRanges.load() == job->rangeCount;
+        });
+    }
+
+    pool.remove(job);
+}
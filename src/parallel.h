@@ -0,0 +1,19 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+// Number of threads used by parallel algorithms, including the calling thread
+size_t threadCount();
+
+// Execute task over the index range [0, count) split in contiguous ranges
+// of at least grain indices, distributed over a persistent pool of worker
+// threads. The calling thread also executes ranges and returns only when
+// every range is finished. Nested calls are allowed.
+void parallelFor(
+        size_t count,
+        size_t grain,
+        const std::function<void(size_t begin, size_t end)> & task);
+
+#endif
@@ -0,0 +1,310 @@
+#include "profiler.h"
+
+#ifdef PROFILER_ENABLED
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Zone between two steady clock times in nanoseconds
+struct ProfileEvent {
+    const char * name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Single producer ring of the zones of a thread
+// The thread publishes every zone by advancing the head after writing it.
+struct ThreadRing {
+    size_t thread;
+    std::atomic<size_t> head;
+
+    ProfileEvent events[PROFILER_THREAD_EVENTS];
+};
+
+// Rings of every thread that recorded a zone, kept after the thread exits
+std::mutex ringsMutex;
+std::vector<ThreadRing *> rings;
+
+thread_local ThreadRing * currentRing = nullptr;
+
+ThreadRing * registerThread() {
+    ThreadRing * ring = new ThreadRing();
+    ring->head.store(0);
+
+    std::lock_guard<std::mutex> lock(ringsMutex);
+
+    ring->thread = rings.size();
+    rings.push_back(ring);
+
+    return ring;
+}
+
+// Timestamp queries of the GPU zones of a frame, with the clocks sampled
+// at its start to place them on the CPU timeline
+struct GpuFrame {
+    GLuint queries[PROFILER_GPU_ZONES * 2];
+    const char * names[PROFILER_GPU_ZONES];
+    size_t count;
+
+    int64_t cpuStart;
+    int64_t gpuStart;
+
+    bool pending;
+};
+
+struct GpuProfiler {
+    bool created;
+
+    GpuFrame frames[PROFILER_GPU_FRAMES];
+    size_t frame;
+
+    // Open zones of the current frame, including unrecorded ones past the
+    // zone limit, marked as PROFILER_GPU_ZONES
+    std::vector<size_t> stack;
+
+    // Ring of the zones read back
+    std::vector<ProfileEvent> events;
+    size_t head;
+};
+
+GpuProfiler gpuProfiler;
+
+void calibrateGpuFrame(GpuFrame & frame) {
+    GLint64 gpuTime = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+
+    frame.cpuStart = (int64_t)profilerTime();
+    frame.gpuStart = gpuTime;
+    frame.count = 0;
+    frame.pending = false;
+}
+
+// Read back zones of a frame when every timestamp is available
+bool readGpuFrame(GpuFrame & frame) {
+    for (size_t i = 0; i < frame.count * 2; i++) {
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (!available)
+            return false;
+    }
+
+    for (size_t i = 0; i < frame.count; i++) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+        ProfileEvent event;
+        event.name = frame.names[i];
+        event.begin = (uint64_t)((int64_t)begin - frame.gpuStart + frame.cpuStart);
+        event.end = (uint64_t)((int64_t)end - frame.gpuStart + frame.cpuStart);
+
+        gpuProfiler.events[gpuProfiler.head % PROFILER_GPU_EVENTS] = event;
+        gpuProfiler.head++;
+    }
+
+    return true;
+}
+
+// Write zone as complete event in microseconds from the trace start
+void writeTraceEvent(
+        std::ostream & stream,
+        const ProfileEvent & event,
+        uint64_t start,
+        size_t thread,
+        bool & first) {
+    stream << (first ? "\n" : ",\n");
+    first = false;
+
+    stream << "{\"name\":\"";
+
+    for (const char * c = event.name; *c != '\0'; c++)
+        if (*c == '"' || *c == '\\')
+            stream << '\\' << *c;
+        else if ((unsigned char)*c >= 0x20)
+            stream << *c;
+
+    stream << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+           << ",\"ts\":" << (event.begin - start) / 1000.0
+           << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+}
+
+}
+
+uint64_t profilerTime() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profilerRecord(const char * name, uint64_t begin, uint64_t end) {
+    ThreadRing * ring = currentRing;
+
+    if (ring == nullptr)
+        ring = currentRing = registerThread();
+
+    size_t head = ring->head.load(std::memory_order_relaxed);
+
+    ProfileEvent & event = ring->events[head % PROFILER_THREAD_EVENTS];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void profilerCreateGpu() {
+    profilerDestroyGpu();
+
+    for (size_t i = 0; i < PROFILER_GPU_FRAMES; i++)
+        glGenQueries((GLsizei)(PROFILER_GPU_ZONES * 2), gpuProfiler.frames[i].queries);
+
+    gpuProfiler.created = true;
+    gpuProfiler.frame = 0;
+    gpuProfiler.stack.clear();
+    gpuProfiler.events.resize(PROFILER_GPU_EVENTS);
+    gpuProfiler.head = 0;
+
+    calibrateGpuFrame(gpuProfiler.frames[0]);
+}
+
+void profilerDestroyGpu() {
+    if (!gpuProfiler.created)
+        return;
+
+    for (size_t i = 0; i < PROFILER_GPU_FRAMES; i++)
+        glDeleteQueries((GLsizei)(PROFILER_GPU_ZONES * 2), gpuProfiler.frames[i].queries);
+
+    gpuProfiler.created = false;
+}
+
+void profilerBeginGpuZone(const char * name) {
+    if (!gpuProfiler.created)
+        return;
+
+    GpuFrame & frame = gpuProfiler.frames[gpuProfiler.frame];
+
+    if (frame.count == PROFILER_GPU_ZONES) {
+        gpuProfiler.stack.push_back(PROFILER_GPU_ZONES);
+        return;
+    }
+
+    frame.names[frame.count] = name;
+    glQueryCounter(frame.queries[frame.count * 2], GL_TIMESTAMP);
+
+    gpuProfiler.stack.push_back(frame.count);
+    frame.count++;
+}
+
+void profilerEndGpuZone() {
+    if (!gpuProfiler.created || gpuProfiler.stack.empty())
+        return;
+
+    size_t zone = gpuProfiler.stack.back();
+    gpuProfiler.stack.pop_back();
+
+    if (zone < PROFILER_GPU_ZONES)
+        glQueryCounter(gpuProfiler.frames[gpuProfiler.frame].queries[zone * 2 + 1], GL_TIMESTAMP);
+}
+
+void profilerGpuFrame() {
+    if (!gpuProfiler.created)
+        return;
+
+    // Zones left open are not closed across frames
+    while (!gpuProfiler.stack.empty())
+        profilerEndGpuZone();
+
+    gpuProfiler.frames[gpuProfiler.frame].pending = true;
+    gpuProfiler.frame = (gpuProfiler.frame + 1) % PROFILER_GPU_FRAMES;
+
+    // Reuse the queries of the oldest frame
+    GpuFrame & frame = gpuProfiler.frames[gpuProfiler.frame];
+
+    if (frame.pending)
+        readGpuFrame(frame);
+
+    calibrateGpuFrame(frame);
+}
+
+bool writeChromeTrace(const std::string & filename) {
+    std::ofstream file(filename.c_str());
+
+    if (!file.is_open())
+        return false;
+
+    // Read back GPU zones still in flight
+    if (gpuProfiler.created) {
+        glFinish();
+
+        for (size_t i = 1; i <= PROFILER_GPU_FRAMES; i++) {
+            GpuFrame & frame = gpuProfiler.frames[(gpuProfiler.frame + i) % PROFILER_GPU_FRAMES];
+
+            if (frame.pending && readGpuFrame(frame))
+                frame.pending = false;
+        }
+    }
+
+    std::vector<ThreadRing *> threads;
+
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        threads = rings;
+    }
+
+    // Published zones of every ring, oldest first
+    std::vector<size_t> firsts(threads.size()), lasts(threads.size());
+    uint64_t start = UINT64_MAX;
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        lasts[i] = threads[i]->head.load(std::memory_order_acquire);
+        firsts[i] = lasts[i] > PROFILER_THREAD_EVENTS ? lasts[i] - PROFILER_THREAD_EVENTS : 0;
+
+        for (size_t j = firsts[i]; j < lasts[i]; j++)
+            start = std::min(start, threads[i]->events[j % PROFILER_THREAD_EVENTS].begin);
+    }
+
+    size_t gpuFirst = gpuProfiler.head > PROFILER_GPU_EVENTS ? gpuProfiler.head - PROFILER_GPU_EVENTS : 0;
+
+    for (size_t j = gpuFirst; j < gpuProfiler.head; j++)
+        start = std::min(start, gpuProfiler.events[j % PROFILER_GPU_EVENTS].begin);
+
+    // GPU zones are shown as the thread after the CPU ones
+    size_t gpuThread = threads.size();
+    bool first = true;
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+             << threads[i]->thread << ",\"args\":{\"name\":\"CPU thread " << threads[i]->thread << "\"}}";
+        first = false;
+
+        for (size_t j = firsts[i]; j < lasts[i]; j++)
+            writeTraceEvent(file, threads[i]->events[j % PROFILER_THREAD_EVENTS], start, threads[i]->thread, first);
+    }
+
+    if (gpuProfiler.head > 0) {
+        file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+             << gpuThread << ",\"args\":{\"name\":\"GPU\"}}";
+        first = false;
+
+        for (size_t j = gpuFirst; j < gpuProfiler.head; j++)
+            writeTraceEvent(file, gpuProfiler.events[j % PROFILER_GPU_EVENTS], start, gpuThread, first);
+    }
+
+    file << "\n]}" << std::endl;
+
+    file.close();
+
+    return !file.fail();
+}
+
+#endif
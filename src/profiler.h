@@ -0,0 +1,119 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Frame profiler of scoped CPU and GPU zones exported to the Chrome trace
+// event format, readable by chrome://tracing and Perfetto
+// Zones are recorded only when compiled with PROFILER_ENABLED defined,
+// otherwise the macros expand to nothing and the functions are empty.
+
+// Zones kept by the ring of every recording thread, older ones are overwritten
+const size_t PROFILER_THREAD_EVENTS = 1 << 16;
+
+// Frames of GPU timestamp queries in flight before their results are read
+const size_t PROFILER_GPU_FRAMES = 4;
+
+// GPU zones of a frame, further ones are not recorded
+const size_t PROFILER_GPU_ZONES = 32;
+
+// GPU zones kept for export, older ones are overwritten
+const size_t PROFILER_GPU_EVENTS = 1 << 16;
+
+#ifdef PROFILER_ENABLED
+
+// Whether zones are recorded by this build
+inline bool profilerEnabled() {
+    return true;
+}
+
+// Steady clock time in nanoseconds
+uint64_t profilerTime();
+
+// Append zone to the ring of the calling thread without locking
+// The name must outlive the export, as string literals do.
+void profilerRecord(const char * name, uint64_t begin, uint64_t end);
+
+// Zone of the calling thread from construction to destruction
+class ProfileZone {
+public:
+    explicit ProfileZone(const char * name) : name(name), begin(profilerTime()) {
+    }
+
+    ~ProfileZone() {
+        profilerRecord(name, begin, profilerTime());
+    }
+
+private:
+    ProfileZone(const ProfileZone &);
+    ProfileZone & operator=(const ProfileZone &);
+
+    const char * name;
+    uint64_t begin;
+};
+
+// Create and delete the timestamp queries of GPU zones in the current
+// OpenGL context
+void profilerCreateGpu();
+void profilerDestroyGpu();
+
+// Write timestamps around the commands of a zone, nested in submission order
+void profilerBeginGpuZone(const char * name);
+void profilerEndGpuZone();
+
+// Close the GPU zones of the frame and read back the zones of the oldest
+// frame in flight when available, dropping them rather than stalling
+void profilerGpuFrame();
+
+// Zone of GPU commands submitted from construction to destruction
+class GpuProfileZone {
+public:
+    explicit GpuProfileZone(const char * name) {
+        profilerBeginGpuZone(name);
+    }
+
+    ~GpuProfileZone() {
+        profilerEndGpuZone();
+    }
+
+private:
+    GpuProfileZone(const GpuProfileZone &);
+    GpuProfileZone & operator=(const GpuProfileZone &);
+};
+
+// Write zones of every thread and the GPU to Chrome trace JSON file
+// Recording threads should be idle while exporting.
+bool writeChromeTrace(const std::string & filename);
+
+#define PROFILE_JOIN_NAME(a, b) a##b
+#define PROFILE_NAME(a, b) PROFILE_JOIN_NAME(a, b)
+
+#define PROFILE_ZONE(name) ProfileZone PROFILE_NAME(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) GpuProfileZone PROFILE_NAME(gpuProfileZone, __LINE__)(name)
+#define PROFILE_GPU_FRAME() profilerGpuFrame()
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_GPU_ZONE(name)
+#define PROFILE_GPU_FRAME()
+
+inline bool profilerEnabled() {
+    return false;
+}
+
+inline void profilerCreateGpu() {
+}
+
+inline void profilerDestroyGpu() {
+}
+
+inline bool writeChromeTrace(const std::string &) {
+    return false;
+}
+
+#endif
+
+#endif
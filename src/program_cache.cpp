@@ -0,0 +1,212 @@
+#include "program_cache.h"
+
+#include "gl_extensions.h"
+#include "hash.h"
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const char MAGIC[8] = { 'C', 'G', 'P', 'R', 'O', 'G', '\0', '\0' };
+
+ShaderExtensions SHADER_EXTENSIONS = { false, false, nullptr, nullptr, nullptr, nullptr };
+
+// Check whether the driver accepts a binary format
+bool supportsBinaryFormat(GLenum format) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+
+    if (count <= 0)
+        return false;
+
+    std::vector<GLint> formats(count);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+
+    for (size_t i = 0; i < formats.size(); i++)
+        if ((GLenum)formats[i] == format)
+            return true;
+
+    return false;
+}
+
+uint64_t hashString(const char * string, uint64_t seed) {
+    return string != nullptr ? hashBytes(string, std::strlen(string), seed) : seed;
+}
+
+}
+
+const ShaderExtensions & loadShaderExtensions(GLADloadproc load) {
+    ShaderExtensions & extensions = SHADER_EXTENSIONS;
+
+    // Program binaries are core since OpenGL 4.1
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+    extensions.supportsProgramBinary = false;
+
+    if (major > 4 || (major == 4 && minor >= 1) || hasExtension("GL_ARB_get_program_binary")) {
+        extensions.getProgramBinary = (void (APIENTRYP)(GLuint, GLsizei, GLsizei *, GLenum *, void *))
+            load("glGetProgramBinary");
+        extensions.programBinary = (void (APIENTRYP)(GLuint, GLenum, const void *, GLsizei))
+            load("glProgramBinary");
+        extensions.programParameteri = (void (APIENTRYP)(GLuint, GLenum, GLint))
+            load("glProgramParameteri");
+
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+        extensions.supportsProgramBinary =
+            extensions.getProgramBinary != nullptr &&
+            extensions.programBinary != nullptr &&
+            extensions.programParameteri != nullptr &&
+            formatCount > 0;
+    }
+
+    // Both extensions share their tokens, only the entry point name differs
+    extensions.maxShaderCompilerThreads = nullptr;
+
+    if (hasExtension("GL_KHR_parallel_shader_compile"))
+        extensions.maxShaderCompilerThreads = (void (APIENTRYP)(GLuint))
+            load("glMaxShaderCompilerThreadsKHR");
+    else if (hasExtension("GL_ARB_parallel_shader_compile"))
+        extensions.maxShaderCompilerThreads = (void (APIENTRYP)(GLuint))
+            load("glMaxShaderCompilerThreadsARB");
+
+    extensions.supportsParallelShaderCompile = extensions.maxShaderCompilerThreads != nullptr;
+
+    return extensions;
+}
+
+const ShaderExtensions & shaderExtensions() {
+    return SHADER_EXTENSIONS;
+}
+
+std::string programCacheFilename(const std::string & name) {
+    return name + ".program";
+}
+
+uint64_t programCacheKey(
+        const std::string & vertexSource,
+        const std::string & fragmentSource,
+        GLenum binaryFormat) {
+    uint64_t key = hashBytes(vertexSource.data(), vertexSource.size());
+    key = hashBytes(fragmentSource.data(), fragmentSource.size(), key);
+
+    // Binaries are only valid for the driver that produced them
+    key = hashString((const char *)glGetString(GL_VENDOR), key);
+    key = hashString((const char *)glGetString(GL_RENDERER), key);
+    key = hashString((const char *)glGetString(GL_VERSION), key);
+
+    return hashBytes(&binaryFormat, sizeof(binaryFormat), key);
+}
+
+bool loadProgramBinary(
+        const std::string & name,
+        const std::string & vertexSource,
+        const std::string & fragmentSource,
+        GLuint & program) {
+    const ShaderExtensions & extensions = SHADER_EXTENSIONS;
+
+    if (!extensions.supportsProgramBinary)
+        return false;
+
+    MappedFile file;
+
+    if (!file.open(programCacheFilename(name)))
+        return false;
+
+    // Check format and key
+    const ProgramCacheHeader * header = (const ProgramCacheHeader *)file.data();
+
+    if (file.size() < sizeof(ProgramCacheHeader) ||
+            std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header->version != PROGRAM_CACHE_VERSION ||
+            header->binaryLength != file.size() - sizeof(ProgramCacheHeader) ||
+            header->key != programCacheKey(vertexSource, fragmentSource, header->binaryFormat) ||
+            !supportsBinaryFormat(header->binaryFormat))
+        return false;
+
+    // The driver may still reject the binary, for example after an update
+    // that kept its version string
+    GLuint id = glCreateProgram();
+
+    extensions.programBinary(
+        id,
+        header->binaryFormat,
+        file.data() + sizeof(ProgramCacheHeader),
+        (GLsizei)header->binaryLength);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(id, GL_LINK_STATUS, &status);
+
+    if (status != GL_TRUE) {
+        glDeleteProgram(id);
+        return false;
+    }
+
+    program = id;
+
+    return true;
+}
+
+bool saveProgramBinary(
+        const std::string & name,
+        const std::string & vertexSource,
+        const std::string & fragmentSource,
+        GLuint program) {
+    const ShaderExtensions & extensions = SHADER_EXTENSIONS;
+
+    if (!extensions.supportsProgramBinary)
+        return false;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+    if (length <= 0)
+        return false;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+
+    extensions.getProgramBinary(program, length, &written, &format, binary.data());
+
+    if (written <= 0)
+        return false;
+
+    ProgramCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.binaryFormat = format;
+    header.key = programCacheKey(vertexSource, fragmentSource, format);
+    header.binaryLength = (uint64_t)written;
+
+    // Write to a temporary file replacing the cache only when complete
+    std::string filename = programCacheFilename(name);
+    std::string temporaryFilename = filename + ".tmp";
+
+    std::ofstream file(temporaryFilename.c_str(), std::ios::out | std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    file.write((const char *)&header, sizeof(header));
+    file.write(binary.data(), written);
+    file.close();
+
+    if (!file) {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    std::remove(filename.c_str());
+
+    return std::rename(temporaryFilename.c_str(), filename.c_str()) == 0;
+}
@@ -0,0 +1,81 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+
+// Constants of program binaries (OpenGL 4.1 or ARB_get_program_binary) and
+// parallel shader compilation (KHR or ARB_parallel_shader_compile), which
+// are not part of the loaded OpenGL 3.3 core profile
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Binary program cache file format version, incremented on every layout change
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// Header at the beginning of a binary program cache file
+// The key identifies the shader sources, the driver and the binary format
+// the binary following the header was retrieved with.
+struct ProgramCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint64_t key;
+    uint64_t binaryLength;
+};
+
+// Entry points and availability of the optional shader extensions
+struct ShaderExtensions {
+    bool supportsProgramBinary;
+    bool supportsParallelShaderCompile;
+
+    void (APIENTRYP getProgramBinary)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
+    void (APIENTRYP programBinary)(GLuint, GLenum, const void *, GLsizei);
+    void (APIENTRYP programParameteri)(GLuint, GLenum, GLint);
+    void (APIENTRYP maxShaderCompilerThreads)(GLuint);
+};
+
+// Load optional shader extensions of the current context, which glad does
+// not load, returning them
+const ShaderExtensions & loadShaderExtensions(GLADloadproc load);
+
+// Shader extensions loaded last
+const ShaderExtensions & shaderExtensions();
+
+// Cache file name of a shader program, next to its shaders
+std::string programCacheFilename(const std::string & name);
+
+// Cache key of the sources of a program built by the current driver into
+// the given binary format
+uint64_t programCacheKey(
+        const std::string & vertexSource,
+        const std::string & fragmentSource,
+        GLenum binaryFormat);
+
+// Create program from its cached binary, failing if missing, stale or
+// rejected by the driver
+bool loadProgramBinary(
+        const std::string & name,
+        const std::string & vertexSource,
+        const std::string & fragmentSource,
+        GLuint & program);
+
+// Write the binary of a linked program to its cache file
+bool saveProgramBinary(
+        const std::string & name,
+        const std::string & vertexSource,
+        const std::string & fragmentSource,
+        GLuint program);
+
+#endif
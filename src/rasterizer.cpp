@@ -0,0 +1,516 @@
+#include "rasterizer.h"
+
+#include "parallel.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define RASTERIZER_SSE2
+#endif
+
+namespace {
+
+// Number of triangles set up and binned by a task, bins of a chunk keep
+// the triangle order
+const size_t BIN_CHUNK_SIZE = 4096;
+
+// Vertices are snapped to 1/256 of a pixel as OpenGL implementations do,
+// so edges fall on the same pixel centers
+const float SUBPIXEL_STEPS = 256.0f;
+
+// Vertex in clip space with its fragment color
+struct ClipVertex {
+    glm::vec4 position;
+    glm::vec3 color;
+};
+
+// Triangle in screen space with attributes divided by w, wound so that
+// its area is positive, and its pixel bounds clamped to the viewport
+struct RasterTriangle {
+    float x[3];
+    float y[3];
+    float z[3];
+    float inverseW[3];
+    float r[3];
+    float g[3];
+    float b[3];
+    float area;
+
+    int minimumX;
+    int minimumY;
+    int maximumX;
+    int maximumY;
+};
+
+// Triangles of a chunk and their indices binned by tile
+struct BinChunk {
+    std::vector<RasterTriangle> triangles;
+    std::vector<std::vector<uint32_t> > bins;
+};
+
+// Edge function a * (x - originX) + b * (y - originY), with ownership of
+// pixel centers exactly on the edge
+// The origin is the lowest endpoint in x then y whatever the direction, so
+// triangles sharing the edge evaluate exactly opposite values and cover
+// every pixel center once.
+struct Edge {
+    float a, b;
+    float originX, originY;
+    bool owned;
+};
+
+Edge makeEdge(const RasterTriangle & triangle, int from, int to) {
+    Edge edge;
+    edge.a = triangle.y[from] - triangle.y[to];
+    edge.b = triangle.x[to] - triangle.x[from];
+
+    bool fromFirst = triangle.x[from] < triangle.x[to] ||
+        (triangle.x[from] == triangle.x[to] && triangle.y[from] < triangle.y[to]);
+
+    int origin = fromFirst ? from : to;
+    edge.originX = triangle.x[origin];
+    edge.originY = triangle.y[origin];
+    edge.owned = edge.a > 0.0f || (edge.a == 0.0f && edge.b > 0.0f);
+
+    return edge;
+}
+
+inline uint32_t packColor(float r, float g, float b, float a) {
+    uint32_t red = (uint32_t)(glm::clamp(r, 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t green = (uint32_t)(glm::clamp(g, 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t blue = (uint32_t)(glm::clamp(b, 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t alpha = (uint32_t)(glm::clamp(a, 0.0f, 1.0f) * 255.0f + 0.5f);
+
+    return red | (green << 8) | (blue << 16) | (alpha << 24);
+}
+
+// Project a clipped triangle to the viewport and append it when visible
+void setupTriangle(
+        const ClipVertex & v0,
+        const ClipVertex & v1,
+        const ClipVertex & v2,
+        size_t width,
+        size_t height,
+        std::vector<RasterTriangle> & triangles) {
+    const ClipVertex * vertices[3] = { &v0, &v1, &v2 };
+
+    RasterTriangle triangle;
+
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4 & position = vertices[i]->position;
+        float inverseW = 1.0f / position.w;
+
+        float x = (position.x * inverseW * 0.5f + 0.5f) * width;
+        float y = (0.5f - position.y * inverseW * 0.5f) * height;
+
+        triangle.x[i] = std::floor(x * SUBPIXEL_STEPS + 0.5f) / SUBPIXEL_STEPS;
+        triangle.y[i] = std::floor(y * SUBPIXEL_STEPS + 0.5f) / SUBPIXEL_STEPS;
+        triangle.z[i] = position.z * inverseW * 0.5f + 0.5f;
+        triangle.inverseW[i] = inverseW;
+        triangle.r[i] = vertices[i]->color.r * inverseW;
+        triangle.g[i] = vertices[i]->color.g * inverseW;
+        triangle.b[i] = vertices[i]->color.b * inverseW;
+    }
+
+    triangle.area =
+        (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+        (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+
+    if (!(std::abs(triangle.area) > 0.0f) || !std::isfinite(triangle.area))
+        return;
+
+    // Both faces are drawn, wind back faces the other way
+    if (triangle.area < 0.0f) {
+        std::swap(triangle.x[1], triangle.x[2]);
+        std::swap(triangle.y[1], triangle.y[2]);
+        std::swap(triangle.z[1], triangle.z[2]);
+        std::swap(triangle.inverseW[1], triangle.inverseW[2]);
+        std::swap(triangle.r[1], triangle.r[2]);
+        std::swap(triangle.g[1], triangle.g[2]);
+        std::swap(triangle.b[1], triangle.b[2]);
+
+        triangle.area = -triangle.area;
+    }
+
+    float minimumX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+    float maximumX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+    float minimumY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+    float maximumY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+
+    // Pixels whose centers may be covered
+    float limitX = (float)width - 1.0f, limitY = (float)height - 1.0f;
+
+    if (maximumX < 0.0f || maximumY < 0.0f || minimumX > (float)width || minimumY > (float)height)
+        return;
+
+    triangle.minimumX = (int)std::max(0.0f, std::floor(minimumX - 0.5f));
+    triangle.minimumY = (int)std::max(0.0f, std::floor(minimumY - 0.5f));
+    triangle.maximumX = (int)std::min(limitX, std::ceil(maximumX - 0.5f));
+    triangle.maximumY = (int)std::min(limitY, std::ceil(maximumY - 0.5f));
+
+    if (triangle.minimumX > triangle.maximumX || triangle.minimumY > triangle.maximumY)
+        return;
+
+    triangles.push_back(triangle);
+}
+
+// Clip a triangle against the near plane z = -w and set up the result
+void clipTriangle(
+        const ClipVertex & v0,
+        const ClipVertex & v1,
+        const ClipVertex & v2,
+        size_t width,
+        size_t height,
+        std::vector<RasterTriangle> & triangles) {
+    const ClipVertex * input[3] = { &v0, &v1, &v2 };
+    float distances[3];
+    int inside = 0;
+
+    for (int i = 0; i < 3; i++) {
+        distances[i] = input[i]->position.z + input[i]->position.w;
+        inside += distances[i] >= 0.0f;
+    }
+
+    if (inside == 0)
+        return;
+
+    if (inside == 3) {
+        setupTriangle(v0, v1, v2, width, height, triangles);
+        return;
+    }
+
+    // Sutherland-Hodgman against a single plane gives at most 4 vertices
+    ClipVertex output[4];
+    int count = 0;
+
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+
+        if (distances[i] >= 0.0f)
+            output[count++] = *input[i];
+
+        if ((distances[i] >= 0.0f) != (distances[j] >= 0.0f)) {
+            float t = distances[i] / (distances[i] - distances[j]);
+
+            ClipVertex & vertex = output[count++];
+            vertex.position = glm::mix(input[i]->position, input[j]->position, t);
+            vertex.color = glm::mix(input[i]->color, input[j]->color, t);
+        }
+    }
+
+    for (int i = 1; i + 1 < count; i++)
+        setupTriangle(output[0], output[i], output[i + 1], width, height, triangles);
+}
+
+// Rasterize triangle into the tile buffers, whose origin is in pixels
+void rasterizeTriangle(
+        const RasterTriangle & triangle,
+        int tileX,
+        int tileY,
+        int tileWidth,
+        int tileHeight,
+        uint32_t * colors,
+        float * depths) {
+    int beginX = std::max(triangle.minimumX, tileX);
+    int beginY = std::max(triangle.minimumY, tileY);
+    int endX = std::min(triangle.maximumX + 1, tileX + tileWidth);
+    int endY = std::min(triangle.maximumY + 1, tileY + tileHeight);
+
+    if (beginX >= endX || beginY >= endY)
+        return;
+
+    // Edges opposite to every vertex, weighting the vertex attributes
+    Edge edges[3] = {
+        makeEdge(triangle, 1, 2),
+        makeEdge(triangle, 2, 0),
+        makeEdge(triangle, 0, 1)
+    };
+
+    float inverseArea = 1.0f / triangle.area;
+
+    // Quads of four pixels start at multiples of 4 inside the tile
+    beginX = tileX + ((beginX - tileX) & ~3);
+
+#ifdef RASTERIZER_SSE2
+    __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 inverseAreaLanes = _mm_set1_ps(inverseArea);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 scale = _mm_set1_ps(255.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128i limits = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i alpha = _mm_set1_epi32((int)0xff000000u);
+
+    __m128 a[3], owned[3];
+
+    for (int i = 0; i < 3; i++) {
+        a[i] = _mm_set1_ps(edges[i].a);
+        owned[i] = edges[i].owned ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : zero;
+    }
+
+    for (int y = beginY; y < endY; y++) {
+        float centerY = (float)y + 0.5f;
+        __m128 rowTerms[3];
+
+        for (int i = 0; i < 3; i++)
+            rowTerms[i] = _mm_set1_ps(edges[i].b * (centerY - edges[i].originY));
+
+        uint32_t * colorRow = colors + (y - tileY) * RASTER_TILE_SIZE;
+        float * depthRow = depths + (y - tileY) * RASTER_TILE_SIZE;
+
+        for (int x = beginX; x < endX; x += 4) {
+            // Edge functions are evaluated from scratch rather than stepped,
+            // keeping them exact opposites across shared edges
+            __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+            __m128 e[3];
+
+            for (int i = 0; i < 3; i++)
+                e[i] = _mm_add_ps(
+                    _mm_mul_ps(a[i], _mm_sub_ps(centerX, _mm_set1_ps(edges[i].originX))),
+                    rowTerms[i]);
+
+            // Inside every edge, pixel centers on owned edges included
+            __m128 mask = _mm_castsi128_ps(_mm_cmplt_epi32(limits, _mm_set1_epi32(endX - x)));
+
+            for (int i = 0; i < 3; i++) {
+                __m128 inside = _mm_or_ps(
+                    _mm_cmpgt_ps(e[i], zero),
+                    _mm_and_ps(_mm_cmpeq_ps(e[i], zero), owned[i]));
+
+                mask = _mm_and_ps(mask, inside);
+            }
+
+            if (_mm_movemask_ps(mask) != 0) {
+                __m128 w0 = _mm_mul_ps(e[0], inverseAreaLanes);
+                __m128 w1 = _mm_mul_ps(e[1], inverseAreaLanes);
+                __m128 w2 = _mm_mul_ps(e[2], inverseAreaLanes);
+
+                // Depth test with the less function
+                __m128 z = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(triangle.z[0])), _mm_mul_ps(w1, _mm_set1_ps(triangle.z[1]))),
+                    _mm_mul_ps(w2, _mm_set1_ps(triangle.z[2])));
+
+                float * depth = depthRow + (x - tileX);
+                __m128 stored = _mm_loadu_ps(depth);
+
+                mask = _mm_and_ps(mask, _mm_cmplt_ps(z, stored));
+
+                if (_mm_movemask_ps(mask) != 0) {
+                    _mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, stored)));
+
+                    // Perspective correct color
+                    __m128 inverseW = _mm_add_ps(
+                        _mm_add_ps(
+                            _mm_mul_ps(w0, _mm_set1_ps(triangle.inverseW[0])),
+                            _mm_mul_ps(w1, _mm_set1_ps(triangle.inverseW[1]))),
+                        _mm_mul_ps(w2, _mm_set1_ps(triangle.inverseW[2])));
+                    __m128 w = _mm_div_ps(one, inverseW);
+
+                    __m128 channels[3];
+                    const float * values[3] = { triangle.r, triangle.g, triangle.b };
+
+                    for (int i = 0; i < 3; i++) {
+                        __m128 value = _mm_add_ps(
+                            _mm_add_ps(
+                                _mm_mul_ps(w0, _mm_set1_ps(values[i][0])),
+                                _mm_mul_ps(w1, _mm_set1_ps(values[i][1]))),
+                            _mm_mul_ps(w2, _mm_set1_ps(values[i][2])));
+
+                        value = _mm_min_ps(_mm_max_ps(_mm_mul_ps(value, w), zero), one);
+                        channels[i] = _mm_add_ps(_mm_mul_ps(value, scale), half);
+                    }
+
+                    __m128i pixels = _mm_or_si128(
+                        _mm_or_si128(
+                            _mm_cvttps_epi32(channels[0]),
+                            _mm_slli_epi32(_mm_cvttps_epi32(channels[1]), 8)),
+                        _mm_or_si128(
+                            _mm_slli_epi32(_mm_cvttps_epi32(channels[2]), 16),
+                            alpha));
+
+                    uint32_t * color = colorRow + (x - tileX);
+                    __m128i previous = _mm_loadu_si128((const __m128i *)color);
+                    __m128i pixelMask = _mm_castps_si128(mask);
+
+                    _mm_storeu_si128(
+                        (__m128i *)color,
+                        _mm_or_si128(_mm_and_si128(pixelMask, pixels), _mm_andnot_si128(pixelMask, previous)));
+                }
+            }
+        }
+    }
+#else
+    for (int y = beginY; y < endY; y++) {
+        float centerY = (float)y + 0.5f;
+
+        for (int x = beginX; x < endX; x++) {
+            float centerX = (float)x + 0.5f;
+            float e[3];
+            bool inside = true;
+
+            for (int i = 0; i < 3 && inside; i++) {
+                e[i] = edges[i].a * (centerX - edges[i].originX) + edges[i].b * (centerY - edges[i].originY);
+                inside = e[i] > 0.0f || (e[i] == 0.0f && edges[i].owned);
+            }
+
+            if (!inside)
+                continue;
+
+            float w0 = e[0] * inverseArea, w1 = e[1] * inverseArea, w2 = e[2] * inverseArea;
+            float z = w0 * triangle.z[0] + w1 * triangle.z[1] + w2 * triangle.z[2];
+            float & depth = depths[(y - tileY) * RASTER_TILE_SIZE + (x - tileX)];
+
+            if (!(z < depth))
+                continue;
+
+            depth = z;
+
+            float w = 1.0f / (w0 * triangle.inverseW[0] + w1 * triangle.inverseW[1] + w2 * triangle.inverseW[2]);
+
+            colors[(y - tileY) * RASTER_TILE_SIZE + (x - tileX)] = packColor(
+                (w0 * triangle.r[0] + w1 * triangle.r[1] + w2 * triangle.r[2]) * w,
+                (w0 * triangle.g[0] + w1 * triangle.g[1] + w2 * triangle.g[2]) * w,
+                (w0 * triangle.b[0] + w1 * triangle.b[1] + w2 * triangle.b[2]) * w,
+                1.0f);
+        }
+    }
+#endif
+}
+
+}
+
+void resizeFramebuffer(RasterFramebuffer & framebuffer, size_t width, size_t height) {
+    framebuffer.width = width;
+    framebuffer.height = height;
+    framebuffer.color.assign(width * height, 0);
+    framebuffer.depth.assign(width * height, 1.0f);
+}
+
+void rasterizeMesh(
+        const std::vector<Vertex> & vertices,
+        const std::vector<uint32_t> & indices,
+        size_t indexCount,
+        const glm::mat4 & modelViewProjection,
+        const glm::vec4 & clearColor,
+        RasterFramebuffer & framebuffer,
+        RasterStatistics * statistics) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    size_t width = framebuffer.width, height = framebuffer.height;
+    size_t tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    size_t tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+    // Transform vertices to clip space and shade them as the vertex shader
+    std::vector<ClipVertex> clipVertices(vertices.size());
+
+    parallelFor(vertices.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            clipVertices[i].position = modelViewProjection * glm::vec4(vertices[i].position, 1.0f);
+            clipVertices[i].color = (vertices[i].normal + glm::vec3(1.0f)) * 0.5f;
+        }
+    });
+
+    std::chrono::steady_clock::time_point transformed = std::chrono::steady_clock::now();
+
+    // Clip, set up and bin chunks of triangles
+    size_t triangleCount = indexCount / 3;
+    size_t chunkCount = (triangleCount + BIN_CHUNK_SIZE - 1) / BIN_CHUNK_SIZE;
+
+    std::vector<BinChunk> chunks(chunkCount);
+
+    parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            BinChunk & bins = chunks[chunk];
+            bins.bins.resize(tilesX * tilesY);
+
+            size_t first = chunk * BIN_CHUNK_SIZE;
+            size_t last = std::min(triangleCount, first + BIN_CHUNK_SIZE);
+
+            for (size_t i = first; i < last; i++)
+                clipTriangle(
+                    clipVertices[indices[i * 3]],
+                    clipVertices[indices[i * 3 + 1]],
+                    clipVertices[indices[i * 3 + 2]],
+                    width,
+                    height,
+                    bins.triangles);
+
+            for (size_t i = 0; i < bins.triangles.size(); i++) {
+                const RasterTriangle & triangle = bins.triangles[i];
+
+                for (size_t y = triangle.minimumY / RASTER_TILE_SIZE; y <= triangle.maximumY / RASTER_TILE_SIZE; y++)
+                    for (size_t x = triangle.minimumX / RASTER_TILE_SIZE; x <= triangle.maximumX / RASTER_TILE_SIZE; x++)
+                        bins.bins[y * tilesX + x].push_back((uint32_t)i);
+            }
+        }
+    });
+
+    std::chrono::steady_clock::time_point binned = std::chrono::steady_clock::now();
+
+    // Rasterize every tile into local buffers in chunk order
+    uint32_t clearPixel = packColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+
+    parallelFor(tilesX * tilesY, 1, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> colors(RASTER_TILE_SIZE * RASTER_TILE_SIZE);
+        std::vector<float> depths(RASTER_TILE_SIZE * RASTER_TILE_SIZE);
+
+        for (size_t tile = begin; tile < end; tile++) {
+            int tileX = (int)((tile % tilesX) * RASTER_TILE_SIZE);
+            int tileY = (int)((tile / tilesX) * RASTER_TILE_SIZE);
+            int tileWidth = (int)std::min(RASTER_TILE_SIZE, width - tileX);
+            int tileHeight = (int)std::min(RASTER_TILE_SIZE, height - tileY);
+
+            std::fill(colors.begin(), colors.end(), clearPixel);
+            std::fill(depths.begin(), depths.end(), 1.0f);
+
+            for (size_t chunk = 0; chunk < chunks.size(); chunk++) {
+                const std::vector<uint32_t> & bin = chunks[chunk].bins[tile];
+
+                for (size_t i = 0; i < bin.size(); i++)
+                    rasterizeTriangle(
+                        chunks[chunk].triangles[bin[i]],
+                        tileX,
+                        tileY,
+                        tileWidth,
+                        tileHeight,
+                        colors.data(),
+                        depths.data());
+            }
+
+            for (int y = 0; y < tileHeight; y++) {
+                std::copy(
+                    colors.begin() + y * RASTER_TILE_SIZE,
+                    colors.begin() + y * RASTER_TILE_SIZE + tileWidth,
+                    framebuffer.color.begin() + (tileY + y) * width + tileX);
+                std::copy(
+                    depths.begin() + y * RASTER_TILE_SIZE,
+                    depths.begin() + y * RASTER_TILE_SIZE + tileWidth,
+                    framebuffer.depth.begin() + (tileY + y) * width + tileX);
+            }
+        }
+    });
+
+    std::chrono::steady_clock::time_point rasterized = std::chrono::steady_clock::now();
+
+    if (statistics != nullptr) {
+        statistics->triangles = triangleCount;
+        statistics->rasterized = 0;
+        statistics->binned = 0;
+
+        for (size_t i = 0; i < chunks.size(); i++) {
+            statistics->rasterized += chunks[i].triangles.size();
+
+            for (size_t j = 0; j < chunks[i].bins.size(); j++)
+                statistics->binned += chunks[i].bins[j].size();
+        }
+
+        statistics->transformSeconds = std::chrono::duration<double>(transformed - start).count();
+        statistics->binSeconds = std::chrono::duration<double>(binned - transformed).count();
+        statistics->rasterSeconds = std::chrono::duration<double>(rasterized - binned).count();
+    }
+}
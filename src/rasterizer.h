@@ -0,0 +1,60 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include "mesh.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Side in pixels of the square screen tiles rasterized in parallel
+const size_t RASTER_TILE_SIZE = 64;
+
+// Color and depth buffers of the software rasterizer
+// Rows are stored from the top of the image, colors as RGBA bytes.
+struct RasterFramebuffer {
+    size_t width;
+    size_t height;
+
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+};
+
+// Counters and durations of rendering a frame
+struct RasterStatistics {
+    size_t triangles;
+
+    // Triangles left after near plane clipping and degenerate rejection
+    size_t rasterized;
+
+    // Triangle and tile pairs of the bins
+    size_t binned;
+
+    double transformSeconds;
+    double binSeconds;
+    double rasterSeconds;
+};
+
+// Allocate framebuffer of the given size
+void resizeFramebuffer(RasterFramebuffer & framebuffer, size_t width, size_t height);
+
+// Render indexed triangles as the triangle shaders do, coloring fragments
+// by their interpolated normal and keeping the nearest ones
+// Triangles are clipped against the near plane, set up and binned to screen
+// tiles in parallel chunks, and tiles are rasterized in parallel, evaluating
+// edge functions over four pixels at a time against a per tile depth buffer.
+// Both faces are drawn and equal depths keep the first triangle, as with the
+// default OpenGL state of the viewer.
+void rasterizeMesh(
+        const std::vector<Vertex> & vertices,
+        const std::vector<uint32_t> & indices,
+        size_t indexCount,
+        const glm::mat4 & modelViewProjection,
+        const glm::vec4 & clearColor,
+        RasterFramebuffer & framebuffer,
+        RasterStatistics * statistics = nullptr);
+
+#endif
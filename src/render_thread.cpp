@@ -0,0 +1,142 @@
+#include "render_thread.h"
+
+bool parseFramePacing(const std::string & name, FramePacing & pacing) {
+    if (name == "vsync")
+        pacing = FRAME_PACING_VSYNC;
+    else if (name == "uncapped")
+        pacing = FRAME_PACING_UNCAPPED;
+    else if (name == "target-latency")
+        pacing = FRAME_PACING_TARGET_LATENCY;
+    else
+        return false;
+
+    return true;
+}
+
+const char * framePacingName(FramePacing pacing) {
+    switch (pacing) {
+    case FRAME_PACING_VSYNC:
+        return "vsync";
+    case FRAME_PACING_UNCAPPED:
+        return "uncapped";
+    case FRAME_PACING_TARGET_LATENCY:
+        return "target-latency";
+    }
+
+    return "unknown";
+}
+
+int swapInterval(FramePacing pacing) {
+    return pacing == FRAME_PACING_UNCAPPED ? 0 : 1;
+}
+
+FrameMailbox::FrameMailbox() :
+        closed(false), consumeInterval(0), mainWait(0.0), renderWait(0.0) {
+}
+
+void FrameMailbox::create(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    packets.assign(count, FramePacket());
+    free.clear();
+    published.clear();
+
+    for (size_t i = 0; i < packets.size(); i++)
+        free.push_back(&packets[i]);
+
+    closed = false;
+    lastConsume = std::chrono::steady_clock::now();
+    consumeInterval = std::chrono::steady_clock::duration(0);
+    mainWait = 0.0;
+    renderWait = 0.0;
+}
+
+FramePacket * FrameMailbox::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while (!closed && free.empty())
+        changed.wait(lock);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    mainWait += elapsed.count();
+
+    if (closed)
+        return nullptr;
+
+    FramePacket * packet = free.front();
+    free.pop_front();
+
+    return packet;
+}
+
+void FrameMailbox::publish(FramePacket * packet) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        packet->published = std::chrono::steady_clock::now();
+        published.push_back(packet);
+    }
+
+    changed.notify_all();
+}
+
+FramePacket * FrameMailbox::consume() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while (!closed && published.empty())
+        changed.wait(lock);
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - start;
+    renderWait += elapsed.count();
+
+    if (published.empty())
+        return nullptr;
+
+    consumeInterval = now - lastConsume;
+    lastConsume = now;
+
+    FramePacket * packet = published.front();
+    published.pop_front();
+
+    return packet;
+}
+
+void FrameMailbox::release(FramePacket * packet) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        free.push_back(packet);
+    }
+
+    changed.notify_all();
+}
+
+void FrameMailbox::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+
+    changed.notify_all();
+}
+
+std::chrono::steady_clock::time_point FrameMailbox::nextConsume() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Packets already queued are taken first, one interval each
+    return lastConsume + consumeInterval * (long)(published.size() + 1);
+}
+
+void FrameMailbox::takeWaitTimes(double & mainWait, double & renderWait) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    mainWait = this->mainWait;
+    renderWait = this->renderWait;
+
+    this->mainWait = 0.0;
+    this->renderWait = 0.0;
+}
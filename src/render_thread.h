@@ -0,0 +1,124 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Frame packets in flight between the main and the render thread
+const size_t MIN_FRAME_PACKETS = 2;
+const size_t MAX_FRAME_PACKETS = 3;
+
+// Pacing of the frames submitted by the render thread
+enum FramePacing {
+    // Swap on vertical blank, the main thread waits for free packets
+    FRAME_PACING_VSYNC = 0,
+
+    // Swap immediately
+    FRAME_PACING_UNCAPPED = 1,
+
+    // Swap on vertical blank and delay building every packet until the
+    // target latency before the render thread is expected to take it, so
+    // that input is sampled as late as possible
+    FRAME_PACING_TARGET_LATENCY = 2
+};
+
+// Parse frame pacing name (vsync, uncapped or target-latency)
+bool parseFramePacing(const std::string & name, FramePacing & pacing);
+
+// Name of frame pacing
+const char * framePacingName(FramePacing pacing);
+
+// Swap interval of a frame pacing
+int swapInterval(FramePacing pacing);
+
+// Scene state of a frame, built by the main thread and left untouched
+// once published until the render thread releases it
+struct FramePacket {
+    size_t frame;
+
+    glm::mat4 model;
+    glm::mat4 view;
+    bool background;
+
+    // Framebuffer size
+    int width;
+    int height;
+
+    // Animation time in seconds
+    double time;
+
+    // Cursor positions of picking requests in normalized device coordinates
+    std::vector<glm::vec2> picks;
+
+    // Whether input was applied to the frame and the time of the oldest event
+    bool hasInput;
+    std::chrono::steady_clock::time_point oldestInput;
+
+    // Time the packet was published
+    std::chrono::steady_clock::time_point published;
+};
+
+// Handoff of frame packets from the main thread to the render thread over
+// a fixed number of packets, two for double and three for triple buffering
+// The render thread holds one packet while rendering it, the main thread
+// fills the others and waits when none is free.
+class FrameMailbox {
+public:
+    FrameMailbox();
+
+    void create(size_t count);
+
+    // Free packet to fill, waiting for the render thread to release one,
+    // nullptr once closed
+    FramePacket * acquire();
+
+    // Queue filled packet for the render thread
+    void publish(FramePacket * packet);
+
+    // Oldest published packet, waiting for the main thread to publish one,
+    // nullptr once closed and every published packet consumed
+    FramePacket * consume();
+
+    // Give rendered packet back to the main thread
+    void release(FramePacket * packet);
+
+    // Wake up both threads to stop
+    void close();
+
+    // Time the render thread is expected to take the next packet, from the
+    // interval between its last two takes
+    std::chrono::steady_clock::time_point nextConsume();
+
+    // Seconds waited by the main thread on free packets and by the render
+    // thread on published ones since the last call
+    void takeWaitTimes(double & mainWait, double & renderWait);
+
+private:
+    FrameMailbox(const FrameMailbox &);
+    FrameMailbox & operator=(const FrameMailbox &);
+
+    std::vector<FramePacket> packets;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    std::deque<FramePacket *> free;
+    std::deque<FramePacket *> published;
+    bool closed;
+
+    std::chrono::steady_clock::time_point lastConsume;
+    std::chrono::steady_clock::duration consumeInterval;
+
+    double mainWait;
+    double renderWait;
+};
+
+#endif
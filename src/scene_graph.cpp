@@ -0,0 +1,342 @@
+#include "scene_graph.h"
+
+#include "parallel.h"
+#include "profiler.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SCENE_GRAPH_SSE2
+#endif
+
+namespace {
+
+// World matrix of a node from the world matrix of its parent and its local
+// transformation, the local matrix is never formed
+void composeWorld(const glm::mat4 & parent, const NodeTransform & local, glm::mat4 & world) {
+    glm::mat3 rotation = glm::mat3_cast(local.rotation);
+
+#ifdef SCENE_GRAPH_SSE2
+    const float * p = glm::value_ptr(parent);
+    float * w = glm::value_ptr(world);
+
+    __m128 p0 = _mm_loadu_ps(p);
+    __m128 p1 = _mm_loadu_ps(p + 4);
+    __m128 p2 = _mm_loadu_ps(p + 8);
+    __m128 p3 = _mm_loadu_ps(p + 12);
+
+    // Scaled rotation axes, with a zero w
+    for (int i = 0; i < 3; i++) {
+        glm::vec3 axis = rotation[i] * local.scale[i];
+
+        __m128 column = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(axis.x)), _mm_mul_ps(p1, _mm_set1_ps(axis.y))),
+            _mm_mul_ps(p2, _mm_set1_ps(axis.z)));
+
+        _mm_storeu_ps(w + i * 4, column);
+    }
+
+    // Translation, with a unit w
+    const glm::vec3 & t = local.translation;
+
+    __m128 column = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(t.x)), _mm_mul_ps(p1, _mm_set1_ps(t.y))),
+        _mm_add_ps(_mm_mul_ps(p2, _mm_set1_ps(t.z)), p3));
+
+    _mm_storeu_ps(w + 12, column);
+#else
+    glm::mat4 matrix(rotation);
+    matrix[0] *= local.scale.x;
+    matrix[1] *= local.scale.y;
+    matrix[2] *= local.scale.z;
+    matrix[3] = glm::vec4(local.translation, 1.0f);
+
+    world = parent * matrix;
+#endif
+}
+
+}
+
+NodeTransform identityTransform() {
+    NodeTransform transform = {
+        glm::vec3(0.0f),
+        glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+        glm::vec3(1.0f)
+    };
+
+    return transform;
+}
+
+glm::mat4 transformMatrix(const NodeTransform & transform) {
+    glm::mat4 matrix;
+    composeWorld(glm::mat4(1.0f), transform, matrix);
+
+    return matrix;
+}
+
+SceneGraph::SceneGraph() : sorted(true) {
+}
+
+uint32_t SceneGraph::addNode(uint32_t parent, const NodeTransform & local) {
+    uint32_t node = (uint32_t)parents.size();
+
+    // Appending keeps the order depth first when the subtree of the parent
+    // is the last one, extending it and its ancestors
+    if (parent != NO_PARENT && sorted) {
+        if (subtreeEnds[parent] == node) {
+            for (uint32_t ancestor = parent; ancestor != NO_PARENT && subtreeEnds[ancestor] == node;
+                    ancestor = parents[ancestor])
+                subtreeEnds[ancestor] = node + 1;
+        }
+        else
+            sorted = false;
+    }
+
+    parents.push_back(parent);
+    subtreeEnds.push_back(node + 1);
+    locals.push_back(local);
+    worlds.push_back(glm::mat4(1.0f));
+    dirtyFlags.push_back(0);
+
+    markDirty(node);
+
+    return node;
+}
+
+void SceneGraph::clear() {
+    parents.clear();
+    subtreeEnds.clear();
+    locals.clear();
+    worlds.clear();
+    dirtyNodes.clear();
+    dirtyFlags.clear();
+    sorted = true;
+}
+
+size_t SceneGraph::size() const {
+    return parents.size();
+}
+
+uint32_t SceneGraph::parent(uint32_t node) const {
+    return parents[node];
+}
+
+uint32_t SceneGraph::subtreeEnd(uint32_t node) const {
+    return subtreeEnds[node];
+}
+
+const NodeTransform & SceneGraph::local(uint32_t node) const {
+    return locals[node];
+}
+
+void SceneGraph::setLocal(uint32_t node, const NodeTransform & local) {
+    locals[node] = local;
+    markDirty(node);
+}
+
+bool SceneGraph::isSorted() const {
+    return sorted;
+}
+
+void SceneGraph::sort(std::vector<uint32_t> & remap) {
+    size_t count = parents.size();
+
+    // Children of every node in index order, roots last
+    std::vector<uint32_t> childOffsets(count + 3, 0);
+    std::vector<uint32_t> children(count);
+
+    for (size_t i = 0; i < count; i++)
+        childOffsets[(parents[i] == NO_PARENT ? count : parents[i]) + 2]++;
+
+    for (size_t i = 2; i < childOffsets.size(); i++)
+        childOffsets[i] += childOffsets[i - 1];
+
+    for (size_t i = 0; i < count; i++)
+        children[childOffsets[(parents[i] == NO_PARENT ? count : parents[i]) + 1]++] = (uint32_t)i;
+
+    // Depth first traversal from the roots, children pushed in reverse so
+    // that they are visited in order
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> stack;
+
+    order.reserve(count);
+
+    for (uint32_t i = childOffsets[count + 1]; i > childOffsets[count]; i--)
+        stack.push_back(children[i - 1]);
+
+    while (!stack.empty()) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+
+        order.push_back(node);
+
+        for (uint32_t i = childOffsets[node + 1]; i > childOffsets[node]; i--)
+            stack.push_back(children[i - 1]);
+    }
+
+    remap.resize(count);
+
+    for (size_t i = 0; i < count; i++)
+        remap[order[i]] = (uint32_t)i;
+
+    // Permute nodes
+    std::vector<uint32_t> sortedParents(count);
+    std::vector<NodeTransform> sortedLocals(count);
+    std::vector<glm::mat4> sortedWorlds(count);
+    std::vector<uint8_t> sortedFlags(count);
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t node = order[i];
+
+        sortedParents[i] = parents[node] == NO_PARENT ? NO_PARENT : remap[parents[node]];
+        sortedLocals[i] = locals[node];
+        sortedWorlds[i] = worlds[node];
+        sortedFlags[i] = dirtyFlags[node];
+    }
+
+    parents.swap(sortedParents);
+    locals.swap(sortedLocals);
+    worlds.swap(sortedWorlds);
+    dirtyFlags.swap(sortedFlags);
+
+    for (size_t i = 0; i < dirtyNodes.size(); i++)
+        dirtyNodes[i] = remap[dirtyNodes[i]];
+
+    // Subtrees end after their last descendant
+    for (size_t i = 0; i < count; i++)
+        subtreeEnds[i] = (uint32_t)i + 1;
+
+    for (size_t i = count; i > 0; i--)
+        if (parents[i - 1] != NO_PARENT)
+            subtreeEnds[parents[i - 1]] = std::max(subtreeEnds[parents[i - 1]], subtreeEnds[i - 1]);
+
+    sorted = true;
+}
+
+size_t SceneGraph::update(SceneUpdateStatistics * statistics) {
+    PROFILE_ZONE("Update scene graph");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (!sorted) {
+        std::vector<uint32_t> remap;
+        sort(remap);
+    }
+
+    // Dirty nodes in depth first order, skipping those inside the subtree
+    // of a previous one
+    std::sort(dirtyNodes.begin(), dirtyNodes.end());
+
+    tasks.clear();
+
+    uint32_t covered = 0;
+    size_t subtrees = 0;
+    size_t updated = 0;
+
+    for (size_t i = 0; i < dirtyNodes.size(); i++) {
+        uint32_t node = dirtyNodes[i];
+        dirtyFlags[node] = 0;
+
+        if (node < covered)
+            continue;
+
+        splitSubtree(node);
+
+        covered = subtreeEnds[node];
+        updated += subtreeEnds[node] - node;
+        subtrees++;
+    }
+
+    dirtyNodes.clear();
+
+    parallelFor(tasks.size(), 1, [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            for (uint32_t node = tasks[i].begin; node < tasks[i].end; node++)
+                updateNode(node);
+    });
+
+    if (statistics != nullptr) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        statistics->dirtySubtrees = subtrees;
+        statistics->updatedNodes = updated;
+        statistics->tasks = tasks.size();
+        statistics->seconds = elapsed.count();
+    }
+
+    return updated;
+}
+
+const glm::mat4 & SceneGraph::world(uint32_t node) const {
+    return worlds[node];
+}
+
+const std::vector<glm::mat4> & SceneGraph::worldMatrices() const {
+    return worlds;
+}
+
+void SceneGraph::markDirty(uint32_t node) {
+    if (dirtyFlags[node])
+        return;
+
+    dirtyFlags[node] = 1;
+    dirtyNodes.push_back(node);
+}
+
+void SceneGraph::splitSubtree(uint32_t root) {
+    splitStack.clear();
+    splitStack.push_back(root);
+
+    while (!splitStack.empty()) {
+        uint32_t node = splitStack.back();
+        splitStack.pop_back();
+
+        uint32_t end = subtreeEnds[node];
+
+        if (end - node <= SCENE_TASK_NODES) {
+            UpdateTask task = { node, end };
+            tasks.push_back(task);
+            continue;
+        }
+
+        // Update the root now and group its child subtrees into tasks,
+        // splitting the large ones further
+        updateNode(node);
+
+        UpdateTask group = { node + 1, node + 1 };
+
+        for (uint32_t child = node + 1; child < end; child = subtreeEnds[child]) {
+            uint32_t childEnd = subtreeEnds[child];
+
+            if (childEnd - child > SCENE_TASK_NODES || childEnd - group.begin > SCENE_TASK_NODES) {
+                if (group.end > group.begin)
+                    tasks.push_back(group);
+
+                group.begin = child;
+            }
+
+            if (childEnd - child > SCENE_TASK_NODES) {
+                splitStack.push_back(child);
+                group.begin = childEnd;
+            }
+
+            group.end = childEnd;
+        }
+
+        if (group.end > group.begin)
+            tasks.push_back(group);
+    }
+}
+
+void SceneGraph::updateNode(uint32_t node) {
+    uint32_t parent = parents[node];
+
+    if (parent == NO_PARENT)
+        composeWorld(glm::mat4(1.0f), locals[node], worlds[node]);
+    else
+        composeWorld(worlds[parent], locals[node], worlds[node]);
+}
@@ -0,0 +1,126 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Parent of root nodes
+const uint32_t NO_PARENT = 0xffffffffu;
+
+// Nodes of the largest subtree or run of sibling subtrees updated by a
+// single task
+const size_t SCENE_TASK_NODES = 4096;
+
+// Local transformation of a node relative to its parent: scale, then
+// rotation, then translation
+struct NodeTransform {
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+// Identity local transformation
+NodeTransform identityTransform();
+
+// Matrix of a local transformation
+glm::mat4 transformMatrix(const NodeTransform & transform);
+
+// Work done by a scene graph update
+struct SceneUpdateStatistics {
+    // Dirty nodes not inside another dirty subtree
+    size_t dirtySubtrees;
+
+    size_t updatedNodes;
+
+    // Ranges of nodes updated in parallel
+    size_t tasks;
+
+    double seconds;
+};
+
+// Hierarchy of nodes with local and world transformations in contiguous
+// arrays sorted depth first, so parents come before their children and
+// every subtree is a contiguous range of nodes
+// Changing the local transformation of a node marks its subtree dirty, and
+// updates recompute the world matrices of dirty subtrees only. Subtrees too
+// large for a single task are split into their child subtrees, updated in
+// parallel once their root is. World matrices are stored in node order,
+// ready to be streamed as instance data.
+class SceneGraph {
+public:
+    SceneGraph();
+
+    // Append a node under a parent of lower index, NO_PARENT for a root,
+    // returning its index
+    // Nodes appended under a parent whose subtree is not the last one
+    // leave the graph unsorted until the next sort or update.
+    uint32_t addNode(uint32_t parent, const NodeTransform & local);
+
+    void clear();
+
+    size_t size() const;
+
+    uint32_t parent(uint32_t node) const;
+
+    // One past the last node of the subtree of a node, while sorted
+    uint32_t subtreeEnd(uint32_t node) const;
+
+    const NodeTransform & local(uint32_t node) const;
+
+    // Replace local transformation of a node, marking its subtree dirty
+    void setLocal(uint32_t node, const NodeTransform & local);
+
+    // Nodes are in depth first order
+    bool isSorted() const;
+
+    // Reorder nodes depth first keeping the order of siblings, writing the
+    // new index of every node at its former index
+    void sort(std::vector<uint32_t> & remap);
+
+    // Recompute world matrices of dirty subtrees, sorting first when
+    // needed, returning the number of updated nodes
+    // Callers keeping data per node should sort after appending out of
+    // order to remap it.
+    size_t update(SceneUpdateStatistics * statistics = nullptr);
+
+    const glm::mat4 & world(uint32_t node) const;
+
+    // World matrices of every node in node order
+    const std::vector<glm::mat4> & worldMatrices() const;
+
+private:
+    // Contiguous range of whole subtrees whose parents are up to date
+    struct UpdateTask {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    void markDirty(uint32_t node);
+
+    // Append the tasks of a dirty subtree, updating the roots of subtrees
+    // split into tasks right away
+    void splitSubtree(uint32_t root);
+
+    void updateNode(uint32_t node);
+
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> subtreeEnds;
+    std::vector<NodeTransform> locals;
+    std::vector<glm::mat4> worlds;
+
+    // Dirty nodes in the order they were marked, and their flags
+    std::vector<uint32_t> dirtyNodes;
+    std::vector<uint8_t> dirtyFlags;
+
+    bool sorted;
+
+    std::vector<UpdateTask> tasks;
+    std::vector<uint32_t> splitStack;
+};
+
+#endif
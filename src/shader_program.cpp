@@ -0,0 +1,546 @@
+#include "shader_program.h"
+
+#include "logger.h"
+#include "profiler.h"
+#include "program_cache.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Values of every uniform are cached as up to 16 floats
+const size_t UNIFORM_VALUE_SIZE = 16;
+
+// Program made current by shader program objects
+GLuint CURRENT_PROGRAM = 0;
+
+// Check whether a value of the given setter type can set a uniform type
+bool compatibleTypes(GLenum uniformType, GLenum valueType) {
+    if (uniformType == valueType)
+        return true;
+
+    // Booleans and samplers are set as integers
+    if (valueType == GL_INT) {
+        switch (uniformType) {
+        case GL_BOOL:
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Program compiled and linked from source, waiting for completion
+struct PendingProgram {
+    size_t index;
+    GLuint program;
+    GLuint vertexShader;
+    GLuint fragmentShader;
+};
+
+// Read from text file to string
+bool readTextFile(const std::string & filename, std::string & text) {
+    std::ifstream file(filename, std::ifstream::in);
+
+    if (!file.is_open())
+        return false;
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    text = buffer.str();
+
+    return true;
+}
+
+// Print log message of a shader that failed to compile
+void printShaderLog(GLuint shader) {
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+    if (status == GL_TRUE)
+        return;
+
+    GLint size = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &size);
+
+    std::string message;
+    message.resize(size);
+
+    glGetShaderInfoLog(shader, size, nullptr, (GLchar *)message.data());
+
+    LogLine() << message;
+}
+
+// Print log message of a program that failed to link
+void printProgramLog(GLuint program) {
+    GLint size = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &size);
+
+    std::string message;
+    message.resize(size);
+
+    glGetProgramInfoLog(program, size, nullptr, (GLchar *)message.data());
+
+    LogLine() << message;
+}
+
+}
+
+ShaderProgram::ShaderProgram() :
+        program(0) {
+}
+
+ShaderProgram::~ShaderProgram() {
+    destroy();
+}
+
+void ShaderProgram::reset(GLuint id) {
+    destroy();
+
+    program = id;
+
+    // Reflect active uniforms
+    GLint uniformCount = 0, maximumLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maximumLength);
+
+    std::vector<GLchar> name(maximumLength + 1);
+
+    for (GLint i = 0; i < uniformCount; i++) {
+        ShaderUniform uniform;
+        GLsizei length = 0;
+        GLuint index = (GLuint)i;
+
+        glGetActiveUniform(
+            program, index, (GLsizei)name.size(), &length, &uniform.size, &uniform.type, name.data());
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &uniform.blockIndex);
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &uniform.offset);
+
+        // Arrays are named after their first element
+        uniform.name.assign(name.data(), length);
+
+        if (uniform.name.size() > 3 && uniform.name.compare(uniform.name.size() - 3, 3, "[0]") == 0)
+            uniform.name.resize(uniform.name.size() - 3);
+
+        uniform.location = uniform.blockIndex < 0 ?
+            glGetUniformLocation(program, uniform.name.c_str()) : -1;
+
+        activeUniforms.push_back(uniform);
+    }
+
+    values.assign(activeUniforms.size() * UNIFORM_VALUE_SIZE, 0.0f);
+    valid.assign(activeUniforms.size(), false);
+
+    // Reflect active uniform blocks
+    GLint blockCount = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maximumLength);
+
+    name.resize(maximumLength + 1);
+
+    for (GLint i = 0; i < blockCount; i++) {
+        ShaderUniformBlock block;
+        GLsizei length = 0;
+
+        block.index = (GLuint)i;
+
+        glGetActiveUniformBlockName(program, block.index, (GLsizei)name.size(), &length, name.data());
+        glGetActiveUniformBlockiv(program, block.index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.size);
+
+        block.name.assign(name.data(), length);
+
+        activeUniformBlocks.push_back(block);
+    }
+}
+
+void ShaderProgram::destroy() {
+    if (program != 0) {
+        if (CURRENT_PROGRAM == program) {
+            glUseProgram(0);
+            CURRENT_PROGRAM = 0;
+        }
+
+        glDeleteProgram(program);
+    }
+
+    program = 0;
+
+    activeUniforms.clear();
+    activeUniformBlocks.clear();
+    values.clear();
+    valid.clear();
+}
+
+GLuint ShaderProgram::release() {
+    GLuint id = program;
+    program = 0;
+
+    activeUniforms.clear();
+    activeUniformBlocks.clear();
+    values.clear();
+    valid.clear();
+
+    return id;
+}
+
+GLuint ShaderProgram::id() const {
+    return program;
+}
+
+void ShaderProgram::use() const {
+    if (CURRENT_PROGRAM == program)
+        return;
+
+    glUseProgram(program);
+    CURRENT_PROGRAM = program;
+}
+
+int ShaderProgram::uniform(const std::string & name) const {
+    for (size_t i = 0; i < activeUniforms.size(); i++)
+        if (activeUniforms[i].location >= 0 && activeUniforms[i].name == name)
+            return (int)i;
+
+    return -1;
+}
+
+bool ShaderProgram::update(int handle, GLenum type, const void * value, size_t size) {
+    if (handle < 0 || (size_t)handle >= activeUniforms.size())
+        return false;
+
+    const ShaderUniform & uniform = activeUniforms[handle];
+
+    if (!compatibleTypes(uniform.type, type)) {
+        LogLine() << "Uniform " << uniform.name << " set with a value of another type.";
+        return false;
+    }
+
+    GLfloat * cached = &values[handle * UNIFORM_VALUE_SIZE];
+
+    if (valid[handle] && std::memcmp(cached, value, size) == 0)
+        return false;
+
+    std::memcpy(cached, value, size);
+    valid[handle] = true;
+
+    use();
+
+    return true;
+}
+
+void ShaderProgram::set(int handle, GLint value) {
+    if (update(handle, GL_INT, &value, sizeof(value)))
+        glUniform1i(activeUniforms[handle].location, value);
+}
+
+void ShaderProgram::set(int handle, GLfloat value) {
+    if (update(handle, GL_FLOAT, &value, sizeof(value)))
+        glUniform1f(activeUniforms[handle].location, value);
+}
+
+void ShaderProgram::set(int handle, const glm::vec2 & value) {
+    if (update(handle, GL_FLOAT_VEC2, glm::value_ptr(value), sizeof(value)))
+        glUniform2fv(activeUniforms[handle].location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(int handle, const glm::vec3 & value) {
+    if (update(handle, GL_FLOAT_VEC3, glm::value_ptr(value), sizeof(value)))
+        glUniform3fv(activeUniforms[handle].location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(int handle, const glm::vec4 & value) {
+    if (update(handle, GL_FLOAT_VEC4, glm::value_ptr(value), sizeof(value)))
+        glUniform4fv(activeUniforms[handle].location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(int handle, const glm::mat3 & value) {
+    if (update(handle, GL_FLOAT_MAT3, glm::value_ptr(value), sizeof(value)))
+        glUniformMatrix3fv(activeUniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(int handle, const glm::mat4 & value) {
+    if (update(handle, GL_FLOAT_MAT4, glm::value_ptr(value), sizeof(value)))
+        glUniformMatrix4fv(activeUniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+bool ShaderProgram::bindUniformBlock(const std::string & name, GLuint binding, GLint size) {
+    for (size_t i = 0; i < activeUniformBlocks.size(); i++) {
+        const ShaderUniformBlock & block = activeUniformBlocks[i];
+
+        if (block.name != name)
+            continue;
+
+        if (size > 0 && block.size != size) {
+            LogLine() << "Uniform block " << name << " has " << block.size
+                      << " bytes instead of " << size << ".";
+            return false;
+        }
+
+        glUniformBlockBinding(program, block.index, binding);
+
+        return true;
+    }
+
+    return false;
+}
+
+const std::vector<ShaderUniform> & ShaderProgram::uniforms() const {
+    return activeUniforms;
+}
+
+const std::vector<ShaderUniformBlock> & ShaderProgram::uniformBlocks() const {
+    return activeUniformBlocks;
+}
+
+UniformBuffer::UniformBuffer() :
+        buffer(0), valid(false) {
+}
+
+UniformBuffer::~UniformBuffer() {
+    destroy();
+}
+
+void UniformBuffer::create(size_t size, GLuint binding) {
+    destroy();
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+
+    shadow.assign(size, 0);
+    valid = false;
+}
+
+void UniformBuffer::destroy() {
+    if (buffer != 0)
+        glDeleteBuffers(1, &buffer);
+
+    buffer = 0;
+    shadow.clear();
+    valid = false;
+}
+
+bool UniformBuffer::update(const void * data) {
+    if (valid && std::memcmp(shadow.data(), data, shadow.size()) == 0)
+        return false;
+
+    std::memcpy(shadow.data(), data, shadow.size());
+    valid = true;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, shadow.size(), shadow.data());
+
+    return true;
+}
+
+bool compileShader(const std::string & filename, GLenum type, GLuint & id) {
+    // Read from text file to string
+    std::string source;
+
+    if (!readTextFile(filename, source))
+        return false;
+
+    // Create shader
+    GLuint shaderID = glCreateShader(type);
+
+    // Setup shader source code
+    const GLchar * src = source.data();
+    glShaderSource(shaderID, 1, &src, nullptr);
+
+    // Compile shader
+    glCompileShader(shaderID);
+
+    // Get compilation status
+    GLint status;
+    glGetShaderiv(shaderID, GL_COMPILE_STATUS, &status);
+
+    // Check compilation errors
+    if (status != GL_TRUE) {
+        // Print log message
+        printShaderLog(shaderID);
+
+        // Delete shader
+        glDeleteShader(shaderID);
+
+        return false;
+    }
+
+    // Return shader id
+    id = shaderID;
+
+    return true;
+}
+
+bool createPrograms(
+        const std::vector<std::string> & names,
+        const std::vector<ShaderProgram *> & programs,
+        ProgramBuildStatistics * statistics) {
+    PROFILE_ZONE("createPrograms");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const ShaderExtensions & extensions = shaderExtensions();
+
+    size_t count = std::min(names.size(), programs.size());
+    size_t cached = 0, compiled = 0, failed = 0;
+
+    std::vector<std::string> vertexSources(count), fragmentSources(count);
+    std::vector<PendingProgram> pending;
+
+    for (size_t i = 0; i < count; i++) {
+        programs[i]->destroy();
+
+        if (!readTextFile(names[i] + ".vert", vertexSources[i]) ||
+                !readTextFile(names[i] + ".frag", fragmentSources[i])) {
+            LogLine() << "Cannot read shaders " << names[i] << ".";
+
+            failed++;
+            continue;
+        }
+
+        // Reload binary of a previous launch
+        GLuint programID;
+
+        if (loadProgramBinary(names[i], vertexSources[i], fragmentSources[i], programID)) {
+            programs[i]->reset(programID);
+
+            cached++;
+            continue;
+        }
+
+        PendingProgram program;
+        program.index = i;
+        program.program = glCreateProgram();
+        program.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        program.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+
+        pending.push_back(program);
+    }
+
+    // Let the driver choose its number of compiler threads
+    if (!pending.empty() && extensions.supportsParallelShaderCompile)
+        extensions.maxShaderCompilerThreads(0xffffffffu);
+
+    // Kick off every compilation and link before querying any status, so
+    // that drivers compiling in parallel work on all of them at once
+    for (size_t i = 0; i < pending.size(); i++) {
+        const PendingProgram & program = pending[i];
+
+        const GLchar * vertexSource = vertexSources[program.index].c_str();
+        const GLchar * fragmentSource = fragmentSources[program.index].c_str();
+
+        glShaderSource(program.vertexShader, 1, &vertexSource, nullptr);
+        glShaderSource(program.fragmentShader, 1, &fragmentSource, nullptr);
+        glCompileShader(program.vertexShader);
+        glCompileShader(program.fragmentShader);
+    }
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        const PendingProgram & program = pending[i];
+
+        glAttachShader(program.program, program.vertexShader);
+        glAttachShader(program.program, program.fragmentShader);
+
+        if (extensions.supportsProgramBinary)
+            extensions.programParameteri(program.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+        glLinkProgram(program.program);
+    }
+
+    // Poll completion instead of blocking on the first program
+    if (extensions.supportsParallelShaderCompile) {
+        size_t remaining = pending.size();
+        std::vector<bool> completed(pending.size(), false);
+
+        while (remaining > 0) {
+            for (size_t i = 0; i < pending.size(); i++) {
+                if (completed[i])
+                    continue;
+
+                GLint status = GL_FALSE;
+                glGetProgramiv(pending[i].program, GL_COMPLETION_STATUS_KHR, &status);
+
+                if (status == GL_TRUE) {
+                    completed[i] = true;
+                    remaining--;
+                }
+            }
+
+            if (remaining > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        const PendingProgram & program = pending[i];
+        const std::string & name = names[program.index];
+
+        GLint status;
+        glGetProgramiv(program.program, GL_LINK_STATUS, &status);
+
+        if (status != GL_TRUE) {
+            printShaderLog(program.vertexShader);
+            printShaderLog(program.fragmentShader);
+            printProgramLog(program.program);
+
+            glDeleteShader(program.vertexShader);
+            glDeleteShader(program.fragmentShader);
+            glDeleteProgram(program.program);
+
+            failed++;
+            continue;
+        }
+
+        glDetachShader(program.program, program.vertexShader);
+        glDetachShader(program.program, program.fragmentShader);
+        glDeleteShader(program.vertexShader);
+        glDeleteShader(program.fragmentShader);
+
+        if (extensions.supportsProgramBinary &&
+                !saveProgramBinary(name, vertexSources[program.index], fragmentSources[program.index], program.program))
+            LogLine() << "Cannot write program cache " << programCacheFilename(name) << ".";
+
+        // Reflect uniforms once and take ownership of the program
+        programs[program.index]->reset(program.program);
+
+        compiled++;
+    }
+
+    if (statistics != nullptr) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        statistics->cached = cached;
+        statistics->compiled = compiled;
+        statistics->failed = failed;
+        statistics->parallel = !pending.empty() && extensions.supportsParallelShaderCompile;
+        statistics->seconds = elapsed.count();
+    }
+
+    return failed == 0;
+}
+
+bool createProgram(
+        const std::string & name,
+        ShaderProgram & program,
+        ProgramBuildStatistics * statistics) {
+    return createPrograms(
+        std::vector<std::string>(1, name),
+        std::vector<ShaderProgram *>(1, &program),
+        statistics);
+}
@@ -0,0 +1,159 @@
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include <glad/glad.h>
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <string>
+#include <vector>
+
+// Uniform block binding of the per frame camera uniforms
+const GLuint CAMERA_BLOCK_BINDING = 0;
+
+// Per frame camera uniforms in std140 layout, shared by every shader
+// program declaring the Camera uniform block
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+
+    // Camera position in world space, w is 1
+    glm::vec4 position;
+};
+
+// Active uniform of a linked shader program
+// Uniforms of uniform blocks have no location but a block index and a
+// byte offset inside the block.
+struct ShaderUniform {
+    std::string name;
+    GLenum type;
+    GLint size;
+    GLint location;
+    GLint blockIndex;
+    GLint offset;
+};
+
+// Active uniform block of a linked shader program
+struct ShaderUniformBlock {
+    std::string name;
+    GLuint index;
+    GLint size;
+};
+
+// Linked shader program with its active uniforms and uniform blocks
+// reflected once, so that uniforms are set through handles instead of
+// names. Setters skip uploads of values equal to the last one.
+class ShaderProgram {
+public:
+    ShaderProgram();
+    ~ShaderProgram();
+
+    // Take ownership of a linked program and reflect it
+    void reset(GLuint id);
+
+    void destroy();
+
+    // Give up ownership of the program without deleting it, leaving this
+    // one empty
+    GLuint release();
+
+    GLuint id() const;
+
+    // Make program current when it is not already
+    void use() const;
+
+    // Handle of an active uniform outside of uniform blocks, -1 when not
+    // active, ignored by setters
+    int uniform(const std::string & name) const;
+
+    // Set uniform of the given handle, making the program current
+    void set(int handle, GLint value);
+    void set(int handle, GLfloat value);
+    void set(int handle, const glm::vec2 & value);
+    void set(int handle, const glm::vec3 & value);
+    void set(int handle, const glm::vec4 & value);
+    void set(int handle, const glm::mat3 & value);
+    void set(int handle, const glm::mat4 & value);
+
+    // Bind an active uniform block to a binding point, failing when not
+    // active or when its size differs from the expected size if given
+    bool bindUniformBlock(const std::string & name, GLuint binding, GLint size = 0);
+
+    const std::vector<ShaderUniform> & uniforms() const;
+    const std::vector<ShaderUniformBlock> & uniformBlocks() const;
+
+private:
+    ShaderProgram(const ShaderProgram &);
+    ShaderProgram & operator=(const ShaderProgram &);
+
+    // Check and record a new value, false when equal to the last one
+    bool update(int handle, GLenum type, const void * value, size_t size);
+
+    GLuint program;
+
+    std::vector<ShaderUniform> activeUniforms;
+    std::vector<ShaderUniformBlock> activeUniformBlocks;
+
+    // Last values set of every uniform, 16 floats each
+    std::vector<GLfloat> values;
+    std::vector<bool> valid;
+};
+
+// Uniform buffer bound to a uniform block binding point
+// Updates are skipped when the data equals the last upload.
+class UniformBuffer {
+public:
+    UniformBuffer();
+    ~UniformBuffer();
+
+    void create(size_t size, GLuint binding);
+
+    void destroy();
+
+    // Upload data of the buffer size, returning whether it was uploaded
+    bool update(const void * data);
+
+private:
+    UniformBuffer(const UniformBuffer &);
+    UniformBuffer & operator=(const UniformBuffer &);
+
+    GLuint buffer;
+    std::vector<unsigned char> shadow;
+    bool valid;
+};
+
+// Counters and duration of building shader programs
+struct ProgramBuildStatistics {
+    size_t cached;
+    size_t compiled;
+    size_t failed;
+    bool parallel;
+    double seconds;
+};
+
+// Compile shader source code from text file format
+bool compileShader(const std::string & filename, GLenum type, GLuint & id);
+
+// Create shader programs from the vertex and fragment shaders of the given
+// names, with .vert and .frag extensions, and reflect them
+// Programs are loaded from their binary cache when valid. The others are
+// compiled and linked together, polling their completion when the driver
+// compiles in parallel, and their binaries are cached. Programs failing to
+// build are left empty.
+bool createPrograms(
+        const std::vector<std::string> & names,
+        const std::vector<ShaderProgram *> & programs,
+        ProgramBuildStatistics * statistics = nullptr);
+
+// Create a single shader program
+bool createProgram(
+        const std::string & name,
+        ShaderProgram & program,
+        ProgramBuildStatistics * statistics = nullptr);
+
+#endif
@@ -0,0 +1,955 @@
+#include "texture.h"
+
+#include "gl_extensions.h"
+#include "image.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define TEXTURE_SSE2
+#endif
+
+namespace {
+
+// Steps of the linear to sRGB table, fine enough to round dark values right
+const size_t LINEAR_STEPS = 16384;
+
+// Texels of the smallest range of rows filtered or blocks encoded by a task
+const size_t TEXTURE_TASK_TEXELS = 16384;
+
+// Interpolation weights of 4 bit BC7 indices, out of 64
+const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Conversions between 8 bit sRGB and linear values, built once
+struct SrgbTables {
+    float toLinear[256];
+    uint8_t fromLinear[LINEAR_STEPS];
+
+    SrgbTables() {
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        for (size_t i = 0; i < LINEAR_STEPS; i++) {
+            float l = i / (float)(LINEAR_STEPS - 1);
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            fromLinear[i] = (uint8_t)std::min(255.0f, c * 255.0f + 0.5f);
+        }
+    }
+};
+
+const SrgbTables & srgbTables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+size_t totalBytes(const std::vector<TextureLevel> & levels) {
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < levels.size(); i++)
+        bytes += levels[i].bytes;
+
+    return bytes;
+}
+
+// Linear RGBA of a row of sRGB pixels, alpha scaled to [0, 1]
+void decodeRow(const uint32_t * pixels, size_t width, float * row) {
+    const SrgbTables & tables = srgbTables();
+
+    for (size_t x = 0; x < width; x++) {
+        uint32_t pixel = pixels[x];
+
+        row[x * 4] = tables.toLinear[pixel & 0xff];
+        row[x * 4 + 1] = tables.toLinear[(pixel >> 8) & 0xff];
+        row[x * 4 + 2] = tables.toLinear[(pixel >> 16) & 0xff];
+        row[x * 4 + 3] = (pixel >> 24) * (1.0f / 255.0f);
+    }
+}
+
+// Average 2 x 2 texels of two linear rows into a row of the next level,
+// repeating the last column of odd widths
+void filterRows(const float * row0, const float * row1, size_t sourceWidth, size_t width, float * target) {
+#ifdef TEXTURE_SSE2
+    const __m128 quarter = _mm_set1_ps(0.25f);
+
+    for (size_t x = 0; x < width; x++) {
+        size_t x0 = x * 2;
+        size_t x1 = std::min(x0 + 1, sourceWidth - 1);
+
+        __m128 sum = _mm_add_ps(
+            _mm_add_ps(_mm_loadu_ps(row0 + x0 * 4), _mm_loadu_ps(row0 + x1 * 4)),
+            _mm_add_ps(_mm_loadu_ps(row1 + x0 * 4), _mm_loadu_ps(row1 + x1 * 4)));
+
+        _mm_storeu_ps(target + x * 4, _mm_mul_ps(sum, quarter));
+    }
+#else
+    for (size_t x = 0; x < width; x++) {
+        size_t x0 = x * 2;
+        size_t x1 = std::min(x0 + 1, sourceWidth - 1);
+
+        for (int c = 0; c < 4; c++)
+            target[x * 4 + c] = 0.25f * (row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c]);
+    }
+#endif
+}
+
+// sRGB pixels of a row of linear RGBA
+void encodeRow(const float * row, size_t width, uint32_t * pixels) {
+    const SrgbTables & tables = srgbTables();
+
+#ifdef TEXTURE_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_setr_ps(LINEAR_STEPS - 1, LINEAR_STEPS - 1, LINEAR_STEPS - 1, 255.0f);
+
+    for (size_t x = 0; x < width; x++) {
+        __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(row + x * 4), zero), one);
+
+        // Table indices of color and rounded alpha
+        int indices[4];
+        _mm_storeu_si128((__m128i *)indices, _mm_cvtps_epi32(_mm_mul_ps(value, scale)));
+
+        pixels[x] = tables.fromLinear[indices[0]] |
+            (tables.fromLinear[indices[1]] << 8) |
+            (tables.fromLinear[indices[2]] << 16) |
+            ((uint32_t)indices[3] << 24);
+    }
+#else
+    for (size_t x = 0; x < width; x++) {
+        uint32_t pixel = 0;
+
+        for (int c = 0; c < 4; c++) {
+            float value = std::min(std::max(row[x * 4 + c], 0.0f), 1.0f);
+
+            if (c < 3)
+                pixel |= (uint32_t)tables.fromLinear[(size_t)(value * (LINEAR_STEPS - 1) + 0.5f)] << (c * 8);
+            else
+                pixel |= (uint32_t)(value * 255.0f + 0.5f) << 24;
+        }
+
+        pixels[x] = pixel;
+    }
+#endif
+}
+
+// Direction of largest variance of points of up to 4 channels around their
+// mean, by power iteration from the diagonal of their bounding box
+void principalAxis(const float (*points)[4], int channels, const float * mean, float * axis) {
+    float covariance[4][4] = {};
+    float low[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+    float high[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for (int i = 0; i < 16; i++) {
+        for (int a = 0; a < channels; a++) {
+            float da = points[i][a] - mean[a];
+
+            for (int b = a; b < channels; b++)
+                covariance[a][b] += da * (points[i][b] - mean[b]);
+
+            low[a] = std::min(low[a], points[i][a]);
+            high[a] = std::max(high[a], points[i][a]);
+        }
+    }
+
+    for (int a = 0; a < channels; a++)
+        for (int b = 0; b < a; b++)
+            covariance[a][b] = covariance[b][a];
+
+    for (int a = 0; a < 4; a++)
+        axis[a] = a < channels ? high[a] - low[a] : 0.0f;
+
+    for (int iteration = 0; iteration < 4; iteration++) {
+        float next[4] = {};
+        float length = 0.0f;
+
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++)
+                next[a] += covariance[a][b] * axis[b];
+
+            length = std::max(length, std::fabs(next[a]));
+        }
+
+        if (length < 1e-6f)
+            break;
+
+        for (int a = 0; a < channels; a++)
+            axis[a] = next[a] / length;
+    }
+
+    float length = 0.0f;
+
+    for (int a = 0; a < channels; a++)
+        length += axis[a] * axis[a];
+
+    length = std::sqrt(length);
+
+    for (int a = 0; a < channels; a++)
+        axis[a] = length > 1e-6f ? axis[a] / length : 0.0f;
+}
+
+// Endpoints of points along their principal axis, inset by a fraction of
+// their extent so that the ends fall closer to the points
+void fitEndpoints(const float (*points)[4], int channels, float inset, float * start, float * end) {
+    float mean[4] = {};
+
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < channels; c++)
+            mean[c] += points[i][c] * (1.0f / 16.0f);
+
+    float axis[4];
+    principalAxis(points, channels, mean, axis);
+
+    float low = 0.0f, high = 0.0f;
+
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+
+        for (int c = 0; c < channels; c++)
+            t += (points[i][c] - mean[c]) * axis[c];
+
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+
+    float margin = (high - low) * inset;
+    low += margin;
+    high -= margin;
+
+    for (int c = 0; c < channels; c++) {
+        start[c] = std::min(std::max(mean[c] + axis[c] * low, 0.0f), 255.0f);
+        end[c] = std::min(std::max(mean[c] + axis[c] * high, 0.0f), 255.0f);
+    }
+}
+
+inline void unpackTexel(uint32_t texel, float * point) {
+    point[0] = (float)(texel & 0xff);
+    point[1] = (float)((texel >> 8) & 0xff);
+    point[2] = (float)((texel >> 16) & 0xff);
+    point[3] = (float)(texel >> 24);
+}
+
+inline uint16_t packColor565(const float * color) {
+    int r = (int)(color[0] * (31.0f / 255.0f) + 0.5f);
+    int g = (int)(color[1] * (63.0f / 255.0f) + 0.5f);
+    int b = (int)(color[2] * (31.0f / 255.0f) + 0.5f);
+
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void unpackColor565(uint16_t color, int * rgb) {
+    int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Indices of the nearest of the four colors of BC1 endpoints in four color
+// mode, returning the squared error
+int selectColorIndices(const float (*points)[4], uint16_t color0, uint16_t color1, uint32_t & indices) {
+    int palette[4][3];
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    int error = 0;
+    indices = 0;
+
+    for (int i = 0; i < 16; i++) {
+        int best = 0, bestError = 0x7fffffff;
+
+        for (int j = 0; j < 4; j++) {
+            int distance = 0;
+
+            for (int c = 0; c < 3; c++) {
+                int d = (int)points[i][c] - palette[j][c];
+                distance += d * d;
+            }
+
+            if (distance < bestError) {
+                best = j;
+                bestError = distance;
+            }
+        }
+
+        indices |= (uint32_t)best << (i * 2);
+        error += bestError;
+    }
+
+    return error;
+}
+
+// Four color BC1 block of RGB texels, endpoints along the principal axis
+// refined once by least squares on the chosen indices
+void encodeColorBlock(const uint32_t * texels, unsigned char * block) {
+    float points[16][4];
+
+    for (int i = 0; i < 16; i++)
+        unpackTexel(texels[i], points[i]);
+
+    float start[4], end[4];
+    fitEndpoints(points, 3, 1.0f / 16.0f, start, end);
+
+    uint16_t color0 = packColor565(end);
+    uint16_t color1 = packColor565(start);
+
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices;
+    int error = selectColorIndices(points, color0, color1, indices);
+
+    // Endpoints minimizing the squared error of the chosen interpolations
+    if (color0 != color1) {
+        const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[3] = {}, bx[3] = {};
+
+        for (int i = 0; i < 16; i++) {
+            float a = weights[(indices >> (i * 2)) & 3];
+            float b = 1.0f - a;
+
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+
+            for (int c = 0; c < 3; c++) {
+                ax[c] += a * points[i][c];
+                bx[c] += b * points[i][c];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+
+        if (std::fabs(determinant) > 1e-6f) {
+            float refined0[3], refined1[3];
+
+            for (int c = 0; c < 3; c++) {
+                refined0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+                refined1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+            }
+
+            uint16_t refinedColor0 = packColor565(refined0);
+            uint16_t refinedColor1 = packColor565(refined1);
+
+            if (refinedColor0 < refinedColor1)
+                std::swap(refinedColor0, refinedColor1);
+
+            uint32_t refinedIndices;
+            int refinedError = selectColorIndices(points, refinedColor0, refinedColor1, refinedIndices);
+
+            if (refinedError < error && refinedColor0 != refinedColor1) {
+                color0 = refinedColor0;
+                color1 = refinedColor1;
+                indices = refinedIndices;
+            }
+        }
+    }
+
+    // Equal endpoints would select three color mode, every index is 0
+    if (color0 == color1)
+        indices = 0;
+
+    block[0] = (unsigned char)(color0 & 0xff);
+    block[1] = (unsigned char)(color0 >> 8);
+    block[2] = (unsigned char)(color1 & 0xff);
+    block[3] = (unsigned char)(color1 >> 8);
+
+    for (int i = 0; i < 4; i++)
+        block[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+// BC3 alpha block of eight interpolated values between the extremes
+void encodeAlphaBlock(const uint32_t * texels, unsigned char * block) {
+    int low = 255, high = 0;
+
+    for (int i = 0; i < 16; i++) {
+        int alpha = texels[i] >> 24;
+        low = std::min(low, alpha);
+        high = std::max(high, alpha);
+    }
+
+    block[0] = (unsigned char)high;
+    block[1] = (unsigned char)low;
+
+    int palette[8] = { high, low };
+
+    for (int k = 2; k < 8; k++)
+        palette[k] = ((8 - k) * high + (k - 1) * low) / 7;
+
+    uint64_t indices = 0;
+
+    if (high != low) {
+        for (int i = 0; i < 16; i++) {
+            int alpha = texels[i] >> 24;
+            int best = 0, bestError = 256;
+
+            for (int k = 0; k < 8; k++) {
+                int error = std::abs(alpha - palette[k]);
+
+                if (error < bestError) {
+                    best = k;
+                    bestError = error;
+                }
+            }
+
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+        block[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+// Quantize an endpoint to 7 bits per channel and a p bit shared by its
+// channels, choosing the p bit of the smaller error
+void quantizeBc7Endpoint(const float * endpoint, int * quantized, int & pBit) {
+    float bestError = 1e30f;
+
+    for (int p = 0; p < 2; p++) {
+        int candidate[4];
+        float error = 0.0f;
+
+        for (int c = 0; c < 4; c++) {
+            candidate[c] = std::min(std::max((int)((endpoint[c] - p) * 0.5f + 0.5f), 0), 127);
+
+            float d = (float)(candidate[c] * 2 + p) - endpoint[c];
+            error += d * d;
+        }
+
+        if (error < bestError) {
+            bestError = error;
+            pBit = p;
+            std::memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+// Appends bits to a 128 bit block from the least significant one
+struct BlockWriter {
+    uint64_t words[2];
+    int position;
+
+    void write(uint32_t value, int bits) {
+        for (int i = 0; i < bits; i++, position++)
+            words[position / 64] |= (uint64_t)((value >> i) & 1) << (position % 64);
+    }
+};
+
+// BC7 block in mode 6: one subset of RGBA endpoints with 7 bits per channel
+// and a p bit, and 4 bit indices
+void encodeBc7Block(const uint32_t * texels, unsigned char * block) {
+    float points[16][4];
+
+    for (int i = 0; i < 16; i++)
+        unpackTexel(texels[i], points[i]);
+
+    float start[4], end[4];
+    fitEndpoints(points, 4, 1.0f / 64.0f, start, end);
+
+    int quantized[2][4], pBits[2];
+    quantizeBc7Endpoint(start, quantized[0], pBits[0]);
+    quantizeBc7Endpoint(end, quantized[1], pBits[1]);
+
+    int palette[16][4];
+
+    for (int c = 0; c < 4; c++) {
+        int value0 = quantized[0][c] * 2 + pBits[0];
+        int value1 = quantized[1][c] * 2 + pBits[1];
+
+        for (int j = 0; j < 16; j++)
+            palette[j][c] = ((64 - BC7_WEIGHTS[j]) * value0 + BC7_WEIGHTS[j] * value1 + 32) >> 6;
+    }
+
+    int indices[16];
+
+    for (int i = 0; i < 16; i++) {
+        int best = 0, bestError = 0x7fffffff;
+
+        for (int j = 0; j < 16; j++) {
+            int distance = 0;
+
+            for (int c = 0; c < 4; c++) {
+                int d = (int)points[i][c] - palette[j][c];
+                distance += d * d;
+            }
+
+            if (distance < bestError) {
+                best = j;
+                bestError = distance;
+            }
+        }
+
+        indices[i] = best;
+    }
+
+    // The most significant bit of the first index is implied zero, swap
+    // endpoints otherwise
+    if (indices[0] & 8) {
+        for (int c = 0; c < 4; c++)
+            std::swap(quantized[0][c], quantized[1][c]);
+
+        std::swap(pBits[0], pBits[1]);
+
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    BlockWriter writer = { { 0, 0 }, 0 };
+
+    writer.write(1 << 6, 7);
+
+    for (int c = 0; c < 4; c++) {
+        writer.write(quantized[0][c], 7);
+        writer.write(quantized[1][c], 7);
+    }
+
+    writer.write(pBits[0], 1);
+    writer.write(pBits[1], 1);
+    writer.write(indices[0], 3);
+
+    for (int i = 1; i < 16; i++)
+        writer.write(indices[i], 4);
+
+    for (int i = 0; i < 16; i++)
+        block[i] = (unsigned char)(writer.words[i / 8] >> ((i % 8) * 8));
+}
+
+// Check whether the driver lists a compressed internal format
+bool listsCompressedFormat(GLenum format) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+
+    if (count <= 0)
+        return false;
+
+    std::vector<GLint> formats(count);
+    glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+
+    for (size_t i = 0; i < formats.size(); i++)
+        if ((GLenum)formats[i] == format)
+            return true;
+
+    return false;
+}
+
+GLenum internalFormat(TextureFormat format) {
+    switch (format) {
+    case TEXTURE_FORMAT_BC1:
+        return TEXTURE_SRGB_S3TC_DXT1;
+    case TEXTURE_FORMAT_BC3:
+        return TEXTURE_SRGB_ALPHA_S3TC_DXT5;
+    case TEXTURE_FORMAT_BC7:
+        return TEXTURE_SRGB_ALPHA_BPTC;
+    default:
+        return GL_SRGB8_ALPHA8;
+    }
+}
+
+}
+
+bool parseTextureFormat(const std::string & name, TextureFormat & format) {
+    if (name == "rgba8")
+        format = TEXTURE_FORMAT_RGBA8;
+    else if (name == "bc1")
+        format = TEXTURE_FORMAT_BC1;
+    else if (name == "bc3")
+        format = TEXTURE_FORMAT_BC3;
+    else if (name == "bc7")
+        format = TEXTURE_FORMAT_BC7;
+    else
+        return false;
+
+    return true;
+}
+
+const char * textureFormatName(TextureFormat format) {
+    switch (format) {
+    case TEXTURE_FORMAT_RGBA8:
+        return "rgba8";
+    case TEXTURE_FORMAT_BC1:
+        return "bc1";
+    case TEXTURE_FORMAT_BC3:
+        return "bc3";
+    case TEXTURE_FORMAT_BC7:
+        return "bc7";
+    }
+
+    return "unknown";
+}
+
+size_t textureLevelBytes(TextureFormat format, size_t width, size_t height) {
+    if (format == TEXTURE_FORMAT_RGBA8)
+        return width * height * 4;
+
+    size_t blocks = ((width + 3) / 4) * ((height + 3) / 4);
+
+    return blocks * (format == TEXTURE_FORMAT_BC1 ? 8 : 16);
+}
+
+void textureLevels(TextureFormat format, size_t width, size_t height, std::vector<TextureLevel> & levels) {
+    levels.clear();
+
+    size_t offset = 0;
+
+    while (levels.size() < MAX_TEXTURE_LEVELS) {
+        TextureLevel level = { width, height, offset, textureLevelBytes(format, width, height) };
+        levels.push_back(level);
+
+        offset += level.bytes;
+
+        if (width == 1 && height == 1)
+            break;
+
+        width = std::max<size_t>(width / 2, 1);
+        height = std::max<size_t>(height / 2, 1);
+    }
+}
+
+void generateMipmaps(size_t width, size_t height, const uint32_t * pixels, TextureData & texture) {
+    PROFILE_ZONE("Generate mipmaps");
+
+    texture.format = TEXTURE_FORMAT_RGBA8;
+    texture.width = width;
+    texture.height = height;
+
+    textureLevels(TEXTURE_FORMAT_RGBA8, width, height, texture.levels);
+    texture.data.resize(totalBytes(texture.levels));
+
+    std::memcpy(texture.data.data(), pixels, texture.levels[0].bytes);
+
+    // Linear texels of the previous level, the first one is decoded from
+    // its pixels a row at a time instead
+    std::vector<float> previous, current;
+
+    for (size_t i = 1; i < texture.levels.size(); i++) {
+        const TextureLevel & source = texture.levels[i - 1];
+        const TextureLevel & level = texture.levels[i];
+
+        current.resize(level.width * level.height * 4);
+
+        const uint32_t * sourcePixels = (const uint32_t *)(texture.data.data() + source.offset);
+        uint32_t * levelPixels = (uint32_t *)(texture.data.data() + level.offset);
+
+        size_t grain = std::max<size_t>(TEXTURE_TASK_TEXELS / level.width, 1);
+
+        parallelFor(level.height, grain, [&](size_t begin, size_t end) {
+            std::vector<float> decoded(i == 1 ? source.width * 8 : 0);
+
+            for (size_t y = begin; y < end; y++) {
+                size_t y0 = y * 2;
+                size_t y1 = std::min(y0 + 1, source.height - 1);
+
+                const float * row0;
+                const float * row1;
+
+                if (i == 1) {
+                    decodeRow(sourcePixels + y0 * source.width, source.width, decoded.data());
+                    decodeRow(sourcePixels + y1 * source.width, source.width, decoded.data() + source.width * 4);
+
+                    row0 = decoded.data();
+                    row1 = decoded.data() + source.width * 4;
+                }
+                else {
+                    row0 = previous.data() + y0 * source.width * 4;
+                    row1 = previous.data() + y1 * source.width * 4;
+                }
+
+                float * target = current.data() + y * level.width * 4;
+
+                filterRows(row0, row1, source.width, level.width, target);
+                encodeRow(target, level.width, levelPixels + y * level.width);
+            }
+        });
+
+        previous.swap(current);
+    }
+}
+
+void compressTexture(TextureFormat format, TextureData & texture) {
+    if (format == TEXTURE_FORMAT_RGBA8 || texture.format != TEXTURE_FORMAT_RGBA8)
+        return;
+
+    PROFILE_ZONE("Compress texture");
+
+    std::vector<TextureLevel> levels;
+    textureLevels(format, texture.width, texture.height, levels);
+
+    std::vector<unsigned char> data(totalBytes(levels));
+    size_t blockBytes = format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const TextureLevel & source = texture.levels[i];
+        const TextureLevel & level = levels[i];
+
+        const uint32_t * pixels = (const uint32_t *)(texture.data.data() + source.offset);
+        unsigned char * blocks = data.data() + level.offset;
+
+        size_t blocksWide = (level.width + 3) / 4;
+        size_t blocksHigh = (level.height + 3) / 4;
+        size_t grain = std::max<size_t>(TEXTURE_TASK_TEXELS / 16 / blocksWide, 1);
+
+        parallelFor(blocksHigh, grain, [&](size_t begin, size_t end) {
+            uint32_t texels[16];
+
+            for (size_t by = begin; by < end; by++) {
+                for (size_t bx = 0; bx < blocksWide; bx++) {
+                    // Texels of the block, repeating the last row and column
+                    for (size_t y = 0; y < 4; y++) {
+                        size_t row = std::min(by * 4 + y, level.height - 1);
+
+                        for (size_t x = 0; x < 4; x++)
+                            texels[y * 4 + x] = pixels[row * level.width + std::min(bx * 4 + x, level.width - 1)];
+                    }
+
+                    unsigned char * block = blocks + (by * blocksWide + bx) * blockBytes;
+
+                    if (format == TEXTURE_FORMAT_BC1)
+                        encodeColorBlock(texels, block);
+                    else if (format == TEXTURE_FORMAT_BC3) {
+                        encodeAlphaBlock(texels, block);
+                        encodeColorBlock(texels, block + 8);
+                    }
+                    else
+                        encodeBc7Block(texels, block);
+                }
+            }
+        });
+    }
+
+    texture.format = format;
+    texture.levels.swap(levels);
+    texture.data.swap(data);
+}
+
+bool buildTexture(
+        const std::string & filename,
+        TextureFormat format,
+        TextureData & texture,
+        TextureStatistics * statistics) {
+    PROFILE_ZONE("buildTexture");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    size_t width, height;
+    std::vector<uint32_t> pixels;
+
+    if (!readImage(filename, width, height, pixels) || std::max(width, height) > (1u << (MAX_TEXTURE_LEVELS - 1)))
+        return false;
+
+    // Rows from the bottom, where texture coordinates start
+    for (size_t y = 0; y < height / 2; y++)
+        std::swap_ranges(
+            pixels.begin() + y * width,
+            pixels.begin() + (y + 1) * width,
+            pixels.begin() + (height - 1 - y) * width);
+
+    std::chrono::steady_clock::time_point decoded = std::chrono::steady_clock::now();
+
+    generateMipmaps(width, height, pixels.data(), texture);
+    std::vector<uint32_t>().swap(pixels);
+
+    std::chrono::steady_clock::time_point filtered = std::chrono::steady_clock::now();
+
+    compressTexture(format, texture);
+
+    std::chrono::steady_clock::time_point encoded = std::chrono::steady_clock::now();
+
+    if (statistics != nullptr) {
+        std::vector<TextureLevel> uncompressed;
+        textureLevels(TEXTURE_FORMAT_RGBA8, width, height, uncompressed);
+
+        statistics->format = format;
+        statistics->cached = false;
+        statistics->width = width;
+        statistics->height = height;
+        statistics->levels = texture.levels.size();
+        statistics->decodeSeconds = std::chrono::duration<double>(decoded - start).count();
+        statistics->mipmapSeconds = std::chrono::duration<double>(filtered - decoded).count();
+        statistics->encodeSeconds = std::chrono::duration<double>(encoded - filtered).count();
+        statistics->uploadSeconds = 0.0;
+        statistics->seconds = std::chrono::duration<double>(encoded - start).count();
+        statistics->bytes = totalBytes(texture.levels);
+        statistics->uncompressedBytes = totalBytes(uncompressed);
+    }
+
+    return true;
+}
+
+bool bakeTexture(const std::string & filename, TextureFormat format, TextureStatistics * statistics) {
+    PROFILE_ZONE("bakeTexture");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    TextureCache cache;
+
+    if (cache.open(filename, format)) {
+        if (statistics != nullptr) {
+            const TextureCacheHeader & header = cache.header();
+
+            std::vector<TextureLevel> uncompressed;
+            textureLevels(TEXTURE_FORMAT_RGBA8, header.width, header.height, uncompressed);
+
+            statistics->format = format;
+            statistics->cached = true;
+            statistics->width = header.width;
+            statistics->height = header.height;
+            statistics->levels = header.levelCount;
+            statistics->decodeSeconds = 0.0;
+            statistics->mipmapSeconds = 0.0;
+            statistics->encodeSeconds = 0.0;
+            statistics->uploadSeconds = 0.0;
+            statistics->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            statistics->bytes = totalBytes(cache.levels());
+            statistics->uncompressedBytes = totalBytes(uncompressed);
+        }
+
+        return true;
+    }
+
+    TextureData texture;
+
+    if (!buildTexture(filename, format, texture, statistics))
+        return false;
+
+    bool written = writeTextureCache(filename, texture);
+
+    if (statistics != nullptr)
+        statistics->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return written;
+}
+
+bool supportsTextureFormat(TextureFormat format) {
+    switch (format) {
+    case TEXTURE_FORMAT_BC1:
+    case TEXTURE_FORMAT_BC3:
+        return (hasExtension("GL_EXT_texture_compression_s3tc") &&
+                (hasExtension("GL_EXT_texture_sRGB") || hasExtension("GL_EXT_texture_compression_s3tc_srgb"))) ||
+            listsCompressedFormat(internalFormat(format));
+    case TEXTURE_FORMAT_BC7: {
+        // BPTC is core since OpenGL 4.2
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+        return major > 4 || (major == 4 && minor >= 2) || hasExtension("GL_ARB_texture_compression_bptc");
+    }
+    default:
+        return true;
+    }
+}
+
+void uploadTexture(
+        TextureFormat format,
+        const std::vector<TextureLevel> & levels,
+        const void * data,
+        GLuint & texture) {
+    PROFILE_ZONE("uploadTexture");
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    const unsigned char * bytes = (const unsigned char *)data;
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const TextureLevel & level = levels[i];
+
+        if (format == TEXTURE_FORMAT_RGBA8)
+            glTexImage2D(
+                GL_TEXTURE_2D, (GLint)i, GL_SRGB8_ALPHA8, (GLsizei)level.width, (GLsizei)level.height, 0,
+                GL_RGBA, GL_UNSIGNED_BYTE, bytes + level.offset);
+        else
+            glCompressedTexImage2D(
+                GL_TEXTURE_2D, (GLint)i, internalFormat(format), (GLsizei)level.width, (GLsizei)level.height, 0,
+                (GLsizei)level.bytes, bytes + level.offset);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+}
+
+bool loadTexture(
+        const std::string & filename,
+        TextureFormat format,
+        GLuint & texture,
+        TextureStatistics * statistics) {
+    PROFILE_ZONE("loadTexture");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (!supportsTextureFormat(format))
+        format = TEXTURE_FORMAT_RGBA8;
+
+    // Upload from binary texture cache when valid
+    TextureCache cache;
+
+    if (cache.open(filename, format)) {
+        const TextureCacheHeader & header = cache.header();
+        std::vector<TextureLevel> levels = cache.levels();
+
+        std::chrono::steady_clock::time_point opened = std::chrono::steady_clock::now();
+
+        uploadTexture(format, levels, cache.data(), texture);
+
+        if (statistics != nullptr) {
+            std::chrono::steady_clock::time_point uploaded = std::chrono::steady_clock::now();
+
+            std::vector<TextureLevel> uncompressed;
+            textureLevels(TEXTURE_FORMAT_RGBA8, header.width, header.height, uncompressed);
+
+            statistics->format = format;
+            statistics->cached = true;
+            statistics->width = header.width;
+            statistics->height = header.height;
+            statistics->levels = levels.size();
+            statistics->decodeSeconds = 0.0;
+            statistics->mipmapSeconds = 0.0;
+            statistics->encodeSeconds = 0.0;
+            statistics->uploadSeconds = std::chrono::duration<double>(uploaded - opened).count();
+            statistics->seconds = std::chrono::duration<double>(uploaded - start).count();
+            statistics->bytes = totalBytes(levels);
+            statistics->uncompressedBytes = totalBytes(uncompressed);
+        }
+
+        return true;
+    }
+
+    // Rebuild texture from the image and refresh cache
+    TextureData data;
+
+    if (!buildTexture(filename, format, data, statistics))
+        return false;
+
+    std::chrono::steady_clock::time_point built = std::chrono::steady_clock::now();
+
+    uploadTexture(format, data.levels, data.data.data(), texture);
+
+    if (statistics != nullptr) {
+        std::chrono::steady_clock::time_point uploaded = std::chrono::steady_clock::now();
+
+        statistics->uploadSeconds = std::chrono::duration<double>(uploaded - built).count();
+        statistics->seconds = std::chrono::duration<double>(uploaded - start).count();
+    }
+
+    writeTextureCache(filename, data);
+
+    return true;
+}
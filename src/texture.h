@@ -0,0 +1,131 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Mip levels of the largest texture, 32768 x 32768 texels
+const size_t MAX_TEXTURE_LEVELS = 16;
+
+// Internal formats of the compressed sRGB formats, which glad does not define
+const GLenum TEXTURE_SRGB_S3TC_DXT1 = 0x8C4C;
+const GLenum TEXTURE_SRGB_ALPHA_S3TC_DXT5 = 0x8C4F;
+const GLenum TEXTURE_SRGB_ALPHA_BPTC = 0x8E8D;
+
+// GPU format of texture levels, sRGB encoded color with linear alpha
+enum TextureFormat {
+    // Uncompressed 8 bit RGBA, 4 bytes per texel
+    TEXTURE_FORMAT_RGBA8,
+
+    // RGB 565 endpoints and 2 bit indices, opaque, 8 bytes per 4 x 4 block
+    TEXTURE_FORMAT_BC1,
+
+    // BC1 color and interpolated 8 bit alpha, 16 bytes per 4 x 4 block
+    TEXTURE_FORMAT_BC3,
+
+    // BPTC RGBA of 7 bit endpoints and 4 bit indices, 16 bytes per 4 x 4 block
+    TEXTURE_FORMAT_BC7
+};
+
+// Parse texture format name: rgba8, bc1, bc3 or bc7
+bool parseTextureFormat(const std::string & name, TextureFormat & format);
+
+const char * textureFormatName(TextureFormat format);
+
+// Bytes of a level of the given size in texels
+size_t textureLevelBytes(TextureFormat format, size_t width, size_t height);
+
+// Level of a mip chain, at a byte offset of the data of its texture
+struct TextureLevel {
+    size_t width;
+    size_t height;
+    size_t offset;
+    size_t bytes;
+};
+
+// Levels from the given size down to 1 x 1, stored contiguously from the
+// largest
+void textureLevels(TextureFormat format, size_t width, size_t height, std::vector<TextureLevel> & levels);
+
+// Texture with its full mip chain in a GPU ready format, rows of every
+// level from the bottom as OpenGL expects them
+struct TextureData {
+    TextureFormat format;
+    size_t width;
+    size_t height;
+
+    std::vector<TextureLevel> levels;
+    std::vector<unsigned char> data;
+};
+
+// Time spent on every step of a texture load and its video memory
+struct TextureStatistics {
+    // Format of the levels, RGBA8 when the requested one cannot be sampled
+    TextureFormat format;
+
+    // Levels were read from the binary texture cache
+    bool cached;
+
+    size_t width;
+    size_t height;
+    size_t levels;
+
+    double decodeSeconds;
+    double mipmapSeconds;
+    double encodeSeconds;
+    double uploadSeconds;
+    double seconds;
+
+    // Bytes of every level in the loaded format and as uncompressed RGBA8
+    size_t bytes;
+    size_t uncompressedBytes;
+};
+
+// Build the full mip chain of RGBA8 sRGB pixels into RGBA8 levels
+// Every level is a 2 x 2 box filter of the previous one, averaged in linear
+// space so that mips keep the brightness of the image. Odd sizes repeat
+// their last row or column. Rows are filtered in parallel.
+void generateMipmaps(size_t width, size_t height, const uint32_t * pixels, TextureData & texture);
+
+// Compress RGBA8 levels into the given format, blocks in parallel
+// Blocks hang over the edges of levels smaller than 4 texels by repeating
+// their last row and column.
+void compressTexture(TextureFormat format, TextureData & texture);
+
+// Decode image file and build its mip chain in the given format
+bool buildTexture(
+        const std::string & filename,
+        TextureFormat format,
+        TextureData & texture,
+        TextureStatistics * statistics = nullptr);
+
+// Refresh the binary texture cache of an image file when missing or stale,
+// callable from any thread, ahead of a later load
+bool bakeTexture(const std::string & filename, TextureFormat format, TextureStatistics * statistics = nullptr);
+
+// Whether the current context samples the given format
+bool supportsTextureFormat(TextureFormat format);
+
+// Upload levels to a new texture object sampled with trilinear filtering
+// and repeat wrapping, bound to the current texture unit
+void uploadTexture(
+        TextureFormat format,
+        const std::vector<TextureLevel> & levels,
+        const void * data,
+        GLuint & texture);
+
+// Load texture of an image file to OpenGL
+// Levels are uploaded straight from the memory mapped binary texture cache
+// next to the image while it is valid, and built from the image otherwise,
+// refreshing the cache. Formats the context cannot sample fall back to RGBA8.
+bool loadTexture(
+        const std::string & filename,
+        TextureFormat format,
+        GLuint & texture,
+        TextureStatistics * statistics = nullptr);
+
+#endif
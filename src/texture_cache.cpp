@@ -0,0 +1,223 @@
+#include "texture_cache.h"
+
+#include "hash.h"
+
+#include <sys/stat.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const char MAGIC[8] = { 'C', 'G', 'T', 'E', 'X', 'T', '\0', '\0' };
+
+// Size and modification time of a file
+bool fileStatus(const std::string & filename, uint64_t & size, int64_t & time) {
+    struct stat status;
+
+    if (stat(filename.c_str(), &status) != 0)
+        return false;
+
+    size = (uint64_t)status.st_size;
+    time = (int64_t)status.st_mtime;
+
+    return true;
+}
+
+// Content hash of a file
+bool fileHash(const std::string & filename, uint64_t & hash) {
+    MappedFile file;
+
+    if (!file.open(filename))
+        return false;
+
+    hash = hashBytes(file.data(), file.size());
+
+    return true;
+}
+
+inline uint64_t alignOffset(uint64_t offset) {
+    return (offset + TEXTURE_CACHE_ALIGNMENT - 1) / TEXTURE_CACHE_ALIGNMENT * TEXTURE_CACHE_ALIGNMENT;
+}
+
+// Write zero padding up to the given offset
+void writePadding(std::ofstream & file, uint64_t offset) {
+    static const char zeros[TEXTURE_CACHE_ALIGNMENT] = {};
+
+    uint64_t position = (uint64_t)file.tellp();
+
+    if (offset > position)
+        file.write(zeros, offset - position);
+}
+
+}
+
+TextureCache::TextureCache() {
+}
+
+bool TextureCache::open(const std::string & sourceFilename, TextureFormat format) {
+    close();
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+
+    if (!fileStatus(sourceFilename, sourceSize, sourceTime))
+        return false;
+
+    std::string filename = textureCacheFilename(sourceFilename);
+
+    if (!file.open(filename))
+        return false;
+
+    // Check format
+    const TextureCacheHeader * header = (const TextureCacheHeader *)file.data();
+
+    if (file.size() < sizeof(TextureCacheHeader) ||
+            std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header->version != TEXTURE_CACHE_VERSION ||
+            header->alignment != TEXTURE_CACHE_ALIGNMENT ||
+            header->format != (uint32_t)format ||
+            header->width == 0 ||
+            header->height == 0 ||
+            header->levelCount == 0 ||
+            header->levelCount > MAX_TEXTURE_LEVELS) {
+        close();
+        return false;
+    }
+
+    // Check that levels have the sizes of the format and fit in the file
+    std::vector<TextureLevel> expected;
+    textureLevels(format, header->width, header->height, expected);
+
+    bool valid = expected.size() == header->levelCount;
+
+    for (size_t i = 0; valid && i < expected.size(); i++)
+        valid = header->levelBytes[i] == expected[i].bytes &&
+            header->levelOffsets[i] + header->levelBytes[i] <= file.size();
+
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    // Check source identity, a size change always invalidates the cache
+    if (header->sourceSize != sourceSize) {
+        close();
+        return false;
+    }
+
+    if (header->sourceTime == sourceTime)
+        return true;
+
+    // Touched but possibly unchanged source, compare contents
+    uint64_t sourceHash;
+
+    if (!fileHash(sourceFilename, sourceHash) || sourceHash != header->sourceHash) {
+        close();
+        return false;
+    }
+
+    // Record the new modification time to skip hashing next time
+    std::fstream update(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+
+    if (update.is_open()) {
+        update.seekp(offsetof(TextureCacheHeader, sourceTime));
+        update.write((const char *)&sourceTime, sizeof(sourceTime));
+    }
+
+    return true;
+}
+
+void TextureCache::close() {
+    file.close();
+}
+
+const TextureCacheHeader & TextureCache::header() const {
+    return *(const TextureCacheHeader *)file.data();
+}
+
+std::vector<TextureLevel> TextureCache::levels() const {
+    const TextureCacheHeader & cached = header();
+
+    std::vector<TextureLevel> levels;
+    textureLevels((TextureFormat)cached.format, cached.width, cached.height, levels);
+
+    for (size_t i = 0; i < levels.size(); i++)
+        levels[i].offset = (size_t)cached.levelOffsets[i];
+
+    return levels;
+}
+
+const void * TextureCache::data() const {
+    return file.data();
+}
+
+std::string textureCacheFilename(const std::string & sourceFilename) {
+    size_t separator = sourceFilename.find_last_of("/\\");
+    size_t extension = sourceFilename.rfind('.');
+
+    if (extension == std::string::npos ||
+            (separator != std::string::npos && extension < separator))
+        return sourceFilename + ".texture";
+
+    return sourceFilename.substr(0, extension) + ".texture";
+}
+
+bool writeTextureCache(const std::string & sourceFilename, const TextureData & texture) {
+    TextureCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.alignment = TEXTURE_CACHE_ALIGNMENT;
+
+    if (!fileStatus(sourceFilename, header.sourceSize, header.sourceTime) ||
+            !fileHash(sourceFilename, header.sourceHash))
+        return false;
+
+    if (texture.levels.empty() || texture.levels.size() > MAX_TEXTURE_LEVELS)
+        return false;
+
+    header.format = (uint32_t)texture.format;
+    header.width = (uint32_t)texture.width;
+    header.height = (uint32_t)texture.height;
+    header.levelCount = (uint32_t)texture.levels.size();
+
+    uint64_t offset = sizeof(TextureCacheHeader);
+
+    for (size_t i = 0; i < texture.levels.size(); i++) {
+        header.levelOffsets[i] = alignOffset(offset);
+        header.levelBytes[i] = texture.levels[i].bytes;
+
+        offset = header.levelOffsets[i] + header.levelBytes[i];
+    }
+
+    // Write to a temporary file replacing the cache only when complete
+    std::string filename = textureCacheFilename(sourceFilename);
+    std::string temporaryFilename = filename + ".tmp";
+
+    std::ofstream file(temporaryFilename.c_str(), std::ios::out | std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    file.write((const char *)&header, sizeof(header));
+
+    for (size_t i = 0; i < texture.levels.size(); i++) {
+        writePadding(file, header.levelOffsets[i]);
+        file.write((const char *)texture.data.data() + texture.levels[i].offset, header.levelBytes[i]);
+    }
+
+    file.close();
+
+    if (!file) {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    std::remove(filename.c_str());
+
+    return std::rename(temporaryFilename.c_str(), filename.c_str()) == 0;
+}
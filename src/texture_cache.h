@@ -0,0 +1,67 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "mapped_file.h"
+#include "texture.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary texture cache file format version, incremented on every layout change
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+// Alignment in bytes of the levels inside a texture cache file
+const uint32_t TEXTURE_CACHE_ALIGNMENT = 64;
+
+// Header at the beginning of a binary texture cache file
+// The source image is identified by size, modification time and content
+// hash. Levels are GPU ready in the recorded format, from the largest, at
+// offsets aligned to TEXTURE_CACHE_ALIGNMENT.
+struct TextureCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t alignment;
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+
+    uint64_t levelOffsets[MAX_TEXTURE_LEVELS];
+    uint64_t levelBytes[MAX_TEXTURE_LEVELS];
+};
+
+// Memory mapped binary texture cache
+class TextureCache {
+public:
+    TextureCache();
+
+    // Map cache file of a source image, failing if missing, stale or
+    // written in another format
+    bool open(const std::string & sourceFilename, TextureFormat format);
+
+    void close();
+
+    const TextureCacheHeader & header() const;
+
+    // Levels at offsets from the beginning of the cache data
+    std::vector<TextureLevel> levels() const;
+
+    const void * data() const;
+
+private:
+    MappedFile file;
+};
+
+// Cache file name of a source image, next to it
+std::string textureCacheFilename(const std::string & sourceFilename);
+
+// Write texture to the cache file of its source image
+bool writeTextureCache(const std::string & sourceFilename, const TextureData & texture);
+
+#endif